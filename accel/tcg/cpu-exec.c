@@ -43,6 +43,7 @@
 #include "tb-hash.h"
 #include "tb-context.h"
 #include "internal.h"
+#include "translate-ahead.h"
 
 /* -icount align implementation. */
 
@@ -237,6 +238,156 @@ static TranslationBlock *tb_htable_lookup(CPUState *cpu, vaddr pc,
     return qht_lookup_custom(&tb_ctx.htable, &desc, h, tb_lookup_cmp);
 }
 
+/* As tb_lookup_cmp, but taking any second page as a match */
+static bool tb_present_cmp(const void *p, const void *d)
+{
+    const TranslationBlock *tb = p;
+    const struct tb_desc *desc = d;
+
+    return (tb_cflags(tb) & CF_PCREL || tb->pc == desc->pc) &&
+           tb_page_addr0(tb) == desc->page_addr0 &&
+           tb->cs_base == desc->cs_base &&
+           tb->flags == desc->flags &&
+           tb_cflags(tb) == desc->cflags;
+}
+
+/*
+ * The TB for the given state starting on @phys_pc, if any.  Unlike
+ * tb_htable_lookup this does not look at any vCPU's TLB, so it may be
+ * called from any thread; a TB that crosses into a second page counts
+ * whatever that page maps to now.
+ */
+TranslationBlock *tb_htable_find(vaddr pc, uint64_t cs_base, uint32_t flags,
+                                 uint32_t cflags, tb_page_addr_t phys_pc)
+{
+    struct tb_desc desc;
+    uint32_t h;
+
+    desc.env = NULL;
+    desc.cs_base = cs_base;
+    desc.flags = flags;
+    desc.cflags = cflags;
+    desc.pc = pc;
+    desc.page_addr0 = phys_pc;
+    h = tb_hash_func(phys_pc, (cflags & CF_PCREL ? 0 : pc),
+                     flags, cs_base, cflags);
+    return qht_lookup_custom(&tb_ctx.htable, &desc, h, tb_present_cmp);
+}
+
+#ifdef CONFIG_SOFTMMU
+bool tb_htable_present(vaddr pc, uint64_t cs_base, uint32_t flags,
+                       uint32_t cflags, tb_page_addr_t phys_pc)
+{
+    return tb_htable_find(pc, cs_base, flags, cflags, phys_pc) != NULL;
+}
+#endif
+
+static CPUJumpCache *tb_jmp_cache_new(unsigned int bits)
+{
+    CPUJumpCache *jc = g_malloc0(sizeof(CPUJumpCache) +
+                                 (sizeof(CPUJumpCacheEntry) << bits));
+
+    jc->bits = bits;
+    return jc;
+}
+
+/* Replace the jump cache by one twice the size; run with all vCPUs out. */
+static void tb_jmp_cache_grow(CPUState *cpu, run_on_cpu_data data)
+{
+    CPUJumpCache *old = cpu->tb_jmp_cache;
+    CPUJumpCache *jc;
+
+    if (old->bits >= tb_jmp_cache_max_bits) {
+        return;
+    }
+    jc = tb_jmp_cache_new(old->bits + 1);
+    jc->hits = old->hits;
+    jc->victim_hits = old->victim_hits;
+    jc->misses = old->misses;
+    jc->window_lookups = old->window_lookups;
+
+    qatomic_rcu_set(&cpu->tb_jmp_cache, jc);
+    g_free_rcu(old, rcu);
+}
+
+/*
+ * Count a lookup that had to go to the global hash table.  Once per
+ * window, grow the direct-mapped level if more than one lookup in
+ * sixteen ended up there.
+ */
+static void tb_jmp_cache_miss(CPUState *cpu, CPUJumpCache *jc)
+{
+    size_t lookups;
+
+    qatomic_set(&jc->misses, jc->misses + 1);
+    if (++jc->window_misses < TB_JMP_CACHE_WINDOW) {
+        return;
+    }
+
+    lookups = jc->hits + jc->victim_hits + jc->misses;
+    if (jc->bits < tb_jmp_cache_max_bits &&
+        lookups - jc->window_lookups < TB_JMP_CACHE_WINDOW * 16) {
+        async_safe_run_on_cpu(cpu, tb_jmp_cache_grow, RUN_ON_CPU_NULL);
+    }
+    jc->window_lookups = lookups;
+    jc->window_misses = 0;
+}
+
+/* Look for @pc in the victim level; a hit leaves the victim level. */
+static TranslationBlock *tb_jmp_victim_lookup(CPUJumpCache *jc, vaddr pc,
+                                              uint64_t cs_base,
+                                              uint32_t flags, uint32_t cflags)
+{
+    CPUJumpCacheEntry *set = jc->victim[tb_jmp_victim_set(pc)];
+
+    for (int i = 0; i < TB_JMP_VICTIM_WAYS; i++) {
+        /* Use acquire to ensure current load of pc from the entry. */
+        TranslationBlock *tb = qatomic_load_acquire(&set[i].tb);
+
+        if (tb &&
+            set[i].pc == pc &&
+            tb->cs_base == cs_base &&
+            tb->flags == flags &&
+            tb_cflags(tb) == cflags) {
+            qatomic_set(&set[i].tb, NULL);
+            return tb;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Install @tb for @pc in slot @hash of the direct-mapped level, and
+ * move the TB it displaces to the victim level.
+ */
+static void tb_jmp_cache_fill(CPUJumpCache *jc, uint32_t hash, vaddr pc,
+                              TranslationBlock *tb, uint32_t cflags)
+{
+    CPUJumpCacheEntry *e = &jc->array[hash];
+    TranslationBlock *old = qatomic_load_acquire(&e->tb);
+
+    if (old && old != tb) {
+        vaddr old_pc = tb_cflags(old) & CF_PCREL ? e->pc : old->pc;
+        unsigned int set = tb_jmp_victim_set(old_pc);
+        unsigned int way = jc->victim_next[set];
+        CPUJumpCacheEntry *v = &jc->victim[set][way];
+
+        jc->victim_next[set] = (way + 1) % TB_JMP_VICTIM_WAYS;
+        v->pc = old_pc;
+        /* Ensure pc is written first. */
+        qatomic_store_release(&v->tb, old);
+    }
+
+    if (cflags & CF_PCREL) {
+        e->pc = pc;
+        /* Ensure pc is written first. */
+        qatomic_store_release(&e->tb, tb);
+    } else {
+        /* Use the pc value already stored in tb->pc. */
+        qatomic_set(&e->tb, tb);
+    }
+}
+
 /* Might cause an exception, so have a longjmp destination ready */
 static inline TranslationBlock *tb_lookup(CPUState *cpu, vaddr pc,
                                           uint64_t cs_base, uint32_t flags,
@@ -249,8 +400,8 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, vaddr pc,
     /* we should never be trying to look up an INVALID tb */
     tcg_debug_assert(!(cflags & CF_INVALID));
 
-    hash = tb_jmp_cache_hash_func(pc);
     jc = cpu->tb_jmp_cache;
+    hash = tb_jmp_cache_hash_func(jc, pc);
 
     if (cflags & CF_PCREL) {
         /* Use acquire to ensure current load of pc from jc. */
@@ -261,15 +412,9 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, vaddr pc,
                    tb->cs_base == cs_base &&
                    tb->flags == flags &&
                    tb_cflags(tb) == cflags)) {
+            qatomic_set(&jc->hits, jc->hits + 1);
             return tb;
         }
-        tb = tb_htable_lookup(cpu, pc, cs_base, flags, cflags);
-        if (tb == NULL) {
-            return NULL;
-        }
-        jc->array[hash].pc = pc;
-        /* Ensure pc is written first. */
-        qatomic_store_release(&jc->array[hash].tb, tb);
     } else {
         /* Use rcu_read to ensure current load of pc from *tb. */
         tb = qatomic_rcu_read(&jc->array[hash].tb);
@@ -279,15 +424,22 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, vaddr pc,
                    tb->cs_base == cs_base &&
                    tb->flags == flags &&
                    tb_cflags(tb) == cflags)) {
+            qatomic_set(&jc->hits, jc->hits + 1);
             return tb;
         }
+    }
+
+    tb = tb_jmp_victim_lookup(jc, pc, cs_base, flags, cflags);
+    if (tb) {
+        qatomic_set(&jc->victim_hits, jc->victim_hits + 1);
+    } else {
         tb = tb_htable_lookup(cpu, pc, cs_base, flags, cflags);
         if (tb == NULL) {
             return NULL;
         }
-        /* Use the pc value already stored in tb->pc. */
-        qatomic_set(&jc->array[hash].tb, tb);
+        tb_jmp_cache_miss(cpu, jc);
     }
+    tb_jmp_cache_fill(jc, hash, pc, tb, cflags);
 
     return tb;
 }
@@ -396,6 +548,31 @@ static inline bool check_for_breakpoints(CPUState *cpu, vaddr pc,
         check_for_breakpoints_slow(cpu, pc, cflags);
 }
 
+static TranslationBlock *lookup_tb_ptr(CPUArchState *env, vaddr *ppc)
+{
+    CPUState *cpu = env_cpu(env);
+    TranslationBlock *tb;
+    uint64_t cs_base;
+    uint32_t flags, cflags;
+
+    cpu_get_tb_cpu_state(env, ppc, &cs_base, &flags);
+
+    cflags = curr_cflags(cpu);
+    if (check_for_breakpoints(cpu, *ppc, &cflags)) {
+        cpu_loop_exit(cpu);
+    }
+
+    tb = tb_lookup(cpu, *ppc, cs_base, flags, cflags);
+    if (tb == NULL) {
+        return NULL;
+    }
+
+    if (qemu_loglevel_mask(CPU_LOG_TB_CPU | CPU_LOG_EXEC)) {
+        log_cpu_exec(*ppc, cpu, tb);
+    }
+    return tb;
+}
+
 /**
  * helper_lookup_tb_ptr: quick check for next tb
  * @env: current cpu state
@@ -406,29 +583,119 @@ static inline bool check_for_breakpoints(CPUState *cpu, vaddr pc,
  */
 const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
 {
-    CPUState *cpu = env_cpu(env);
     TranslationBlock *tb;
     vaddr pc;
-    uint64_t cs_base;
-    uint32_t flags, cflags;
 
-    cpu_get_tb_cpu_state(env, &pc, &cs_base, &flags);
+    tb = lookup_tb_ptr(env, &pc);
+    return tb ? tb->tc.ptr : tcg_code_gen_epilogue;
+}
 
-    cflags = curr_cflags(cpu);
-    if (check_for_breakpoints(cpu, pc, &cflags)) {
-        cpu_loop_exit(cpu);
+uintptr_t tb_ic_gen_next = 1;
+#ifdef CONFIG_USER_ONLY
+uintptr_t tb_ic_gen;
+#endif
+
+/*
+ * Record @tb, which @cpu found for @pc, in @ic.  A way that already
+ * holds @tb for @pc, filled before the last flush of some jump cache,
+ * only has its generation renewed: with a single mapping for @pc the
+ * record is now valid for @cpu.  Otherwise a new record replaces the
+ * next way, until the site has proven too polymorphic to be worth it.
+ */
+static void tb_ic_fill(CPUState *cpu, TBInlineCache *ic, vaddr pc,
+                       TranslationBlock *tb)
+{
+    uintptr_t gen = qatomic_read(tb_ic_gen_ptr(cpu));
+    TBInlineRecord *rec, *old;
+    unsigned int i;
+
+    for (i = 0; i < ic->ways; i++) {
+        rec = qatomic_rcu_read(&ic->way[i]);
+        if (rec && rec->pc == pc && rec->tb == tb) {
+#ifndef CONFIG_USER_ONLY
+            tb_ic_note_page(cpu, pc);
+#endif
+            qatomic_set(&rec->gen, gen);
+            return;
+        }
     }
 
-    tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
+    if (qatomic_read(&ic->fills) >= TB_IC_MAX_FILLS) {
+        return;
+    }
+    qatomic_inc(&ic->fills);
+#ifndef CONFIG_USER_ONLY
+    tb_ic_note_page(cpu, pc);
+#endif
+
+    i = qatomic_read(&ic->next) % ic->ways;
+    qatomic_set(&ic->next, i + 1);
+
+    rec = g_new(TBInlineRecord, 1);
+    rec->pc = pc;
+    rec->cs_base = tb->cs_base;
+    rec->flags = tb->flags;
+    rec->gen = gen;
+    rec->tb = tb;
+    old = qatomic_xchg(&ic->way[i], rec);
+    if (old) {
+        g_free_rcu(old, rcu);
+    }
+}
+
+/**
+ * helper_lookup_tb_ptr_ic: indirect jump miss
+ * @env: current cpu state
+ * @ic: the inline cache of the jump, or NULL
+ *
+ * As helper_lookup_tb_ptr, after the inline cache of the jump (or the
+ * return slot popped for a return) did not know the destination; the TB
+ * found is recorded in @ic.
+ */
+const void *HELPER(lookup_tb_ptr_ic)(CPUArchState *env, void *ic)
+{
+    TranslationBlock *tb;
+    vaddr pc;
+
+    tb = lookup_tb_ptr(env, &pc);
     if (tb == NULL) {
         return tcg_code_gen_epilogue;
     }
+    if (ic) {
+        tb_ic_fill(env_cpu(env), ic, pc, tb);
+    }
+    return tb->tc.ptr;
+}
 
-    if (qemu_loglevel_mask(CPU_LOG_TB_CPU | CPU_LOG_EXEC)) {
-        log_cpu_exec(pc, cpu, tb);
+/*
+ * Forget the records of @tb.  Its image was loaded from a tb-cache file,
+ * and the records of the process that saved it are long gone.
+ */
+void tb_inline_cache_reset(TranslationBlock *tb)
+{
+    for (int i = 0; i < tb->nb_ic; i++) {
+        TBInlineCache *ic = tb_inline_cache(tb, i);
+
+        memset(ic->way, 0, sizeof(ic->way));
+        ic->next = 0;
+        ic->fills = 0;
     }
+}
 
-    return tb->tc.ptr;
+/* Free the records of @tb, when the code buffer is flushed. */
+void tb_inline_cache_free(TranslationBlock *tb)
+{
+    for (int i = 0; i < tb->nb_ic; i++) {
+        TBInlineCache *ic = tb_inline_cache(tb, i);
+
+        for (int j = 0; j < TB_IC_WAYS; j++) {
+            TBInlineRecord *rec = qatomic_xchg(&ic->way[j], NULL);
+
+            if (rec) {
+                g_free_rcu(rec, rcu);
+            }
+        }
+    }
 }
 
 /* Execute a TB, and fix up the CPU state afterwards if necessary */
@@ -534,6 +801,7 @@ static void cpu_exec_longjmp_cleanup(CPUState *cpu)
 #ifdef CONFIG_USER_ONLY
     clear_helper_retaddr();
     if (have_mmap_lock()) {
+        tcg_ctx->gen_superblock = NULL;
         mmap_unlock();
     }
 #else
@@ -556,6 +824,7 @@ static void cpu_exec_longjmp_cleanup(CPUState *cpu)
         tb_unlock_pages(tcg_ctx->gen_tb);
         tcg_ctx->gen_tb = NULL;
     }
+    tcg_ctx->gen_superblock = NULL;
 #endif
     if (qemu_mutex_iothread_locked()) {
         qemu_mutex_unlock_iothread();
@@ -654,8 +923,13 @@ static inline void tb_add_jump(TranslationBlock *tb, int n,
         goto out_unlock_next;
     }
 
-    /* patch the native jump address */
-    tb_set_jmp_target(tb, n, (uintptr_t)tb_next->tc.ptr);
+    /*
+     * Patch the native jump address.  Both TBs follow the chained globals
+     * convention when they have a chain_entry, and then the loads at the
+     * start of tb_next can be skipped.
+     */
+    tb_set_jmp_target(tb, n, (uintptr_t)tb_next->tc.ptr +
+                      (tb->chain_entry ? tb_next->chain_entry : 0));
 
     /* add in TB jmp list */
     tb->jmp_list_next[n] = tb_next->jmp_list_head;
@@ -935,6 +1209,11 @@ static inline void cpu_loop_exec_tb(CPUState *cpu, TranslationBlock *tb,
         return;
     }
 
+    if (!(tb_cflags(tb) & CF_USE_ICOUNT)) {
+        /* A hot TB left to be retranslated, see tb_is_hot.  */
+        return;
+    }
+
     /* Instruction counter expired.  */
     assert(icount_enabled());
 #ifndef CONFIG_USER_ONLY
@@ -997,28 +1276,25 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
             }
 
             tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
-            if (tb == NULL) {
+            if (tb == NULL || unlikely(tb_is_hot(tb))) {
                 CPUJumpCache *jc;
                 uint32_t h;
 
                 mmap_lock();
-                tb = tb_gen_code(cpu, pc, cs_base, flags, cflags);
+                if (tb) {
+                    tb = tb_gen_superblock(cpu, tb, pc);
+                } else {
+                    tb = tb_gen_code(cpu, pc, cs_base, flags, cflags);
+                }
                 mmap_unlock();
 
                 /*
                  * We add the TB in the virtual pc hash table
                  * for the fast lookup
                  */
-                h = tb_jmp_cache_hash_func(pc);
                 jc = cpu->tb_jmp_cache;
-                if (cflags & CF_PCREL) {
-                    jc->array[h].pc = pc;
-                    /* Ensure pc is written first. */
-                    qatomic_store_release(&jc->array[h].tb, tb);
-                } else {
-                    /* Use the pc value already stored in tb->pc. */
-                    qatomic_set(&jc->array[h].tb, tb);
-                }
+                h = tb_jmp_cache_hash_func(jc, pc);
+                tb_jmp_cache_fill(jc, h, pc, tb, cflags);
             }
 
 #ifndef CONFIG_USER_ONLY
@@ -1098,7 +1374,8 @@ void tcg_exec_realizefn(CPUState *cpu, Error **errp)
         tcg_target_initialized = true;
     }
 
-    cpu->tb_jmp_cache = g_new0(CPUJumpCache, 1);
+    cpu->tb_jmp_cache = tb_jmp_cache_new(tb_jmp_cache_bits);
+    tb_ic_new_gen(cpu);
     tlb_init(cpu);
 #ifndef CONFIG_USER_ONLY
     tcg_iommu_init_notifier_list(cpu);
@@ -1110,6 +1387,7 @@ void tcg_exec_realizefn(CPUState *cpu, Error **errp)
 void tcg_exec_unrealizefn(CPUState *cpu)
 {
 #ifndef CONFIG_USER_ONLY
+    translate_ahead_cancel(cpu);
     tcg_iommu_free_notifier_list(cpu);
 #endif /* !CONFIG_USER_ONLY */
 
@@ -102,16 +102,35 @@ static void tlb_window_reset(CPUTLBDesc *desc, int64_t ns,
 static void tb_jmp_cache_clear_page(CPUState *cpu, vaddr page_addr)
 {
     CPUJumpCache *jc = cpu->tb_jmp_cache;
-    int i, i0;
+    int i, i0, n;
 
     if (unlikely(!jc)) {
         return;
     }
 
-    i0 = tb_jmp_cache_hash_page(page_addr);
-    for (i = 0; i < TB_JMP_PAGE_SIZE; i++) {
+    i0 = tb_jmp_cache_hash_page(jc, page_addr);
+    n = tb_jmp_page_size(jc);
+    for (i = 0; i < n; i++) {
         qatomic_set(&jc->array[i0 + i].tb, NULL);
     }
+
+    /* Victim entries are not grouped by page, but they record their pc. */
+    for (i = 0; i < TB_JMP_VICTIM_SETS; i++) {
+        for (int j = 0; j < TB_JMP_VICTIM_WAYS; j++) {
+            CPUJumpCacheEntry *v = &jc->victim[i][j];
+
+            if (qatomic_read(&v->tb) &&
+                (v->pc & TARGET_PAGE_MASK) == page_addr) {
+                qatomic_set(&v->tb, NULL);
+            }
+        }
+    }
+
+    /*
+     * Inline cache records are not grouped by page at all; only a page
+     * that some of them may point into retires them.
+     */
+    tb_ic_flush_page(cpu, page_addr);
 }
 
 /**
@@ -788,7 +807,7 @@ static void tlb_flush_range_by_mmuidx_async_0(CPUState *cpu,
      * If the length is larger than the jump cache size, then it will take
      * longer to clear each entry individually than it will to clear it all.
      */
-    if (d.len >= (TARGET_PAGE_SIZE * TB_JMP_CACHE_SIZE)) {
+    if (d.len >= TARGET_PAGE_SIZE * tb_jmp_cache_size(cpu->tb_jmp_cache)) {
         tcg_flush_jmp_cache(cpu);
         return;
     }
@@ -3112,50 +3131,73 @@ void cpu_st16_mmu(CPUArchState *env, target_ulong addr, Int128 val,
 
 /* Code access functions.  */
 
+/*
+ * These go through the vCPU's TLB, which a translator thread working
+ * ahead of the vCPU must not touch: it drops the TB instead.
+ */
+static inline void code_load_check_ahead(void)
+{
+    if (unlikely(tcg_ctx && tcg_ctx->gen_ahead)) {
+        siglongjmp(tcg_ctx->jmp_trans, -4);
+    }
+}
+
 uint32_t cpu_ldub_code(CPUArchState *env, abi_ptr addr)
 {
     MemOpIdx oi = make_memop_idx(MO_UB, cpu_mmu_index(env, true));
+
+    code_load_check_ahead();
     return do_ld1_mmu(env, addr, oi, 0, MMU_INST_FETCH);
 }
 
 uint32_t cpu_lduw_code(CPUArchState *env, abi_ptr addr)
 {
     MemOpIdx oi = make_memop_idx(MO_TEUW, cpu_mmu_index(env, true));
+
+    code_load_check_ahead();
     return do_ld2_mmu(env, addr, oi, 0, MMU_INST_FETCH);
 }
 
 uint32_t cpu_ldl_code(CPUArchState *env, abi_ptr addr)
 {
     MemOpIdx oi = make_memop_idx(MO_TEUL, cpu_mmu_index(env, true));
+
+    code_load_check_ahead();
     return do_ld4_mmu(env, addr, oi, 0, MMU_INST_FETCH);
 }
 
 uint64_t cpu_ldq_code(CPUArchState *env, abi_ptr addr)
 {
     MemOpIdx oi = make_memop_idx(MO_TEUQ, cpu_mmu_index(env, true));
+
+    code_load_check_ahead();
     return do_ld8_mmu(env, addr, oi, 0, MMU_INST_FETCH);
 }
 
 uint8_t cpu_ldb_code_mmu(CPUArchState *env, abi_ptr addr,
                          MemOpIdx oi, uintptr_t retaddr)
 {
+    code_load_check_ahead();
     return do_ld1_mmu(env, addr, oi, retaddr, MMU_INST_FETCH);
 }
 
 uint16_t cpu_ldw_code_mmu(CPUArchState *env, abi_ptr addr,
                           MemOpIdx oi, uintptr_t retaddr)
 {
+    code_load_check_ahead();
     return do_ld2_mmu(env, addr, oi, retaddr, MMU_INST_FETCH);
 }
 
 uint32_t cpu_ldl_code_mmu(CPUArchState *env, abi_ptr addr,
                           MemOpIdx oi, uintptr_t retaddr)
 {
+    code_load_check_ahead();
     return do_ld4_mmu(env, addr, oi, retaddr, MMU_INST_FETCH);
 }
 
 uint64_t cpu_ldq_code_mmu(CPUArchState *env, abi_ptr addr,
                           MemOpIdx oi, uintptr_t retaddr)
 {
+    code_load_check_ahead();
     return do_ld8_mmu(env, addr, oi, retaddr, MMU_INST_FETCH);
 }
@@ -9,6 +9,7 @@
 #ifndef ACCEL_TCG_INTERNAL_H
 #define ACCEL_TCG_INTERNAL_H
 
+#include "qemu/cacheinfo.h"
 #include "exec/exec-all.h"
 #include "exec/translate-all.h"
 
@@ -72,6 +73,18 @@ G_NORETURN void cpu_io_recompile(CPUState *cpu, uintptr_t retaddr);
 TranslationBlock *tb_gen_code(CPUState *cpu, vaddr pc,
                               uint64_t cs_base, uint32_t flags,
                               int cflags);
+TranslationBlock *tb_gen_superblock(CPUState *cpu, TranslationBlock *tb,
+                                    vaddr pc);
+#ifdef CONFIG_SOFTMMU
+TranslationBlock *tb_gen_code_ahead(CPUState *cpu, vaddr pc,
+                                    uint64_t cs_base, uint32_t flags,
+                                    uint32_t cflags, tb_page_addr_t phys_pc,
+                                    void *host_pc);
+bool tb_htable_present(vaddr pc, uint64_t cs_base, uint32_t flags,
+                       uint32_t cflags, tb_page_addr_t phys_pc);
+#endif
+TranslationBlock *tb_htable_find(vaddr pc, uint64_t cs_base, uint32_t flags,
+                                 uint32_t cflags, tb_page_addr_t phys_pc);
 void page_init(void);
 void tb_htable_init(void);
 void tb_reset_jump(TranslationBlock *tb, int n);
@@ -103,6 +116,85 @@ extern int64_t max_delay;
 extern int64_t max_advance;
 
 extern bool one_insn_per_tb;
+extern uint32_t tb_hot_threshold;
+extern uint32_t tb_jmp_cache_bits;
+extern uint32_t tb_jmp_cache_max_bits;
+extern bool tb_inline_cache;
+
+/* Return true if @tb is due to be retranslated as a superblock. */
+static inline bool tb_is_hot(const TranslationBlock *tb)
+{
+    return tb_hot_threshold &&
+           qatomic_read(&tb->exec_count) >= tb_hot_threshold;
+}
+
+/*
+ * The inline caches of indirect jumps in @tb (see TBInlineCache), laid
+ * out where tcg_tb_alloc() would otherwise have started its code.
+ */
+static inline TBInlineCache *tb_inline_cache(TranslationBlock *tb, int i)
+{
+    uintptr_t base = ROUND_UP((uintptr_t)(tb + 1), qemu_icache_linesize);
+
+    return (TBInlineCache *)(base + i * TB_IC_STRIDE);
+}
+
+void tb_inline_cache_reset(TranslationBlock *tb);
+void tb_inline_cache_free(TranslationBlock *tb);
+
+extern uintptr_t tb_ic_gen_next;
+#ifdef CONFIG_USER_ONLY
+extern uintptr_t tb_ic_gen;
+#endif
+
+/* The generation that inline cache records filled by @cpu are tagged with */
+static inline uintptr_t *tb_ic_gen_ptr(CPUState *cpu)
+{
+#ifdef CONFIG_USER_ONLY
+    return &tb_ic_gen;
+#else
+    return &cpu_neg(cpu)->ijmp.gen;
+#endif
+}
+
+/*
+ * Retire the records filled by @cpu so far; called when its jump cache
+ * is flushed.  Generations are never reused, short of a 32-bit host
+ * wrapping the counter.
+ */
+static inline void tb_ic_new_gen(CPUState *cpu)
+{
+    qatomic_set(tb_ic_gen_ptr(cpu), qatomic_fetch_inc(&tb_ic_gen_next));
+#ifndef CONFIG_USER_ONLY
+    qatomic_set(&cpu_neg(cpu)->ijmp.pages, 0);
+#endif
+}
+
+#ifndef CONFIG_USER_ONLY
+static inline uint64_t tb_ic_page_bit(vaddr pc)
+{
+    return 1ull << ((pc >> TARGET_PAGE_BITS) & 63);
+}
+
+/* Note that a record filled by @cpu for its generation points at @pc. */
+static inline void tb_ic_note_page(CPUState *cpu, vaddr pc)
+{
+    uint64_t *pages = &cpu_neg(cpu)->ijmp.pages;
+
+    qatomic_set(pages, qatomic_read(pages) | tb_ic_page_bit(pc));
+}
+
+/*
+ * Retire the records filled by @cpu if any of them may point into the
+ * page at @page_addr.
+ */
+static inline void tb_ic_flush_page(CPUState *cpu, vaddr page_addr)
+{
+    if (qatomic_read(&cpu_neg(cpu)->ijmp.pages) & tb_ic_page_bit(page_addr)) {
+        tb_ic_new_gen(cpu);
+    }
+}
+#endif
 
 /**
  * tcg_req_mo:
@@ -16,7 +16,10 @@
 #include "sysemu/cpu-timers.h"
 #include "sysemu/tcg.h"
 #include "tcg/tcg.h"
+#include "hw/core/cpu.h"
 #include "internal.h"
+#include "tb-jmp-cache.h"
+#include "translate-ahead.h"
 
 
 static void dump_drift_info(GString *buf)
@@ -50,6 +53,35 @@ static void dump_accel_info(GString *buf)
                            one_insn_per_tb ? "on" : "off");
 }
 
+static void dump_jmp_cache_info(GString *buf)
+{
+    CPUState *cpu;
+
+    g_string_append_printf(buf, "\nJump cache:\n");
+    RCU_READ_LOCK_GUARD();
+    CPU_FOREACH(cpu) {
+        CPUJumpCache *jc = qatomic_rcu_read(&cpu->tb_jmp_cache);
+        size_t hits, victim_hits, misses, total;
+
+        if (!jc) {
+            continue;
+        }
+        hits = qatomic_read(&jc->hits);
+        victim_hits = qatomic_read(&jc->victim_hits);
+        misses = qatomic_read(&jc->misses);
+        total = MAX(hits + victim_hits + misses, 1);
+
+        g_string_append_printf(buf, "CPU %-3d %7u entries, "
+                               "hit %zu (%.1f%%), "
+                               "victim hit %zu (%.1f%%), "
+                               "miss %zu (%.1f%%)\n",
+                               cpu->cpu_index, tb_jmp_cache_size(jc),
+                               hits, hits * 100.0 / total,
+                               victim_hits, victim_hits * 100.0 / total,
+                               misses, misses * 100.0 / total);
+    }
+}
+
 HumanReadableText *qmp_x_query_jit(Error **errp)
 {
     g_autoptr(GString) buf = g_string_new("");
@@ -61,6 +93,8 @@ HumanReadableText *qmp_x_query_jit(Error **errp)
 
     dump_accel_info(buf);
     dump_exec_info(buf);
+    dump_jmp_cache_info(buf);
+    translate_ahead_dump_info(buf);
     dump_drift_info(buf);
 
     return human_readable_text_from_str(buf);
@@ -0,0 +1,715 @@
+/*
+ * Persistent translation block cache
+ *
+ * Regression farms boot the same firmware and kernel images thousands of
+ * times, and most of a short run goes into translating the same boot code
+ * again.  With -accel tcg,tb-cache=FILE the host code of every TB is saved
+ * on exit and loaded back into the code buffer on the next start; a TB is
+ * then handed out instead of translating it when its lookup key matches
+ * and the guest bytes it was made from are unchanged.
+ *
+ * The code is not relocated: it is loaded back at the address it was
+ * generated at.  The code buffer is therefore mapped at a fixed hint
+ * (TB_CACHE_CODE_HINT), and the QEMU binary, whose helpers the code
+ * calls, must be loaded at the same address too: with a position
+ * independent build that means address space randomization has to be
+ * off, which is checked at startup.  A single code region, no split-wx
+ * mapping and the same binary, identified by its GNU build ID, are also
+ * required, all of which is checked before anything is used.  A file
+ * that does not match is ignored and replaced on exit.
+ *
+ * Only one TCG thread exists when the buffer is a single region, so the
+ * table of loaded TBs is not locked: it is set up before the vCPUs run
+ * and afterwards only touched from the translating thread.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#ifdef CONFIG_LINUX
+#include <sys/personality.h>
+#endif
+#include "qemu/cacheflush.h"
+#include "qemu/cacheinfo.h"
+#include "qemu/config-file.h"
+#include "qemu/cutils.h"
+#include "qemu/error-report.h"
+#include "qemu/notify.h"
+#include "qemu/option.h"
+#include "qom/object.h"
+#include "hw/core/cpu.h"
+#include "exec/exec-all.h"
+#include "exec/memory.h"
+#ifdef CONFIG_CSKY_TRACE
+#include "exec/tracestub.h"
+#endif
+#include "elf.h"
+#include "sysemu/sysemu.h"
+#include "tcg/tcg.h"
+#include "internal.h"
+#include "perf.h"
+#include "tb-cache.h"
+#include "tb-hash.h"
+#include "trace.h"
+
+#define TB_CACHE_MAGIC      "QEMUTBC1"
+#define TB_CACHE_VERSION    1
+#define TB_CACHE_ID_LEN     32
+
+typedef struct TBCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nb_entries;
+    uint8_t build_id[TB_CACHE_ID_LEN];
+    uint8_t config_key[TB_CACHE_ID_LEN];
+    /* code buffer layout; the prologue is [buf, start) */
+    uint64_t buf;
+    uint64_t start;
+    uint64_t total_size;
+    uint64_t image_size;
+    uint64_t entries_size;
+    /* address of a function in this binary */
+    uint64_t anchor;
+} TBCacheHeader;
+
+/*
+ * The header is followed by nb_entries entries, each followed by the guest
+ * code of its TB padded to 8 bytes, then by the prologue and the code image
+ * [start, start + image_size).
+ */
+typedef struct TBCacheEntry {
+    uint64_t offset;    /* of the TranslationBlock from start */
+    uint32_t size;      /* guest bytes */
+    uint32_t reserved;
+    uint8_t code[];
+} TBCacheEntry;
+
+typedef struct TBCacheKey {
+    vaddr pc;
+    uint64_t cs_base;
+    uint32_t flags;
+    uint32_t cflags;
+    tb_page_addr_t phys_pc;
+    TranslationBlock *tb;
+    const TBCacheEntry *entry;
+} TBCacheKey;
+
+static struct {
+    char *path;
+    uint8_t build_id[TB_CACHE_ID_LEN];
+    uint8_t config_key[TB_CACHE_ID_LEN];
+    /* part of config_key, taken again on exit */
+    uint8_t trace_key[TB_CACHE_ID_LEN];
+
+    /* the file being loaded from, until the vCPUs start */
+    GMappedFile *file;
+    uint8_t file_key[TB_CACHE_ID_LEN];
+    TBCacheKey *keys;
+    unsigned nb_keys;
+
+    /* loaded TBs not yet handed out */
+    GHashTable *pending;
+
+    /* the buffer holds code that is not in the file */
+    bool dirty;
+    /* plugin instrumentation is not part of the saved code */
+    bool tainted;
+
+    Notifier init_done;
+    Notifier exit;
+} tb_cache;
+
+/*
+ * Option groups read directly by the csky and riscv translators, rather
+ * than through CPU properties.
+ */
+static const char *const tb_cache_opts[] = {
+    "cpu-prop", "csky-extend", "csky-trace",
+};
+
+static guint tb_cache_key_hash(gconstpointer p)
+{
+    const TBCacheKey *k = p;
+
+    return tb_hash_func(k->phys_pc, k->pc, k->flags, k->cs_base, k->cflags);
+}
+
+static gboolean tb_cache_key_equal(gconstpointer a, gconstpointer b)
+{
+    const TBCacheKey *ka = a, *kb = b;
+
+    return ka->pc == kb->pc && ka->cs_base == kb->cs_base &&
+           ka->flags == kb->flags && ka->cflags == kb->cflags &&
+           ka->phys_pc == kb->phys_pc;
+}
+
+#ifdef CONFIG_LINUX
+#if HOST_LONG_BITS == 64
+typedef Elf64_Phdr TBCachePhdr;
+typedef Elf64_Nhdr TBCacheNhdr;
+#else
+typedef Elf32_Phdr TBCachePhdr;
+typedef Elf32_Nhdr TBCacheNhdr;
+#endif
+
+#define TB_CACHE_NT_GNU_BUILD_ID 3
+
+/*
+ * Find the program headers of the running binary and the offset it was
+ * loaded at; the offset is non-zero for a position independent binary.
+ */
+static const TBCachePhdr *tb_cache_phdrs(unsigned *n, uintptr_t *bias)
+{
+    const TBCachePhdr *ph = (const TBCachePhdr *)qemu_getauxval(AT_PHDR);
+    unsigned i;
+
+    *n = qemu_getauxval(AT_PHNUM);
+    *bias = 0;
+    if (!ph) {
+        return NULL;
+    }
+    for (i = 0; i < *n; i++) {
+        if (ph[i].p_type == PT_PHDR) {
+            *bias = (uintptr_t)ph - ph[i].p_vaddr;
+        }
+    }
+    return ph;
+}
+
+/* Return the GNU build ID note of the running binary, or NULL. */
+static const uint8_t *tb_cache_gnu_build_id(size_t *len)
+{
+    const TBCachePhdr *ph;
+    uintptr_t bias;
+    unsigned i, n;
+
+    ph = tb_cache_phdrs(&n, &bias);
+    for (i = 0; ph && i < n; i++) {
+        size_t align = ph[i].p_align == 8 ? 8 : 4;
+        const uint8_t *p = (const uint8_t *)(bias + ph[i].p_vaddr);
+        const uint8_t *end = p + ph[i].p_filesz;
+
+        if (ph[i].p_type != PT_NOTE) {
+            continue;
+        }
+        while (p + sizeof(TBCacheNhdr) <= end) {
+            const TBCacheNhdr *nh = (const TBCacheNhdr *)p;
+            const uint8_t *name = p + sizeof(*nh);
+            const uint8_t *desc = name + ROUND_UP(nh->n_namesz, align);
+
+            p = desc + ROUND_UP(nh->n_descsz, align);
+            if (p > end) {
+                break;
+            }
+            if (nh->n_type == TB_CACHE_NT_GNU_BUILD_ID &&
+                nh->n_namesz == 4 && !memcmp(name, "GNU", 4) &&
+                nh->n_descsz) {
+                *len = nh->n_descsz;
+                return desc;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ * The code buffer is mapped at the same address in every run, but code
+ * that calls back into QEMU embeds the address of the binary, which moves
+ * with address space randomization when QEMU is position independent.
+ */
+static bool tb_cache_binary_moves(void)
+{
+    g_autofree char *aslr = NULL;
+    uintptr_t bias;
+    unsigned n;
+
+    tb_cache_phdrs(&n, &bias);
+    if (!bias || (personality(0xffffffff) & ADDR_NO_RANDOMIZE)) {
+        return false;
+    }
+    return !g_file_get_contents("/proc/sys/kernel/randomize_va_space",
+                                &aslr, NULL, NULL) || aslr[0] != '0';
+}
+#endif
+
+/*
+ * The build ID changes with every link, unlike the version string, and
+ * is the same on every host of a farm that runs the binary from shared
+ * storage.
+ */
+static bool tb_cache_build_id(uint8_t *id)
+{
+    GChecksum *sum = g_checksum_new(G_CHECKSUM_SHA256);
+    gsize len = TB_CACHE_ID_LEN;
+    const uint8_t *note = NULL;
+    size_t note_len = 0;
+
+#ifdef CONFIG_LINUX
+    note = tb_cache_gnu_build_id(&note_len);
+    if (note) {
+        g_checksum_update(sum, note, note_len);
+    }
+#endif
+    g_checksum_update(sum, (const guchar *)QEMU_VERSION "/" TARGET_NAME, -1);
+    g_checksum_get_digest(sum, id, &len);
+    g_checksum_free(sum);
+    return note != NULL;
+}
+
+/*
+ * The csky trace filter is global state set by the guest, and decides
+ * which instrumentation the translators emit.
+ */
+static void tb_cache_trace_key(uint8_t *key)
+{
+#ifdef CONFIG_CSKY_TRACE
+    GChecksum *sum = g_checksum_new(G_CHECKSUM_SHA256);
+    gsize len = TB_CACHE_ID_LEN;
+    struct csky_trace_tb_state st;
+
+    /* the state is cleared first, padding included */
+    csky_trace_get_tb_state(&st);
+    g_checksum_update(sum, (const guchar *)&st, sizeof(st));
+    g_checksum_get_digest(sum, key, &len);
+    g_checksum_free(sum);
+#else
+    memset(key, 0, TB_CACHE_ID_LEN);
+#endif
+}
+
+static gint tb_cache_strcmp(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void tb_cache_hash_cpu(GChecksum *sum, Object *obj)
+{
+    g_autoptr(GPtrArray) props = g_ptr_array_new_with_free_func(g_free);
+    ObjectPropertyIterator iter;
+    ObjectProperty *prop;
+
+    g_checksum_update(sum, (const guchar *)object_get_typename(obj), -1);
+
+    object_property_iter_init(&iter, obj);
+    while ((prop = object_property_iter_next(&iter))) {
+        g_autofree char *value = NULL;
+
+        if (!prop->get || !prop->set || strstart(prop->type, "link<", NULL)) {
+            continue;
+        }
+        value = object_property_print(obj, prop->name, false, NULL);
+        if (value) {
+            g_ptr_array_add(props, g_strdup_printf("%s=%s", prop->name, value));
+        }
+    }
+
+    /* property tables are hashed, so fix the order */
+    g_ptr_array_sort(props, tb_cache_strcmp);
+    for (guint i = 0; i < props->len; i++) {
+        g_checksum_update(sum, (const guchar *)g_ptr_array_index(props, i),
+                          -1);
+        g_checksum_update(sum, (const guchar *)"", 1);
+    }
+}
+
+static int tb_cache_hash_opt(void *opaque, const char *name,
+                             const char *value, Error **errp)
+{
+    GChecksum *sum = opaque;
+
+    g_checksum_update(sum, (const guchar *)name, strlen(name) + 1);
+    g_checksum_update(sum, (const guchar *)value, strlen(value) + 1);
+    return 0;
+}
+
+static int tb_cache_hash_opts(void *opaque, QemuOpts *opts, Error **errp)
+{
+    return qemu_opt_foreach(opts, tb_cache_hash_opt, opaque, errp);
+}
+
+/* Everything beyond the guest code that changes what gets translated. */
+static void tb_cache_config_key(uint8_t *key)
+{
+    GChecksum *sum = g_checksum_new(G_CHECKSUM_SHA256);
+    gsize len = TB_CACHE_ID_LEN;
+    CPUState *cpu;
+
+    CPU_FOREACH(cpu) {
+        tb_cache_hash_cpu(sum, OBJECT(cpu));
+    }
+    /* code entered past its chain_entry relies on the same registers */
+    g_checksum_update(sum, (const guchar *)tcg_ctx->chain_temps,
+                      tcg_ctx->nb_chain * sizeof(tcg_ctx->chain_temps[0]));
+    g_checksum_update(sum, (const guchar *)tcg_ctx->chain_regs,
+                      tcg_ctx->nb_chain * sizeof(tcg_ctx->chain_regs[0]));
+    tb_cache_trace_key(tb_cache.trace_key);
+    g_checksum_update(sum, tb_cache.trace_key, TB_CACHE_ID_LEN);
+    for (int i = 0; i < ARRAY_SIZE(tb_cache_opts); i++) {
+        QemuOptsList *list = qemu_find_opts_err(tb_cache_opts[i], NULL);
+
+        g_checksum_update(sum, (const guchar *)tb_cache_opts[i], -1);
+        if (list) {
+            qemu_opts_foreach(list, tb_cache_hash_opts, sum, NULL);
+        }
+    }
+    g_checksum_get_digest(sum, key, &len);
+    g_checksum_free(sum);
+}
+
+static void tb_cache_drop(void)
+{
+    if (tb_cache.pending) {
+        g_hash_table_destroy(tb_cache.pending);
+        tb_cache.pending = NULL;
+    }
+    g_clear_pointer(&tb_cache.keys, g_free);
+    tb_cache.nb_keys = 0;
+    g_clear_pointer(&tb_cache.file, g_mapped_file_unref);
+}
+
+static bool tb_cache_entry_valid(const TBCacheEntry *e, void *start,
+                                 size_t image_size)
+{
+    const TranslationBlock *tb = start + e->offset;
+
+    if (image_size < sizeof(*tb) || e->offset > image_size - sizeof(*tb) ||
+        !QEMU_IS_ALIGNED((uintptr_t)tb, qemu_icache_linesize)) {
+        return false;
+    }
+    return e->size != 0 && e->size == tb->size &&
+           tb->tc.ptr >= (const void *)(tb + 1) &&
+           tb->tc.size <= start + image_size - tb->tc.ptr &&
+           tb_page_addr0(tb) != -1 && tb_page_addr1(tb) == -1 &&
+           !(tb->cflags & (CF_INVALID | CF_PCREL));
+}
+
+static void tb_cache_load(void *buf, void *start, size_t total_size)
+{
+    g_autoptr(GError) err = NULL;
+    const TBCacheHeader *hdr;
+    const uint8_t *data, *p, *end;
+    size_t len, prologue_size = start - buf;
+    void *dst;
+
+    tb_cache.file = g_mapped_file_new(tb_cache.path, false, &err);
+    if (!tb_cache.file) {
+        if (!g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            warn_report("tb-cache: %s", err->message);
+        }
+        return;
+    }
+    data = (const uint8_t *)g_mapped_file_get_contents(tb_cache.file);
+    len = g_mapped_file_get_length(tb_cache.file);
+    end = data + len;
+    hdr = (const TBCacheHeader *)data;
+
+    if (len < sizeof(*hdr) ||
+        memcmp(hdr->magic, TB_CACHE_MAGIC, sizeof(hdr->magic)) ||
+        hdr->version != TB_CACHE_VERSION) {
+        warn_report("tb-cache: %s is not a TB cache file", tb_cache.path);
+        goto reject;
+    }
+    if (memcmp(hdr->build_id, tb_cache.build_id, TB_CACHE_ID_LEN) ||
+        hdr->anchor != (uintptr_t)tb_gen_code) {
+        trace_tb_cache_reject(tb_cache.path, "different binary");
+        goto reject;
+    }
+    if (hdr->buf != (uintptr_t)buf || hdr->start != (uintptr_t)start ||
+        hdr->total_size != total_size) {
+        trace_tb_cache_reject(tb_cache.path, "different code buffer");
+        goto reject;
+    }
+    p = data + sizeof(*hdr);
+    if (hdr->entries_size > end - p ||
+        prologue_size > end - p - hdr->entries_size ||
+        hdr->image_size > end - p - hdr->entries_size - prologue_size ||
+        hdr->nb_entries > hdr->entries_size / sizeof(TBCacheEntry)) {
+        goto truncated;
+    }
+    if (memcmp(p + hdr->entries_size, buf, prologue_size)) {
+        trace_tb_cache_reject(tb_cache.path, "different prologue");
+        goto reject;
+    }
+
+    /*
+     * Nothing runs from the region yet, so load the image first and
+     * check the TBs in place, where they are aligned as generated.
+     */
+    dst = tcg_region_code_reserve(hdr->image_size);
+    if (!dst) {
+        trace_tb_cache_reject(tb_cache.path, "code buffer too small");
+        goto reject;
+    }
+    g_assert(dst == start);
+    qemu_thread_jit_write();
+    memcpy(dst, p + hdr->entries_size + prologue_size, hdr->image_size);
+
+    tb_cache.keys = g_new(TBCacheKey, hdr->nb_entries);
+    end = p + hdr->entries_size;
+    for (uint32_t i = 0; i < hdr->nb_entries; i++) {
+        const TBCacheEntry *e = (const TBCacheEntry *)p;
+        TranslationBlock *tb;
+        TBCacheKey *k;
+
+        if (sizeof(*e) > end - p ||
+            ROUND_UP(e->size, 8) > end - p - sizeof(*e)) {
+            tcg_region_code_reserve(0);
+            goto truncated;
+        }
+        p += sizeof(*e) + ROUND_UP(e->size, 8);
+
+        if (!tb_cache_entry_valid(e, start, hdr->image_size)) {
+            warn_report("tb-cache: %s: bad entry %u", tb_cache.path, i);
+            tcg_region_code_reserve(0);
+            goto reject;
+        }
+
+        tb = start + e->offset;
+        k = &tb_cache.keys[tb_cache.nb_keys++];
+        k->pc = tb->pc;
+        k->cs_base = tb->cs_base;
+        k->flags = tb->flags;
+        k->cflags = tb->cflags;
+        k->phys_pc = tb_page_addr0(tb);
+        k->tb = tb;
+        k->entry = e;
+    }
+
+    flush_idcache_range((uintptr_t)tcg_splitwx_to_rx(dst), (uintptr_t)dst,
+                        hdr->image_size);
+    memcpy(tb_cache.file_key, hdr->config_key, TB_CACHE_ID_LEN);
+    return;
+
+ truncated:
+    warn_report("tb-cache: %s is truncated", tb_cache.path);
+ reject:
+    tb_cache_drop();
+}
+
+static void tb_cache_init_done(Notifier *notifier, void *data)
+{
+    tb_cache_config_key(tb_cache.config_key);
+
+    if (!tb_cache.file) {
+        return;
+    }
+    /*
+     * The loaded code stays reserved even if it cannot be used: the vCPU
+     * threads have already taken their copy of the initial context.
+     */
+    if (memcmp(tb_cache.file_key, tb_cache.config_key, TB_CACHE_ID_LEN)) {
+        trace_tb_cache_reject(tb_cache.path, "different configuration");
+        tb_cache_drop();
+        tb_cache.dirty = true;
+        return;
+    }
+
+    tb_cache.pending = g_hash_table_new(tb_cache_key_hash, tb_cache_key_equal);
+    for (unsigned i = 0; i < tb_cache.nb_keys; i++) {
+        g_hash_table_add(tb_cache.pending, &tb_cache.keys[i]);
+    }
+    trace_tb_cache_load(tb_cache.path, tb_cache.nb_keys);
+}
+
+TranslationBlock *tb_cache_restore(CPUState *cpu, vaddr pc, uint64_t cs_base,
+                                   uint32_t flags, uint32_t cflags,
+                                   tb_page_addr_t phys_pc, void *host_pc)
+{
+    TBCacheKey key = {
+        .pc = pc,
+        .cs_base = cs_base,
+        .flags = flags,
+        .cflags = cflags,
+        .phys_pc = phys_pc,
+    };
+    TranslationBlock *tb, *existing_tb;
+    TBCacheKey *hit;
+
+    if (!tb_cache.path) {
+        return NULL;
+    }
+    if (test_bit(QEMU_PLUGIN_EV_VCPU_TB_TRANS, cpu->plugin_mask)) {
+        tb_cache.tainted = true;
+        return NULL;
+    }
+    if (!tb_cache.pending) {
+        tb_cache.dirty = true;
+        return NULL;
+    }
+
+    hit = g_hash_table_lookup(tb_cache.pending, &key);
+    if (!hit) {
+        tb_cache.dirty = true;
+        return NULL;
+    }
+    /* Either way it is not needed again; a stale entry is retranslated. */
+    g_hash_table_remove(tb_cache.pending, hit);
+    if (!host_pc || memcmp(host_pc, hit->entry->code, hit->entry->size)) {
+        tb_cache.dirty = true;
+        return NULL;
+    }
+
+    tb = hit->tb;
+
+    /* the same as tb_gen_code does for freshly generated code */
+    qemu_spin_init(&tb->jmp_lock);
+    tb->exec_count = 0;
+    tb->taken_count = 0;
+    tb_inline_cache_reset(tb);
+    tb->jmp_list_head = (uintptr_t)NULL;
+    tb->jmp_list_next[0] = (uintptr_t)NULL;
+    tb->jmp_list_next[1] = (uintptr_t)NULL;
+    tb->jmp_dest[0] = (uintptr_t)NULL;
+    tb->jmp_dest[1] = (uintptr_t)NULL;
+    if (tb->jmp_reset_offset[0] != TB_JMP_OFFSET_INVALID) {
+        tb_reset_jump(tb, 0);
+    }
+    if (tb->jmp_reset_offset[1] != TB_JMP_OFFSET_INVALID) {
+        tb_reset_jump(tb, 1);
+    }
+
+    tb_lock_page0(phys_pc);
+    tcg_tb_insert(tb);
+    existing_tb = tb_link_page(tb);
+    assert_no_pages_locked();
+    if (unlikely(existing_tb != tb)) {
+        tcg_tb_remove(tb);
+        return existing_tb;
+    }
+
+    perf_report_code(pc, tb, tb->tc.ptr);
+    return tb;
+}
+
+void tb_cache_flush(void)
+{
+    if (tb_cache.path) {
+        tb_cache_drop();
+        tb_cache.dirty = true;
+    }
+}
+
+typedef struct TBCacheSave {
+    void *start;
+    void *end;
+    GByteArray *entries;
+    uint32_t nb_entries;
+} TBCacheSave;
+
+static gboolean tb_cache_collect(gpointer key, gpointer value, gpointer data)
+{
+    TranslationBlock *tb = value;
+    TBCacheSave *s = data;
+    tb_page_addr_t phys_pc = tb_page_addr0(tb);
+    TBCacheEntry e = { };
+    static const uint8_t pad[8];
+
+    if ((tb_cflags(tb) & (CF_INVALID | CF_PCREL)) ||
+        phys_pc == -1 || tb_page_addr1(tb) != -1 ||
+        (void *)tb < s->start || (void *)tb >= s->end) {
+        return false;
+    }
+
+    e.offset = (void *)tb - s->start;
+    e.size = tb->size;
+    g_byte_array_append(s->entries, (const guint8 *)&e, sizeof(e));
+    g_byte_array_append(s->entries, qemu_map_ram_ptr(NULL, phys_pc), e.size);
+    g_byte_array_append(s->entries, pad, ROUND_UP(e.size, 8) - e.size);
+    s->nb_entries++;
+    return false;
+}
+
+static void tb_cache_save(Notifier *notifier, void *data)
+{
+    g_autofree char *tmp = NULL;
+    g_autoptr(GByteArray) entries = g_byte_array_new();
+    TBCacheSave s = { .entries = entries };
+    TBCacheHeader hdr = { };
+    void *buf;
+    size_t total_size;
+    uint8_t trace_key[TB_CACHE_ID_LEN];
+    bool ok;
+    int fd;
+
+    if (!tb_cache.dirty || tb_cache.tainted ||
+        !tcg_region_code_span(&buf, &s.start, &s.end, &total_size)) {
+        return;
+    }
+    /*
+     * A change of the trace filter flushes the TBs, so what is in the
+     * buffer now was made for the filter the guest has left behind, not
+     * for the one the next run starts with.
+     */
+    tb_cache_trace_key(trace_key);
+    if (memcmp(trace_key, tb_cache.trace_key, TB_CACHE_ID_LEN)) {
+        trace_tb_cache_reject(tb_cache.path, "trace filter changed");
+        return;
+    }
+    tcg_tb_foreach(tb_cache_collect, &s);
+
+    memcpy(hdr.magic, TB_CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version = TB_CACHE_VERSION;
+    hdr.nb_entries = s.nb_entries;
+    memcpy(hdr.build_id, tb_cache.build_id, TB_CACHE_ID_LEN);
+    memcpy(hdr.config_key, tb_cache.config_key, TB_CACHE_ID_LEN);
+    hdr.buf = (uintptr_t)buf;
+    hdr.start = (uintptr_t)s.start;
+    hdr.total_size = total_size;
+    hdr.image_size = s.end - s.start;
+    hdr.anchor = (uintptr_t)tb_gen_code;
+    hdr.entries_size = entries->len;
+
+    /* write a new file and rename it, so concurrent runs share one cache */
+    tmp = g_strdup_printf("%s.XXXXXX", tb_cache.path);
+    fd = g_mkstemp(tmp);
+    if (fd < 0) {
+        warn_report("tb-cache: cannot create %s: %s", tmp, strerror(errno));
+        return;
+    }
+    ok = qemu_write_full(fd, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+         qemu_write_full(fd, entries->data, entries->len) == entries->len &&
+         qemu_write_full(fd, buf, s.start - buf) == s.start - buf &&
+         qemu_write_full(fd, s.start, hdr.image_size) == hdr.image_size;
+    if (close(fd) < 0 || !ok || rename(tmp, tb_cache.path) < 0) {
+        warn_report("tb-cache: cannot write %s: %s", tb_cache.path,
+                    strerror(errno));
+        unlink(tmp);
+        return;
+    }
+    trace_tb_cache_save(tb_cache.path, s.nb_entries);
+}
+
+void tb_cache_init(const char *path)
+{
+    void *buf, *start, *end;
+    size_t total_size;
+
+    if (!tcg_region_code_span(&buf, &start, &end, &total_size)) {
+        warn_report("tb-cache: needs a single TCG thread and split-wx=off, "
+                    "not using %s", path);
+        return;
+    }
+
+    if (!tb_cache_build_id(tb_cache.build_id)) {
+        warn_report("tb-cache: the QEMU binary has no build ID, not using %s",
+                    path);
+        return;
+    }
+#ifdef CONFIG_LINUX
+    if (tb_cache_binary_moves()) {
+        warn_report("tb-cache: QEMU is position independent and address "
+                    "space randomization is on, not using %s", path);
+        error_printf("Run QEMU under 'setarch -R' or build it with "
+                     "--disable-pie to use the cache.\n");
+        return;
+    }
+#endif
+    tb_cache.path = g_strdup(path);
+    tb_cache_load(buf, start, total_size);
+    tb_cache.dirty = !tb_cache.file;
+
+    tb_cache.init_done.notify = tb_cache_init_done;
+    qemu_add_machine_init_done_notifier(&tb_cache.init_done);
+    tb_cache.exit.notify = tb_cache_save;
+    qemu_add_exit_notifier(&tb_cache.exit);
+}
@@ -0,0 +1,50 @@
+/*
+ * Persistent translation block cache
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef ACCEL_TCG_TB_CACHE_H
+#define ACCEL_TCG_TB_CACHE_H
+
+#include "exec/exec-all.h"
+
+#ifdef CONFIG_SOFTMMU
+/*
+ * Where the code buffer is asked to go when a cache file is used, so that
+ * the code saved by one run is at the same address in the next one.  A
+ * range that is taken moves the buffer, and the file is then not used.
+ */
+#if HOST_LONG_BITS == 64
+#define TB_CACHE_CODE_HINT  ((void *)(uintptr_t)0x500000000000ull)
+#else
+#define TB_CACHE_CODE_HINT  NULL
+#endif
+
+/* Load translated code from @path and save it back there on exit. */
+void tb_cache_init(const char *path);
+
+/*
+ * Return a TB loaded from the cache file for the given lookup key, if its
+ * guest code at @host_pc is unchanged, or NULL to translate it afresh.
+ */
+TranslationBlock *tb_cache_restore(CPUState *cpu, vaddr pc, uint64_t cs_base,
+                                   uint32_t flags, uint32_t cflags,
+                                   tb_page_addr_t phys_pc, void *host_pc);
+
+/* The code buffer has been reset: drop everything not yet restored. */
+void tb_cache_flush(void);
+#else
+static inline TranslationBlock *
+tb_cache_restore(CPUState *cpu, vaddr pc, uint64_t cs_base, uint32_t flags,
+                 uint32_t cflags, tb_page_addr_t phys_pc, void *host_pc)
+{
+    return NULL;
+}
+
+static inline void tb_cache_flush(void)
+{
+}
+#endif
+
+#endif
@@ -9,20 +9,66 @@
 #ifndef ACCEL_TCG_TB_JMP_CACHE_H
 #define ACCEL_TCG_TB_JMP_CACHE_H
 
-#define TB_JMP_CACHE_BITS 12
-#define TB_JMP_CACHE_SIZE (1 << TB_JMP_CACHE_BITS)
+/*
+ * The size of the direct-mapped level is chosen at run time, between
+ * these bounds; the default is TB_JMP_CACHE_BITS.
+ */
+#define TB_JMP_CACHE_BITS     12
+#define TB_JMP_CACHE_MIN_BITS 8
+#define TB_JMP_CACHE_MAX_BITS 20
+
+/*
+ * Entries displaced from the direct-mapped level go to a small
+ * set-associative victim level, which is probed before the global
+ * hash table.
+ */
+#define TB_JMP_VICTIM_SETS 32
+#define TB_JMP_VICTIM_WAYS 4
+
+/*
+ * After this many lookups that had to be satisfied from the global hash
+ * table, the miss rate decides whether the direct-mapped level grows.
+ */
+#define TB_JMP_CACHE_WINDOW 1024
+
+typedef struct CPUJumpCacheEntry {
+    TranslationBlock *tb;
+    vaddr pc;
+} CPUJumpCacheEntry;
 
 /*
  * Accessed in parallel; all accesses to 'tb' must be atomic.
  * For CF_PCREL, accesses to 'pc' must be protected by a
- * load_acquire/store_release to 'tb'.
+ * load_acquire/store_release to 'tb'.  Victim entries always record
+ * 'pc' and follow the CF_PCREL protocol.
+ *
+ * The structure is replaced, under RCU, when it grows; other threads
+ * must read cpu->tb_jmp_cache with qatomic_rcu_read.  The statistics
+ * are written only by the vCPU that owns the cache.
  */
 struct CPUJumpCache {
     struct rcu_head rcu;
-    struct {
-        TranslationBlock *tb;
-        vaddr pc;
-    } array[TB_JMP_CACHE_SIZE];
+    unsigned int bits;
+
+    size_t hits;
+    size_t victim_hits;
+    size_t misses;
+    size_t window_lookups;
+    unsigned int window_misses;
+
+    uint8_t victim_next[TB_JMP_VICTIM_SETS];
+    CPUJumpCacheEntry victim[TB_JMP_VICTIM_SETS][TB_JMP_VICTIM_WAYS];
+    CPUJumpCacheEntry array[];
 };
 
+static inline unsigned int tb_jmp_cache_size(const CPUJumpCache *jc)
+{
+    return 1u << jc->bits;
+}
+
+static inline unsigned int tb_jmp_victim_set(vaddr pc)
+{
+    return (pc ^ (pc >> 5) ^ (pc >> 10)) & (TB_JMP_VICTIM_SETS - 1);
+}
+
 #endif /* ACCEL_TCG_TB_JMP_CACHE_H */
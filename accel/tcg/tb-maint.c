@@ -30,6 +30,8 @@
 #include "tb-hash.h"
 #include "tb-context.h"
 #include "internal.h"
+#include "tb-cache.h"
+#include "translate-ahead.h"
 
 
 /* List iterators for lists of tagged pointers in TranslationBlock. */
@@ -755,6 +757,12 @@ static void tb_remove(TranslationBlock *tb)
 #endif /* CONFIG_USER_ONLY */
 
 /* flush all the translation blocks */
+static gboolean tb_ic_free_iter(gpointer key, gpointer value, gpointer data)
+{
+    tb_inline_cache_free(value);
+    return false;
+}
+
 static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
 {
     bool did_flush = false;
@@ -766,6 +774,9 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
     }
     did_flush = true;
 
+    /* The translator threads allocate from the buffer as well. */
+    translate_ahead_pause();
+
     CPU_FOREACH(cpu) {
         tcg_flush_jmp_cache(cpu);
     }
@@ -773,9 +784,12 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
     qht_reset_size(&tb_ctx.htable, CODE_GEN_HTABLE_SIZE);
     tb_remove_all();
 
+    tcg_tb_foreach(tb_ic_free_iter, NULL);
     tcg_region_reset_all();
+    tb_cache_flush();
     /* XXX: flush processor icache at this point if cache flush is expensive */
     qatomic_inc(&tb_ctx.tb_flush_count);
+    translate_ahead_resume();
 
 done:
     mmap_unlock();
@@ -884,14 +898,23 @@ static void tb_jmp_cache_inval_tb(TranslationBlock *tb)
             tcg_flush_jmp_cache(cpu);
         }
     } else {
-        uint32_t h = tb_jmp_cache_hash_func(tb->pc);
+        CPUJumpCacheEntry *set;
+        uint32_t h;
 
+        RCU_READ_LOCK_GUARD();
         CPU_FOREACH(cpu) {
-            CPUJumpCache *jc = cpu->tb_jmp_cache;
+            CPUJumpCache *jc = qatomic_rcu_read(&cpu->tb_jmp_cache);
 
+            h = tb_jmp_cache_hash_func(jc, tb->pc);
             if (qatomic_read(&jc->array[h].tb) == tb) {
                 qatomic_set(&jc->array[h].tb, NULL);
             }
+            set = jc->victim[tb_jmp_victim_set(tb->pc)];
+            for (int i = 0; i < TB_JMP_VICTIM_WAYS; i++) {
+                if (qatomic_read(&set[i].tb) == tb) {
+                    qatomic_set(&set[i].tb, NULL);
+                }
+            }
         }
     }
 }
@@ -39,6 +39,9 @@
 #include "hw/boards.h"
 #endif
 #include "internal.h"
+#include "tb-jmp-cache.h"
+#include "tb-cache.h"
+#include "translate-ahead.h"
 
 struct TCGState {
     AccelState parent_obj;
@@ -47,6 +50,13 @@ struct TCGState {
     bool one_insn_per_tb;
     int splitwx_enabled;
     unsigned long tb_size;
+    uint32_t hot_threshold;
+    uint32_t jmp_cache_bits;
+    uint32_t jmp_cache_max_bits;
+    bool chain_regs;
+    bool inline_cache;
+    char *tb_cache;
+    uint32_t translate_threads;
 };
 typedef struct TCGState TCGState;
 
@@ -88,6 +98,8 @@ static void tcg_accel_instance_init(Object *obj)
     TCGState *s = TCG_STATE(obj);
 
     s->mttcg_enabled = default_mttcg_enabled();
+    s->jmp_cache_bits = TB_JMP_CACHE_BITS;
+    s->jmp_cache_max_bits = TB_JMP_CACHE_BITS;
 
     /* If debugging enabled, default "auto on", otherwise off. */
 #if defined(CONFIG_DEBUG_TCG) && !defined(CONFIG_USER_ONLY)
@@ -99,6 +111,10 @@ static void tcg_accel_instance_init(Object *obj)
 
 bool mttcg_enabled;
 bool one_insn_per_tb;
+uint32_t tb_hot_threshold;
+uint32_t tb_jmp_cache_bits = TB_JMP_CACHE_BITS;
+uint32_t tb_jmp_cache_max_bits = TB_JMP_CACHE_BITS;
+bool tb_inline_cache;
 
 static int tcg_init_machine(MachineState *ms)
 {
@@ -111,10 +127,31 @@ static int tcg_init_machine(MachineState *ms)
 
     tcg_allowed = true;
     mttcg_enabled = s->mttcg_enabled;
+    tb_hot_threshold = s->hot_threshold;
+    tb_jmp_cache_bits = s->jmp_cache_bits;
+    tb_jmp_cache_max_bits = MAX(s->jmp_cache_max_bits, s->jmp_cache_bits);
+    tb_inline_cache = s->inline_cache;
+
+#ifndef CONFIG_USER_ONLY
+    if (s->translate_threads && !mttcg_enabled) {
+        warn_report("translate-threads needs thread=multi, ignoring it");
+        s->translate_threads = 0;
+    }
+#endif
 
     page_init();
     tb_htable_init();
-    tcg_init(s->tb_size * MiB, s->splitwx_enabled, max_cpus);
+#ifdef CONFIG_SOFTMMU
+    if (s->tb_cache) {
+        tcg_region_code_hint(TB_CACHE_CODE_HINT);
+    }
+#endif
+    /* Each translator thread has a TCG context of its own. */
+    tcg_init(s->tb_size * MiB, s->splitwx_enabled,
+             max_cpus + s->translate_threads);
+    if (s->chain_regs) {
+        tcg_enable_chain_globals();
+    }
 
 #if defined(CONFIG_SOFTMMU)
     /*
@@ -122,6 +159,11 @@ static int tcg_init_machine(MachineState *ms)
      * initialize the prologue now.
      */
     tcg_prologue_init(tcg_ctx);
+
+    if (s->tb_cache) {
+        tb_cache_init(s->tb_cache);
+    }
+    translate_ahead_init(s->translate_threads);
 #endif
 
     return 0;
@@ -181,6 +223,108 @@ static void tcg_set_tb_size(Object *obj, Visitor *v,
     s->tb_size = value;
 }
 
+static void tcg_get_hot_threshold(Object *obj, Visitor *v,
+                                  const char *name, void *opaque,
+                                  Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->hot_threshold;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_hot_threshold(Object *obj, Visitor *v,
+                                  const char *name, void *opaque,
+                                  Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+
+    s->hot_threshold = value;
+}
+
+/* @opaque is the offset of the field in TCGState */
+static void tcg_get_jmp_cache_bits(Object *obj, Visitor *v,
+                                   const char *name, void *opaque,
+                                   Error **errp)
+{
+    uint32_t *ptr = (void *)TCG_STATE(obj) + (uintptr_t)opaque;
+    uint32_t value = *ptr;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_jmp_cache_bits(Object *obj, Visitor *v,
+                                   const char *name, void *opaque,
+                                   Error **errp)
+{
+    uint32_t *ptr = (void *)TCG_STATE(obj) + (uintptr_t)opaque;
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+
+    if (value < TB_JMP_CACHE_MIN_BITS || value > TB_JMP_CACHE_MAX_BITS) {
+        error_setg(errp, "%s must be between %d and %d", name,
+                   TB_JMP_CACHE_MIN_BITS, TB_JMP_CACHE_MAX_BITS);
+        return;
+    }
+    *ptr = value;
+}
+
+#if !defined(CONFIG_USER_ONLY)
+static char *tcg_get_tb_cache(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    return g_strdup(s->tb_cache);
+}
+
+static void tcg_set_tb_cache(Object *obj, const char *value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    g_free(s->tb_cache);
+    s->tb_cache = g_strdup(value);
+}
+#endif
+
+#if !defined(CONFIG_USER_ONLY)
+static void tcg_get_translate_threads(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->translate_threads;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_translate_threads(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+
+    if (value > TRANSLATE_AHEAD_MAX_THREADS) {
+        error_setg(errp, "%s must be at most %d", name,
+                   TRANSLATE_AHEAD_MAX_THREADS);
+        return;
+    }
+    s->translate_threads = value;
+}
+#endif
+
 static bool tcg_get_splitwx(Object *obj, Error **errp)
 {
     TCGState *s = TCG_STATE(obj);
@@ -207,6 +351,34 @@ static void tcg_set_one_insn_per_tb(Object *obj, bool value, Error **errp)
     qatomic_set(&one_insn_per_tb, value);
 }
 
+static bool tcg_get_chain_regs(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    return s->chain_regs;
+}
+
+static void tcg_set_chain_regs(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    s->chain_regs = value;
+}
+
+static bool tcg_get_inline_cache(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    return s->inline_cache;
+}
+
+static void tcg_set_inline_cache(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    s->inline_cache = value;
+}
+
 static int tcg_gdbstub_supported_sstep_flags(void)
 {
     /*
@@ -240,6 +412,41 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
     object_class_property_set_description(oc, "tb-size",
         "TCG translation block cache size");
 
+    object_class_property_add(oc, "hot-threshold", "int",
+        tcg_get_hot_threshold, tcg_set_hot_threshold,
+        NULL, NULL);
+    object_class_property_set_description(oc, "hot-threshold",
+        "Executions after which a TB is retranslated as a superblock "
+        "(0 disables)");
+
+    object_class_property_add(oc, "jmp-cache-bits", "int",
+        tcg_get_jmp_cache_bits, tcg_set_jmp_cache_bits,
+        NULL, (void *)offsetof(TCGState, jmp_cache_bits));
+    object_class_property_set_description(oc, "jmp-cache-bits",
+        "log2 of the initial number of per-vCPU jump cache entries");
+
+    object_class_property_add(oc, "jmp-cache-max-bits", "int",
+        tcg_get_jmp_cache_bits, tcg_set_jmp_cache_bits,
+        NULL, (void *)offsetof(TCGState, jmp_cache_max_bits));
+    object_class_property_set_description(oc, "jmp-cache-max-bits",
+        "log2 of the number of entries up to which a per-vCPU jump cache "
+        "grows when it misses often");
+
+#if !defined(CONFIG_USER_ONLY)
+    object_class_property_add_str(oc, "tb-cache",
+                                  tcg_get_tb_cache,
+                                  tcg_set_tb_cache);
+    object_class_property_set_description(oc, "tb-cache",
+        "File to keep translated code in across runs");
+
+    object_class_property_add(oc, "translate-threads", "int",
+        tcg_get_translate_threads, tcg_set_translate_threads,
+        NULL, NULL);
+    object_class_property_set_description(oc, "translate-threads",
+        "Threads translating direct jump targets ahead of the vCPUs "
+        "(needs thread=multi)");
+#endif
+
     object_class_property_add_bool(oc, "split-wx",
         tcg_get_splitwx, tcg_set_splitwx);
     object_class_property_set_description(oc, "split-wx",
@@ -250,6 +457,18 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
                                    tcg_set_one_insn_per_tb);
     object_class_property_set_description(oc, "one-insn-per-tb",
         "Only put one guest insn in each translation block");
+
+    object_class_property_add_bool(oc, "chain-regs",
+                                   tcg_get_chain_regs,
+                                   tcg_set_chain_regs);
+    object_class_property_set_description(oc, "chain-regs",
+        "Hand guest registers between chained TBs in host registers");
+
+    object_class_property_add_bool(oc, "inline-cache",
+                                   tcg_get_inline_cache,
+                                   tcg_set_inline_cache);
+    object_class_property_set_description(oc, "inline-cache",
+        "Cache the targets of indirect jumps and returns in the code");
 }
 
 static const TypeInfo tcg_accel_type = {
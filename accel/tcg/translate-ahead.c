@@ -0,0 +1,339 @@
+/*
+ * Translating ahead of the vCPUs
+ *
+ * With MTTCG every vCPU translates the code it reaches on its own thread,
+ * so when many of them run into fresh code at once, as while booting,
+ * each one stops for its own translations and they contend for the page
+ * locks.  With -accel tcg,translate-threads=N a pool of N translator
+ * threads takes the direct jump targets of each TB a vCPU translates and
+ * translates them too, in TCG contexts of their own, so that the vCPU
+ * usually finds the next TB in the hash table already.
+ *
+ * A target is only taken if it is on the guest page of the TB that names
+ * it, and the translator thread reads it through the host mapping that
+ * the vCPU found for that page.  It never touches the vCPU's TLB: a TB
+ * that would need to (crossing into the next page, or a target reading
+ * code through cpu_ld*_code) is dropped and left to the vCPU.  The TB is
+ * translated for the state of the TB it was named by; a vCPU that gets
+ * there in a different state does not find it and translates its own.
+ * The target's translate_ahead_ok hook confirms that this is the state
+ * the targets are reached with, and that its translator reads nothing
+ * of the vCPU beyond it, such as tracing options; state that may still
+ * change at run time, like the C-SKY trace filter, flushes the TBs when
+ * it does, which also drops what the translator threads are working on.
+ *
+ * Requests are kept in a bounded ring and dropped when it is full, since
+ * a vCPU that gets to the code first translates it anyway.  The lock of
+ * the ring is a QemuMutex so that -enable-sync-profile can show how it
+ * compares with the rest of the translation path.  "info jit" shows how
+ * long the vCPUs spent in tb_gen_code, page lock waits included, which
+ * is what the translator threads are meant to bring down.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/log.h"
+#include "qemu/rcu.h"
+#include "qemu/stats64.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
+#include "hw/core/cpu.h"
+#include "hw/core/tcg-cpu-ops.h"
+#include "exec/exec-all.h"
+#include "tcg/tcg.h"
+#include "internal.h"
+#include "translate-ahead.h"
+
+/* Must be a power of 2 */
+#define TRANSLATE_AHEAD_QUEUE   256
+
+/*
+ * TBs made for one particular situation: their targets would be
+ * translated for that situation too, and not be looked up again.
+ */
+#define TRANSLATE_AHEAD_CF_SKIP (CF_COUNT_MASK | CF_LAST_IO | CF_NOIRQ | \
+                                 CF_SINGLE_STEP | CF_MEMI_ONLY |          \
+                                 CF_USE_ICOUNT)
+
+typedef struct TranslateRequest {
+    CPUState *cpu;          /* NULL once cancelled */
+    vaddr pc;
+    uint64_t cs_base;
+    uint32_t flags;
+    uint32_t cflags;
+    tb_page_addr_t phys_pc;
+    void *host_pc;
+} TranslateRequest;
+
+enum {
+    TRANSLATE_AHEAD_DONE,
+    TRANSLATE_AHEAD_PRESENT,
+    TRANSLATE_AHEAD_DROPPED,
+    TRANSLATE_AHEAD_NR,
+};
+
+static struct {
+    QemuMutex lock;
+    QemuCond work_cond;     /* requests queued, or resumed */
+    QemuCond idle_cond;     /* a request was finished */
+    unsigned n_threads;
+    unsigned busy;          /* threads translating */
+    unsigned paused;
+    unsigned head, tail;    /* free running indices into queue */
+    CPUState **current;     /* per thread: whose request it translates */
+    TranslateRequest queue[TRANSLATE_AHEAD_QUEUE];
+
+    size_t queued;
+    size_t overflows;
+    size_t results[TRANSLATE_AHEAD_NR];
+    uint64_t ahead_ns;      /* spent by the translator threads */
+    Stat64 vcpu_tbs;        /* translated by the vCPUs themselves */
+    Stat64 vcpu_ns;
+} ahead;
+
+static int translate_ahead_one(const TranslateRequest *req)
+{
+    ram_addr_t offset;
+    RAMBlock *rb;
+
+    RCU_READ_LOCK_GUARD();
+
+    /* The vCPU, or another thread, may have got there first... */
+    if (tb_htable_present(req->pc, req->cs_base, req->flags, req->cflags,
+                          req->phys_pc)) {
+        return TRANSLATE_AHEAD_PRESENT;
+    }
+
+    /* ...or the RAM may have been unplugged since the request. */
+    rb = qemu_ram_block_from_host(req->host_pc, false, &offset);
+    if (!rb || qemu_ram_get_offset(rb) + offset != req->phys_pc) {
+        return TRANSLATE_AHEAD_DROPPED;
+    }
+
+    if (!tb_gen_code_ahead(req->cpu, req->pc, req->cs_base, req->flags,
+                           req->cflags, req->phys_pc, req->host_pc)) {
+        return TRANSLATE_AHEAD_DROPPED;
+    }
+    return TRANSLATE_AHEAD_DONE;
+}
+
+static void *translate_ahead_thread(void *opaque)
+{
+    unsigned int idx = (uintptr_t)opaque;
+
+    rcu_register_thread();
+    tcg_register_thread();
+
+    qemu_mutex_lock(&ahead.lock);
+    while (true) {
+        TranslateRequest req;
+        int64_t start;
+        int ret;
+
+        while (ahead.paused || ahead.head == ahead.tail) {
+            qemu_cond_wait(&ahead.work_cond, &ahead.lock);
+        }
+        req = ahead.queue[ahead.tail++ & (TRANSLATE_AHEAD_QUEUE - 1)];
+        if (req.cpu == NULL) {
+            continue;
+        }
+        ahead.current[idx] = req.cpu;
+        ahead.busy++;
+        qemu_mutex_unlock(&ahead.lock);
+
+        start = get_clock();
+        ret = translate_ahead_one(&req);
+
+        qemu_mutex_lock(&ahead.lock);
+        ahead.ahead_ns += get_clock() - start;
+        ahead.results[ret]++;
+        ahead.current[idx] = NULL;
+        ahead.busy--;
+        qemu_cond_broadcast(&ahead.idle_cond);
+    }
+    return NULL;
+}
+
+void translate_ahead_init(unsigned n_threads)
+{
+    unsigned int i;
+
+    if (n_threads == 0) {
+        return;
+    }
+
+    qemu_mutex_init(&ahead.lock);
+    qemu_cond_init(&ahead.work_cond);
+    qemu_cond_init(&ahead.idle_cond);
+    ahead.current = g_new0(CPUState *, n_threads);
+    ahead.n_threads = n_threads;
+
+    for (i = 0; i < n_threads; i++) {
+        QemuThread thread;
+        g_autofree char *name = g_strdup_printf("TCG translate %u", i);
+
+        qemu_thread_create(&thread, name, translate_ahead_thread,
+                           (void *)(uintptr_t)i, QEMU_THREAD_DETACHED);
+    }
+}
+
+void translate_ahead_queue(CPUState *cpu, TranslationBlock *tb,
+                           void *host_pc)
+{
+    tb_page_addr_t phys_pc = tb_page_addr0(tb);
+    vaddr page_ofs = phys_pc & ~TARGET_PAGE_MASK;
+    uint32_t cflags = tb_cflags(tb) & ~CF_INVALID;
+    const TCGCPUOps *ops;
+    int i;
+
+    if (ahead.n_threads == 0 || phys_pc == -1 ||
+        (cflags & TRANSLATE_AHEAD_CF_SKIP)) {
+        return;
+    }
+    /* Only the target knows what its translator reads besides the flags. */
+    ops = cpu->cc->tcg_ops;
+    if (!ops->translate_ahead_ok || !ops->translate_ahead_ok(cpu, tb)) {
+        return;
+    }
+    /* Disassembling the guest code walks the vCPU's page tables. */
+    if (qemu_loglevel_mask(CPU_LOG_TB_IN_ASM)) {
+        return;
+    }
+#ifdef CONFIG_PLUGIN
+    /* Plugins expect to see each translation from the vCPU's thread. */
+    if (test_bit(QEMU_PLUGIN_EV_VCPU_TB_TRANS, cpu->plugin_mask)) {
+        return;
+    }
+#endif
+
+    qemu_mutex_lock(&ahead.lock);
+    for (i = 0; i < tcg_ctx->nb_gen_succ; i++) {
+        vaddr dest_ofs = tcg_ctx->gen_succ[i] & ~TARGET_PAGE_MASK;
+        TranslateRequest *req;
+
+        if (ahead.head - ahead.tail == TRANSLATE_AHEAD_QUEUE) {
+            ahead.overflows++;
+            continue;
+        }
+        req = &ahead.queue[ahead.head++ & (TRANSLATE_AHEAD_QUEUE - 1)];
+        req->cpu = cpu;
+        req->pc = tcg_ctx->gen_succ[i];
+        req->cs_base = tb->cs_base;
+        req->flags = tb->flags;
+        req->cflags = cflags;
+        req->phys_pc = phys_pc - page_ofs + dest_ofs;
+        req->host_pc = host_pc - page_ofs + dest_ofs;
+        ahead.queued++;
+    }
+    qemu_cond_broadcast(&ahead.work_cond);
+    qemu_mutex_unlock(&ahead.lock);
+}
+
+static bool translate_ahead_busy_with(CPUState *cpu)
+{
+    unsigned int i;
+
+    for (i = 0; i < ahead.n_threads; i++) {
+        if (ahead.current[i] == cpu) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void translate_ahead_cancel(CPUState *cpu)
+{
+    unsigned int i;
+
+    if (ahead.n_threads == 0) {
+        return;
+    }
+
+    qemu_mutex_lock(&ahead.lock);
+    for (i = ahead.tail; i != ahead.head; i++) {
+        TranslateRequest *req = &ahead.queue[i & (TRANSLATE_AHEAD_QUEUE - 1)];
+
+        if (req->cpu == cpu) {
+            req->cpu = NULL;
+        }
+    }
+    while (translate_ahead_busy_with(cpu)) {
+        qemu_cond_wait(&ahead.idle_cond, &ahead.lock);
+    }
+    qemu_mutex_unlock(&ahead.lock);
+}
+
+void translate_ahead_pause(void)
+{
+    if (ahead.n_threads == 0) {
+        return;
+    }
+
+    qemu_mutex_lock(&ahead.lock);
+    ahead.paused++;
+    ahead.tail = ahead.head;
+    while (ahead.busy) {
+        qemu_cond_wait(&ahead.idle_cond, &ahead.lock);
+    }
+    qemu_mutex_unlock(&ahead.lock);
+}
+
+void translate_ahead_resume(void)
+{
+    if (ahead.n_threads == 0) {
+        return;
+    }
+
+    qemu_mutex_lock(&ahead.lock);
+    if (--ahead.paused == 0) {
+        qemu_cond_broadcast(&ahead.work_cond);
+    }
+    qemu_mutex_unlock(&ahead.lock);
+}
+
+int64_t translate_ahead_clock(void)
+{
+    return ahead.n_threads ? get_clock() : 0;
+}
+
+void translate_ahead_account(int64_t start)
+{
+    if (start) {
+        stat64_add(&ahead.vcpu_ns, get_clock() - start);
+        stat64_add(&ahead.vcpu_tbs, 1);
+    }
+}
+
+void translate_ahead_dump_info(GString *buf)
+{
+    uint64_t vcpu_tbs, vcpu_ns;
+
+    if (ahead.n_threads == 0) {
+        return;
+    }
+
+    vcpu_tbs = stat64_get(&ahead.vcpu_tbs);
+    vcpu_ns = stat64_get(&ahead.vcpu_ns);
+
+    qemu_mutex_lock(&ahead.lock);
+    g_string_append_printf(buf, "\nTranslation ahead (%u threads):\n",
+                           ahead.n_threads);
+    g_string_append_printf(buf, "queued              %zu "
+                           "(%zu more did not fit)\n",
+                           ahead.queued, ahead.overflows);
+    g_string_append_printf(buf, "translated          %zu\n",
+                           ahead.results[TRANSLATE_AHEAD_DONE]);
+    g_string_append_printf(buf, "already present     %zu\n",
+                           ahead.results[TRANSLATE_AHEAD_PRESENT]);
+    g_string_append_printf(buf, "dropped             %zu\n",
+                           ahead.results[TRANSLATE_AHEAD_DROPPED]);
+    g_string_append_printf(buf, "time in threads     %" PRIu64 " us\n",
+                           ahead.ahead_ns / SCALE_US);
+    g_string_append_printf(buf, "vCPU translations   %" PRIu64
+                           " in %" PRIu64 " us (%.1f us each)\n",
+                           vcpu_tbs, vcpu_ns / SCALE_US,
+                           vcpu_tbs ? (double)vcpu_ns / SCALE_US / vcpu_tbs
+                                    : 0.0);
+    qemu_mutex_unlock(&ahead.lock);
+}
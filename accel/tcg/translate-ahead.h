@@ -0,0 +1,69 @@
+/*
+ * Translating ahead of the vCPUs on a pool of translator threads
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef ACCEL_TCG_TRANSLATE_AHEAD_H
+#define ACCEL_TCG_TRANSLATE_AHEAD_H
+
+#include "exec/exec-all.h"
+
+/* Translator threads allowed by -accel tcg,translate-threads */
+#define TRANSLATE_AHEAD_MAX_THREADS 32
+
+#ifdef CONFIG_SOFTMMU
+/* Start @n_threads translator threads; each needs a TCG context of its own. */
+void translate_ahead_init(unsigned n_threads);
+
+/*
+ * Queue the direct jump targets that @cpu just recorded while translating
+ * @tb from @host_pc, if they are on the same guest page.
+ */
+void translate_ahead_queue(CPUState *cpu, TranslationBlock *tb,
+                           void *host_pc);
+
+/* Forget the requests of @cpu and wait for any of them being translated. */
+void translate_ahead_cancel(CPUState *cpu);
+
+/*
+ * Stop the translator threads, dropping what they have queued, until
+ * translate_ahead_resume(); used while the code buffer is reset.
+ */
+void translate_ahead_pause(void);
+void translate_ahead_resume(void);
+
+/*
+ * Time a translation by a vCPU, which the translator threads are there
+ * to save: pass the result of translate_ahead_clock() taken before it to
+ * translate_ahead_account().  Free while there are no translator threads.
+ */
+int64_t translate_ahead_clock(void);
+void translate_ahead_account(int64_t start);
+
+void translate_ahead_dump_info(GString *buf);
+#else
+static inline void translate_ahead_queue(CPUState *cpu, TranslationBlock *tb,
+                                         void *host_pc)
+{
+}
+
+static inline int64_t translate_ahead_clock(void)
+{
+    return 0;
+}
+
+static inline void translate_ahead_account(int64_t start)
+{
+}
+
+static inline void translate_ahead_pause(void)
+{
+}
+
+static inline void translate_ahead_resume(void)
+{
+}
+#endif
+
+#endif
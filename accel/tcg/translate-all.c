@@ -63,6 +63,8 @@
 #include "tb-context.h"
 #include "internal.h"
 #include "perf.h"
+#include "tb-cache.h"
+#include "translate-ahead.h"
 #include "tcg/insn-start-words.h"
 
 TBContext tb_ctx;
@@ -283,28 +285,22 @@ static int setjmp_gen_code(CPUArchState *env, TranslationBlock *tb,
     return tcg_gen_code(tcg_ctx, tb, pc);
 }
 
-/* Called with mmap_lock held for user mode emulation.  */
-TranslationBlock *tb_gen_code(CPUState *cpu,
-                              vaddr pc, uint64_t cs_base,
-                              uint32_t flags, int cflags)
+/*
+ * Translate the guest code at @pc, found at @phys_pc and @host_pc.
+ * Return NULL if the code buffer is full, or if a translation ahead of
+ * the vCPU had to be dropped.
+ */
+static TranslationBlock *do_tb_gen_code(CPUState *cpu,
+                                        vaddr pc, uint64_t cs_base,
+                                        uint32_t flags, int cflags,
+                                        tb_page_addr_t phys_pc, void *host_pc)
 {
     CPUArchState *env = cpu->env_ptr;
     TranslationBlock *tb, *existing_tb;
-    tb_page_addr_t phys_pc, phys_p2;
+    tb_page_addr_t phys_p2;
     tcg_insn_unit *gen_code_buf;
     int gen_code_size, search_size, max_insns;
     int64_t ti;
-    void *host_pc;
-
-    assert_memory_lock();
-    qemu_thread_jit_write();
-
-    phys_pc = get_page_addr_code_hostp(env, pc, &host_pc);
-
-    if (phys_pc == -1) {
-        /* Generate a one-shot TB with 1 insn in it */
-        cflags = (cflags & ~CF_COUNT_MASK) | CF_LAST_IO | 1;
-    }
 
     max_insns = cflags & CF_COUNT_MASK;
     if (max_insns == 0) {
@@ -316,22 +312,18 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     assert_no_pages_locked();
     tb = tcg_tb_alloc(tcg_ctx);
     if (unlikely(!tb)) {
-        /* flush must be done */
-        tb_flush(cpu);
-        mmap_unlock();
-        /* Make the execution loop process the flush as soon as possible.  */
-        cpu->exception_index = EXCP_INTERRUPT;
-        cpu_loop_exit(cpu);
+        return NULL;
     }
 
     gen_code_buf = tcg_ctx->code_gen_ptr;
-    tb->tc.ptr = tcg_splitwx_to_rx(gen_code_buf);
     if (!(cflags & CF_PCREL)) {
         tb->pc = pc;
     }
     tb->cs_base = cs_base;
     tb->flags = flags;
     tb->cflags = cflags;
+    tb->exec_count = 0;
+    tb->taken_count = 0;
     tb_set_page_addr0(tb, phys_pc);
     tb_set_page_addr1(tb, -1);
     if (phys_pc != -1) {
@@ -355,6 +347,9 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
 #endif
 
  restart_translate:
+    /* Inline caches allocated by the translator move the code forward. */
+    tb->tc.ptr = tcg_splitwx_to_rx(gen_code_buf);
+    tb->nb_ic = 0;
     trace_translate_block(tb, pc, tb->tc.ptr);
 
     gen_code_size = setjmp_gen_code(env, tb, pc, host_pc, &max_insns, &ti);
@@ -416,11 +411,23 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
                           "Restarting code generation with re-locked pages");
             goto restart_translate;
 
+        case -4:
+            /*
+             * A translation ahead of the vCPU needed more than the page
+             * it was queued for.  Give the space back and leave the TB
+             * to the vCPU.
+             */
+            tb_unlock_pages(tb);
+            tcg_ctx->gen_tb = NULL;
+            qatomic_set(&tcg_ctx->code_gen_ptr, (void *)tb);
+            return NULL;
+
         default:
             g_assert_not_reached();
         }
     }
     tcg_ctx->gen_tb = NULL;
+    gen_code_buf = tcg_splitwx_to_rw(tb->tc.ptr);
 
     search_size = encode_search(tb, (void *)gen_code_buf + gen_code_size);
     if (unlikely(search_size < 0)) {
@@ -556,7 +563,8 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     if (unlikely(existing_tb != tb)) {
         uintptr_t orig_aligned = (uintptr_t)gen_code_buf;
 
-        orig_aligned -= ROUND_UP(sizeof(*tb), qemu_icache_linesize);
+        orig_aligned -= ROUND_UP(sizeof(*tb), qemu_icache_linesize) +
+                        tb->nb_ic * TB_IC_STRIDE;
         qatomic_set(&tcg_ctx->code_gen_ptr, (void *)orig_aligned);
         tcg_tb_remove(tb);
         return existing_tb;
@@ -564,6 +572,98 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     return tb;
 }
 
+/* Called with mmap_lock held for user mode emulation.  */
+TranslationBlock *tb_gen_code(CPUState *cpu,
+                              vaddr pc, uint64_t cs_base,
+                              uint32_t flags, int cflags)
+{
+    CPUArchState *env = cpu->env_ptr;
+    TranslationBlock *tb;
+    tb_page_addr_t phys_pc;
+    void *host_pc;
+    int64_t start;
+
+    assert_memory_lock();
+    qemu_thread_jit_write();
+
+    phys_pc = get_page_addr_code_hostp(env, pc, &host_pc);
+
+    if (phys_pc == -1) {
+        /* Generate a one-shot TB with 1 insn in it */
+        cflags = (cflags & ~CF_COUNT_MASK) | CF_LAST_IO | 1;
+    } else if (!tcg_ctx->gen_superblock) {
+        tb = tb_cache_restore(cpu, pc, cs_base, flags, cflags,
+                              phys_pc, host_pc);
+        if (tb) {
+            return tb;
+        }
+    }
+
+    start = translate_ahead_clock();
+    tb = do_tb_gen_code(cpu, pc, cs_base, flags, cflags, phys_pc, host_pc);
+    translate_ahead_account(start);
+    if (unlikely(!tb)) {
+        /* flush must be done */
+        tb_flush(cpu);
+        tcg_ctx->gen_superblock = NULL;
+        mmap_unlock();
+        /* Make the execution loop process the flush as soon as possible.  */
+        cpu->exception_index = EXCP_INTERRUPT;
+        cpu_loop_exit(cpu);
+    }
+
+    if (tcg_ctx->nb_gen_succ) {
+        translate_ahead_queue(cpu, tb, host_pc);
+    }
+    return tb;
+}
+
+#ifdef CONFIG_SOFTMMU
+/*
+ * Translate @pc for @cpu on a translator thread, from the page that the
+ * vCPU mapped at @phys_pc and @host_pc when it translated a predecessor.
+ * Return NULL if the TB would need more than that page or the code
+ * buffer is full; the vCPU translates it itself if it gets there.
+ */
+TranslationBlock *tb_gen_code_ahead(CPUState *cpu,
+                                    vaddr pc, uint64_t cs_base,
+                                    uint32_t flags, uint32_t cflags,
+                                    tb_page_addr_t phys_pc, void *host_pc)
+{
+    TranslationBlock *tb;
+
+    qemu_thread_jit_write();
+
+    tcg_ctx->gen_ahead = true;
+    tb = do_tb_gen_code(cpu, pc, cs_base, flags, cflags, phys_pc, host_pc);
+    tcg_ctx->gen_ahead = false;
+    return tb;
+}
+#endif
+
+/*
+ * Replace the hot @tb, looked up for @pc, with a superblock translated
+ * from the same state.  Incoming jumps are unlinked by the invalidation
+ * and relinked to the superblock as they are taken again.
+ *
+ * Called with mmap_lock held for user mode emulation.
+ */
+TranslationBlock *tb_gen_superblock(CPUState *cpu, TranslationBlock *tb,
+                                    vaddr pc)
+{
+    uint64_t cs_base = tb->cs_base;
+    uint32_t flags = tb->flags;
+    uint32_t cflags = tb_cflags(tb) & ~CF_INVALID;
+
+    tb_phys_invalidate(tb, -1);
+
+    /* the old TB is not freed before a flush, and has the branch counts */
+    tcg_ctx->gen_superblock = tb;
+    tb = tb_gen_code(cpu, pc, cs_base, flags, cflags);
+    tcg_ctx->gen_superblock = NULL;
+    return tb;
+}
+
 /* user-mode: call with mmap_lock held */
 void tb_check_watchpoint(CPUState *cpu, uintptr_t retaddr)
 {
@@ -789,16 +889,30 @@ void cpu_interrupt(CPUState *cpu, int mask)
  */
 void tcg_flush_jmp_cache(CPUState *cpu)
 {
-    CPUJumpCache *jc = cpu->tb_jmp_cache;
+    CPUJumpCache *jc;
+
+    RCU_READ_LOCK_GUARD();
+    jc = qatomic_rcu_read(&cpu->tb_jmp_cache);
 
     /* During early initialization, the cache may not yet be allocated. */
     if (unlikely(jc == NULL)) {
         return;
     }
 
-    for (int i = 0; i < TB_JMP_CACHE_SIZE; i++) {
+    for (int i = 0; i < tb_jmp_cache_size(jc); i++) {
         qatomic_set(&jc->array[i].tb, NULL);
     }
+    for (int i = 0; i < TB_JMP_VICTIM_SETS; i++) {
+        for (int j = 0; j < TB_JMP_VICTIM_WAYS; j++) {
+            qatomic_set(&jc->victim[i][j].tb, NULL);
+        }
+    }
+
+    /* The inline caches go with it, and so do the return slots. */
+    tb_ic_new_gen(cpu);
+    for (int i = 0; i < TB_RAS_SIZE; i++) {
+        qatomic_set(&cpu_neg(cpu)->ijmp.ras[i], NULL);
+    }
 }
 
 /* This is a wrapper for common code that can not use CONFIG_SOFTMMU */
@@ -16,6 +16,12 @@
 #include "tcg/tcg-op-common.h"
 #include "internal.h"
 
+/*
+ * A branch is followed when one of its sides was seen at least this many
+ * times, and 7 times out of 8.
+ */
+#define SUPERBLOCK_MIN_BRANCHES 16
+
 static void gen_io_start(void)
 {
     tcg_gen_st_i32(tcg_constant_i32(1), cpu_env,
@@ -47,7 +53,8 @@ bool translator_io_start(DisasContextBase *db)
     return true;
 }
 
-static TCGOp *gen_tb_start(uint32_t cflags)
+static TCGOp *gen_tb_start(TranslationBlock *tb, uint32_t cflags,
+                           bool count_execs)
 {
     TCGv_i32 count = tcg_temp_new_i32();
     TCGOp *icount_start_insn = NULL;
@@ -96,6 +103,22 @@ static TCGOp *gen_tb_start(uint32_t cflags)
                        offsetof(ArchCPU, env));
     }
 
+    if (count_execs) {
+        /*
+         * Leave through the exit request path once hot, for cpu_exec to
+         * retranslate the TB as a superblock.  The count is not atomic;
+         * losing an increment to another vCPU only delays that.
+         */
+        TCGv_ptr ptr = tcg_constant_ptr(&tb->exec_count);
+        TCGv_i32 execs = tcg_temp_new_i32();
+
+        tcg_gen_ld_i32(execs, ptr, 0);
+        tcg_gen_addi_i32(execs, execs, 1);
+        tcg_gen_st_i32(execs, ptr, 0);
+        tcg_gen_brcondi_i32(TCG_COND_GEU, execs, tb_hot_threshold,
+                            tcg_ctx->exitreq_label);
+    }
+
     return icount_start_insn;
 }
 
@@ -125,7 +148,286 @@ bool translator_use_goto_tb(DisasContextBase *db, vaddr dest)
     }
 
     /* Check for the dest on the same page as the start of the TB.  */
-    return ((db->pc_first ^ dest) & TARGET_PAGE_MASK) == 0;
+    if ((db->pc_first ^ dest) & TARGET_PAGE_MASK) {
+        return false;
+    }
+
+    /* Remember the target for the translator threads. */
+    if (tcg_ctx->nb_gen_succ < ARRAY_SIZE(tcg_ctx->gen_succ) &&
+        (tcg_ctx->nb_gen_succ == 0 || tcg_ctx->gen_succ[0] != dest)) {
+        tcg_ctx->gen_succ[tcg_ctx->nb_gen_succ++] = dest;
+    }
+    return true;
+}
+
+bool translator_follow_jump(DisasContextBase *db, vaddr next, vaddr dest)
+{
+    /*
+     * Keeping to the first page and above pc_first lets the TB still be
+     * described by [pc_first, pc_first + size) for invalidation.
+     */
+    if (db->superblock_jumps == 0 ||
+        dest < db->pc_first || !is_same_page(db, dest)) {
+        return false;
+    }
+    db->superblock_jumps--;
+    db->pc_end = MAX(db->pc_end, next);
+    db->pc_block = dest;
+    return true;
+}
+
+bool translator_follow_branch(DisasContextBase *db, vaddr next, vaddr dest,
+                              bool *taken)
+{
+    TranslationBlock *tb = db->tb, *prof;
+    uint64_t execs, taken_count;
+
+    if (db->superblock_jumps == 0 || tb_page_addr0(tb) == -1 ||
+        !is_same_page(db, db->pc_block)) {
+        return false;
+    }
+
+    /*
+     * The counted TB that started where this part of the superblock does
+     * ended at this branch, unless it was cut short somewhere else.  For
+     * the first part it is the hot TB, which is no longer in the table.
+     */
+    if (db->pc_block == db->pc_first) {
+        prof = tcg_ctx->gen_superblock;
+    } else {
+        tb_page_addr_t phys = tb_page_addr0(tb) + db->pc_block - db->pc_first;
+
+        prof = tb_htable_find(db->pc_block, tb->cs_base, tb->flags,
+                              tb_cflags(tb), phys);
+    }
+    if (!prof || prof->size != next - db->pc_block) {
+        return false;
+    }
+
+    execs = qatomic_read(&prof->exec_count);
+    taken_count = MIN(qatomic_read(&prof->taken_count), execs);
+    if (execs < SUPERBLOCK_MIN_BRANCHES) {
+        return false;
+    }
+    if (taken_count * 8 >= execs * 7) {
+        if (dest < db->pc_first || !is_same_page(db, dest)) {
+            return false;
+        }
+        *taken = true;
+    } else if (taken_count * 8 <= execs) {
+        *taken = false;
+    } else {
+        return false;
+    }
+
+    db->superblock_jumps--;
+    db->pc_end = MAX(db->pc_end, next);
+    db->pc_block = *taken ? dest : next;
+    return true;
+}
+
+void translator_count_taken(DisasContextBase *db)
+{
+    TCGv_ptr ptr;
+    TCGv_i32 taken;
+
+    if (!db->count_execs) {
+        return;
+    }
+    ptr = tcg_constant_ptr(&db->tb->taken_count);
+    taken = tcg_temp_new_i32();
+    tcg_gen_ld_i32(taken, ptr, 0);
+    tcg_gen_addi_i32(taken, taken, 1);
+    tcg_gen_st_i32(taken, ptr, 0);
+}
+
+/* Offset of a field of CPUIndirectJumpState from env */
+#define IJMP_OFS(F) \
+    ((int)offsetof(ArchCPU, neg.ijmp.F) - (int)offsetof(ArchCPU, env))
+
+#define RAS_MASK (TB_RAS_SIZE * sizeof(void *) - 1)
+
+/*
+ * Whether indirect jumps of the TB being translated get inline caches.
+ * TBs that are not kept, and logging that wants to see every lookup,
+ * are left to the helper.
+ */
+static bool translator_use_ic(DisasContextBase *db)
+{
+    return tb_inline_cache &&
+           !(tb_cflags(db->tb) & CF_NO_GOTO_PTR) &&
+           tb_page_addr0(db->tb) != -1 &&
+           !qemu_loglevel_mask(CPU_LOG_TB_CPU | CPU_LOG_EXEC);
+}
+
+/*
+ * Carve an inline cache out of the space in front of the code of the TB
+ * being translated: tcg_gen_code() starts the code at tb->tc.ptr, and
+ * tb_gen_code() resets both when it restarts the translation.
+ */
+static TBInlineCache *translator_alloc_ic(DisasContextBase *db, int ways)
+{
+    TranslationBlock *tb = db->tb;
+    TBInlineCache *ic;
+
+    if (tb->nb_ic == TB_MAX_IC) {
+        return NULL;
+    }
+    ic = tb_inline_cache(tb, tb->nb_ic++);
+    tb->tc.ptr += TB_IC_STRIDE;
+    memset(ic, 0, sizeof(*ic));
+    ic->ways = ways;
+    return ic;
+}
+
+static TCGv_ptr gen_load_ic_gen(void)
+{
+    TCGv_ptr gen = tcg_temp_new_ptr();
+
+#ifdef CONFIG_USER_ONLY
+    tcg_gen_ld_ptr(gen, tcg_constant_ptr(&tb_ic_gen), 0);
+#else
+    tcg_gen_ld_ptr(gen, cpu_env, IJMP_OFS(gen));
+#endif
+    return gen;
+}
+
+/*
+ * Jump to the TB of inline cache record @rec if the record is for @dest
+ * and generation @gen and the TB is still valid, else branch to @miss.
+ * With @db, the record must also be for the cs_base and flags of the TB
+ * being translated, which the jump leaves unchanged.
+ */
+static void gen_ic_way(DisasContextBase *db, TCGv_ptr rec, TCGv_i64 dest,
+                       TCGv_ptr gen, TCGLabel *miss)
+{
+    TCGv_i64 pc = tcg_temp_new_i64();
+    TCGv_ptr t = tcg_temp_new_ptr();
+    TCGv_i32 cflags = tcg_temp_new_i32();
+
+    tcg_gen_brcondi_ptr(TCG_COND_EQ, rec, 0, miss);
+    tcg_gen_ld_i64(pc, rec, offsetof(TBInlineRecord, pc));
+    tcg_gen_brcond_i64(TCG_COND_NE, pc, dest, miss);
+    if (db) {
+        TCGv_i32 flags = tcg_temp_new_i32();
+        TCGv_i64 cs_base = tcg_temp_new_i64();
+
+        tcg_gen_ld_i32(flags, rec, offsetof(TBInlineRecord, flags));
+        tcg_gen_brcondi_i32(TCG_COND_NE, flags, db->tb->flags, miss);
+        tcg_gen_ld_i64(cs_base, rec, offsetof(TBInlineRecord, cs_base));
+        tcg_gen_brcondi_i64(TCG_COND_NE, cs_base, db->tb->cs_base, miss);
+    }
+    tcg_gen_ld_ptr(t, rec, offsetof(TBInlineRecord, gen));
+    tcg_gen_brcond_ptr(TCG_COND_NE, t, gen, miss);
+    tcg_gen_ld_ptr(t, rec, offsetof(TBInlineRecord, tb));
+    tcg_gen_ld_i32(cflags, t, offsetof(TranslationBlock, cflags));
+    tcg_gen_andi_i32(cflags, cflags, CF_INVALID);
+    tcg_gen_brcondi_i32(TCG_COND_NE, cflags, 0, miss);
+    tcg_gen_ld_ptr(t, t, offsetof(TranslationBlock, tc.ptr));
+    tcg_gen_goto_ptr(t);
+}
+
+void translator_lookup_and_goto_ptr(DisasContextBase *db, TCGv_i64 dest)
+{
+    TBInlineCache *ic = NULL;
+    TCGv_ptr ic_ptr, rec, gen;
+
+    if (translator_use_ic(db)) {
+        ic = translator_alloc_ic(db, TB_IC_WAYS);
+    }
+    if (ic == NULL) {
+        tcg_gen_lookup_and_goto_ptr();
+        return;
+    }
+
+    ic_ptr = tcg_constant_ptr(ic);
+    rec = tcg_temp_new_ptr();
+    gen = gen_load_ic_gen();
+    for (int i = 0; i < TB_IC_WAYS; i++) {
+        TCGLabel *miss = gen_new_label();
+
+        tcg_gen_ld_ptr(rec, ic_ptr, offsetof(TBInlineCache, way[i]));
+        gen_ic_way(NULL, rec, dest, gen, miss);
+        gen_set_label(miss);
+    }
+    tcg_gen_lookup_and_goto_ptr_ic(ic_ptr);
+}
+
+void translator_push_return(DisasContextBase *db)
+{
+    TBInlineCache *ic;
+    TCGv_i32 top;
+    TCGv_ptr addr;
+
+    if (!translator_use_ic(db)) {
+        return;
+    }
+
+    /* Without a slot, push NULL to keep the stack in step with the calls. */
+    ic = translator_alloc_ic(db, 1);
+    top = tcg_temp_new_i32();
+    addr = tcg_temp_new_ptr();
+
+    QEMU_BUILD_BUG_ON(TB_RAS_SIZE & (TB_RAS_SIZE - 1));
+    tcg_gen_ld_i32(top, cpu_env, IJMP_OFS(ras_top));
+    tcg_gen_addi_i32(top, top, sizeof(void *));
+    tcg_gen_andi_i32(top, top, RAS_MASK);
+    tcg_gen_st_i32(top, cpu_env, IJMP_OFS(ras_top));
+    tcg_gen_ext_i32_ptr(addr, top);
+    tcg_gen_add_ptr(addr, addr, cpu_env);
+    tcg_gen_st_ptr(tcg_constant_ptr(ic), addr, IJMP_OFS(ras));
+}
+
+void translator_return(DisasContextBase *db, TCGv_i64 dest)
+{
+    TCGv_i32 top;
+    TCGv_ptr addr, slot, rec;
+    TCGLabel *miss;
+
+    if (!translator_use_ic(db)) {
+        tcg_gen_lookup_and_goto_ptr();
+        return;
+    }
+
+    top = tcg_temp_new_i32();
+    addr = tcg_temp_new_ptr();
+    slot = tcg_temp_new_ptr();
+    rec = tcg_temp_new_ptr();
+    miss = gen_new_label();
+
+    tcg_gen_ld_i32(top, cpu_env, IJMP_OFS(ras_top));
+    tcg_gen_ext_i32_ptr(addr, top);
+    tcg_gen_add_ptr(addr, addr, cpu_env);
+    tcg_gen_ld_ptr(slot, addr, IJMP_OFS(ras));
+    tcg_gen_st_ptr(tcg_constant_ptr(NULL), addr, IJMP_OFS(ras));
+    tcg_gen_subi_i32(top, top, sizeof(void *));
+    tcg_gen_andi_i32(top, top, RAS_MASK);
+    tcg_gen_st_i32(top, cpu_env, IJMP_OFS(ras_top));
+
+    /*
+     * The slot of the matching call remembers where it returned to, from
+     * whichever return popped it last: check that it had our flags.
+     */
+    tcg_gen_brcondi_ptr(TCG_COND_EQ, slot, 0, miss);
+    tcg_gen_ld_ptr(rec, slot, offsetof(TBInlineCache, way[0]));
+    gen_ic_way(db, rec, dest, gen_load_ic_gen(), miss);
+    gen_set_label(miss);
+    tcg_gen_lookup_and_goto_ptr_ic(slot);
+}
+
+/*
+ * Whether TBs translated with @cflags take part in superblock formation.
+ * One-shot TBs with an exact insn count, TBs that must not chain and
+ * icount, whose budget the early exit would upset, are left alone.
+ */
+static bool translator_superblock_ok(const TranslatorOps *ops,
+                                     DisasContextBase *db, CPUState *cpu,
+                                     uint32_t cflags)
+{
+    return tb_hot_threshold && ops->superblock &&
+           !(cflags & (CF_COUNT_MASK | CF_NO_GOTO_TB | CF_LAST_IO |
+                       CF_USE_ICOUNT | CF_NOIRQ)) &&
+           ops->superblock(db, cpu);
 }
 
 void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
@@ -134,7 +436,7 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
 {
     uint32_t cflags = tb_cflags(tb);
     TCGOp *icount_start_insn;
-    bool plugin_enabled;
+    bool plugin_enabled, count_execs;
 
     /* Initialize DisasContext */
     db->tb = tb;
@@ -144,14 +446,26 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
     db->num_insns = 0;
     db->max_insns = *max_insns;
     db->singlestep_enabled = cflags & CF_SINGLE_STEP;
+    db->superblock_jumps = 0;
+    db->pc_end = pc;
+    db->pc_block = pc;
     db->host_addr[0] = host_pc;
     db->host_addr[1] = NULL;
+    tcg_ctx->nb_gen_succ = 0;
 
     ops->init_disas_context(db, cpu);
     tcg_debug_assert(db->is_jmp == DISAS_NEXT);  /* no early exit */
 
+    /* Count executions until hot, then fold jumps and branches instead. */
+    count_execs = translator_superblock_ok(ops, db, cpu, cflags);
+    if (count_execs && tcg_ctx->gen_superblock) {
+        db->superblock_jumps = SUPERBLOCK_MAX_JUMPS;
+        count_execs = false;
+    }
+    db->count_execs = count_execs;
+
     /* Start translating.  */
-    icount_start_insn = gen_tb_start(cflags);
+    icount_start_insn = gen_tb_start(tb, cflags, count_execs);
     ops->tb_start(db, cpu);
     tcg_debug_assert(db->is_jmp == DISAS_NEXT);  /* no early exit */
 
@@ -215,7 +529,7 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
     }
 
     /* The disas_log hook may use these values rather than recompute.  */
-    tb->size = db->pc_next - db->pc_first;
+    tb->size = MAX(db->pc_next, db->pc_end) - db->pc_first;
     tb->icount = db->num_insns;
 
     if (qemu_loglevel_mask(CPU_LOG_TB_IN_ASM)
@@ -254,6 +568,14 @@ static void *translator_access(CPUArchState *env, DisasContextBase *db,
         if (host == NULL) {
             tb_page_addr_t page0, old_page1, new_page1;
 
+            /*
+             * Mapping the second page would need the vCPU's TLB, which a
+             * translator thread must not touch: drop the TB instead.
+             */
+            if (tcg_ctx->gen_ahead) {
+                siglongjmp(tcg_ctx->jmp_trans, -4);
+            }
+
             new_page1 = get_page_addr_code_hostp(env, base, &db->host_addr[1]);
 
             /*
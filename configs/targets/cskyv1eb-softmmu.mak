@@ -1,6 +1,7 @@
 TARGET_ARCH=cskyv1
 TARGET_BASE_ARCH=csky
 TARGET_ABI_DIR=csky
+TARGET_SUPPORTS_MTTCG=y
 TARGET_HAS_BFLT=y
 TARGET_CSKYV1=y
 TARGET_XML_FILES= gdb-xml/csky-abiv1-linux-user-core.xml gdb-xml/csky-abiv1-softmmu-core.xml
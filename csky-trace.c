@@ -20,10 +20,15 @@
 #include "cpu.h"
 #include "exec/tracestub.h"
 #include "exec/helper-proto.h"
+#include "exec/tb-flush.h"
 
 extern bool is_gdbserver_start;
 static uint32_t csky_trace_insn_seg;
 static uint32_t csky_trace_data_seg;
+static int csky_trace_insn_base = -1;
+/* set when the seg must be sent again even if it is unchanged */
+static bool csky_trace_insn_seg_stale;
+static bool csky_trace_data_seg_stale;
 #ifdef TARGET_RISCV
 bool csky_trace_elf_start;
 #endif
@@ -43,6 +48,20 @@ inline bool gen_mem_trace(void)
     return false;
 }
 
+/*
+ * Inline records are turned into packets later, so only use them when the
+ * data filter does not depend on run time state.
+ */
+bool gen_mem_trace_inline(void)
+{
+#ifdef TARGET_CSKY
+    return traceserver.inline_mem && gen_mem_trace() &&
+           tfilter.stsp_num == 0 && !(tfilter.asid & TRACE_ASID_ENABLE_MASK);
+#else
+    return false;
+#endif
+}
+
 inline bool gen_tb_trace(void)
 {
     if (tfilter.enable) {
@@ -90,20 +109,32 @@ static inline uint32_t csky_trace_get_addr_offset(target_ulong addr)
 }
 
 
-static inline void csky_trace_send_base(uint32_t *base, uint8_t type,
-                                        target_ulong addr)
+static inline void csky_trace_send_base(uint32_t *base, bool *stale,
+                                        uint8_t type, target_ulong addr)
 {
     int packlen = 0;
     uint32_t addr_base;
     packlen = 2 * sizeof(uint8_t) + sizeof(uint32_t);
     addr_base = csky_trace_get_addr_base(addr);
-    if (addr_base != *base) {
+    if (addr_base != *base || *stale) {
         *base = addr_base;
+        *stale = false;
         write_trace_8_8(type, packlen, sizeof(uint8_t), addr_base);
     }
     return;
 }
 
+/*
+ * Called at a seek point of the trace file: a reader may start decoding
+ * there, so the bases have to be sent again before the next offsets.
+ */
+void csky_trace_resync(void)
+{
+    csky_trace_insn_base = -1;
+    csky_trace_insn_seg_stale = true;
+    csky_trace_data_seg_stale = true;
+}
+
 static bool stsp_range_match(target_ulong pc, target_ulong smask)
 {
     struct trace_range *tr = NULL;
@@ -206,6 +237,56 @@ static bool data_range_match(target_ulong pc, target_ulong value)
 }
 #endif
 
+static bool insn_range_match(target_ulong pc)
+{
+    struct trace_range *tr;
+    int i;
+
+    if (tfilter.insn_range_num == 0) {
+        return true;
+    }
+    for (i = 0; i < tfilter.insn_range_num; i++) {
+        tr = &tfilter.insn_range[i];
+        if ((tr->start <= pc) && (tr->end > pc)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Classify the TB starting at pc against the instruction windows. The
+ * class holds for [pc, *limit), the translator must end the TB there.
+ * Windows can only be checked at translation time; stsp and asid
+ * filtering depend on run time state and keep the filtering helper.
+ */
+int csky_trace_tb_class(uint64_t pc, uint64_t *limit)
+{
+    struct trace_range *tr;
+    bool inside = tfilter.insn_range_num == 0;
+    int i;
+
+    *limit = UINT64_MAX;
+    for (i = 0; i < tfilter.insn_range_num; i++) {
+        tr = &tfilter.insn_range[i];
+        if ((tr->start <= pc) && (tr->end > pc)) {
+            inside = true;
+            *limit = MIN(*limit, tr->end);
+        } else if (tr->start > pc) {
+            *limit = MIN(*limit, tr->start);
+        }
+    }
+    if (!inside) {
+        return TRACE_TB_OUTSIDE;
+    }
+#ifdef TARGET_CSKY
+    if (tfilter.stsp_num == 0 && !(tfilter.asid & TRACE_ASID_ENABLE_MASK)) {
+        return TRACE_TB_INSIDE;
+    }
+#endif
+    return TRACE_TB_FILTER;
+}
+
 bool trace_range_test(void *cpu, uint32_t pc, uint32_t smask)
 {
     bool result = false;
@@ -244,6 +325,21 @@ static int addr_trace_filter(CPUArchState *env, target_ulong pc)
     return result;
 }
 
+/* the part of addr_trace_filter that decides if insns are counted */
+static bool icount_trace_filter(CPUArchState *env, target_ulong pc)
+{
+#ifdef TARGET_CSKY
+    if (tfilter.asid & TRACE_ASID_ENABLE_MASK) {
+        if (ENV_GET_MMU(env)) {
+            if (tfilter.asid != ENV_GET_ASID(env)) {
+                return false;
+            }
+        }
+    }
+#endif
+    return stsp_range_match(pc, 0);
+}
+
 static int data_trace_filter(CPUArchState *env,
     target_ulong pc, target_ulong addr, target_ulong value)
 {
@@ -278,35 +374,36 @@ static int sync_trace_count;
 #endif
 void helper_csky_trace_icount(CPUArchState *env, target_ulong tb_pc, uint32_t icount)
 {
-    static long long total_csky_trace_icount;
-    static long long last_csky_trace_icount;
-    total_csky_trace_icount += icount;
-    if ((total_csky_trace_icount - last_csky_trace_icount) > INSN_PER_PACKET) {
+    bool traced = tfilter.enable && (tfilter.event & TRACE_EVENT_INSN) &&
+                  icount_trace_filter(env, tb_pc);
+
 #ifdef CSKY_TRACE_DEBUG
-        if (sync_trace_count % 100 == 0) {
-            fprintf(stderr, ".");
-            fflush(stderr);
-        }
-        sync_trace_count++;
-#endif
-        trace_send();
-        last_csky_trace_icount = total_csky_trace_icount;
+    if (sync_trace_count % 100 == 0) {
+        fprintf(stderr, ".");
+        fflush(stderr);
     }
-    if (tfilter.enable) {
-        if (tfilter.event & TRACE_EVENT_INSN) {
-            int result = addr_trace_filter(env, tb_pc);
-            if (result & STSP_RANGE_MATCH) {
-                csky_trace_icount += icount;
-            }
-        }
+    sync_trace_count++;
+#endif
+    trace_count_insns(icount, traced);
+}
+
+static void trace_tb_start_emit(CPUArchState *env, target_ulong tb_pc)
+{
+    int base = (tb_pc >> 24) & 0xff;
+    int32_t offset = tb_pc & 0xffffff;
+
+    csky_trace_send_base(&csky_trace_insn_seg, &csky_trace_insn_seg_stale,
+                         INST_SEG, tb_pc);
+    env->last_pc = tb_pc;
+    if (base != csky_trace_insn_base) {
+        write_trace_8(INST_BASE, 2 * sizeof(uint8_t), base);
+        csky_trace_insn_base = base;
     }
+    write_trace_8(INST_OFFSET, sizeof(uint32_t), offset);
 }
 
 void helper_trace_tb_start(CPUArchState *env, target_ulong tb_pc)
 {
-    static int8_t lastbase;
-    int8_t base = (tb_pc >> 24) & 0xff;
-    int32_t offset = tb_pc & 0xffffff;
     int result = addr_trace_filter(env, tb_pc);
 #ifdef TARGET_RISCV
     if (!csky_trace_elf_start) {
@@ -318,20 +415,22 @@ void helper_trace_tb_start(CPUArchState *env, target_ulong tb_pc)
         return;
     }
 #endif
-    if (result & STSP_RANGE_MATCH) {
-        csky_trace_send_base(&csky_trace_insn_seg, INST_SEG, tb_pc);
-        env->last_pc = tb_pc;
-        if (base != lastbase) {
-            write_trace_8(INST_BASE, 2 * sizeof(uint8_t), base);
-            lastbase = base;
-        }
-        write_trace_8(INST_OFFSET, sizeof(uint32_t), offset);
+    if ((result & STSP_RANGE_MATCH) && insn_range_match(tb_pc)) {
+        trace_tb_start_emit(env, tb_pc);
         if (result & ADDR_RANGE_MATCH) {
             //write_trace_8(ADDR_CMPR_MATCH, sizeof(uint32_t), offset);
         }
     }
 }
 
+#ifdef TARGET_CSKY
+/* for TB_TRACE_INSIDE blocks, see csky_trace_tb_class */
+void helper_trace_tb_start_fast(CPUArchState *env, target_ulong tb_pc)
+{
+    trace_tb_start_emit(env, tb_pc);
+}
+#endif
+
 void helper_trace_tb_exit(uint32_t subtype, uint32_t offset)
 {
 #ifdef TARGET_RISCV
@@ -350,8 +449,8 @@ void extern_helper_trace_tb_exit(uint32_t subtype, uint32_t offset)
     helper_trace_tb_exit(subtype, offset);
 }
 
-static void helper_trace_ldst(CPUArchState *env, target_ulong pc,
-    target_ulong rz, target_ulong addr, int type)
+static void trace_ldst_emit(CPUArchState *env, target_ulong pc,
+    target_ulong last_pc, target_ulong rz, target_ulong addr, int type)
 {
     int packlen = 0;
     int result = data_trace_filter(env, pc, addr, rz);
@@ -359,9 +458,10 @@ static void helper_trace_ldst(CPUArchState *env, target_ulong pc,
     packlen = 2 * sizeof(uint8_t) + sizeof(uint32_t);
     if (result & STSP_RANGE_MATCH) {
         if (tfilter.proxy) {
-            write_trace_8(DATA_INST_OFFSET, sizeof(uint32_t), pc - env->last_pc);
+            write_trace_8(DATA_INST_OFFSET, sizeof(uint32_t), pc - last_pc);
         }
-        csky_trace_send_base(&csky_trace_data_seg, DATA_SEG, addr);
+        csky_trace_send_base(&csky_trace_data_seg,
+                             &csky_trace_data_seg_stale, DATA_SEG, addr);
         addr = csky_trace_get_addr_offset(addr);
         switch (type) {
         case LD8U: case LD8S:
@@ -418,6 +518,61 @@ static void helper_trace_ldst(CPUArchState *env, target_ulong pc,
     }
 }
 
+static void helper_trace_ldst(CPUArchState *env, target_ulong pc,
+    target_ulong rz, target_ulong addr, int type)
+{
+    trace_ldst_emit(env, pc, env->last_pc, rz, addr, type);
+}
+
+#ifdef TARGET_CSKY
+/* turn the records stored by gen_trace_rec into packets */
+static void csky_trace_rec_drain(CPUArchState *env)
+{
+    struct CSKYTraceRec *rec = env->trace_rec;
+    struct CSKYTraceRec *end = rec + env->trace_rec_pos / sizeof(*rec);
+
+    /* the packets below come back here through write_trace_before */
+    env->trace_rec_pos = 0;
+    for (; rec < end; rec++) {
+        trace_ldst_emit(env, rec->pc, rec->last_pc, rec->value, rec->addr,
+                        rec->type);
+    }
+}
+
+void helper_trace_rec_flush(CPUArchState *env)
+{
+    csky_trace_rec_drain(env);
+}
+#endif
+
+/* emit the pending records of this vCPU before any other packet */
+void csky_trace_rec_sync(void)
+{
+#ifdef TARGET_CSKY
+    CPUState *cs = current_cpu;
+
+    if (traceserver.inline_mem && cs) {
+        CPUArchState *env = cs->env_ptr;
+        if (env->trace_rec_pos) {
+            csky_trace_rec_drain(env);
+        }
+    }
+#endif
+}
+
+void csky_trace_rec_sync_all(void)
+{
+#ifdef TARGET_CSKY
+    CPUState *cs;
+
+    if (traceserver.inline_mem) {
+        CPU_FOREACH(cs) {
+            csky_trace_rec_drain(cs->env_ptr);
+        }
+    }
+#endif
+}
+
 void helper_trace_ld8u(CPUArchState *env, target_ulong pc,
                        target_ulong rz, target_ulong addr)
 {
@@ -498,7 +653,8 @@ void helper_trace_m_addr(CPUArchState *env, target_ulong pc,
 
     packlen = 2 * sizeof(uint8_t) + sizeof(uint32_t);
     if (result & STSP_RANGE_MATCH) {
-        csky_trace_send_base(&csky_trace_data_seg, DATA_SEG, addr);
+        csky_trace_send_base(&csky_trace_data_seg,
+                             &csky_trace_data_seg_stale, DATA_SEG, addr);
         addr = csky_trace_get_addr_offset(addr);
         write_trace_8_8(type, packlen, num * sizeof(uint32_t), addr);
         if (type == 0x41) {
@@ -533,7 +689,27 @@ void helper_trace_m_value(CPUArchState *env, target_ulong pc,
     }
 }
 
-void helper_trace_update_tcr(CPUArchState *env)
+void csky_trace_get_tb_state(struct csky_trace_tb_state *st)
+{
+    uint32_t n;
+
+    memset(st, 0, sizeof(*st));
+    st->enable = tfilter.enable;
+    st->proxy = tfilter.proxy;
+    st->asid_filter = tfilter.asid & TRACE_ASID_ENABLE_MASK;
+    st->event = tfilter.event;
+    n = MIN(tfilter.stsp_num, MAX_ADDR_CMPR_NUM);
+    st->stsp_num = n;
+    memcpy(st->stsp_range, tfilter.stsp_range, n * sizeof(struct trace_range));
+    n = MIN(tfilter.addr_num, MAX_ADDR_CMPR_NUM);
+    st->addr_num = n;
+    memcpy(st->addr_range, tfilter.addr_range, n * sizeof(struct trace_range));
+    n = MIN(tfilter.insn_range_num, MAX_ADDR_CMPR_NUM);
+    st->insn_range_num = n;
+    memcpy(st->insn_range, tfilter.insn_range, n * sizeof(struct trace_range));
+}
+
+static void trace_update_filter(CPUArchState *env)
 {
     int mode = -1;
     int enable = 0;
@@ -545,6 +721,11 @@ void helper_trace_update_tcr(CPUArchState *env)
 
     /* TRCEn enable */
     if ((env->cp13.tcr & 0x01) && (cpu->csky_trace_features & CSKY_TRACE)) {
+        /* the comparators are read again, not appended to the old ones */
+        *addr_index = 0;
+        *data_index = 0;
+        *stsp_index = 0;
+        tfilter.insn_range_num = 0;
 
         tfilter.enable = true;
         tfilter.event = env->cp13.ter; /* get all trace event */
@@ -567,6 +748,12 @@ void helper_trace_update_tcr(CPUArchState *env)
             if (enable) {
                 switch (mode) {
                 case INSN_ADDR_RANGE_CMPR:
+                    tfilter.insn_range[tfilter.insn_range_num].start
+                                    = env->cp13.addr_cmpr[i];
+                    tfilter.insn_range[tfilter.insn_range_num].end
+                                    = env->cp13.addr_cmpr[i + 1];
+                    tfilter.insn_range_num++;
+                    /* fall through */
                 case DATA_ADDR_RANGE_CMPR: /* addr range match */
                     tfilter.addr_range[*addr_index].start
                                     = env->cp13.addr_cmpr[i];
@@ -617,3 +804,17 @@ void helper_trace_update_tcr(CPUArchState *env)
     }
 }
 
+void helper_trace_update_tcr(CPUArchState *env)
+{
+    struct csky_trace_tb_state old, new;
+
+    csky_trace_get_tb_state(&old);
+    trace_update_filter(env);
+    csky_trace_get_tb_state(&new);
+
+    /* TBs were translated against the old filter, see csky_trace_tb_class */
+    if (memcmp(&old, &new, sizeof(old))) {
+        tb_flush(env_cpu(env));
+    }
+}
+
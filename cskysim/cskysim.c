@@ -29,6 +29,11 @@
 #else
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <sys/stat.h>
+#include <errno.h>
+#endif
+#ifdef __linux__
+#include <sys/personality.h>
 #endif
 
 #include <libxml/xmlstring.h>
@@ -1109,6 +1114,171 @@ static int xml_check(struct dynsoc_board_info *b_info)
     return 0;
 }
 
+#ifndef _WIN32
+/*
+ * The board parsed from a SoC XML is cached as a compiled board
+ * description, named after the hash of the XML.  A launch with an XML seen
+ * before loads the cached board instead of parsing, and QEMU maps the same
+ * file instead of attaching to a shared memory segment.
+ */
+static int board_xml_hash(char *filename, uint64_t *hash)
+{
+    char buf[4096];
+    size_t n;
+    FILE *fp;
+    uint64_t h = DYNSOC_HASH_INIT;
+    uint32_t size = sizeof(struct dynsoc_board_info);
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    /* the parser and the layout of the board are part of the key */
+    h = dynsoc_hash(h, CSKYSIM_VERSION, strlen(CSKYSIM_VERSION));
+    h = dynsoc_hash(h, &size, sizeof(size));
+    while ((n = fread(buf, 1, sizeof(buf), fp)) != 0) {
+        h = dynsoc_hash(h, buf, n);
+    }
+    if (ferror(fp)) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    *hash = h;
+    return 0;
+}
+
+static int board_cache_dir(char *dir, size_t len)
+{
+    const char *env;
+    char *p;
+
+    if ((env = getenv("CSKYSIM_CACHE_DIR")) != NULL && *env) {
+        snprintf(dir, len, "%s", env);
+    } else if ((env = getenv("XDG_CACHE_HOME")) != NULL && *env) {
+        snprintf(dir, len, "%s/cskysim", env);
+    } else if ((env = getenv("HOME")) != NULL && *env) {
+        snprintf(dir, len, "%s/.cache/cskysim", env);
+    } else {
+        return -1;
+    }
+
+    for (p = dir + 1; ; p++) {
+        if (*p == '/' || *p == '\0') {
+            char c = *p;
+
+            *p = '\0';
+            if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+                return -1;
+            }
+            *p = c;
+            if (c == '\0') {
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+static int board_read(char *path, uint64_t xml_hash,
+                      struct dynsoc_board_info *b_info)
+{
+    struct dynsoc_board_file bf;
+    FILE *fp;
+    int ok;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+    ok = fread(&bf, sizeof(bf), 1, fp) == 1 && fgetc(fp) == EOF;
+    fclose(fp);
+
+    if (!ok || memcmp(bf.magic, DYNSOC_BOARD_MAGIC, sizeof(bf.magic)) ||
+        bf.version != DYNSOC_BOARD_VERSION ||
+        bf.info_size != sizeof(bf.info) || bf.xml_hash != xml_hash ||
+        bf.info_hash != dynsoc_hash(DYNSOC_HASH_INIT, &bf.info,
+                                    sizeof(bf.info))) {
+        return -1;
+    }
+
+    memcpy(b_info, &bf.info, sizeof(bf.info));
+    /* xml_parse() only keeps the board name for known riscv machines */
+    rv_set_machine = strcmp(b_info->name, "dummyh") != 0;
+    return 0;
+}
+
+static int board_write(char *path, uint64_t xml_hash,
+                       struct dynsoc_board_info *b_info)
+{
+    struct dynsoc_board_file bf;
+    char tmp[1024];
+    FILE *fp;
+    int ok;
+
+    memset(&bf, 0, sizeof(bf));
+    memcpy(bf.magic, DYNSOC_BOARD_MAGIC, sizeof(DYNSOC_BOARD_MAGIC));
+    bf.version = DYNSOC_BOARD_VERSION;
+    bf.info_size = sizeof(bf.info);
+    bf.xml_hash = xml_hash;
+    memcpy(&bf.info, b_info, sizeof(bf.info));
+    bf.info_hash = dynsoc_hash(DYNSOC_HASH_INIT, &bf.info, sizeof(bf.info));
+
+    /* concurrent launches may compile the same board; rename is atomic */
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    fp = fopen(tmp, "wb");
+    if (fp == NULL) {
+        return -1;
+    }
+    ok = fwrite(&bf, sizeof(bf), 1, fp) == 1;
+    if (fclose(fp) != 0 || !ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Parse the XML or load its cached board.  On return @path names the
+ * compiled board for QEMU, or is empty if it could not be cached.
+ */
+static int board_compile(char *filename, struct dynsoc_board_info *b_info,
+                         char *path, size_t len)
+{
+    char dir[512];
+    uint64_t xml_hash;
+
+    path[0] = '\0';
+    if (board_xml_hash(filename, &xml_hash) != 0 ||
+        board_cache_dir(dir, sizeof(dir)) != 0) {
+        return xml_parse(filename, b_info);
+    }
+    snprintf(path, len, "%s/%016llx.board", dir,
+             (unsigned long long)xml_hash);
+
+    if (board_read(path, xml_hash, b_info) == 0) {
+        return 0;
+    }
+    if (xml_parse(filename, b_info) != 0) {
+        path[0] = '\0';
+        return 1;
+    }
+    if (board_write(path, xml_hash, b_info) != 0) {
+        path[0] = '\0';
+    }
+    return 0;
+}
+#else
+static int board_compile(char *filename, struct dynsoc_board_info *b_info,
+                         char *path, size_t len)
+{
+    path[0] = '\0';
+    return xml_parse(filename, b_info);
+}
+#endif
+
 static inline void print_help(void)
 {
     fprintf(stderr, CSKYSIM_VERSION"\n"
@@ -1317,6 +1487,15 @@ void free_shm(struct dynsoc_board_info *b_info)
 
 void start_qemu(char *cmd)
 {
+#ifdef __linux__
+    /*
+     * -accel tcg,tb-cache=FILE reloads translated code at the address it
+     * was generated at, which only works without address randomization.
+     */
+    if (strstr(cmd, "tb-cache=")) {
+        personality(personality(0xffffffff) | ADDR_NO_RANDOMIZE);
+    }
+#endif
     system(cmd);
 }
 
@@ -1417,6 +1596,33 @@ static struct dynsoc_board_info *share_board_info(int shmkey)
     return b_info;
 }
 
+/* Hand the board over in shared memory if it could not be cached. */
+static struct dynsoc_board_info *share_board(struct dynsoc_board_info *board,
+                                             int *shmkey)
+{
+    struct dynsoc_board_info *b_info;
+    int shmid;
+    int i = 20;
+
+    /* generate dynsoc_board_info randomly. */
+    srand((unsigned)time(NULL));
+    do {
+        *shmkey = rand() % 10000;
+        b_info = share_board_info(*shmkey);
+    } while ((b_info == (struct dynsoc_board_info *)-1) && i--);
+
+    if (b_info == (struct dynsoc_board_info *)-1) {
+        return b_info;
+    }
+
+    shmid = b_info->shmid;
+    memcpy(b_info, board, sizeof(*b_info));
+    b_info->shmid = shmid;
+    b_info->write_enable = 1;
+    b_info->read_enable = 0;
+    return b_info;
+}
+
 static int postfix_args(struct dynsoc_board_info *b_info, char *cmd)
 {
     space_strcat(cmd, "-machine");
@@ -1464,7 +1670,9 @@ static int postfix_args(struct dynsoc_board_info *b_info, char *cmd)
 
 int main(int argc, char *argv[])
 {
-    struct dynsoc_board_info *b_info;
+    static struct dynsoc_board_info board;
+    struct dynsoc_board_info *b_info = &board;
+    char board_path[512];
     char cmd[2048];
     char *index = cmd;
     int i, ret;
@@ -1499,19 +1707,6 @@ int main(int argc, char *argv[])
         }
     }
 
-    /* generate dynsoc_board_info randomly. */
-    srand((unsigned)time(NULL));
-    i = 20;
-    do {
-        shmkey = rand() % 10000;
-        b_info = share_board_info(shmkey);
-    } while ((b_info == (struct dynsoc_board_info *)-1) && i--);
-
-    if (b_info == (struct dynsoc_board_info *)-1) {
-        printf("can not share the board info\n");
-        goto cskysim_fail;
-    }
-
     /* find the option -check, parse and check the xml file */
     for (i = 1; i < argc; i++) {
         if ((strcmp(argv[i], "--check") == 0) ||
@@ -1531,15 +1726,25 @@ int main(int argc, char *argv[])
     /* find the option -soc and parse the xml file */
     for (i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-soc") == 0) {
-            ret = xml_parse(argv[i + 1], b_info);
+            ret = board_compile(argv[i + 1], b_info, board_path,
+                                sizeof(board_path));
             if (ret != 0) {
                 printf("Error: xml is not a legal board.\n");
                 goto cskysim_fail;
             }
             /* check rv and set machine */
             if (!rv_set_machine) {
-                if (b_info->shm == 1) {
+                if (b_info->shm == 1 && board_path[0]) {
+                    argv[i + 1] = (char *)malloc(strlen(board_path) + 6);
+                    sprintf(argv[i + 1], "file=%s", board_path);
+                } else if (b_info->shm == 1) {
                     char shmkey_str[20] = {0};
+
+                    b_info = share_board(&board, &shmkey);
+                    if (b_info == (struct dynsoc_board_info *)-1) {
+                        printf("can not share the board info\n");
+                        goto cskysim_fail;
+                    }
                     sprintf(shmkey_str, "shm=on,shmkey=%d", shmkey);
                     argv[i + 1] = (char *)malloc(strlen(shmkey_str) + 1);
                     memset(argv[i + 1], 0, strlen(shmkey_str) + 1);
@@ -1597,7 +1802,7 @@ int main(int argc, char *argv[])
         start_qemu(cmd);
     }
 
-    if (b_info->shm == 1) {
+    if (b_info != &board) {
         free_shm(b_info);
     }
 
@@ -82,13 +82,25 @@ static struct dynsoc_board_info *create_shm(int shmkey)
 
 #endif
 
+static void dynsoc_load_board(struct dynsoc_board_info *b_info)
+{
+    int i;
+
+    dynsoc_b_info = b_info;
+    module_load("hw-csky-", b_info->name, false);
+
+    for (i = 0; i < 10; i++) {
+        if (b_info->dev[i].name[0] != 0) {
+            module_load("", b_info->dev[i].filename, false);
+        }
+    }
+}
+
 void dynsoc_load_modules(int shmkey)
 {
     struct dynsoc_board_info *b_info;
-    int i;
 
     b_info = create_shm(shmkey);
-    dynsoc_b_info = b_info;
 
     if (b_info == (struct dynsoc_board_info *)-1) {
         error_report("create shm failed");
@@ -100,14 +112,38 @@ void dynsoc_load_modules(int shmkey)
         goto dynsoc_fail;
     }
 
-    module_load("hw-csky-", b_info->name, false);
+    dynsoc_load_board(b_info);
+    return;
+dynsoc_fail:
+    assert(0);
+}
 
-    for (i = 0; i < 10; i++) {
-        if (b_info->dev[i].name[0] != 0) {
-            module_load("", b_info->dev[i].filename, false);
-        }
+void dynsoc_load_file(const char *filename)
+{
+    g_autoptr(GError) err = NULL;
+    struct dynsoc_board_file *bf;
+    GMappedFile *file;
+
+    /* private and writable, the board outlives any change to the file */
+    file = g_mapped_file_new(filename, true, &err);
+    if (!file) {
+        error_report("%s", err->message);
+        goto dynsoc_fail;
+    }
+
+    bf = (struct dynsoc_board_file *)g_mapped_file_get_contents(file);
+    if (g_mapped_file_get_length(file) != sizeof(*bf) ||
+        memcmp(bf->magic, DYNSOC_BOARD_MAGIC, sizeof(bf->magic)) ||
+        bf->version != DYNSOC_BOARD_VERSION ||
+        bf->info_size != sizeof(bf->info) ||
+        bf->info_hash != dynsoc_hash(DYNSOC_HASH_INIT, &bf->info,
+                                     sizeof(bf->info))) {
+        error_report("%s is not a valid board description", filename);
+        goto dynsoc_fail;
     }
 
+    /* the mapping is kept for the lifetime of the board */
+    dynsoc_load_board(&bf->info);
     return;
 dynsoc_fail:
     assert(0);
@@ -25,6 +25,7 @@
 #include "target/csky/cpu.h"
 #include "hw/csky/csky_boot.h"
 #include "hw/sysbus.h"
+#include "hw/qdev-properties.h"
 #include "net/net.h"
 #include "sysemu/sysemu.h"
 #include "hw/boards.h"
@@ -124,10 +125,20 @@ static void yunvoice_v2_init(MachineState *machine)
         yunvoice_v2_memmap[YUNVOICE_V2_CORET].base, intc[CORET_IRQ_NUM]);
     csky_coret_set_freq(yunvoice_v2_binfo.freq);
 
-    sysbus_create_simple("csky_mca",
-        yunvoice_v2_memmap[YUNVOICE_V2_MCA].base, intc[MCA_IRQ_NUM]);
-    sysbus_create_simple("csky_fft",
-        yunvoice_v2_memmap[YUNVOICE_V2_FFT].base, intc[FFT_IRQ_NUM]);
+    /* the accelerators time their jobs in cpu cycles */
+    dev = qdev_new("csky_mca");
+    qdev_prop_set_uint32(dev, "clock-frequency", yunvoice_v2_binfo.freq);
+    sysbus_realize_and_unref(SYS_BUS_DEVICE(dev), &error_fatal);
+    sysbus_mmio_map(SYS_BUS_DEVICE(dev), 0,
+        yunvoice_v2_memmap[YUNVOICE_V2_MCA].base);
+    sysbus_connect_irq(SYS_BUS_DEVICE(dev), 0, intc[MCA_IRQ_NUM]);
+
+    dev = qdev_new("csky_fft");
+    qdev_prop_set_uint32(dev, "clock-frequency", yunvoice_v2_binfo.freq);
+    sysbus_realize_and_unref(SYS_BUS_DEVICE(dev), &error_fatal);
+    sysbus_mmio_map(SYS_BUS_DEVICE(dev), 0,
+        yunvoice_v2_memmap[YUNVOICE_V2_FFT].base);
+    sysbus_connect_irq(SYS_BUS_DEVICE(dev), 0, intc[FFT_IRQ_NUM]);
 
     csky_uart_create(yunvoice_v2_memmap[YUNVOICE_V2_UART3].base,
         intc[UART_IRQ_NUM], serial_hd(0));
@@ -18,17 +18,31 @@
  */
 
 #include "qemu/osdep.h"
+#include "qapi/error.h"
 #include "hw/sysbus.h"
 #include "sysemu/sysemu.h"
 #include "qemu/log.h"
+#include "qemu/host-utils.h"
 #include "exec/tracestub.h"
 #include "migration/vmstate.h"
 #include "exec/memory.h"
+#include "exec/address-spaces.h"
 #include "hw/irq.h"
+#include "hw/qdev-properties.h"
+#include "qemu/timer.h"
+#include "sysemu/runstate.h"
+#include "block/aio-wait.h"
+#include "block/thread-pool.h"
 
 #define TYPE_THEAD_FFT  "csky_fft"
 #define THEAD_FFT(obj)  OBJECT_CHECK(struct csky_fft_state, (obj), TYPE_THEAD_FFT)
 
+/* Complex number in format of 32-bit integer. */
+typedef struct {
+    int32_t re;
+    int32_t im;
+} ci32_t;
+
 struct csky_fft_state {
     SysBusDevice parent_obj;
     MemoryRegion iomem;
@@ -41,6 +55,25 @@ struct csky_fft_state {
     uint32_t in_num;             /* FFT input number register */
     uint32_t intr;               /* FFT interrupt & error flag register */
     uint32_t mask;               /* FFT interrupt & error mask register */
+
+    uint32_t freq;               /* clock the cycle tables are counted in */
+    QEMUTimer *done_timer;       /* fires when the job would have finished */
+
+    /* job latched by the start register, see csky_fft_start() */
+    bool job_running;            /* the thread pool owns the buffers */
+    bool job_pending;            /* result not yet written back */
+    int64_t job_deadline;
+    uint32_t job_func;
+    uint32_t job_order;
+    uint32_t job_in_num;
+    uint32_t job_out_addr;
+    uint32_t job_out_size;
+    hwaddr job_in_size;
+    int32_t *job_in;             /* mapped guest memory or in_buf */
+
+    int32_t in_buf[1024];
+    int32_t out_buf[1024];
+    ci32_t temp[512];
 };
 
 /* fft types */
@@ -213,14 +246,6 @@ static const uint32_t twiddle_coeff_512[] = {
 /* Number of butterfly stages of 512-point FFT. */
 static const uint32_t fft_order_512 = 9;
 
-/* Complex number in format of 32-bit integer. */
-typedef struct {
-    int32_t re;
-    int32_t im;
-} ci32_t;
-
-static ci32_t g_fft_temp_buffer[512];
-
 static int32_t i64_round_to_i32(int64_t x, uint8_t shift_bits) {
 #if ENABLE_ROUNDING
     bool is_neg = x < 0;
@@ -380,15 +405,13 @@ static void cfft(ci32_t *x, const uint32_t order, bool iflag)
     bit_reversal(x, fft_len);
 }
 
-static void csky_fft_real(const int32_t *in_addr, int32_t *out_addr,
-    uint32_t order, uint32_t in_num)
+static void csky_fft_real(ci32_t *temp, const int32_t *in_addr,
+    int32_t *out_addr, uint32_t order, uint32_t in_num)
 {
     uint32_t fft_len = (uint32_t)1 << order;
     assert(in_addr != NULL && out_addr != NULL);
     assert(in_num > 0 && in_num <= fft_len);
 
-    ci32_t *temp = g_fft_temp_buffer;
-
     for (uint32_t i = 0; i < in_num; ++i) {
         temp[i].re = in_addr[i];
         temp[i].im = 0;
@@ -431,14 +454,12 @@ static void csky_fft_complex(const int32_t *in_addr, int32_t *out_addr,
 
 }
 
-static void csky_ifft_real(const int32_t *in_addr, int32_t *out_addr,
-        uint32_t order)
+static void csky_ifft_real(ci32_t *temp, const int32_t *in_addr,
+        int32_t *out_addr, uint32_t order)
 {
     uint32_t fft_len = (uint32_t)1 << order;
     assert(in_addr != NULL && out_addr != NULL);
 
-    ci32_t *temp = g_fft_temp_buffer;
-
     temp[0].re = in_addr[0];
     temp[0].im = 0;
     temp[fft_len >> 1].re = in_addr[1];
@@ -463,14 +484,14 @@ static void csky_ifft_real(const int32_t *in_addr, int32_t *out_addr,
     }
 }
 
-static void csky_power_spectrums(const int32_t *in_addr, int64_t *out_addr,
-        uint32_t order, uint32_t in_num)
+static void csky_power_spectrums(ci32_t *temp, const int32_t *in_addr,
+        int64_t *out_addr, uint32_t order, uint32_t in_num)
 {
     uint32_t fft_len = (uint32_t)1 << order;
     uint32_t fft_len_half = fft_len >> 1;
 
 	int32_t *y = (int32_t *)out_addr;
-    csky_fft_real(in_addr, y, order, in_num);
+    csky_fft_real(temp, in_addr, y, order, in_num);
 
     out_addr[fft_len_half] = (int64_t)y[1] * y[1];
     out_addr[0] = (int64_t)y[0] * y[0];
@@ -551,13 +572,74 @@ static int csky_fft_get_region(uint32_t in_addr)
     return 1;
 }
 
-static void csky_fft_compute(struct csky_fft_state *s)
+/*
+ * A job is latched by csky_fft_start() on the vCPU thread, transformed by
+ * csky_fft_run() in the thread pool, and written back by csky_fft_done()
+ * once the cycles it takes on the hardware have passed on the virtual
+ * clock.  Only csky_fft_done() touches guest memory or the registers.
+ */
+static int csky_fft_run(void *opaque)
+{
+    struct csky_fft_state *s = opaque;
+    const int32_t *in = s->job_in;
+
+    switch (s->job_func) {
+    case RFFT:
+        csky_fft_real(s->temp, in, s->out_buf, s->job_order, s->job_in_num);
+        break;
+    case CFFT:
+        csky_fft_complex(in, s->out_buf, s->job_order, false);
+        break;
+    case IRFFT:
+        csky_ifft_real(s->temp, in, s->out_buf, s->job_order);
+        break;
+    case ICFFT:
+        csky_fft_complex(in, s->out_buf, s->job_order, true);
+        break;
+    case PSD:
+        csky_power_spectrums(s->temp, in, (int64_t *)s->out_buf,
+            s->job_order, s->job_in_num);
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+static void csky_fft_run_done(void *opaque, int ret)
+{
+    struct csky_fft_state *s = opaque;
+
+    s->job_running = false;
+    timer_mod(s->done_timer, s->job_deadline);
+}
+
+static void csky_fft_done(void *opaque)
+{
+    struct csky_fft_state *s = opaque;
+
+    if (s->job_in != s->in_buf) {
+        address_space_unmap(&address_space_memory, s->job_in, s->job_in_size,
+            false, 0);
+    }
+    s->job_in = NULL;
+
+    address_space_write(&address_space_memory, s->job_out_addr,
+        MEMTXATTRS_UNSPECIFIED, s->out_buf, s->job_out_size);
+    s->job_pending = false;
+
+    s->intr |= INTERRUPT_MASK << INTERRUPT_POS;
+    qemu_set_irq(s->irq, 1);
+    s->start &= (UINT32_MAX - 1);
+}
+
+static void csky_fft_start(struct csky_fft_state *s)
 {
     /* fixme: maybe different memory size for different fft mode */
-    int32_t *in_addr, *out_addr, region;
-    uint32_t func, order, in_num, output_size, input_size;
+    uint32_t func, order, output_size, region, cyc = 0;
+    hwaddr input_size, len;
+
     func     = s->mode & MODE_FUNC_SEL ;
-    in_num   = s->in_num;
 
     /* default input output size */
     input_size = DEFAULT_INPUT_NUM * 4;
@@ -576,45 +658,60 @@ static void csky_fft_compute(struct csky_fft_state *s)
         output_size *= 2;
     }
 
-    /* copy physical memory to a local buffer */
-    in_addr = g_malloc(input_size);
-    out_addr = g_malloc(output_size);
+    /* the function select is one-hot, in the row order of cycles[] */
     region = csky_fft_get_region(s->in_addr);
-    cpu_physical_memory_read (s->in_addr, in_addr, input_size);
+    if (is_power_of_2(func) && func <= PSD) {
+        cyc = cycles[ctz32(func)][region][order - 4];
+        write_trace_8_24(DEVICE_EVENT, 8, DEVICE_MCA | (MCA_RFFT << 8), cyc);
+    } else {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "csky_fft: function select error %x\n", func);
+        output_size = 0;
+    }
 
-    switch (func) {
-    case RFFT:
-        csky_fft_real(in_addr, out_addr, order, in_num);
-        write_trace_8_24(DEVICE_EVENT, 8, DEVICE_MCA | (MCA_RFFT << 8),
-            cycles[0][region][order - 4]);
-        break;
-    case CFFT:
-        csky_fft_complex(in_addr, out_addr, order, false);
-        write_trace_8_24(DEVICE_EVENT, 8, DEVICE_MCA | (MCA_RFFT << 8),
-            cycles[1][region][order - 4]);
-        break;
-    case IRFFT:
-        csky_ifft_real(in_addr, out_addr, order);
-        write_trace_8_24(DEVICE_EVENT, 8, DEVICE_MCA | (MCA_RFFT << 8),
-            cycles[2][region][order - 4]);
-        break;
-    case ICFFT:
-        csky_fft_complex(in_addr, out_addr, order, true);
-        write_trace_8_24(DEVICE_EVENT, 8, DEVICE_MCA | (MCA_RFFT << 8),
-            cycles[3][region][order - 4]);
-        break;
-    case PSD:
-        csky_power_spectrums(in_addr, (int64_t *)out_addr, order, in_num);
-        write_trace_8_24(DEVICE_EVENT, 8, DEVICE_MCA | (MCA_RFFT << 8),
-            cycles[4][region][order - 4]);
-        break;
-    default:
-        break;
+    s->job_func = func;
+    s->job_order = order;
+    s->job_in_num = s->in_num;
+    s->job_out_addr = s->out_addr;
+    s->job_out_size = output_size;
+
+    /* read the input in place when it is in RAM, else copy it */
+    len = input_size;
+    s->job_in = address_space_map(&address_space_memory, s->in_addr, &len,
+        false, MEMTXATTRS_UNSPECIFIED);
+    if (s->job_in && len < input_size) {
+        address_space_unmap(&address_space_memory, s->job_in, len, false, 0);
+        s->job_in = NULL;
+    }
+    if (!s->job_in) {
+        address_space_read(&address_space_memory, s->in_addr,
+            MEMTXATTRS_UNSPECIFIED, s->in_buf, input_size);
+        s->job_in = s->in_buf;
+    }
+    s->job_in_size = input_size;
+
+    s->job_deadline = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) +
+        muldiv64(cyc, NANOSECONDS_PER_SECOND, s->freq);
+    s->job_running = true;
+    s->job_pending = true;
+    thread_pool_submit_aio(csky_fft_run, s, csky_fft_run_done, s);
+}
+
+/*
+ * Finish an outstanding job before the VM stops, so that its result is in
+ * guest memory before RAM and device state are saved.
+ */
+static void csky_fft_vm_state_change(void *opaque, bool running,
+                                     RunState state)
+{
+    struct csky_fft_state *s = opaque;
+
+    if (running || !s->job_pending) {
+        return;
     }
-    /* write back local buffer to physical memory */
-    cpu_physical_memory_write (s->out_addr, out_addr, output_size);
-    g_free(in_addr);
-    g_free(out_addr);
+    AIO_WAIT_WHILE(NULL, s->job_running);
+    timer_del(s->done_timer);
+    csky_fft_done(s);
 }
 
 static uint64_t csky_fft_read(void *opaque, hwaddr offset, unsigned size)
@@ -672,10 +769,7 @@ static void csky_fft_write(void *opaque, hwaddr offset, uint64_t value,
     case 0x0: /* fft_start_reg */
         if ((s->start & 0x1) != 1) { /* not busy */
             s->start |= 0x1;
-            csky_fft_compute(s);
-            s->intr |= INTERRUPT_MASK << INTERRUPT_POS;
-            qemu_set_irq(s->irq, 1);
-            s->start &= (UINT32_MAX - 1);
+            csky_fft_start(s);
         } else { /* device is busy */
             qemu_log_mask(LOG_GUEST_ERROR,
                           "csky_fft_write: device is too busy\n");
@@ -781,8 +875,21 @@ static void csky_fft_realize(DeviceState *dev, Error **errp)
     s->in_num       = 0x00000200;
     s->intr   = 0x00000000;
     s->mask    = 0x00000001;
+
+    if (s->freq == 0) {
+        error_setg(errp, "csky_fft: clock-frequency must be non-zero");
+        return;
+    }
+    s->done_timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, csky_fft_done, s);
+    qemu_add_vm_change_state_handler(csky_fft_vm_state_change, s);
 }
 
+static Property csky_fft_properties[] = {
+    DEFINE_PROP_UINT32("clock-frequency", struct csky_fft_state, freq,
+                       1000000000),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
 static void csky_fft_class_init(ObjectClass *oc, void *data)
 {
     DeviceClass *dc = DEVICE_CLASS(oc);
@@ -790,6 +897,7 @@ static void csky_fft_class_init(ObjectClass *oc, void *data)
     set_bit(DEVICE_CATEGORY_CSKY, dc->categories);
     dc->realize = csky_fft_realize;
     dc->vmsd = &vmstate_csky_fft;
+    device_class_set_props(dc, csky_fft_properties);
     dc->desc = "cskysim type: FFT";
     dc->user_creatable = true;
 }
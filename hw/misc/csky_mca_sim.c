@@ -0,0 +1,1370 @@
+/*
+ * CSKY MCA fixed-point DSP kernels.
+ *
+ * Copyright (c) 2021 C-SKY Microsystems Co., Ltd. All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "host/cpuinfo.h"
+#include "hw/misc/csky_mca_sim.h"
+
+typedef int16_t fxp16_q15_t;
+typedef int32_t fxp32_q16_t;
+
+#define Q16 (16)
+
+typedef struct {
+    uint64_t lo;  // Low part
+    union {
+        uint64_t u; // High part as unsigned 64-bit int
+        int64_t s;  // High part as signed 64-bit int
+    } hi;         // High part
+} int128_t;
+
+typedef struct {
+    void *result;
+    uint32_t result_shift_bits;
+    drv_acc_shift_dir_t result_shift_dir;
+    drv_acc_data_bits_t result_bits;
+} output_handler_params_t;
+
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+// IIR order, i.e. history length of input
+#define DRV_IIR_ORDER 2
+
+// IIR history length of output
+#define DRV_IIR_OUTPUT_HISTORY_LENGTH 2
+
+static void int128_mac(int128_t *i128, int64_t a, int64_t b);
+static bool int128_is_negative(const int128_t *i128);
+static void int128_negate(int128_t *i128);
+static void int128_init(int128_t *i128);
+static void int128_add_mca(int128_t *i128, int64_t v);
+static void mul_64_64_keep_128(int64_t a, int64_t b, int128_t *product);
+static void int128_shift_left(int128_t *i128, unsigned int shift_bits);
+static void int128_shift_right(int128_t *i128, unsigned int shift_bits);
+static void int128_round(int128_t *i128, unsigned int frac_bits);
+static int64_t int128_sat_to_int64(const int128_t *i128);
+
+static inline int64_t csky_mca_sim_acc_read_data(
+    const void **addr, drv_acc_data_bits_t data_bits)
+{
+    int64_t value = 0;
+    switch (data_bits) {
+    case DRV_ACC_DATA_BITS_8:
+        value = *(const int8_t *)*addr;
+        *addr = (const char *)*addr + sizeof(int8_t);
+        break;
+    case DRV_ACC_DATA_BITS_16:
+        value = *(const int16_t *)*addr;
+        *addr = (const char *)*addr + sizeof(int16_t);
+        break;
+    case DRV_ACC_DATA_BITS_32:
+        value = *(const int32_t *)*addr;
+        *addr = (const char *)*addr + sizeof(int32_t);
+        break;
+    }
+    return value;
+}
+
+static inline
+uint32_t drv_asrc_size_of_data_mode(drv_asrc_data_mode_t data_mode) {
+    switch (data_mode) {
+        case DRV_ASRC_DATA_MODE_32_BITS:
+            return 4;
+        case DRV_ASRC_DATA_MODE_24_BITS:
+            return 4;
+        case DRV_ASRC_DATA_MODE_16_BITS_STORED_AS_32_BITS:
+            return 4;
+        case DRV_ASRC_DATA_MODE_16_BITS:
+            return 2;
+        default:
+            assert(0 && "Invalid data mode.");
+            return 0;
+    }
+}
+
+static uint32_t n_power_of_2(fxp32_q16_t value)
+{
+    uint32_t n = 0;
+
+    while (value >>= 1) {
+        n++;
+    }
+
+    return n;
+}
+
+// The input range should be [1, 1024].
+#define assert_input_range(input) \
+    assert((input) >= (1 << Q16) && (input) <= (1024 << Q16))
+
+static fxp32_q16_t round_shift64(int64_t in, uint32_t shift)
+{
+    in += 1 << (shift - 1);
+
+    return (fxp32_q16_t)(in >> shift);
+}
+
+#define INT128_BITS (CHAR_BIT * sizeof(int128_t))
+#define INT128_BITS_HALF (INT128_BITS >> 1)
+
+static void int128_init(int128_t *i128)
+{
+    i128->lo = 0;
+    i128->hi.u = 0;
+}
+
+static void int128_add_mca(int128_t *i128, int64_t v)
+{
+    uint64_t uv = v;
+    if ((i128->lo += uv) < uv) {
+        ++i128->hi.u;
+    }
+    if (v < 0) {
+        i128->hi.u += ~(uint64_t)0;
+    }
+}
+
+static void mul_64_64_keep_128(int64_t a, int64_t b, int128_t *product) {
+#ifdef CONFIG_INT128
+    __int128_t prod = (__int128_t)a * b;
+
+    product->lo = (uint64_t)prod;
+    product->hi.s = (int64_t)(prod >> 64);
+#else
+    int sign = (a < 0 ? 1 : 0) ^ (b < 0 ? 1 : 0);
+
+    uint64_t ua = a < 0 ? -a : a;
+    uint64_t ub = b < 0 ? -b : b;
+
+    // BIT: [0, 64)
+    uint64_t prod_0 = (ua & UINT32_MAX) * (ub & UINT32_MAX);
+    // BIT: [32, 96)
+    uint64_t prod_1 = (ua & UINT32_MAX) * (ub >> 32);
+    // BIT: [32, 96)
+    uint64_t prod_2 = (ua >> 32) * (ub & UINT32_MAX);
+    // BIT: [64, 128)
+    uint64_t prod_3 = (ua >> 32) * (ub >> 32);
+
+    uint64_t prod_00 = prod_0 >> 32;
+    if ((prod_1 += prod_00) < prod_00) {
+        prod_3 += (uint64_t)1 << 32;
+    }
+    if ((prod_1 += prod_2) < prod_2) {
+        prod_3 += (uint64_t)1 << 32;
+    }
+    prod_3 += (prod_1 >> 32);
+
+    product->lo = (prod_1 << 32) | (prod_0 & UINT32_MAX);
+    product->hi.u = prod_3;
+
+    if (sign) {
+        int128_negate(product);
+    }
+#endif
+}
+
+static void int128_mac(int128_t *i128, int64_t a, int64_t b) {
+    int128_t product;
+    mul_64_64_keep_128(a, b, &product);
+
+    if ((i128->lo += product.lo) < product.lo) {
+        ++i128->hi.u;
+    }
+    i128->hi.u += product.hi.u;
+}
+
+static bool int128_is_negative(const int128_t *i128) {
+    return i128->hi.s < 0;
+}
+
+static void int128_negate(int128_t *i128) {
+    i128->lo = ~i128->lo;
+    i128->hi.u = ~i128->hi.u;
+    int128_add_mca(i128, 1);
+}
+
+static void int128_shift_left(int128_t *i128, unsigned int shift_bits)
+{
+    if (shift_bits >= INT128_BITS) {
+        i128->lo = 0;
+        i128->hi.u = 0;
+    } else if (shift_bits >= INT128_BITS_HALF) {
+        i128->hi.u = i128->lo << (shift_bits - INT128_BITS_HALF);
+        i128->lo = 0;
+    } else if (shift_bits > 0) {
+        i128->hi.u <<= shift_bits;
+        i128->hi.u |= (i128->lo >> (INT128_BITS_HALF - shift_bits));
+        i128->lo <<= shift_bits;
+    }
+}
+
+static void int128_shift_right(int128_t *i128, unsigned int shift_bits) {
+    if (shift_bits >= INT128_BITS) {
+        i128->hi.s >>= shift_bits;
+        i128->lo = i128->hi.u;
+    } else if (shift_bits >= INT128_BITS_HALF) {
+        i128->lo = i128->hi.s >> (shift_bits - INT128_BITS_HALF);
+        i128->hi.s >>= shift_bits;
+    } else if (shift_bits > 0) {
+        i128->lo >>= shift_bits;
+        i128->lo |= (i128->hi.s << (INT128_BITS_HALF - shift_bits));
+        i128->hi.s >>= shift_bits;
+    }
+}
+
+static void int128_round(int128_t *i128, unsigned int frac_bits) {
+    assert(frac_bits < INT128_BITS);
+
+    if (frac_bits == 0) {
+        return;
+    }
+
+    bool is_negative = int128_is_negative(i128);
+    if (is_negative) {
+        int128_negate(i128);
+    }
+
+    if (frac_bits <= INT128_BITS_HALF) {
+        uint64_t mask = (uint64_t)1 << (frac_bits - 1);
+        if (i128->lo & mask) {
+            if ((i128->lo += mask) < mask) {
+                ++i128->hi.u;
+            }
+        }
+        i128->lo &= (~((mask << 1) - 1));
+    } else {
+        uint64_t mask = (uint64_t)1 << (frac_bits - 1 - INT128_BITS_HALF);
+        if (i128->hi.u & mask) {
+            i128->hi.u += mask;
+        }
+        i128->hi.u &= (~((mask << 1) - 1));
+        i128->lo = 0;
+    }
+
+    if (is_negative) {
+        int128_negate(i128);
+    }
+}
+
+static int64_t int128_sat_to_int64(const int128_t *i128) {
+    if (i128->hi.s > 0) {
+        return INT64_MAX;
+    }
+    if (i128->hi.s < -1) {
+        return INT64_MIN;
+    }
+    uint64_t mask = (uint64_t)1 << (INT128_BITS_HALF - 1);
+    if (i128->hi.s == 0) {
+        return (i128->lo & mask) ? INT64_MAX : i128->lo;
+    }
+    return (i128->lo & mask) ? i128->lo : INT64_MIN;
+}
+
+static inline int64_t csky_mca_sim_asrc_read_data(
+    const void **data, drv_asrc_data_mode_t data_mode) {
+    int64_t value = 0;
+    switch (data_mode) {
+    case DRV_ASRC_DATA_MODE_32_BITS:
+        value = *(const int32_t *)*data;
+        *data = (const char *)*data + sizeof(int32_t);
+        break;
+    case DRV_ASRC_DATA_MODE_24_BITS:
+        value = (*(const int32_t *)*data << 8) >> 8;
+        *data = (const char *)*data + sizeof(int32_t);
+        break;
+    case DRV_ASRC_DATA_MODE_16_BITS_STORED_AS_32_BITS:
+        value = (*(const int32_t *)*data << 16) >> 16;
+        *data = (const char *)*data + sizeof(int32_t);
+        break;
+    case DRV_ASRC_DATA_MODE_16_BITS:
+        value = *(const int16_t *)*data;
+        *data = (const char *)*data + sizeof(int16_t);
+        break;
+    }
+    return value;
+}
+
+static inline int64_t csky_mca_sim_asrc_read_filter_coeff(
+    const void **coeff, drv_fir_iir_coeff_sel_t coeff_sel) {
+    int64_t value = 0;
+    switch (coeff_sel) {
+    case DRV_FIR_IIR_COEFF_SEL_32_BITS:
+        value = *(const int32_t *)*coeff;
+        *coeff = (const char *)*coeff + sizeof(int32_t);
+        break;
+    case DRV_FIR_IIR_COEFF_SEL_64_BITS:
+        value = *(const int64_t *)*coeff;
+        *coeff = (const char *)*coeff + sizeof(int64_t);
+        break;
+    }
+    return value;
+}
+
+static inline uint32_t csky_mca_sim_asrc_write_data(
+    void **addr, const int128_t *value, drv_asrc_data_mode_t data_mode) {
+    int32_t value_i32 = 0;
+    int64_t value_i64 = int128_sat_to_int64(value);
+    switch (data_mode) {
+    case DRV_ASRC_DATA_MODE_32_BITS:
+        value_i32 = *(int32_t *)*addr =
+            (int32_t)min((int64_t)INT32_MAX, max((int64_t)INT32_MIN, value_i64));
+        *addr = (char *)*addr + sizeof(int32_t);
+        break;
+    case DRV_ASRC_DATA_MODE_24_BITS:
+        value_i32 = *(int32_t *)*addr =
+            0x00FFFFFF & (int32_t)min((int64_t)(INT32_MAX >> 8),
+                                      max((int64_t)(INT32_MIN >> 8), value_i64));
+        *addr = (char *)*addr + sizeof(int32_t);
+        break;
+    case DRV_ASRC_DATA_MODE_16_BITS_STORED_AS_32_BITS:
+        value_i32 = *(int32_t *)*addr =
+            0x0000FFFF &
+            (int32_t)min((int64_t)INT16_MAX, max((int64_t)INT16_MIN, value_i64));
+        *addr = (char *)*addr + sizeof(int32_t);
+        break;
+    case DRV_ASRC_DATA_MODE_16_BITS:
+        value_i32 = *(int16_t *)*addr =
+            (int16_t)min((int64_t)INT16_MAX, max((int64_t)INT16_MIN, value_i64));
+        *addr = (char *)*addr + sizeof(int16_t);
+        break;
+    }
+    return value_i32;
+}
+
+/*
+ * Advance to the next ASRC output: the word after the order + 1 taps of
+ * the current list entry is the number of input samples to move by.
+ */
+static inline uint32_t csky_mca_sim_asrc_step(const int32_t *coeff,
+                                              uint32_t order,
+                                              uint32_t list_size,
+                                              uint32_t *asrc_pointer) {
+    uint32_t step = (uint32_t)coeff[*asrc_pointer * (order + 2) + order + 1];
+
+    *asrc_pointer += 1;
+    if (*asrc_pointer == list_size) {
+        *asrc_pointer = 0;
+    }
+    return step;
+}
+
+uint32_t csky_mca_sim_asrc_outputs(uint32_t order, uint32_t list_size,
+                                   uint32_t num, const int32_t *coeff,
+                                   uint32_t asrc_pointer) {
+    uint32_t outputs = 0;
+    uint64_t pos;
+
+    assert(asrc_pointer < list_size);
+    for (pos = order; pos < num;
+         pos += csky_mca_sim_asrc_step(coeff, order, list_size,
+                                       &asrc_pointer)) {
+        outputs++;
+    }
+    return outputs;
+}
+
+uint32_t csky_mca_sim_asrc(drv_asrc_data_mode_t data_mode,
+                           drv_asrc_ch_num_sel_t ch_num_sel, uint32_t order,
+                           uint32_t list_size, const void *ch1_data_start,
+                           const void *ch1_data_end, const void *ch2_data_start,
+                           const void *ch2_data_end, const int32_t *coeff,
+                           void *result, uint32_t *asrc_pointer) {
+    uint32_t result_size = 0;
+
+    uint32_t data_elem_size = drv_asrc_size_of_data_mode(data_mode);
+    const char *ch1_data_start_iter = (const char *)ch1_data_start;
+    const char *ch1_data_asrc_iter = ch1_data_start_iter + data_elem_size * order;
+    const char *ch2_data_start_iter = (const char *)ch2_data_start;
+    while (ch1_data_asrc_iter <= (const char *)ch1_data_end) {
+        int128_t sum1, sum2;
+        int128_init(&sum1);
+
+        if (ch_num_sel == DRV_ASRC_CH_NUM_SEL_STEREO) {
+            int128_init(&sum2);
+        }
+
+        assert(*asrc_pointer < list_size);
+        const int32_t *coeff_iter = coeff + *asrc_pointer * (order + 2);
+        const void *ch1_data_iter = ch1_data_start_iter;
+        const void *ch2_data_iter = ch2_data_start_iter;
+
+        for (uint32_t i = 0; i <= order; ++i) {
+            int32_t coeff_value = *coeff_iter++;
+            int64_t data_value;
+            data_value = csky_mca_sim_asrc_read_data(&ch1_data_iter, data_mode);
+            int128_add_mca(&sum1, coeff_value * data_value);
+
+            if (ch_num_sel == DRV_ASRC_CH_NUM_SEL_STEREO) {
+                data_value = csky_mca_sim_asrc_read_data(&ch2_data_iter, data_mode);
+                int128_add_mca(&sum2, coeff_value * data_value);
+            }
+      }
+
+        const uint32_t q_output = 31;  // Coeff is Q1.0.31
+        int128_round(&sum1, q_output);
+        int128_shift_right(&sum1, q_output);
+        csky_mca_sim_asrc_write_data(&result, &sum1, data_mode);
+        result_size += data_elem_size;
+
+        if (ch_num_sel == DRV_ASRC_CH_NUM_SEL_STEREO) {
+            int128_round(&sum2, q_output);
+            int128_shift_right(&sum2, q_output);
+            csky_mca_sim_asrc_write_data(&result, &sum2, data_mode);
+            result_size += data_elem_size;
+        }
+
+        uint32_t step = csky_mca_sim_asrc_step(coeff, order, list_size,
+                                               asrc_pointer);
+        ch1_data_start_iter += data_elem_size * step;
+        ch1_data_asrc_iter += data_elem_size * step;
+        ch2_data_start_iter += data_elem_size * step;
+    }
+
+    return result_size;
+}
+
+uint32_t csky_mca_sim_fir_ref(drv_asrc_data_mode_t data_mode,
+                              drv_fir_iir_coeff_sel_t coeff_sel, uint32_t order,
+                              uint32_t out_loc_sel, const void *data_start,
+                              const void *data_end, const void *coeff,
+                              void *result) {
+    uint32_t result_size = 0;
+
+    uint32_t data_elem_size = drv_asrc_size_of_data_mode(data_mode);
+    const char *data_start_iter = (const char *)data_start;
+    const char *data_filter_iter = data_start_iter + data_elem_size * order;
+
+    while (data_filter_iter <= (const char *)data_end) {
+        int128_t sum;
+        int128_init(&sum);
+
+        const void *coeff_iter = coeff;
+        const void *data_iter = data_start_iter;
+        for (uint32_t i = 0; i <= order; ++i) {
+            int64_t coeff_value =
+                csky_mca_sim_asrc_read_filter_coeff(&coeff_iter, coeff_sel);
+            int64_t data_value = csky_mca_sim_asrc_read_data(&data_iter, data_mode);
+            if (coeff_sel == DRV_FIR_IIR_COEFF_SEL_32_BITS) {
+                int128_add_mca(&sum, coeff_value * data_value);
+            } else {
+                int128_mac(&sum, coeff_value, data_value);
+            }
+        }
+
+        uint32_t q_output =
+          coeff_sel == DRV_FIR_IIR_COEFF_SEL_32_BITS ? 24 : (out_loc_sel * 4);
+        int128_round(&sum, q_output);
+        int128_shift_right(&sum, q_output);
+        csky_mca_sim_asrc_write_data(&result, &sum, data_mode);
+        result_size += data_elem_size;
+
+        data_start_iter += data_elem_size;
+        data_filter_iter += data_elem_size;
+    }
+
+    return result_size;
+}
+
+uint32_t csky_mca_sim_iir(drv_asrc_data_mode_t data_mode,
+                          drv_fir_iir_coeff_sel_t coeff_sel,
+                          uint32_t out_loc_sel, const void *data_start,
+                          const void *data_end, const void *coeff, uint32_t yn1,
+                          uint32_t yn2, void *result) {
+    uint32_t result_size = 0;
+
+    uint32_t data_elem_size = drv_asrc_size_of_data_mode(data_mode);
+    const char *data_start_iter = (const char *)data_start;
+    const char *data_filter_iter =
+        data_start_iter + data_elem_size * DRV_IIR_ORDER;
+    while (data_filter_iter <= (const char *)data_end) {
+        int128_t sum;
+        int128_init(&sum);
+
+        const void *coeff_iter = coeff;
+        const void *data_iter = data_start_iter;
+        for (uint32_t i = 0; i <= (DRV_IIR_ORDER + DRV_IIR_OUTPUT_HISTORY_LENGTH);
+             ++i) {
+            int64_t coeff_value =
+                csky_mca_sim_asrc_read_filter_coeff(&coeff_iter, coeff_sel);
+            int64_t data_value;
+            if (i <= DRV_IIR_ORDER) {
+                data_value = csky_mca_sim_asrc_read_data(&data_iter, data_mode);
+            } else {
+                const void *temp = (i == DRV_IIR_ORDER + 1) ? &yn1 : &yn2;
+                data_value = csky_mca_sim_asrc_read_data(&temp, data_mode);
+            }
+            if (coeff_sel == DRV_FIR_IIR_COEFF_SEL_32_BITS) {
+                int128_add_mca(&sum, coeff_value * data_value);
+            } else {
+                int128_mac(&sum, coeff_value, data_value);
+            }
+        }
+
+        uint32_t q_output =
+            coeff_sel == DRV_FIR_IIR_COEFF_SEL_32_BITS ? 24 : (out_loc_sel * 4);
+        int128_round(&sum, q_output);
+        int128_shift_right(&sum, q_output);
+        yn2 = yn1;
+        yn1 = csky_mca_sim_asrc_write_data(&result, &sum, data_mode);
+        result_size += data_elem_size;
+
+        data_start_iter += data_elem_size;
+        data_filter_iter += data_elem_size;
+    }
+
+    return result_size;
+}
+
+static inline void csky_mca_sim_acc_write_data_from_i128(
+    void **addr, int128_t *value, uint32_t shift_bits,
+    drv_acc_shift_dir_t shift_dir, drv_acc_data_bits_t data_bits)
+{
+    switch (shift_dir) {
+    case DRV_ACC_SHIFT_LEFT:
+        int128_shift_left(value, shift_bits);
+        break;
+    case DRV_ACC_SHIFT_RIGHT:
+        int128_shift_right(value, shift_bits);
+        break;
+    }
+
+    int64_t value_i64 = int128_sat_to_int64(value);
+
+    switch (data_bits) {
+    case DRV_ACC_DATA_BITS_8:
+        *(int8_t *)*addr =
+            (int8_t)min((int64_t)INT8_MAX, max((int64_t)INT8_MIN, value_i64));
+        *addr = (char *)*addr + sizeof(int8_t);
+        break;
+    case DRV_ACC_DATA_BITS_16:
+        *(int16_t *)*addr =
+            (int16_t)min((int64_t)INT16_MAX, max((int64_t)INT16_MIN, value_i64));
+        *addr = (char *)*addr + sizeof(int16_t);
+        break;
+    case DRV_ACC_DATA_BITS_32:
+        *(int32_t *)*addr =
+            (int32_t)min((int64_t)INT32_MAX, max((int64_t)INT32_MIN, value_i64));
+        *addr = (char *)*addr + sizeof(int32_t);
+        break;
+    }
+}
+
+void csky_mca_sim_mac_ref(
+    const void *data_a, const void *data_b, const void *init_data, void *result,
+    uint32_t data_depth, uint32_t data_way, drv_acc_data_bits_t input_data_bits,
+    bool enable_init_data, bool enable_active, bool enable_data_b_loop,
+    bool enable_data_a_loop, uint32_t init_data_shift_bits,
+    drv_acc_shift_dir_t init_data_shift_dir, drv_acc_data_bits_t init_data_bits,
+    uint32_t result_shift_bits, drv_acc_shift_dir_t result_shift_dir,
+    drv_acc_data_bits_t result_bits, uint32_t step)
+{
+    for (uint32_t i_depth = 0; i_depth < data_depth; ++i_depth) {
+        int128_t sum;
+        int128_init(&sum);
+
+        // Adds with initial data.
+        if (enable_init_data) {
+            int64_t init_data_value =
+              csky_mca_sim_acc_read_data(&init_data, init_data_bits);
+            switch (init_data_shift_dir) {
+            case DRV_ACC_SHIFT_LEFT:
+                init_data_value <<= init_data_shift_bits;
+                break;
+            case DRV_ACC_SHIFT_RIGHT:
+                init_data_value >>= init_data_shift_bits;
+                break;
+            }
+            int128_add_mca(&sum, init_data_value);
+        }
+
+        const void *data_a_iter = data_a;
+        const void *data_b_iter = data_b;
+
+        // Multiplication & accumulation.
+        for (uint32_t i_way = 0; i_way < data_way; ++i_way) {
+            int64_t a = csky_mca_sim_acc_read_data(&data_a_iter, input_data_bits);
+            int64_t b = csky_mca_sim_acc_read_data(&data_b_iter, input_data_bits);
+            int128_add_mca(&sum, a * b);
+        }
+
+        // Performs activation function (ReLU is the only one).
+        if (enable_active) {
+            if (int128_is_negative(&sum)) {
+                int128_init(&sum);
+            }
+        }
+
+        // Shifts, saturates, and writes to the output.
+        csky_mca_sim_acc_write_data_from_i128(&result, &sum, result_shift_bits,
+                                              result_shift_dir, result_bits);
+
+        // Updates input iterators.
+        if (!enable_data_a_loop) {
+            data_a = data_a_iter + step;
+        }
+        if (!enable_data_b_loop) {
+            data_b = data_b_iter + step;
+        }
+    }
+}
+
+// -----------------------------------------------------------------
+// HOW IT WORKS?
+// Calculating "1/a" is same with solving y(x) = 0, where y(x) is:
+// y(x) = 1/x - a......(1)
+// And according to Newtown-Raphson method, we need to iteratively
+// calculating the following function until converging:
+// x(n+1) = x(n) * (2 - a * x[n])........(2);
+// In case we get lost, remember that the goal is calculating "1/a",
+// which is the same with the root of (1). And to solve (1), we need
+// to iteratively calculating (2). Finally, if x converging to some
+// value, we will have a approximated "1/a".
+// BUT...here is the difficult part:
+// 1. how to make sure that x can converge?
+// 2. how to pick the initial value of x (x0)?
+// The answer of the first question is that the converging range of
+// x is (0, 2/a). And for the second question, the x0 must be very
+// close to "1/a" to get faster convergence.
+// It's really hard to pick x0, but we can use some trick to do that.
+// Suppose we can limit the range of x to [0.5, 1], in which case the
+// range of a will be [1, 2], we can pick 0.75 as the initial value
+// and get a good convergence. So all we need to do is putting a into
+// [1, 2], which can be done by dividing a with 2^n (n is the nearest
+// n power of two that smaller than a).
+// -----------------------------------------------------------------
+// Here is the fake code of the entire solution:
+//     let n = floor(log2(a));
+//     a = a * 2^-n;
+//     x = 0.75;
+//     loop 5 times:
+//         x = x * (2 - a * x);
+//     loop end;
+//     x = x * 2^-n;
+//     return x;
+// -----------------------------------------------------------------
+// References:
+// 1. How it works: https://www.dsprelated.com/showcode/201.php;
+// 2. Newton-Raphson: https://en.wikipedia.org/wiki/Newton%27s_method;
+// 3. Pick initial value: https://hal.inria.fr/inria-00071899/document;
+static fxp32_q16_t reciprocal_q16(fxp32_q16_t input)
+{
+    // By now, it's only for softmax, which means the input
+    // is in range [1, 1024].
+    assert_input_range(input);
+
+    // Get the nearest n power of 2 that is smaller than
+    // the integer part of the input.
+    uint32_t n = n_power_of_2(input >> Q16);
+
+    // Move input to [1, 2], so the 1/input will be within
+    // [0.5, 1], which is easy for determining the initial
+    // value.
+    input >>= n;
+
+    // See reference 3, section 2.2.1 for picking initial value.
+    // Since we moved input into [1, 2], we can further divide it
+    // into two sections [1, 1.33333) and [1.33333, 2] for faster
+    // convergence.
+    fxp32_q16_t iterator =
+        (input - 87381) < 0  // 1.3 q16.
+            ? 56246          // 0.858245067268760, beta 4 of [0, 1.33333)
+            : 39421;         // 0.601524275335661, beta 4 of [1.33333, 2]
+
+    const fxp32_q16_t two = 2 << Q16;
+
+    int64_t temp_64;
+    int32_t temp_32;
+
+    // Why 3 iterations?
+    // Under following conditions:
+    //     1. input in range [1, 1024];
+    //     2. output has at least q15 precision;
+    // iterates 3 rounds can have expected convergence.
+    for (size_t i = 0; i < 3; i++) {
+        temp_64 = (int64_t)iterator * (int64_t)input;  // q32
+
+        // Round shift.
+        temp_32 = round_shift64(temp_64, Q16);
+
+        temp_32 = two - temp_32;
+
+        temp_64 = (int64_t)temp_32 * (int64_t)iterator;
+
+        iterator = round_shift64(temp_64, Q16);
+    }
+
+    iterator = iterator >> n;
+
+    return iterator;
+}
+
+static inline fxp32_q16_t round_shift(fxp32_q16_t in, uint8_t shift)
+{
+    in += 1 << (shift - 1);
+    return in >> shift;
+}
+
+// The basic idea and code is from:
+// https://www.quinapalus.com/efunc.html
+// Another reference and to solve the negative part:
+// https://github.com/Rockbox/rockbox/blob/master/lib/fixedpoint/fixedpoint.c
+static fxp32_q16_t exp_q16(fxp32_q16_t x) {
+    // Make sure the input is non-positive.
+    assert(x <= 0);
+
+    const fxp32_q16_t one_q16 = 0x00010000;
+
+    // If x == 0x0, just return 1.0f;
+    if (x == 0x0) {
+        return one_q16;
+    }
+
+    // Try move x to the positive side.
+    x = x + 0xb1721;  // log(65536) in q16.
+
+    // If x is still negative, we can directly return
+    // 0x0 since the output will be too small for q16.
+    if (x < 0) {
+        return 0x0;
+    }
+
+    fxp32_q16_t temp;
+
+    // Start from exp(-log(65536)) in q16.
+    fxp32_q16_t out = 0x1;
+
+    temp = x - 0x58b91;  // log(256) in q16.
+    if (temp >= 0) {
+        x = temp;
+        out <<= 8;
+    }
+
+    temp = x - 0x2c5c8;  // log(16) in q16.
+    if (temp >= 0) {
+        x = temp;
+        out <<= 4;
+    };
+
+    temp = x - 0x162e4;  // log(4) in q16.
+    if (temp >= 0) {
+        x = temp;
+        out <<= 2;
+    }
+
+    temp = x - 0x0b172;  // log(2) in q16.
+    if (temp >= 0) {
+        x = temp;
+        out <<= 1;
+    }
+
+    temp = x - 0x067cd;  // log(3/2) in q16.
+    if (temp >= 0) {
+        x = temp;
+        out += round_shift(out, 1);
+    }
+
+    temp = x - 0x03920;  // log(5/4) in q16.
+    if (temp >= 0) {
+        x = temp;
+        out += round_shift(out, 2);
+    }
+
+    temp = x - 0x01e27;  // log(9/8) in q16.
+    if (temp >= 0) {
+        x = temp;
+        out += round_shift(out, 3);
+    }
+
+    temp = x - 0x00f85;  // log(17/16) in q16.
+    if (temp >= 0) {
+        x = temp;
+        out += round_shift(out, 4);
+    }
+
+    temp = x - 0x007e1;  // log(33/32) in q16.
+    if (temp >= 0) {
+        x = temp;
+        out += round_shift(out, 5);
+    }
+
+    temp = x - 0x003f8;  // log(65/64) in q16.
+    if (temp >= 0) {
+        x = temp;
+        out += round_shift(out, 6);
+    }
+
+    temp = x - 0x001fe;  // log(129/128) in q16.
+    if (temp >= 0) {
+        x = temp;
+        out += round_shift(out, 7);
+    }
+
+    // The following lines handles the residual error. From
+    // my understanding, the logic is similar with:
+    //     out = out * (1 + x); // floating point.
+    // which is for reducing the error at near zero, only
+    // this solution can approach bit by bit.
+    if (x & 0x100) {
+        out += round_shift(out, 8);
+    }
+    if (x & 0x080) {
+        out += round_shift(out, 9);
+    }
+    if (x & 0x040) {
+        out += round_shift(out, 10);
+    }
+    if (x & 0x020) {
+        out += round_shift(out, 11);
+    }
+    if (x & 0x010) {
+        out += round_shift(out, 12);
+    }
+    if (x & 0x008) {
+        out += round_shift(out, 13);
+    }
+    if (x & 0x004) {
+        out += round_shift(out, 14);
+    }
+    if (x & 0x002) {
+        out += round_shift(out, 15);
+    }
+    if (x & 0x001) {
+        out += round_shift(out, 16);
+    }
+
+    return out;
+}
+
+static fxp32_q16_t get_max(const fxp32_q16_t *input, size_t size)
+{
+    fxp32_q16_t max = input[0];
+
+    for (size_t i = 1; i < size; i++) {
+        fxp32_q16_t value = input[i];
+
+        int64_t temp = (int64_t)value - (int64_t)max;
+
+        // sign bit is 0.
+        if (temp >= 0) {
+            max = value;
+        }
+    }
+
+    return max;
+}
+
+static fxp16_q15_t round_saturate_shift(int64_t in, uint32_t shift)
+{
+     // Round.
+     in += (1 << (shift - 1));
+
+     // Shift and take the low 32 bit.
+     // Since this method is only for softmax, so 32 bit
+     // would be enough.
+     int32_t temp = (int32_t)(in >> shift);
+
+     // Saturate.
+     // Since this method is only for softmax, so the
+     // input must be positive and only deal with the
+     // positive part would be enough.
+     if (temp > INT16_MAX) temp = INT16_MAX;
+
+     return (fxp16_q15_t)temp;
+}
+
+typedef void (*output_handler_t)(fxp16_q15_t output, size_t index,
+                                 void *params);
+
+// For the math explain, check this wiki page:
+// https://zh.wikipedia.org/wiki/Softmax%E5%87%BD%E6%95%B0
+static void softmax_q16_in_q15_out(const fxp32_q16_t *input, fxp32_q16_t *temp,
+                                   size_t size, output_handler_t output_handler,
+                                   void *params)
+{
+    assert(size <= 1024);
+
+    // WHY?
+    // Making sure every element in the input array to be
+    // non-positive can prevent overflow in exp.
+    fxp32_q16_t max = get_max(input, size);
+
+    // The worest case would be 1024 * 2^16, which is
+    // 0x4000000, and takes less than 32 bits.
+    fxp32_q16_t sum_exp = 0;  // q16;
+
+    for (size_t i = 0; i < size; i++) {
+       // Expands to prevent overflow.
+       int64_t diff = (int64_t)input[i] - (int64_t)max;
+
+       fxp32_q16_t exp_out = 0x0;
+
+       // Exp will return zero if its input is less than
+       // -0xb1721.
+       if (diff > -0xb1721) {
+           fxp32_q16_t low_half = (fxp32_q16_t)diff;
+
+           exp_out = exp_q16(low_half);  // q16.
+       }
+
+       temp[i] = exp_out;  // q16.
+
+       sum_exp += exp_out;
+    }
+
+    // 1 / sum, q16.
+    fxp32_q16_t inv_sum = reciprocal_q16(sum_exp);
+
+    for (size_t i = 0; i < size; i++) {
+        int64_t raw = (int64_t)temp[i] * (int64_t)inv_sum;  // q32.
+
+        fxp16_q15_t out = round_saturate_shift(raw, Q16 + 1);  // q15.
+
+        output_handler(out, i, params);  // q15.
+    }
+}
+
+
+static void output_handler(fxp16_q15_t output, size_t index, void *params)
+{
+    output_handler_params_t *tp = (output_handler_params_t *)params;
+    int64_t value = output;
+    switch (tp->result_shift_dir) {
+    case DRV_ACC_SHIFT_LEFT:
+        value <<= tp->result_shift_bits;
+        break;
+    case DRV_ACC_SHIFT_RIGHT:
+        value >>= tp->result_shift_bits;
+        break;
+    }
+    switch (tp->result_bits) {
+    case DRV_ACC_DATA_BITS_8:
+        break;
+    case DRV_ACC_DATA_BITS_16:
+        *(int16_t *)tp->result =
+            (int16_t)min((int64_t)INT16_MAX, max((int64_t)INT16_MIN, value));
+        tp->result = (char *)tp->result + sizeof(int16_t);
+        break;
+    case DRV_ACC_DATA_BITS_32:
+        *(int32_t *)tp->result =
+            (int32_t)min((int64_t)INT32_MAX, max((int64_t)INT32_MIN, value));
+        tp->result = (char *)tp->result + sizeof(int32_t);
+        break;
+    }
+}
+
+void csky_mca_sim_softmax(const void *data_a, void *data_b, void *result,
+                          uint32_t data_depth, uint32_t result_shift_bits,
+                          drv_acc_shift_dir_t result_shift_dir,
+                          drv_acc_data_bits_t result_bits)
+{
+    output_handler_params_t params = {
+        .result = result,
+        .result_shift_bits = result_shift_bits,
+        .result_shift_dir = result_shift_dir,
+        .result_bits = result_bits,
+    };
+
+    softmax_q16_in_q15_out(data_a, data_b, data_depth, output_handler, &params);
+}
+
+static inline void csky_mca_sim_acc_write_data_from_i64(
+    void **addr, int64_t value, uint32_t shift_bits,
+    drv_acc_shift_dir_t shift_dir, drv_acc_data_bits_t data_bits)
+{
+    switch (shift_dir) {
+    case DRV_ACC_SHIFT_LEFT:
+        value <<= shift_bits;
+        break;
+    case DRV_ACC_SHIFT_RIGHT:
+        value >>= shift_bits;
+        break;
+    }
+    switch (data_bits) {
+    case DRV_ACC_DATA_BITS_8:
+        *(int8_t *)*addr =
+            (int8_t)min((int64_t)INT8_MAX, max((int64_t)INT8_MIN, value));
+        *addr = (char *)*addr + sizeof(int8_t);
+        break;
+    case DRV_ACC_DATA_BITS_16:
+        *(int16_t *)*addr =
+            (int16_t)min((int64_t)INT16_MAX, max((int64_t)INT16_MIN, value));
+        *addr = (char *)*addr + sizeof(int16_t);
+        break;
+    case DRV_ACC_DATA_BITS_32:
+        *(int32_t *)*addr =
+            (int32_t)min((int64_t)INT32_MAX, max((int64_t)INT32_MIN, value));
+        *addr = (char *)*addr + sizeof(int32_t);
+        break;
+    }
+}
+
+void csky_mca_sim_vec_ref(csky_mca_sim_vec_op_t vec_op, const void *data_a,
+                          const void *data_b, void *result, uint32_t data_depth,
+                          drv_acc_data_bits_t input_data_bits,
+                          bool enable_vec_scalar, uint32_t result_shift_bits,
+                          drv_acc_shift_dir_t result_shift_dir,
+                          drv_acc_data_bits_t result_bits, uint32_t scalar)
+{
+    int64_t a, b, c = 0;
+
+    for (uint32_t i_depth = 0; i_depth < data_depth; ++i_depth) {
+        a = csky_mca_sim_acc_read_data(&data_a, input_data_bits);
+        if (enable_vec_scalar) {
+            b = (int32_t)scalar;
+        } else {
+            b = csky_mca_sim_acc_read_data(&data_b, input_data_bits);
+        }
+        switch (vec_op) {
+        case THEAD_MCA_SIM_VEC_OP_MUL:
+            c = a * b;
+            break;
+        case THEAD_MCA_SIM_VEC_OP_ADD:
+            c = a + b;
+            break;
+        }
+        csky_mca_sim_acc_write_data_from_i64(&result, c, result_shift_bits,
+                                         result_shift_dir, result_bits);
+    }
+}
+
+/*
+ * Fast paths
+ *
+ * The reference kernels above read one sample at a time and add every
+ * product into a software 128-bit integer.  The ones below unpack the
+ * operands to int32 arrays first and sum the products with dot_s32(),
+ * which keeps exact 64-bit partial sums and widens to 128 bits once per
+ * output.  The integer result is the same, so rounding and saturation see
+ * the same value and the output is bit-exact.
+ */
+
+/*
+ * dot_s32() sums a[i] * b[i] as *hi * 2^16 + *lo, b split into its signed
+ * top and unsigned bottom 16 bits.  The partial products fit in 48 bits,
+ * so neither sum can overflow for up to DOT_MAX_TERMS terms.
+ */
+#define DOT_MAX_TERMS   (1u << 15)
+
+typedef void dot_fn(int64_t *hi, int64_t *lo, const int32_t *a,
+                    const int32_t *b, uint32_t n);
+
+static void dot_s32_int(int64_t *hi, int64_t *lo, const int32_t *a,
+                        const int32_t *b, uint32_t n)
+{
+    int64_t h = 0, l = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        h += (int64_t)a[i] * (b[i] >> 16);
+        l += (int64_t)a[i] * (b[i] & 0xffff);
+    }
+    *hi = h;
+    *lo = l;
+}
+
+#ifdef CONFIG_AVX2_OPT
+#include <immintrin.h>
+
+static void __attribute__((target("avx2")))
+dot_s32_avx2(int64_t *hi, int64_t *lo, const int32_t *a, const int32_t *b,
+             uint32_t n)
+{
+    const __m128i mask = _mm_set1_epi32(0xffff);
+    __m256i h = _mm256_setzero_si256();
+    __m256i l = _mm256_setzero_si256();
+    int64_t hv[4], lv[4];
+    uint32_t i;
+
+    /* _mm256_mul_epi32 multiplies the sign-extended low halves of each lane */
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        __m256i wa = _mm256_cvtepi32_epi64(va);
+        __m256i bh = _mm256_cvtepi32_epi64(_mm_srai_epi32(vb, 16));
+        __m256i bl = _mm256_cvtepi32_epi64(_mm_and_si128(vb, mask));
+
+        h = _mm256_add_epi64(h, _mm256_mul_epi32(wa, bh));
+        l = _mm256_add_epi64(l, _mm256_mul_epi32(wa, bl));
+    }
+    _mm256_storeu_si256((__m256i *)hv, h);
+    _mm256_storeu_si256((__m256i *)lv, l);
+
+    dot_s32_int(hi, lo, a + i, b + i, n - i);
+    *hi += hv[0] + hv[1] + hv[2] + hv[3];
+    *lo += lv[0] + lv[1] + lv[2] + lv[3];
+}
+#endif /* CONFIG_AVX2_OPT */
+
+static dot_fn *dot_s32 = dot_s32_int;
+
+#ifdef CONFIG_AVX2_OPT
+static void __attribute__((constructor)) init_dot_s32(void)
+{
+    if (cpuinfo_init() & CPUINFO_AVX2) {
+        dot_s32 = dot_s32_avx2;
+    }
+}
+#endif
+
+/* Adds the exact sum of a[i] * b[i], i < n, to sum. */
+static void csky_mca_dot(int128_t *sum, const int32_t *a, const int32_t *b,
+                         uint32_t n)
+{
+    while (n) {
+        uint32_t k = MIN(n, DOT_MAX_TERMS);
+        int64_t hi, lo;
+        int128_t part;
+
+        dot_s32(&hi, &lo, a, b, k);
+        part.lo = hi;
+        part.hi.s = hi < 0 ? -1 : 0;
+        int128_shift_left(&part, 16);
+        int128_add_mca(&part, lo);
+
+        if ((sum->lo += part.lo) < part.lo) {
+            ++sum->hi.u;
+        }
+        sum->hi.u += part.hi.u;
+
+        a += k;
+        b += k;
+        n -= k;
+    }
+}
+
+/* Sign-extends n samples, as csky_mca_sim_asrc_read_data() would. */
+static void unpack_asrc_data(int32_t *dst, const void *src, uint32_t n,
+                             drv_asrc_data_mode_t data_mode)
+{
+    const int32_t *s32 = src;
+    const int16_t *s16 = src;
+
+    switch (data_mode) {
+    case DRV_ASRC_DATA_MODE_32_BITS:
+        memcpy(dst, src, n * sizeof(int32_t));
+        break;
+    case DRV_ASRC_DATA_MODE_24_BITS:
+        for (uint32_t i = 0; i < n; i++) {
+            dst[i] = (s32[i] << 8) >> 8;
+        }
+        break;
+    case DRV_ASRC_DATA_MODE_16_BITS_STORED_AS_32_BITS:
+        for (uint32_t i = 0; i < n; i++) {
+            dst[i] = (s32[i] << 16) >> 16;
+        }
+        break;
+    case DRV_ASRC_DATA_MODE_16_BITS:
+        for (uint32_t i = 0; i < n; i++) {
+            dst[i] = s16[i];
+        }
+        break;
+    }
+}
+
+/* Sign-extends n elements, as csky_mca_sim_acc_read_data() would. */
+static void unpack_acc_data(int32_t *dst, const void *src, uint32_t n,
+                            drv_acc_data_bits_t data_bits)
+{
+    const int8_t *s8 = src;
+    const int16_t *s16 = src;
+
+    switch (data_bits) {
+    case DRV_ACC_DATA_BITS_8:
+        for (uint32_t i = 0; i < n; i++) {
+            dst[i] = s8[i];
+        }
+        break;
+    case DRV_ACC_DATA_BITS_16:
+        for (uint32_t i = 0; i < n; i++) {
+            dst[i] = s16[i];
+        }
+        break;
+    case DRV_ACC_DATA_BITS_32:
+        memcpy(dst, src, n * sizeof(int32_t));
+        break;
+    }
+}
+
+uint32_t csky_mca_sim_fir(drv_asrc_data_mode_t data_mode,
+                          drv_fir_iir_coeff_sel_t coeff_sel, uint32_t order,
+                          uint32_t out_loc_sel, const void *data_start,
+                          const void *data_end, const void *coeff,
+                          void *result)
+{
+    uint32_t data_elem_size = drv_asrc_size_of_data_mode(data_mode);
+    uintptr_t start = (uintptr_t)data_start, end = (uintptr_t)data_end;
+    g_autofree int32_t *data = NULL;
+    uint32_t num;
+
+    /* 64-bit coefficients need full 64x32-bit products */
+    if (coeff_sel != DRV_FIR_IIR_COEFF_SEL_32_BITS) {
+        return csky_mca_sim_fir_ref(data_mode, coeff_sel, order, out_loc_sel,
+                                    data_start, data_end, coeff, result);
+    }
+    if (end < start + (uintptr_t)data_elem_size * order) {
+        return 0;
+    }
+
+    num = (end - start) / data_elem_size + 1;
+    data = g_new(int32_t, num);
+    unpack_asrc_data(data, data_start, num, data_mode);
+
+    for (uint32_t i = 0; i + order < num; i++) {
+        int128_t sum;
+
+        int128_init(&sum);
+        csky_mca_dot(&sum, coeff, data + i, order + 1);
+        int128_round(&sum, 24);
+        int128_shift_right(&sum, 24);
+        csky_mca_sim_asrc_write_data(&result, &sum, data_mode);
+    }
+
+    return (num - order) * data_elem_size;
+}
+
+void csky_mca_sim_mac(
+    const void *data_a, const void *data_b, const void *init_data, void *result,
+    uint32_t data_depth, uint32_t data_way, drv_acc_data_bits_t input_data_bits,
+    bool enable_init_data, bool enable_active, bool enable_data_b_loop,
+    bool enable_data_a_loop, uint32_t init_data_shift_bits,
+    drv_acc_shift_dir_t init_data_shift_dir, drv_acc_data_bits_t init_data_bits,
+    uint32_t result_shift_bits, drv_acc_shift_dir_t result_shift_dir,
+    drv_acc_data_bits_t result_bits, uint32_t step)
+{
+    uint32_t row = data_way * drv_acc_size_of_data_bits(input_data_bits) + step;
+    g_autofree int32_t *a = g_new(int32_t, data_way);
+    g_autofree int32_t *b = g_new(int32_t, data_way);
+
+    for (uint32_t i_depth = 0; i_depth < data_depth; ++i_depth) {
+        int128_t sum;
+        int128_init(&sum);
+
+        if (enable_init_data) {
+            int64_t init_data_value =
+              csky_mca_sim_acc_read_data(&init_data, init_data_bits);
+            switch (init_data_shift_dir) {
+            case DRV_ACC_SHIFT_LEFT:
+                init_data_value <<= init_data_shift_bits;
+                break;
+            case DRV_ACC_SHIFT_RIGHT:
+                init_data_value >>= init_data_shift_bits;
+                break;
+            }
+            int128_add_mca(&sum, init_data_value);
+        }
+
+        /* a looping operand is the same row every time */
+        if (i_depth == 0 || !enable_data_a_loop) {
+            unpack_acc_data(a, data_a, data_way, input_data_bits);
+        }
+        if (i_depth == 0 || !enable_data_b_loop) {
+            unpack_acc_data(b, data_b, data_way, input_data_bits);
+        }
+        csky_mca_dot(&sum, a, b, data_way);
+
+        if (enable_active && int128_is_negative(&sum)) {
+            int128_init(&sum);
+        }
+
+        csky_mca_sim_acc_write_data_from_i128(&result, &sum, result_shift_bits,
+                                              result_shift_dir, result_bits);
+
+        if (!enable_data_a_loop) {
+            data_a = (const char *)data_a + row;
+        }
+        if (!enable_data_b_loop) {
+            data_b = (const char *)data_b + row;
+        }
+    }
+}
+
+/* Elements per pass of csky_mca_sim_vec(), small enough for the stack */
+#define VEC_CHUNK       256
+
+void csky_mca_sim_vec(csky_mca_sim_vec_op_t vec_op, const void *data_a,
+                      const void *data_b, void *result, uint32_t data_depth,
+                      drv_acc_data_bits_t input_data_bits,
+                      bool enable_vec_scalar, uint32_t result_shift_bits,
+                      drv_acc_shift_dir_t result_shift_dir,
+                      drv_acc_data_bits_t result_bits, uint32_t scalar)
+{
+    uint32_t in_size = drv_acc_size_of_data_bits(input_data_bits);
+    uint32_t out_size = drv_acc_size_of_data_bits(result_bits);
+    int64_t lo = -((int64_t)1 << (out_size * 8 - 1));
+    int64_t hi = ((int64_t)1 << (out_size * 8 - 1)) - 1;
+    int32_t a[VEC_CHUNK], b[VEC_CHUNK];
+    int64_t c[VEC_CHUNK];
+
+    for (uint32_t done = 0; done < data_depth; done += VEC_CHUNK) {
+        uint32_t n = MIN(data_depth - done, VEC_CHUNK);
+
+        unpack_acc_data(a, (const char *)data_a + done * in_size, n,
+                        input_data_bits);
+        if (enable_vec_scalar) {
+            for (uint32_t i = 0; i < n; i++) {
+                b[i] = (int32_t)scalar;
+            }
+        } else {
+            unpack_acc_data(b, (const char *)data_b + done * in_size, n,
+                            input_data_bits);
+        }
+
+        if (vec_op == THEAD_MCA_SIM_VEC_OP_MUL) {
+            for (uint32_t i = 0; i < n; i++) {
+                c[i] = (int64_t)a[i] * b[i];
+            }
+        } else {
+            for (uint32_t i = 0; i < n; i++) {
+                c[i] = (int64_t)a[i] + b[i];
+            }
+        }
+
+        if (result_shift_dir == DRV_ACC_SHIFT_LEFT) {
+            for (uint32_t i = 0; i < n; i++) {
+                c[i] = MIN(hi, MAX(lo, c[i] << result_shift_bits));
+            }
+        } else {
+            for (uint32_t i = 0; i < n; i++) {
+                c[i] = MIN(hi, MAX(lo, c[i] >> result_shift_bits));
+            }
+        }
+
+        switch (result_bits) {
+        case DRV_ACC_DATA_BITS_8:
+            for (uint32_t i = 0; i < n; i++) {
+                ((int8_t *)result)[done + i] = c[i];
+            }
+            break;
+        case DRV_ACC_DATA_BITS_16:
+            for (uint32_t i = 0; i < n; i++) {
+                ((int16_t *)result)[done + i] = c[i];
+            }
+            break;
+        case DRV_ACC_DATA_BITS_32:
+            for (uint32_t i = 0; i < n; i++) {
+                ((int32_t *)result)[done + i] = c[i];
+            }
+            break;
+        }
+    }
+}
@@ -21,16 +21,50 @@
 
 #include "qemu/osdep.h"
 #include "hw/sysbus.h"
+#include "hw/qdev-properties.h"
 #include "trace.h"
 #include "qemu/log.h"
+#include "qemu/iov.h"
+#include "qemu/timer.h"
 #include "migration/vmstate.h"
 #include "exec/memory.h"
+#include "exec/address-spaces.h"
+#include "sysemu/runstate.h"
+#include "sysemu/sysemu.h"
+
+/*
+ * Registers:
+ *   0x0  a character to log
+ *   0x4  guest physical address of a string to log
+ *   0x8  length of that string, writing it logs the whole string
+ */
+#define MEMLOG_CHAR         0x0
+#define MEMLOG_BUF_ADDR     0x4
+#define MEMLOG_BUF_LEN      0x8
+
+/* guest string pieces written with one writev */
+#define MEMLOG_IOV_MAX      16
 
 typedef struct {
     SysBusDevice parent_obj;
 
     MemoryRegion iomem;
     int fd;
+
+    /*
+     * Characters are gathered in buf and written on newline, when it is
+     * full, flush_ms after the first one or when the VM stops.  A
+     * buffer-size of 0 writes every character on its own.
+     */
+    uint32_t buf_size;
+    uint32_t flush_ms;
+    uint8_t *buf;
+    uint32_t buf_len;
+    QEMUTimer *flush_timer;
+    VMChangeStateEntry *vmstate_entry;
+    Notifier exit_notifier;
+
+    uint32_t buf_addr;
 } csky_memlog_state;
 
 #define TYPE_THEAD_MEMLOG  "csky_memlog"
@@ -51,29 +85,162 @@ static void csky_memlog_openfile(csky_memlog_state *s)
     } while (s->fd < 0 && errno == EINTR);
 }
 
+static void csky_memlog_writev(csky_memlog_state *s, struct iovec *iov,
+                               unsigned int iovcnt)
+{
+    ssize_t ret;
+
+    if (s->fd <= 0) {
+        csky_memlog_openfile(s);
+    }
+
+    while (iovcnt > 0) {
+        ret = writev(s->fd, iov, iovcnt);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        iov_discard_front(&iov, &iovcnt, ret);
+    }
+}
+
+static void csky_memlog_flush(csky_memlog_state *s)
+{
+    struct iovec iov = { .iov_base = s->buf, .iov_len = s->buf_len };
+
+    if (s->buf_len == 0) {
+        return;
+    }
+    csky_memlog_writev(s, &iov, 1);
+    s->buf_len = 0;
+    timer_del(s->flush_timer);
+}
+
+static void csky_memlog_putc(csky_memlog_state *s, char a)
+{
+    struct iovec iov = { .iov_base = &a, .iov_len = 1 };
+
+    if (s->buf == NULL) {
+        csky_memlog_writev(s, &iov, 1);
+        return;
+    }
+
+    s->buf[s->buf_len++] = a;
+    if (a == '\n' || s->buf_len == s->buf_size) {
+        csky_memlog_flush(s);
+    } else if (s->buf_len == 1 && s->flush_ms) {
+        timer_mod(s->flush_timer,
+                  qemu_clock_get_ms(QEMU_CLOCK_REALTIME) + s->flush_ms);
+    }
+}
+
+/*
+ * Log @len bytes of guest memory at @addr.  RAM is written in place
+ * together with the buffered characters, anything address_space_map
+ * cannot map is copied.
+ */
+static void csky_memlog_puts(csky_memlog_state *s, hwaddr addr, hwaddr len)
+{
+    struct iovec iov[MEMLOG_IOV_MAX + 1];
+    unsigned int n = 0, i;
+    uint8_t bounce[256];
+    hwaddr plen;
+    void *p;
+
+    if (s->buf_len) {
+        iov[n].iov_base = s->buf;
+        iov[n++].iov_len = s->buf_len;
+    }
+
+    while (len && n < ARRAY_SIZE(iov)) {
+        plen = len;
+        p = address_space_map(&address_space_memory, addr, &plen, false,
+                              MEMTXATTRS_UNSPECIFIED);
+        if (p == NULL) {
+            break;
+        }
+        iov[n].iov_base = p;
+        iov[n++].iov_len = plen;
+        addr += plen;
+        len -= plen;
+    }
+
+    csky_memlog_writev(s, iov, n);
+
+    for (i = 0; i < n; i++) {
+        if (iov[i].iov_base != s->buf) {
+            address_space_unmap(&address_space_memory, iov[i].iov_base,
+                                iov[i].iov_len, false, iov[i].iov_len);
+        }
+    }
+    if (s->buf_len) {
+        s->buf_len = 0;
+        timer_del(s->flush_timer);
+    }
+
+    while (len) {
+        plen = MIN(len, sizeof(bounce));
+        if (address_space_read(&address_space_memory, addr,
+                               MEMTXATTRS_UNSPECIFIED, bounce, plen)
+            != MEMTX_OK) {
+            qemu_log_mask(LOG_GUEST_ERROR, "csky_memlog: cannot read "
+                          "0x%" HWADDR_PRIx "\n", addr);
+            break;
+        }
+        iov[0].iov_base = bounce;
+        iov[0].iov_len = plen;
+        csky_memlog_writev(s, iov, 1);
+        addr += plen;
+        len -= plen;
+    }
+}
+
 static void csky_memlog_write(void *opaque, hwaddr offset,
                               uint64_t value, unsigned size)
 {
     csky_memlog_state *s = (csky_memlog_state *)opaque;
-    char a = value;
-    int ret;
-
-    if (offset != 0) {
-        qemu_log_mask(LOG_GUEST_ERROR, "csky_memlog_write: bad offset\n");
-    }
 
     if (size != 4) {
         qemu_log_mask(LOG_GUEST_ERROR,
                       "csky_memlog_write: only support word align access\n");
     }
 
-    if (s->fd <= 0) {
-        csky_memlog_openfile(s);
+    switch (offset) {
+    case MEMLOG_CHAR:
+        csky_memlog_putc(s, value);
+        break;
+    case MEMLOG_BUF_ADDR:
+        s->buf_addr = value;
+        break;
+    case MEMLOG_BUF_LEN:
+        csky_memlog_puts(s, s->buf_addr, (uint32_t)value);
+        break;
+    default:
+        qemu_log_mask(LOG_GUEST_ERROR, "csky_memlog_write: bad offset\n");
+        break;
     }
+}
 
-    do {
-        ret = write(s->fd, &a, 1);
-    } while (ret < 0 && errno == EINTR);
+static void csky_memlog_flush_timer(void *opaque)
+{
+    csky_memlog_flush(opaque);
+}
+
+static void csky_memlog_vm_state_change(void *opaque, bool running,
+                                        RunState state)
+{
+    if (!running) {
+        csky_memlog_flush(opaque);
+    }
+}
+
+static void csky_memlog_exit(Notifier *n, void *data)
+{
+    csky_memlog_state *s = container_of(n, csky_memlog_state, exit_notifier);
+
+    csky_memlog_flush(s);
 }
 
 static const MemoryRegionOps csky_memlog_ops = {
@@ -84,10 +251,11 @@ static const MemoryRegionOps csky_memlog_ops = {
 
 static const VMStateDescription vmstate_csky_memlog = {
     .name = TYPE_THEAD_MEMLOG,
-    .version_id = 1,
+    .version_id = 2,
     .minimum_version_id = 1,
     .fields = (VMStateField[]) {
         VMSTATE_INT32(fd, csky_memlog_state),
+        VMSTATE_UINT32_V(buf_addr, csky_memlog_state, 2),
         VMSTATE_END_OF_LIST()
     }
 };
@@ -104,11 +272,34 @@ static void csky_memlog_init(Object *obj)
     s->fd = -1;
 }
 
+static void csky_memlog_realize(DeviceState *dev, Error **errp)
+{
+    csky_memlog_state *s = THEAD_MEMLOG(dev);
+
+    if (s->buf_size) {
+        s->buf = g_malloc(s->buf_size);
+        s->flush_timer = timer_new_ms(QEMU_CLOCK_REALTIME,
+                                      csky_memlog_flush_timer, s);
+        s->vmstate_entry =
+            qemu_add_vm_change_state_handler(csky_memlog_vm_state_change, s);
+        s->exit_notifier.notify = csky_memlog_exit;
+        qemu_add_exit_notifier(&s->exit_notifier);
+    }
+}
+
+static Property csky_memlog_properties[] = {
+    DEFINE_PROP_UINT32("buffer-size", csky_memlog_state, buf_size, 4096),
+    DEFINE_PROP_UINT32("flush-ms", csky_memlog_state, flush_ms, 100),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
 static void csky_memlog_class_init(ObjectClass *oc, void *data)
 {
     DeviceClass *dc = DEVICE_CLASS(oc);
     set_bit(DEVICE_CATEGORY_CSKY, dc->categories);
 
+    dc->realize = csky_memlog_realize;
+    device_class_set_props(dc, csky_memlog_properties);
     dc->vmsd = &vmstate_csky_memlog;
     dc->desc = "cskysim type: MEMLOG";
 }
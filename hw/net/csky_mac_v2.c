@@ -28,13 +28,30 @@
 #include "migration/vmstate.h"
 #include "hw/ptimer.h"
 #include "sysemu/sysemu.h"
+#include "sysemu/dma.h"
 
 #define CSKY_BUS_WIDTH                  32    /* 32 bit ahb bus */
 #define CSKY_MAC_V2_FREQ                40000000ll
+#define CSKY_MAC_V2_MAX_FRAME           1518
+#define CSKY_MAC_V2_TX_IOV              16
+
+static void csky_mac_v2_rx_flush(csky_mac_v2_state *s)
+{
+    s->rx_bd_head = 0;
+    s->rx_bd_num = 0;
+}
+
+static int csky_mac_v2_post_load(void *opaque, int version_id)
+{
+    csky_mac_v2_rx_flush(opaque);
+    return 0;
+}
+
 static const VMStateDescription vmstate_csky_mac_v2 = {
     .name = "csky_mac_v2",
     .version_id = 2,
     .minimum_version_id = 2,
+    .post_load = csky_mac_v2_post_load,
     .fields      = (VMStateField []) {
         VMSTATE_UINT32(config, csky_mac_v2_state),
         VMSTATE_UINT32(frame_filter, csky_mac_v2_state),
@@ -322,65 +339,236 @@ static uint64_t csky_mac_v2_read(void *opaque, hwaddr offset, unsigned size)
 
 /**************************************************************************
  * Description:
- *     Send a frame according to the tx bd.
+ *     Fetch a run of descriptors with a single DMA read. The run stops
+ *     after the descriptor that ends the ring, and before the first one
+ *     the MAC does not own, unless that is the first one: it is returned
+ *     on its own and the caller checks its OWN bit. Descriptors the guest
+ *     still owns are thus never kept, it may hand them over at any time.
+ *     The read never goes past the last descriptor of the ring, which is
+ *     learnt from its end of ring bit; until then one is read at a time.
+ * Argument:
+ *     s           --- the pointer to the MAC state
+ *     addr        --- the address of the first descriptor
+ *     bd          --- CSKY_MAC_V2_BD_BATCH descriptors to fill in
+ *     bd_addr     --- the guest address of each descriptor
+ *     end_of_ring --- the end of ring bit in status2, TXBD_TER or RXBD_RER
+ *     ring_end    --- the address of the last descriptor, 0 if unknown
+ * Return:
+ *     the number of descriptors fetched, at least 1
+ **************************************************************************/
+static unsigned csky_mac_v2_fetch_bds(csky_mac_v2_state *s, uint32_t addr,
+                                      csky_mac_v2_bd *bd, uint32_t *bd_addr,
+                                      uint32_t end_of_ring,
+                                      uint32_t *ring_end)
+{
+    uint32_t stride = (s->bus_mode & BUSMODE_DSL) + 16;
+    uint8_t buf[CSKY_MAC_V2_BD_BATCH * (BUSMODE_DSL + 16)];
+    unsigned max = 1, n;
+
+    if (*ring_end >= addr && (*ring_end - addr) % stride == 0) {
+        max = MIN((*ring_end - addr) / stride + 1, CSKY_MAC_V2_BD_BATCH);
+    }
+
+    if (dma_memory_read(&address_space_memory, addr, buf,
+                        (max - 1) * stride + sizeof(*bd),
+                        MEMTXATTRS_UNSPECIFIED) != MEMTX_OK) {
+        /* nothing to fetch from there, the MAC does not own it */
+        memset(bd, 0, sizeof(*bd));
+        bd_addr[0] = addr;
+        *ring_end = 0;
+        return 1;
+    }
+
+    for (n = 0; n < max; n++) {
+        memcpy(&bd[n], buf + n * stride, sizeof(*bd));
+        bd_addr[n] = addr + n * stride;
+        if (!(bd[n].status1 & TXBD_OWN)) {
+            return n ? n : 1;
+        }
+        if (bd[n].status2 & end_of_ring) {
+            *ring_end = bd_addr[n];
+            return n + 1;
+        }
+    }
+    if (bd_addr[n - 1] == *ring_end) {
+        /* the guest has made the ring longer */
+        *ring_end = 0;
+    }
+    return n;
+}
+
+/* Hand a descriptor back to the guest, only status1 has changed */
+static void csky_mac_v2_put_bd(uint32_t addr, uint32_t status1)
+{
+    dma_memory_write(&address_space_memory, addr, &status1, sizeof(status1),
+                     MEMTXATTRS_UNSPECIFIED);
+}
+
+/* A frame being gathered from its tx descriptors */
+typedef struct {
+    struct iovec iov[CSKY_MAC_V2_TX_IOV];
+    bool mapped[CSKY_MAC_V2_TX_IOV];
+    int niov;
+    size_t len;
+    bool drop;
+    /* descriptors whose buffers are mapped, given back once it is sent */
+    uint32_t bd_addr[CSKY_MAC_V2_TX_IOV];
+    uint32_t bd_status1[CSKY_MAC_V2_TX_IOV];
+    int nbd;
+    /* segments that could not be mapped */
+    uint8_t bounce[CSKY_MAC_V2_MAX_FRAME];
+    size_t copied;
+} csky_mac_v2_tx_frame;
+
+/**************************************************************************
+ * Description:
+ *     Add a segment to the frame. Segments in RAM are mapped and sent
+ *     from guest memory, anything else is copied to the bounce buffer.
+ *     The last iovec is kept for copies, so a frame with more segments
+ *     than iovecs still fits.
+ * Argument:
+ *     f    --- the frame
+ *     addr --- the guest address of the segment
+ *     size --- the segment size
+ * Return:
+ *     true if the segment was mapped
+ **************************************************************************/
+static bool csky_mac_v2_tx_add(csky_mac_v2_tx_frame *f, uint32_t addr,
+                               uint32_t size)
+{
+    struct iovec *last = f->niov ? &f->iov[f->niov - 1] : NULL;
+    dma_addr_t len = size;
+    void *p;
+
+    if (f->niov < CSKY_MAC_V2_TX_IOV - 1) {
+        p = dma_memory_map(&address_space_memory, addr, &len,
+                           DMA_DIRECTION_TO_DEVICE, MEMTXATTRS_UNSPECIFIED);
+        if (p && len == size) {
+            f->iov[f->niov].iov_base = p;
+            f->iov[f->niov].iov_len = size;
+            f->mapped[f->niov++] = true;
+            f->len += size;
+            return true;
+        }
+        if (p) {
+            dma_memory_unmap(&address_space_memory, p, len,
+                             DMA_DIRECTION_TO_DEVICE, 0);
+        }
+    }
+
+    dma_memory_read(&address_space_memory, addr, f->bounce + f->copied, size,
+                    MEMTXATTRS_UNSPECIFIED);
+    if (last && !f->mapped[f->niov - 1] &&
+        (uint8_t *)last->iov_base + last->iov_len == f->bounce + f->copied) {
+        last->iov_len += size;
+    } else {
+        f->iov[f->niov].iov_base = f->bounce + f->copied;
+        f->iov[f->niov].iov_len = size;
+        f->mapped[f->niov++] = false;
+    }
+    f->copied += size;
+    f->len += size;
+    return false;
+}
+
+/* Unmap the frame and give back the descriptors it was holding */
+static void csky_mac_v2_tx_release(csky_mac_v2_tx_frame *f)
+{
+    int i;
+
+    for (i = 0; i < f->niov; i++) {
+        if (f->mapped[i]) {
+            dma_memory_unmap(&address_space_memory, f->iov[i].iov_base,
+                             f->iov[i].iov_len, DMA_DIRECTION_TO_DEVICE,
+                             f->iov[i].iov_len);
+        }
+    }
+    for (i = 0; i < f->nbd; i++) {
+        csky_mac_v2_put_bd(f->bd_addr[i], f->bd_status1[i]);
+    }
+    f->niov = 0;
+    f->nbd = 0;
+    f->len = 0;
+    f->copied = 0;
+    f->drop = false;
+}
+
+/**************************************************************************
+ * Description:
+ *     Send the frames queued in the tx ring, fetching the descriptors
+ *     CSKY_MAC_V2_BD_BATCH at a time. The interrupt is raised once for
+ *     the whole run.
  * Argument:
  *     s  --- the pointer to the MAC state
  * Return:
  *     void
  **************************************************************************/
-
 static void csky_mac_v2_release_packet(csky_mac_v2_state *s)
 {
-    int size;
-    uint8_t *p;
-    uint8_t frame[1518];
-    csky_mac_v2_bd cur_tx_bd;
-    int end_of_ring;
     NetClientState *nc = qemu_get_queue(s->nic);
-    int en_int;
+    csky_mac_v2_bd bd[CSKY_MAC_V2_BD_BATCH];
+    uint32_t bd_addr[CSKY_MAC_V2_BD_BATCH];
+    csky_mac_v2_tx_frame f = { 0 };
+    unsigned i = 0, n = 0;
 
-    p = frame;
-    int len=0;
     while (1) {
+        csky_mac_v2_bd *cur_tx_bd;
+        uint32_t size;
+        bool mapped = false;
+
+        if (i == n) {
+            n = csky_mac_v2_fetch_bds(s, s->cur_tx_des_addr, bd, bd_addr,
+                                      TXBD_TER, &s->tx_ring_end);
+            i = 0;
+        }
+        cur_tx_bd = &bd[i];
 
-        /* acquire current tx bd, save the important control bits */
-        cpu_physical_memory_read(s->cur_tx_des_addr, (uint8_t *)&cur_tx_bd, 16);
-        en_int           = cur_tx_bd.status2 & TXBD_IC;
-        end_of_ring      = cur_tx_bd.status2 & TXBD_TER;
-        size             = cur_tx_bd.status2 & TXBD_BUF1_SIZE;
-
-        assert(size <= 1518 && len <= 1518);
-        if ((cur_tx_bd.status1 & TXBD_OWN) == 0) {
+        if ((cur_tx_bd->status1 & TXBD_OWN) == 0) {
             s->status |= STATUS_TX_BUF_UNAVAILABLE | STATUS_NORMAL_INT;
             s->status |= STATUS_TX_STATE_SUSPEND;
             break;
         }
-        cpu_physical_memory_read(cur_tx_bd.buffer1, p, size);
-        p += size;
-        len +=size;
-        if (cur_tx_bd.status2 & TXBD_LS) {
-            qemu_send_packet(nc, frame, len);
-            cur_tx_bd.status1 &= ~TXBD_OWN;
-            cpu_physical_memory_write(s->cur_tx_des_addr, (uint8_t *)&cur_tx_bd, 16);
-            if (en_int) {
-                s->status |= STATUS_TX_INT | STATUS_NORMAL_INT;
-                csky_mac_v2_update(s);
+
+        size = cur_tx_bd->status2 & TXBD_BUF1_SIZE;
+        if (f.len + size > CSKY_MAC_V2_MAX_FRAME) {
+            if (!f.drop) {
+                qemu_log_mask(LOG_GUEST_ERROR,
+                              "csky_mac_v2: tx frame longer than %d bytes\n",
+                              CSKY_MAC_V2_MAX_FRAME);
             }
-            p = frame;
-            len = 0;
+            f.drop = true;
+        } else if (size) {
+            mapped = csky_mac_v2_tx_add(&f, cur_tx_bd->buffer1, size);
         }
-        else {
-            cur_tx_bd.status1 &= ~TXBD_OWN;
-            cpu_physical_memory_write(s->cur_tx_des_addr, (uint8_t *)&cur_tx_bd, 16);
+
+        cur_tx_bd->status1 &= ~TXBD_OWN;
+        if (cur_tx_bd->status2 & TXBD_LS) {
+            if (!f.drop) {
+                qemu_sendv_packet(nc, f.iov, f.niov);
+            }
+            csky_mac_v2_tx_release(&f);
+            csky_mac_v2_put_bd(bd_addr[i], cur_tx_bd->status1);
+            if (cur_tx_bd->status2 & TXBD_IC) {
+                s->status |= STATUS_TX_INT | STATUS_NORMAL_INT;
+            }
+        } else if (mapped) {
+            /* the guest may not reuse the buffer before it is sent */
+            f.bd_addr[f.nbd] = bd_addr[i];
+            f.bd_status1[f.nbd++] = cur_tx_bd->status1;
+        } else {
+            csky_mac_v2_put_bd(bd_addr[i], cur_tx_bd->status1);
         }
-        if (end_of_ring) {
+
+        if (cur_tx_bd->status2 & TXBD_TER) {
             s->cur_tx_des_addr = s->tx_des_list_addr;
         } else {
             s->cur_tx_des_addr += (s->bus_mode & BUSMODE_DSL) + 16;
         }
-
+        i++;
     }
 
+    /* a frame cut short by the guest is dropped */
+    csky_mac_v2_tx_release(&f);
     csky_mac_v2_update(s);
 }
 
@@ -465,6 +653,7 @@ static void csky_mac_v2_write(void *opaque, hwaddr offset,
     case 0x0:
         if (!(s->config & CONFIG_RXEN) && (value & CONFIG_RXEN)) {
             s->cur_rx_des_addr = s->rx_des_list_addr;
+            csky_mac_v2_rx_flush(s);
         }
         if (!(s->config & CONFIG_TXEN) && (value & CONFIG_TXEN)) {
             s->cur_tx_des_addr = s->tx_des_list_addr;
@@ -537,6 +726,7 @@ static void csky_mac_v2_write(void *opaque, hwaddr offset,
         }
         return;
     case 0x1008:  /* rx_poll_demand register read only */
+        csky_mac_v2_rx_flush(s);
         cpu_physical_memory_read(s->cur_rx_des_addr, p_cur_bd, 16);
         if (cur_bd.status1 & RXBD_OWN) {
             s->status &= ~STATUS_RX_BUF_UNAVAILABLE;
@@ -551,13 +741,16 @@ static void csky_mac_v2_write(void *opaque, hwaddr offset,
     case 0x100c:
         /* the lowest two bits are always 0 for 32-bit bus width. */
         s->rx_des_list_addr = value & (~0x3);
+        s->rx_ring_end = 0;
         if (!(s->operation_mode & OPMODE_START_RX)) {
             s->cur_rx_des_addr = s->rx_des_list_addr;
+            csky_mac_v2_rx_flush(s);
         }
         return;
     case 0x1010:
         /* the lowest two bits are always 0 for 32-bit bus width. */
         s->tx_des_list_addr = value & (~0x3);
+        s->tx_ring_end = 0;
         if (!(s->operation_mode & OPMODE_START_TX)) {
             s->cur_tx_des_addr = s->tx_des_list_addr;
         }
@@ -592,6 +785,7 @@ static void csky_mac_v2_write(void *opaque, hwaddr offset,
 
         if (!(s->operation_mode & OPMODE_START_RX) &&
             (value & OPMODE_START_RX)) {
+            csky_mac_v2_rx_flush(s);
             cpu_physical_memory_read(s->cur_rx_des_addr, p_cur_bd, 16);
             if (cur_bd.status1 & RXBD_OWN) {
                 s->status &= ~STATUS_RX_BUF_UNAVAILABLE;
@@ -712,7 +906,7 @@ static ssize_t csky_mac_v2_receive(NetClientState *nc, const uint8_t *buf,
                                    size_t size)
 {
     csky_mac_v2_state *s = qemu_get_nic_opaque(nc);
-    csky_mac_v2_bd cur_rx_bd;
+    csky_mac_v2_bd *cur_rx_bd;
     int dis_int, end_of_ring;
 
     if (!((s->operation_mode & OPMODE_START_RX)
@@ -722,11 +916,17 @@ static ssize_t csky_mac_v2_receive(NetClientState *nc, const uint8_t *buf,
     }
     /* acquire current rx bd, save the important bits */
     assert( size <= 1518 );
-    cpu_physical_memory_read(s->cur_rx_des_addr, (uint8_t *)&cur_rx_bd, 16);
-    dis_int        = cur_rx_bd.status2 & RXBD_IC_DIS;
-    end_of_ring    = cur_rx_bd.status2 & RXBD_RER;
+    if (s->rx_bd_head == s->rx_bd_num) {
+        s->rx_bd_num = csky_mac_v2_fetch_bds(s, s->cur_rx_des_addr, s->rx_bd,
+                                             s->rx_bd_addr, RXBD_RER,
+                                             &s->rx_ring_end);
+        s->rx_bd_head = 0;
+    }
+    cur_rx_bd = &s->rx_bd[s->rx_bd_head++];
+    dis_int        = cur_rx_bd->status2 & RXBD_IC_DIS;
+    end_of_ring    = cur_rx_bd->status2 & RXBD_RER;
 
-    if ((cur_rx_bd.status1 & RXBD_OWN) == 0){
+    if ((cur_rx_bd->status1 & RXBD_OWN) == 0){
         if (end_of_ring) {
             s->cur_rx_des_addr = s->rx_des_list_addr;
         } else {
@@ -734,28 +934,34 @@ static ssize_t csky_mac_v2_receive(NetClientState *nc, const uint8_t *buf,
         }
         return -1;
     }
-    cpu_physical_memory_write(cur_rx_bd.buffer1, buf, size);
-    cur_rx_bd.status1 &= ~0x3fff0000;
-    cur_rx_bd.status1 |= (size + 4) << 16;
-    cur_rx_bd.status1 |= RXBD_FS | RXBD_LS;
-    cur_rx_bd.status1 &= ~RXBD_OWN;
-    cpu_physical_memory_write(s->cur_rx_des_addr, (uint8_t *)&cur_rx_bd, 16);
+    dma_memory_write(&address_space_memory, cur_rx_bd->buffer1, buf, size,
+                     MEMTXATTRS_UNSPECIFIED);
+    cur_rx_bd->status1 &= ~0x3fff0000;
+    cur_rx_bd->status1 |= (size + 4) << 16;
+    cur_rx_bd->status1 |= RXBD_FS | RXBD_LS;
+    cur_rx_bd->status1 &= ~RXBD_OWN;
+    csky_mac_v2_put_bd(s->cur_rx_des_addr, cur_rx_bd->status1);
+
+    /*
+     * Frames with interrupt on completion disabled are coalesced: the
+     * first one starts the receive interrupt watchdog (rx_int_watchdog_timer,
+     * in units of 256 clocks) and RI is raised when it runs out, or earlier
+     * by a frame that does want its interrupt.
+     */
+    ptimer_transaction_begin(s->timer);
     if (!dis_int) {
         s->status |= STATUS_RX_INT | STATUS_NORMAL_INT;
         csky_mac_v2_update(s);
         /* disabled timer before it runs out */
         ptimer_stop(s->timer);
+        s->rx_wdt_running = false;
+    } else if (s->rx_int_watchdog_timer != 0 && !s->rx_wdt_running) {
+        ptimer_set_limit(s->timer, s->rx_int_watchdog_timer * 256, 1);
+        ptimer_run(s->timer, 1);
+        s->rx_wdt_running = true;
     }
-    /* if non-zero,ritw get activated */
-    if (s->rx_int_watchdog_timer != 0 && ptimer_get_count(s->timer) == 0){
-        ptimer_set_limit(s->timer, s->rx_int_watchdog_timer*256 ,0);
-        ptimer_set_freq(s->timer, CSKY_MAC_V2_FREQ);
-        ptimer_run(s->timer,1);
-    }
-    /*
-    s->status |= STATUS_RX_INT | STATUS_NORMAL_INT;
-    csky_mac_v2_update(s);
-    */
+    ptimer_transaction_commit(s->timer);
+
     if (end_of_ring) {
         s->cur_rx_des_addr = s->rx_des_list_addr;
     } else {
@@ -775,6 +981,7 @@ static ssize_t csky_mac_v2_receive(NetClientState *nc, const uint8_t *buf,
  ***************************************************************************/
 static void csky_mac_v2_timer_tick(void *opaque){
     csky_mac_v2_state *s = (csky_mac_v2_state*)opaque;
+    s->rx_wdt_running = false;
     s->status |= STATUS_RX_INT | STATUS_NORMAL_INT;
     csky_mac_v2_update(s);
 }
@@ -814,6 +1021,15 @@ static inline void csky_mac_v2_reset(csky_mac_v2_state *s)
 {
     memset(&s->config, 0, 25 * sizeof(uint32_t));
     s->bus_mode = 0x00020100;
+    s->tx_ring_end = 0;
+    s->rx_ring_end = 0;
+    csky_mac_v2_rx_flush(s);
+    if (s->timer) {
+        ptimer_transaction_begin(s->timer);
+        ptimer_stop(s->timer);
+        ptimer_transaction_commit(s->timer);
+    }
+    s->rx_wdt_running = false;
 }
 
 /**************************************************************************
@@ -842,6 +1058,9 @@ static void csky_mac_v2_init(Object *obj)
 
     csky_mac_v2_reset(s);
     s->timer = ptimer_init(csky_mac_v2_timer_tick, s, PTIMER_POLICY_LEGACY);
+    ptimer_transaction_begin(s->timer);
+    ptimer_set_freq(s->timer, CSKY_MAC_V2_FREQ);
+    ptimer_transaction_commit(s->timer);
 }
 
 static Property csky_mac_v2_properties[] = {
@@ -209,11 +209,32 @@ typedef struct CPUTLB { } CPUTLB;
 
 #endif /* CONFIG_SOFTMMU && CONFIG_TCG */
 
+/*
+ * State read by the inline caches of indirect jumps (see TBInlineCache).
+ * @gen tags the records filled by this vCPU; it is renewed whenever its
+ * jump cache is flushed.  @pages has bit N set if one of those records may
+ * point into a page whose number is N modulo 64, so that flushing other
+ * pages leaves them alone.  User-mode vCPUs share one address space and
+ * use a common generation instead.  @ras is a ring of the return slots of the
+ * calls made most recently, @ras_top the byte offset of the newest one.
+ */
+#define TB_RAS_SIZE 16
+
+typedef struct CPUIndirectJumpState {
+#ifndef CONFIG_USER_ONLY
+    uintptr_t gen;
+    uint64_t pages;
+#endif
+    uint32_t ras_top;
+    void *ras[TB_RAS_SIZE];
+} CPUIndirectJumpState;
+
 /*
  * This structure must be placed in ArchCPU immediately
  * before CPUArchState, as a field named "neg".
  */
 typedef struct CPUNegativeOffsetState {
+    CPUIndirectJumpState ijmp;
     CPUTLB tlb;
     IcountDecr icount_decr;
 } CPUNegativeOffsetState;
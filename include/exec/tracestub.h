@@ -6,6 +6,7 @@
 #include "qemu/cutils.h"
 #include "qemu/option.h"
 #include "qemu/timer.h"
+#include "qemu/thread.h"
 #ifdef CONFIG_USER_ONLY
 #include "qemu/sockets.h"
 #else
@@ -25,6 +26,16 @@
 #define DEFAULT_DATA_MAXLEN     4
 #define TRACE_HEADER_LENGTH     4096
 #define INSN_PER_PACKET         (20 * 512)
+#define DEFAULT_RING_SLOTS      16
+#define MAX_RING_SLOTS          4096
+#define MAX_TRACE_RINGS         64
+
+/* trace file sink */
+#define TRACE_FILE_MAGIC        0x31435254594b5343ULL /* "CSKYTRC1" */
+#define TRACE_FILE_VERSION      1
+#define TRACE_FILE_HEADER_LEN   4096
+#define TRACE_FILE_CHUNK        (64 * 1024 * 1024)
+#define TRACE_FILE_INDEX_STEP   (16 * INSN_PER_PACKET)
 
 #define TRACE_VERSION           0x1
 #define TRACE_END               0x3
@@ -52,6 +63,7 @@
 #define DATA_SWADDR             0x54
 #define DATA_SEG                0x60
 #define TRACE_COMPRESS          0x82
+#define TRACE_ZSTD_BLOCK        0x83
 #define SYN_START               ((0x00 << 8) | 0x02)
 #define SYN_END                 ((0x07 << 8) | 0x02)
 #define SYN_ICOUNT              ((0x01 << 8) | 0x02)
@@ -92,6 +104,8 @@
 #define TRACE_EVENT_GDB         (0x1 << 22)
 #define TRACE_EVENT_X_VF        (0x1 << 23)
 #define TRACE_EVENT_X_LMUL      (0x1 << 24)
+#define TRACE_EVENT_DELTA       (0x1 << 25)
+#define TRACE_EVENT_ZSTD        (0x1 << 26)
 
 #define MAX_ADDR_CMPR_NUM       2
 #define MAX_DATA_CMPR_NUM       2
@@ -138,6 +152,118 @@ struct csky_trace_compress {
     uint32_t count;
 };
 
+/*
+ * Stream codecs, announced in the config word of the trace header and
+ * used for every packet after it.
+ *
+ * delta: each packet is its type byte followed by its fields as LEB128
+ * varints. The 8 bit field of write_trace_8_8 stays a raw byte. INST_OFFSET
+ * and DATA_*ADDR values are sent as the zigzag encoded difference to the
+ * previous value of the same kind; both references restart from 0 at every
+ * SYN record.
+ *
+ * zstd: delta, and every buffer is sent as one TRACE_ZSTD_BLOCK packet:
+ * type byte, 3 reserved bytes, 32 bit compressed length, 32 bit raw
+ * length, then one zstd frame holding the delta encoded packets.
+ */
+enum csky_trace_codec {
+    TRACE_CODEC_RAW,
+    TRACE_CODEC_DELTA,
+    TRACE_CODEC_ZSTD,
+};
+
+#define TRACE_DELTA_MAXLEN      12
+#define TRACE_ZSTD_HEADER_LEN   12
+#define TRACE_ZSTD_LEVEL        1
+
+/* what a vCPU does when its trace ring has no free slot */
+enum csky_trace_backpressure {
+    TRACE_BP_BLOCK,         /* wait for the writer thread */
+    TRACE_BP_DROP,          /* discard the chunk and count it */
+    TRACE_BP_GROW,          /* keep appending to the current chunk */
+};
+
+struct csky_trace_chunk {
+    char *buf;
+    uint32_t len;
+    uint32_t pos;
+    uint64_t seq;
+    uint64_t icount;        /* traced insns before the first packet */
+    bool indexed;           /* starts at a seek point */
+    bool zstd;              /* compress before sending */
+};
+
+/*
+ * Trace output of one vCPU. Packets are staged in buf by that vCPU's thread
+ * only. In async mode full buffers are passed to the writer thread through
+ * slot: single producer, single consumer, head is only written by the
+ * producer, tail only by the writer.
+ *
+ * The instruction counts are those of the same vCPU: icount is what the
+ * filter let through, and a SYN record carries insn_num, the part of it
+ * since last_icount. run_icount and sent_icount decide when the vCPU sends
+ * its buffer.
+ */
+struct csky_trace_ring {
+    char *buf;
+    uint32_t len;
+    uint32_t pos;
+    uint64_t icount;
+    uint64_t insn_num;
+    uint64_t last_icount;
+    uint64_t run_icount;
+    uint64_t sent_icount;
+    uint64_t chunk_icount;
+    bool chunk_indexed;
+    uint32_t delta_inst;
+    uint32_t delta_data;
+    struct csky_trace_chunk *slot;
+    uint32_t mask;
+    uint32_t head;
+    uint32_t tail;
+};
+
+/*
+ * Layout of a trace file:
+ *   header, padded to TRACE_FILE_HEADER_LEN
+ *   packet stream, same bytes as sent to a trace port
+ *   index_num entries of csky_trace_index_entry, sorted by icount
+ * All fields are little endian. Every index entry points at a SYN record,
+ * or a TRACE_ZSTD_BLOCK starting with one, followed by fresh
+ * INST_SEG/INST_BASE/DATA_SEG packets, so decoding can start there without
+ * replaying the stream from the beginning. The buffer after a dropped one
+ * is always a seek point.
+ *
+ * The header is written when the file is created and data_end is kept up
+ * to date while tracing. index_offset stays 0 until the index has been
+ * written at close, so a file without one was not closed cleanly.
+ */
+struct csky_trace_file_header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t chunk_size;
+    uint64_t data_end;
+    uint64_t index_offset;
+    uint64_t index_num;
+};
+
+struct csky_trace_index_entry {
+    uint64_t icount;
+    uint64_t offset;
+};
+
+struct csky_trace_file {
+    int fd;
+    struct csky_trace_file_header *hdr;  /* mapped for the whole run */
+    char *map;              /* currently mapped chunk */
+    uint64_t map_start;     /* file offset of map */
+    uint64_t pos;           /* next write offset */
+    uint64_t size;          /* current file size */
+    uint32_t chunk_size;
+    uint64_t next_index;    /* icount of the next seek point */
+    GArray *index;
+};
+
 struct csky_trace_server_state {
 #ifdef CONFIG_USER_ONLY
     int fd;
@@ -148,12 +274,29 @@ struct csky_trace_server_state {
     bool initok;
     uint32_t count;
     uint32_t total;
-    uint32_t pos;
-    char *buf;
-    uint32_t len;
-    uint64_t insn_num;
-    uint64_t last_icount;
     struct csky_trace_compress compress;
+    /* asynchronous output */
+    bool async;
+    bool writer_quit;
+    enum csky_trace_backpressure backpressure;
+    uint32_t ring_slots;
+    uint64_t seq;
+    uint64_t dropped_chunks;
+    uint64_t dropped_bytes;
+    /* one ring per vCPU, plus one for producers outside vCPU threads */
+    struct csky_trace_ring *rings[MAX_TRACE_RINGS + 1];
+    QemuMutex out_lock;     /* serialises synchronous output */
+    QemuThread writer;
+    QemuEvent data_ev;
+    QemuEvent space_ev;
+    /* file sink, NULL when sending to a port */
+    struct csky_trace_file *file;
+    /* stream codec, only active once the header has been sent */
+    enum csky_trace_codec codec;
+    bool delta;
+    bool zstd;
+    /* ld/st records are stored by generated code, see gen_trace_rec */
+    bool inline_mem;
 };
 
 extern struct csky_trace_server_state traceserver;
@@ -169,6 +312,13 @@ struct trace_data {
     uint32_t max;
 };
 
+/* how a TB is traced, decided when it is translated */
+enum csky_trace_tb_class {
+    TRACE_TB_FILTER,        /* filter at run time */
+    TRACE_TB_INSIDE,        /* always traced, no filter needed */
+    TRACE_TB_OUTSIDE,       /* never traced, no trace helpers */
+};
+
 enum stsp_status {
     STSP_START = 1,
     STSP_EXIT = 2
@@ -184,6 +334,9 @@ struct csky_trace_filter {
     uint32_t stsp_num;
     struct trace_range addr_range[MAX_ADDR_CMPR_NUM];
     uint32_t addr_num;
+    /* INSN_ADDR_RANGE_CMPR windows, only these filter the insn trace */
+    struct trace_range insn_range[MAX_ADDR_CMPR_NUM];
+    uint32_t insn_range_num;
     struct trace_data data_range[MAX_DATA_CMPR_NUM];
     uint32_t data_num;
     uint32_t cpuid;
@@ -191,6 +344,23 @@ struct csky_trace_filter {
 };
 
 
+/*
+ * The part of tfilter that generated code depends on. Unused entries are
+ * zero so that two states can be compared with memcmp.
+ */
+struct csky_trace_tb_state {
+    bool enable;
+    bool proxy;
+    bool asid_filter;
+    uint32_t event;
+    uint32_t stsp_num;
+    uint32_t addr_num;
+    uint32_t insn_range_num;
+    struct trace_range stsp_range[MAX_ADDR_CMPR_NUM];
+    struct trace_range addr_range[MAX_ADDR_CMPR_NUM];
+    struct trace_range insn_range[MAX_ADDR_CMPR_NUM];
+};
+
 extern struct csky_trace_filter tfilter;
 extern long long csky_trace_icount;
 extern int waddr_num;
@@ -201,8 +371,13 @@ int traceserver_start(int port, int debug_mode);
 #else
 int traceserver_start(const char *device);
 #endif
+int traceserver_start_file(const char *path);
 void trace_exit_notify(void);
+void csky_trace_resync(void);
 bool gen_mem_trace(void);
+bool gen_mem_trace_inline(void);
+void csky_trace_rec_sync(void);
+void csky_trace_rec_sync_all(void);
 bool gen_tb_trace(void);
 bool gen_x_vf_trace(void);
 bool gen_x_lmul_trace(void);
@@ -218,7 +393,10 @@ void write_trace_8_24(uint8_t type, uint32_t packlen, uint32_t value,
 void trace_termsig_handler(void);
 void trace_send(void);
 void trace_send_immediately(void);
+void trace_count_insns(uint32_t icount, bool traced);
 bool trace_range_test(void *cpu, uint32_t pc, uint32_t smask);
+int csky_trace_tb_class(uint64_t pc, uint64_t *limit);
+void csky_trace_get_tb_state(struct csky_trace_tb_state *st);
 void csky_trace_handle_opts(CPUState *cs, uint32_t cpuid);
 void csky_trace_set_cpu(const char *cpu_type);
 
@@ -9,6 +9,7 @@
 
 #include "qemu/atomic.h"
 #include "qemu/thread.h"
+#include "qemu/rcu.h"
 #include "qemu/interval-tree.h"
 #include "exec/cpu-common.h"
 #include "exec/target_page.h"
@@ -89,6 +90,11 @@ struct TranslationBlock {
     uint16_t size;
     uint16_t icount;
 
+    /* Counted by the TB itself while tb_hot_threshold is set */
+    uint32_t exec_count;
+    /* and how often the conditional branch ending the TB was taken */
+    uint32_t taken_count;
+
     struct tb_tc tc;
 
     /*
@@ -119,6 +125,8 @@ struct TranslationBlock {
 #define TB_JMP_OFFSET_INVALID 0xffff /* indicates no jump generated */
     uint16_t jmp_reset_offset[2]; /* offset of original jump target */
     uint16_t jmp_insn_offset[2];  /* offset of direct jump insn */
+    uint16_t chain_entry;         /* offset past the chained global loads */
+    uint8_t nb_ic;                /* inline caches before the code */
     uintptr_t jmp_target_addr[2]; /* target address */
 
     /*
@@ -146,4 +154,45 @@ struct TranslationBlock {
 /* The alignment given to TranslationBlock during allocation. */
 #define CODE_GEN_ALIGN  16
 
+/*
+ * An indirect jump that leaves the TB flags alone may carry an inline
+ * cache: the generated code compares the new pc against the records in
+ * it and jumps straight to the cached TB, calling the lookup helper only
+ * on a miss.  The caches of a TB sit between the TranslationBlock and its
+ * code, TB_IC_STRIDE bytes each.
+ *
+ * A record is never modified once published except for @gen, so a vCPU
+ * reading it concurrently with a refill sees either the old or the new
+ * record but never half of each; replaced records are freed under RCU.
+ * @gen is the generation of the jump cache the record was filled for (see
+ * tb_ic_gen_ptr), which stops it from outliving a flush of that cache.
+ *
+ * @cs_base and @flags are those the TB was looked up with.  A jump site
+ * only ever sees the flags of its own TB, but the return slot of a call
+ * is filled by whichever return pops it, so returns compare them too.
+ */
+#define TB_IC_WAYS      2
+#define TB_MAX_IC       4
+
+/* Refills after which a polymorphic site is left to the helper */
+#define TB_IC_MAX_FILLS 64
+
+typedef struct TBInlineRecord {
+    struct rcu_head rcu;
+    uint64_t pc;
+    uint64_t cs_base;
+    uint32_t flags;
+    uintptr_t gen;
+    TranslationBlock *tb;
+} TBInlineRecord;
+
+typedef struct TBInlineCache {
+    TBInlineRecord *way[TB_IC_WAYS];
+    uint32_t ways;      /* in use: 1 for the return slot of a call */
+    uint32_t next;      /* the way to refill next */
+    uint32_t fills;
+} TBInlineCache;
+
+#define TB_IC_STRIDE    ROUND_UP(sizeof(TBInlineCache), CODE_GEN_ALIGN)
+
 #endif /* EXEC_TRANSLATION_BLOCK_H */
@@ -20,6 +20,7 @@
 
 #include "qemu/bswap.h"
 #include "exec/cpu_ldst.h"	/* for abi_ptr */
+#include "tcg/tcg.h"
 
 /**
  * gen_intermediate_code
@@ -72,9 +73,21 @@ typedef enum DisasJumpType {
  * @num_insns: Number of translated instructions (including current).
  * @max_insns: Maximum number of instructions to be translated in this TB.
  * @singlestep_enabled: "Hardware" single stepping enabled.
+ * @superblock_jumps: Direct jumps and branches translator_follow_jump()
+ *                    and translator_follow_branch() may still fold into
+ *                    this TB; 0 unless building a superblock.
+ * @pc_end: End of the highest guest instruction translated before the
+ *          last folded jump.
+ * @pc_block: Where translation last went on after a folded jump or
+ *            branch, pc_first before that.
+ * @count_execs: The TB counts its executions and taken branches, to
+ *               become a superblock once hot.
  *
  * Architecture-agnostic disassembly context.
  */
+/* Direct jumps and branches folded into one superblock at most */
+#define SUPERBLOCK_MAX_JUMPS 8
+
 typedef struct DisasContextBase {
     TranslationBlock *tb;
     target_ulong pc_first;
@@ -83,6 +96,10 @@ typedef struct DisasContextBase {
     int num_insns;
     int max_insns;
     bool singlestep_enabled;
+    int superblock_jumps;
+    target_ulong pc_end;
+    target_ulong pc_block;
+    bool count_execs;
     void *host_addr[2];
 } DisasContextBase;
 
@@ -109,6 +126,14 @@ typedef struct DisasContextBase {
  *
  * @disas_log:
  *      Print instruction disassembly to log.
+ *
+ * @superblock:
+ *      Optional.  Return true if this TB may be retranslated as a
+ *      superblock once it gets hot (see tb_hot_threshold): the target
+ *      folds direct jumps with translator_follow_jump(), and may follow
+ *      the hot side of conditional branches with translator_follow_branch(),
+ *      and nothing in the current state, e.g. tracing, depends on the TB
+ *      boundaries.  Targets without the hook never form superblocks.
  */
 typedef struct TranslatorOps {
     void (*init_disas_context)(DisasContextBase *db, CPUState *cpu);
@@ -117,6 +142,7 @@ typedef struct TranslatorOps {
     void (*translate_insn)(DisasContextBase *db, CPUState *cpu);
     void (*tb_stop)(DisasContextBase *db, CPUState *cpu);
     void (*disas_log)(const DisasContextBase *db, CPUState *cpu, FILE *f);
+    bool (*superblock)(DisasContextBase *db, CPUState *cpu);
 } TranslatorOps;
 
 /**
@@ -155,6 +181,49 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
  */
 bool translator_use_goto_tb(DisasContextBase *db, vaddr dest);
 
+/**
+ * translator_follow_jump
+ * @db: Disassembly context
+ * @next: address following the jump instruction
+ * @dest: target pc of the jump
+ *
+ * Return true if, instead of ending the TB, translation may continue at
+ * @dest after an unconditional direct jump.  This is only ever the case
+ * while building a superblock, for a @dest within the page of the TB
+ * and not below its start.  On true the caller must emit no exit for
+ * the jump and arrange for the next instruction to be decoded at @dest.
+ */
+bool translator_follow_jump(DisasContextBase *db, vaddr next, vaddr dest);
+
+/**
+ * translator_follow_branch
+ * @db: Disassembly context
+ * @next: address following the branch instruction
+ * @dest: target pc of the branch when taken
+ * @taken: set to the side translation goes on with
+ *
+ * Return true if, instead of ending the TB, translation may go on along
+ * the side of a conditional direct branch that nearly always ran while
+ * the code was counted towards this superblock.  As for
+ * translator_follow_jump(), a taken side is only followed to a @dest
+ * within the page of the TB and not below its start.  On true the caller
+ * must leave the TB at the other side, without goto_tb since the two
+ * slots are kept for the end of the TB, and go on decoding at @next or
+ * @dest as per @taken.
+ */
+bool translator_follow_branch(DisasContextBase *db, vaddr next, vaddr dest,
+                              bool *taken);
+
+/**
+ * translator_count_taken
+ * @db: Disassembly context
+ *
+ * Emit code that counts the taken side of the conditional branch that
+ * ends the TB, for translator_follow_branch() to learn its bias, if the
+ * TB is counted towards a superblock.  Call it on the taken path only.
+ */
+void translator_count_taken(DisasContextBase *db);
+
 /**
  * translator_io_start
  * @db: Disassembly context
@@ -165,6 +234,36 @@ bool translator_use_goto_tb(DisasContextBase *db, vaddr dest);
  */
 bool translator_io_start(DisasContextBase *db);
 
+/**
+ * translator_lookup_and_goto_ptr
+ * @db: Disassembly context
+ * @dest: the new pc, zero-extended, as already stored in the CPU state
+ *
+ * Like tcg_gen_lookup_and_goto_ptr(), for an indirect jump that leaves
+ * the TB flags unchanged.  With the inline-cache accelerator property the
+ * jump remembers the last TBs it went to and jumps to them directly.
+ */
+void translator_lookup_and_goto_ptr(DisasContextBase *db, TCGv_i64 dest);
+
+/**
+ * translator_push_return
+ * @db: Disassembly context
+ *
+ * Note on the return-address stack that the instruction being translated
+ * is a call, whose return comes back to the instruction after it.
+ */
+void translator_push_return(DisasContextBase *db);
+
+/**
+ * translator_return
+ * @db: Disassembly context
+ * @dest: as for translator_lookup_and_goto_ptr()
+ *
+ * As translator_lookup_and_goto_ptr(), for a return: the destination is
+ * predicted by the call popped from the return-address stack.
+ */
+void translator_return(DisasContextBase *db, TCGv_i64 dest);
+
 /*
  * Translator Load Functions
  *
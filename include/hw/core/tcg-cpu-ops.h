@@ -170,6 +170,18 @@ struct TCGCPUOps {
      */
     bool (*io_recompile_replay_branch)(CPUState *cpu,
                                        const TranslationBlock *tb);
+
+    /**
+     * @translate_ahead_ok: Callback for -accel tcg,translate-threads.
+     *
+     * @tb has just been translated on the thread of @cpu.  Return true
+     * if its direct jump targets may be translated by another thread
+     * while @cpu runs: they must normally be reached with the cs_base
+     * and flags of @tb, and translating them must read nothing from
+     * @cpu or from global state that those do not describe.  Targets
+     * without this hook are never translated ahead.
+     */
+    bool (*translate_ahead_ok)(CPUState *cpu, const TranslationBlock *tb);
 #endif /* !CONFIG_USER_ONLY */
 #endif /* NEED_CPU_H */
 
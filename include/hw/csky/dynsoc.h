@@ -20,6 +20,7 @@
 #ifndef DYNSOC_H
 #define DYNSOC_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define DYNSOC_EMPTY   (0 << 0)
@@ -101,10 +102,46 @@ struct dynsoc_board_info {
     uint64_t                loader_start;
 };
 
+/*
+ * Compiled board description.  cskysim writes the dynsoc_board_info it
+ * parsed from a SoC XML into a file named after the hash of that XML, so
+ * later launches with the same XML skip the parse, and QEMU maps it with
+ * -soc file=<path> instead of attaching to shared memory.
+ */
+#define DYNSOC_BOARD_MAGIC      "DYNSOCB"
+#define DYNSOC_BOARD_VERSION    1
+
+struct dynsoc_board_file {
+    char                        magic[8];
+    uint32_t                    version;
+    uint32_t                    info_size;
+    /* dynsoc_hash() of the XML the board was compiled from */
+    uint64_t                    xml_hash;
+    /* dynsoc_hash() of info */
+    uint64_t                    info_hash;
+    struct dynsoc_board_info    info;
+};
+
+#define DYNSOC_HASH_INIT        0xcbf29ce484222325ULL
+
+/* 64-bit FNV-1a, continuing from @hash */
+static inline uint64_t dynsoc_hash(uint64_t hash, const void *buf,
+                                   size_t len)
+{
+    const uint8_t *p = buf;
+
+    while (len--) {
+        hash = (hash ^ *p++) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
 #if defined(CONFIG_DYNSOC)
 void dynsoc_load_modules(int shmkey);
+void dynsoc_load_file(const char *filename);
 #else
 static inline void dynsoc_load_modules(int shmkey) {}
+static inline void dynsoc_load_file(const char *filename) {}
 #endif
 extern struct dynsoc_board_info *dynsoc_b_info;
 
@@ -0,0 +1,162 @@
+/*
+ * CSKY MCA fixed-point DSP kernels.
+ *
+ * Copyright (c) 2021 C-SKY Microsystems Co., Ltd. All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HW_MISC_CSKY_MCA_SIM_H
+#define HW_MISC_CSKY_MCA_SIM_H
+
+// Bit-width of input & output data
+typedef enum {
+    DRV_ACC_DATA_BITS_8  = 0,
+    DRV_ACC_DATA_BITS_16 = 1,
+    DRV_ACC_DATA_BITS_32 = 2,
+} drv_acc_data_bits_t;
+
+// Shift dir of input & output data
+typedef enum {
+    DRV_ACC_SHIFT_LEFT  = 0,
+    DRV_ACC_SHIFT_RIGHT = 1,
+} drv_acc_shift_dir_t;
+
+// Mode selection of ACC
+typedef enum {
+    DRV_ACC_MODE_SEL_MAC      = 0,
+    DRV_ACC_MODE_SEL_VEC_MUL  = 2,
+    DRV_ACC_MODE_SEL_VEC_ADD  = 3,
+    DRV_ACC_MODE_SEL_SOFTMAX  = 9,
+} drv_acc_mode_sel_t;
+
+typedef enum {
+  THEAD_MCA_SIM_VEC_OP_MUL,
+  THEAD_MCA_SIM_VEC_OP_ADD,
+} csky_mca_sim_vec_op_t;
+
+// ASRC work mode
+typedef enum {
+    DRV_ASRC_MODE_ASRC = 0,
+    DRV_ASRC_MODE_FIR  = 2,
+    DRV_ASRC_MODE_IIR  = 3,
+} drv_asrc_mode_t;
+
+// ASRC source data mode
+typedef enum {
+    DRV_ASRC_DATA_MODE_32_BITS                   = 0,
+    DRV_ASRC_DATA_MODE_24_BITS                   = 1,
+    DRV_ASRC_DATA_MODE_16_BITS_STORED_AS_32_BITS = 2,
+    DRV_ASRC_DATA_MODE_16_BITS                   = 3,
+} drv_asrc_data_mode_t;
+
+// ASRC source data channel number selection
+typedef enum {
+    DRV_ASRC_CH_NUM_SEL_STEREO = 0,
+    DRV_ASRC_CH_NUM_SEL_MONO   = 1,
+} drv_asrc_ch_num_sel_t;
+
+// FIR & IIR coefficient data mode selection
+typedef enum {
+    DRV_FIR_IIR_COEFF_SEL_32_BITS = 0, // Q=1.7.24
+    DRV_FIR_IIR_COEFF_SEL_64_BITS = 1, // Q=1.15.48
+} drv_fir_iir_coeff_sel_t;
+
+static inline
+uint32_t drv_acc_size_of_data_bits(drv_acc_data_bits_t data_bits) {
+    switch (data_bits) {
+    case DRV_ACC_DATA_BITS_8:
+        return 1;
+    case DRV_ACC_DATA_BITS_16:
+        return 2;
+    case DRV_ACC_DATA_BITS_32:
+        return 4;
+    default:
+        assert(0 && "Invalid data bits.");
+        return 0;
+    }
+}
+
+/* Number of output samples per channel csky_mca_sim_asrc() produces. */
+uint32_t csky_mca_sim_asrc_outputs(uint32_t order, uint32_t list_size,
+                                   uint32_t num, const int32_t *coeff,
+                                   uint32_t asrc_pointer);
+
+uint32_t csky_mca_sim_asrc(drv_asrc_data_mode_t data_mode,
+                           drv_asrc_ch_num_sel_t ch_num_sel, uint32_t order,
+                           uint32_t list_size, const void *ch1_data_start,
+                           const void *ch1_data_end, const void *ch2_data_start,
+                           const void *ch2_data_end, const int32_t *coeff,
+                           void *result, uint32_t *asrc_pointer);
+
+uint32_t csky_mca_sim_fir(drv_asrc_data_mode_t data_mode,
+                          drv_fir_iir_coeff_sel_t coeff_sel, uint32_t order,
+                          uint32_t out_loc_sel, const void *data_start,
+                          const void *data_end, const void *coeff,
+                          void *result);
+
+uint32_t csky_mca_sim_iir(drv_asrc_data_mode_t data_mode,
+                          drv_fir_iir_coeff_sel_t coeff_sel,
+                          uint32_t out_loc_sel, const void *data_start,
+                          const void *data_end, const void *coeff, uint32_t yn1,
+                          uint32_t yn2, void *result);
+
+void csky_mca_sim_mac(
+    const void *data_a, const void *data_b, const void *init_data, void *result,
+    uint32_t data_depth, uint32_t data_way, drv_acc_data_bits_t input_data_bits,
+    bool enable_init_data, bool enable_active, bool enable_data_b_loop,
+    bool enable_data_a_loop, uint32_t init_data_shift_bits,
+    drv_acc_shift_dir_t init_data_shift_dir, drv_acc_data_bits_t init_data_bits,
+    uint32_t result_shift_bits, drv_acc_shift_dir_t result_shift_dir,
+    drv_acc_data_bits_t result_bits, uint32_t step);
+
+void csky_mca_sim_softmax(const void *data_a, void *data_b, void *result,
+                          uint32_t data_depth, uint32_t result_shift_bits,
+                          drv_acc_shift_dir_t result_shift_dir,
+                          drv_acc_data_bits_t result_bits);
+
+void csky_mca_sim_vec(csky_mca_sim_vec_op_t vec_op, const void *data_a,
+                      const void *data_b, void *result, uint32_t data_depth,
+                      drv_acc_data_bits_t input_data_bits,
+                      bool enable_vec_scalar, uint32_t result_shift_bits,
+                      drv_acc_shift_dir_t result_shift_dir,
+                      drv_acc_data_bits_t result_bits, uint32_t scalar);
+
+/*
+ * Scalar versions of the fir, mac and vec kernels, kept as the reference
+ * their fast paths must match bit for bit.
+ */
+uint32_t csky_mca_sim_fir_ref(drv_asrc_data_mode_t data_mode,
+                              drv_fir_iir_coeff_sel_t coeff_sel, uint32_t order,
+                              uint32_t out_loc_sel, const void *data_start,
+                              const void *data_end, const void *coeff,
+                              void *result);
+
+void csky_mca_sim_mac_ref(
+    const void *data_a, const void *data_b, const void *init_data, void *result,
+    uint32_t data_depth, uint32_t data_way, drv_acc_data_bits_t input_data_bits,
+    bool enable_init_data, bool enable_active, bool enable_data_b_loop,
+    bool enable_data_a_loop, uint32_t init_data_shift_bits,
+    drv_acc_shift_dir_t init_data_shift_dir, drv_acc_data_bits_t init_data_bits,
+    uint32_t result_shift_bits, drv_acc_shift_dir_t result_shift_dir,
+    drv_acc_data_bits_t result_bits, uint32_t step);
+
+void csky_mca_sim_vec_ref(csky_mca_sim_vec_op_t vec_op, const void *data_a,
+                          const void *data_b, void *result, uint32_t data_depth,
+                          drv_acc_data_bits_t input_data_bits,
+                          bool enable_vec_scalar, uint32_t result_shift_bits,
+                          drv_acc_shift_dir_t result_shift_dir,
+                          drv_acc_data_bits_t result_bits, uint32_t scalar);
+
+#endif
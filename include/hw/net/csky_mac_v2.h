@@ -28,6 +28,9 @@
 #define CSKY_MAC_V2(obj) \
     OBJECT_CHECK(csky_mac_v2_state, (obj), TYPE_CSKY_MAC_V2)
 
+/* descriptors fetched from the ring with one DMA read */
+#define CSKY_MAC_V2_BD_BATCH    16
+
 /* buffer descriptor*/
 typedef struct {
     uint32_t status1;
@@ -71,6 +74,17 @@ typedef struct {
     uint32_t cur_rx_des_addr;
     uint32_t cur_tx_buf_addr;
     uint32_t cur_rx_buf_addr;
+
+    /* the address of the last descriptor of each ring, 0 until it is seen */
+    uint32_t tx_ring_end;
+    uint32_t rx_ring_end;
+    /* RX descriptors fetched ahead, all owned by the MAC */
+    csky_mac_v2_bd rx_bd[CSKY_MAC_V2_BD_BATCH];
+    uint32_t rx_bd_addr[CSKY_MAC_V2_BD_BATCH];
+    unsigned rx_bd_head;
+    unsigned rx_bd_num;
+    /* the receive interrupt watchdog is counting down */
+    bool rx_wdt_running;
 } csky_mac_v2_state;
 
 void csky_mac_v2_create(NICInfo *nd, uint32_t base, qemu_irq irq);
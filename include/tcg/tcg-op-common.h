@@ -285,6 +285,21 @@ void tcg_gen_goto_tb(unsigned idx);
  */
 void tcg_gen_lookup_and_goto_ptr(void);
 
+/**
+ * tcg_gen_lookup_and_goto_ptr_ic() - as tcg_gen_lookup_and_goto_ptr()
+ * @ic: the TBInlineCache to record the TB found in, or NULL
+ *
+ * For the miss path of an inline cache emitted by the translator; the
+ * caller has checked CF_NO_GOTO_PTR.
+ */
+void tcg_gen_lookup_and_goto_ptr_ic(TCGv_ptr ic);
+
+/**
+ * tcg_gen_goto_ptr() - jump to host code
+ * @ptr: host address of the code of a valid TB, or the epilogue
+ */
+void tcg_gen_goto_ptr(TCGv_ptr ptr);
+
 static inline void tcg_gen_plugin_cb_start(unsigned from, unsigned type,
                                            unsigned wr)
 {
@@ -954,6 +969,12 @@ static inline void tcg_gen_brcondi_ptr(TCGCond cond, TCGv_ptr a,
     glue(tcg_gen_brcondi_,PTR)(cond, (NAT)a, b, label);
 }
 
+static inline void tcg_gen_brcond_ptr(TCGCond cond, TCGv_ptr a,
+                                      TCGv_ptr b, TCGLabel *label)
+{
+    glue(tcg_gen_brcond_,PTR)(cond, (NAT)a, (NAT)b, label);
+}
+
 static inline void tcg_gen_ext_i32_ptr(TCGv_ptr r, TCGv_i32 a)
 {
 #if UINTPTR_MAX == UINT32_MAX
@@ -236,6 +236,7 @@ typedef struct TCGPool {
 
 #define TCG_MAX_TEMPS 512
 #define TCG_MAX_INSNS 512
+#define TCG_MAX_CHAIN_GLOBALS 8
 
 /* when the size of the arguments of a called function is smaller than
    this value, they are statically allocated in the TB stack frame */
@@ -498,12 +499,20 @@ struct TCGContext {
     TCGBar guest_mo;
 
     TCGRegSet reserved_regs;
+    /* globals handed between chained TBs in host registers */
+    int nb_chain;
+    int chain_temps[TCG_MAX_CHAIN_GLOBALS];   /* temp indices */
+    TCGReg chain_regs[TCG_MAX_CHAIN_GLOBALS];
     intptr_t current_frame_offset;
     intptr_t frame_start;
     intptr_t frame_end;
     TCGTemp *frame_temp;
 
     TranslationBlock *gen_tb;     /* tb for which code is being generated */
+    TranslationBlock *gen_superblock; /* the hot tb gen_tb replaces */
+    bool gen_ahead;               /* gen_tb is translated ahead of a vCPU */
+    int nb_gen_succ;
+    uint64_t gen_succ[2];         /* goto_tb targets on the page of gen_tb */
     tcg_insn_unit *code_buf;      /* pointer for start of tb */
     tcg_insn_unit *code_ptr;      /* pointer for running end of tb */
 
@@ -757,6 +766,10 @@ void tcg_region_reset_all(void);
 
 size_t tcg_code_size(void);
 size_t tcg_code_capacity(void);
+void tcg_region_code_hint(void *hint);
+bool tcg_region_code_span(void **buf, void **start, void **end,
+                          size_t *total_size);
+void *tcg_region_code_reserve(size_t size);
 
 void tcg_tb_insert(TranslationBlock *tb);
 void tcg_tb_remove(TranslationBlock *tb);
@@ -797,6 +810,8 @@ void tcg_set_frame(TCGContext *s, TCGReg reg, intptr_t start, intptr_t size);
 
 TCGTemp *tcg_global_mem_new_internal(TCGType, TCGv_ptr,
                                      intptr_t, const char *);
+void tcg_enable_chain_globals(void);
+void tcg_chain_global(TCGTemp *ts);
 TCGTemp *tcg_temp_new_internal(TCGType, TCGTempKind);
 TCGv_vec tcg_temp_new_vec(TCGType type);
 TCGv_vec tcg_temp_new_vec_matching(TCGv_vec match);
@@ -70,6 +70,9 @@ char *exec_path;
 char real_exec_path[PATH_MAX];
 
 static bool opt_one_insn_per_tb;
+static uint32_t opt_hot_threshold;
+static bool opt_chain_regs;
+static bool opt_inline_cache;
 static const char *argv0;
 static const char *gdbstub;
 static envlist_t *envlist;
@@ -412,6 +415,24 @@ static void handle_arg_one_insn_per_tb(const char *arg)
     opt_one_insn_per_tb = true;
 }
 
+static void handle_arg_hot_threshold(const char *arg)
+{
+    if (qemu_strtoui(arg, NULL, 0, &opt_hot_threshold)) {
+        fprintf(stderr, "Invalid hot threshold: %s\n", arg);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void handle_arg_chain_regs(const char *arg)
+{
+    opt_chain_regs = true;
+}
+
+static void handle_arg_inline_cache(const char *arg)
+{
+    opt_inline_cache = true;
+}
+
 static void handle_arg_strace(const char *arg)
 {
     enable_strace = true;
@@ -580,6 +601,12 @@ static const struct qemu_argument arg_table[] = {
      "",           "run with one guest instruction per emulated TB"},
     {"singlestep", "QEMU_SINGLESTEP",  false, handle_arg_one_insn_per_tb,
      "",           "deprecated synonym for -one-insn-per-tb"},
+    {"hot-threshold", "QEMU_HOT_THRESHOLD", true, handle_arg_hot_threshold,
+     "count",      "retranslate TBs executed 'count' times as superblocks"},
+    {"chain-regs", "QEMU_CHAIN_REGS",  false, handle_arg_chain_regs,
+     "",           "keep guest registers in host registers across chained TBs"},
+    {"inline-cache", "QEMU_INLINE_CACHE", false, handle_arg_inline_cache,
+     "",           "cache indirect jump and return targets in the code"},
     {"strace",     "QEMU_STRACE",      false, handle_arg_strace,
      "",           "log system calls"},
     {"seed",       "QEMU_RAND_SEED",   true,  handle_arg_seed,
@@ -881,6 +908,12 @@ int main(int argc, char **argv, char **envp)
         accel_init_interfaces(ac);
         object_property_set_bool(OBJECT(accel), "one-insn-per-tb",
                                  opt_one_insn_per_tb, &error_abort);
+        object_property_set_uint(OBJECT(accel), "hot-threshold",
+                                 opt_hot_threshold, &error_abort);
+        object_property_set_bool(OBJECT(accel), "chain-regs",
+                                 opt_chain_regs, &error_abort);
+        object_property_set_bool(OBJECT(accel), "inline-cache",
+                                 opt_inline_cache, &error_abort);
         ac->init_machine(NULL);
     }
     cpu = cpu_create(cpu_type);
@@ -1059,7 +1092,11 @@ int main(int argc, char **argv, char **envp)
     if (trace_opts) {
         str = qemu_opt_get(trace_opts, "port");
         csky_trace_set_cpu(cpu_model);
-        if (str != NULL) {
+        if (qemu_opt_get(trace_opts, "file")) {
+            if (traceserver_start_file(qemu_opt_get(trace_opts, "file"))) {
+                exit(EXIT_FAILURE);
+            }
+        } else if (str != NULL) {
             port = atoi(str);
             if (port) {
                 traceserver_start(port, (gdbstub != 0));
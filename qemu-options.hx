@@ -179,15 +179,18 @@ ERST
 DEF("cpu-prop", HAS_ARG, QEMU_OPTION_cpu_prop,
     "-cpu-prop [pctrace=on|off][,elrw=on|off][,mem_prot=mmu|mpu|no]\n"
     "          [,full_mmu=on|off][,unaligned_access=on|off]\n"
+    "          [,jtlb=entries][,jtlb_ways=ways]\n"
     "                set CSKY CPU's properties\n"
     "                pctrace= default is off, log no more than 511 items\n"
     "                elrw= default is off\n"
     "                mem_prot= ck610/ck807/ck810/ck860/c807/c810/c860 default is mmu, else mpu\n"
     "                full_mmu= default is off\n"
     "                unaligned_access= default is off\n"
+    "                jtlb= default is 0, refill the 2 x 64 entry JTLB\n"
+    "                jtlb_ways= default is 4\n"
     , QEMU_ARCH_CSKY | QEMU_ARCH_RISCV)
 SRST
-``-cpu-prop [pctrace=on|off][,elrw=on|off][,mem_prot=mmu|mpu|no][,full_mmu=on|off][,unaligned_access=on|off]]``
+``-cpu-prop [pctrace=on|off][,elrw=on|off][,mem_prot=mmu|mpu|no][,full_mmu=on|off][,unaligned_access=on|off][,jtlb=entries][,jtlb_ways=ways]]``
     Choose extend CPU properities. Valid options are:
 
     ``pctrace=on|off``
@@ -205,6 +208,16 @@ SRST
 
     ``unaligned_access=on|off``
         This option defines if cpu need support unaligned data access.
+
+    ``jtlb=entries``
+        With ``full_mmu=on``, refill 4K pages into a set associative JTLB
+        of this many entries instead of the 2 x 64 entry architectural
+        one.  Must be a power of 2, default is 0 (off).  Refilled entries
+        are not visible to tlbp/tlbr.  The statistics are reported by the
+        ``query-csky-jtlb`` QMP command.
+
+    ``jtlb_ways=ways``
+        Associativity of the ``jtlb`` JTLB, a power of 2, default is 4.
 ERST
 
 DEF("csky-extend", HAS_ARG, QEMU_OPTION_csky_extend,
@@ -256,6 +269,9 @@ ERST
 
 DEF("csky-trace", HAS_ARG, QEMU_OPTION_csky_trace,
     "-csky-trace port=port[,tb_trace=on|off][,mem_trace=on|off][,start=addr][exit=addr][,proxy_trace=on|off]\n"
+    "                [,async=on|off][,ring=n][,backpressure=block|drop|grow]\n"
+    "                [,file=path][,file_chunk=size][,compress=off|delta|zstd]\n"
+    "                [,inline_mem=on|off]\n"
     "                set CSKY trace properties\n"
     "                port= socket parameter,default is 8810\n"
     "                tb_trace= trace basic block or not, default is on\n"
@@ -264,6 +280,13 @@ DEF("csky-trace", HAS_ARG, QEMU_OPTION_csky_trace,
     "                auto_trace= auto gen trace or not, default is on\n"
     "                start= start trace from addr, default is the entry point\n"
     "                exit= exit trace from addr\n"
+    "                file= write trace to an indexed file instead of a port\n"
+    "                file_chunk= size of the mapped file window, default is 64M\n"
+    "                compress= stream compression, default is off\n"
+    "                inline_mem= record ld/st in generated code, default is off\n"
+    "                async= send trace from a writer thread, default is off\n"
+    "                ring= buffers per vCPU in async mode, default is 16\n"
+    "                backpressure= policy when the ring is full, default is block\n"
     , QEMU_ARCH_CSKY | QEMU_ARCH_RISCV)
 SRST
 ``-csky-trace port=@var{port}[,tb_trace=on|off][,mem_trace=on|off][,auto_trace=on|off]``
@@ -278,15 +301,49 @@ Choose extend CSKY trace properities. Valid options are:
 
     ``mem_trace=on|off``
         This option defines if must not trace ld/st operations.
+
+    ``file=@var{path}``
+        Write the trace to @var{path} instead of serving it on a port. The
+        file holds the same packet stream followed by an index of seek
+        points keyed by instruction count, see ``scripts/csky-trace-file.py``.
+
+    ``file_chunk=@var{size}``
+        Size of the window of the trace file that is mapped at a time.
+
+    ``compress=off|delta|zstd``
+        Compress the packets after the trace header. ``delta`` sends
+        instruction and data addresses as varint encoded differences,
+        ``zstd`` additionally compresses every buffer with zstd. The codec
+        is announced in the config word of the header.
+
+    ``inline_mem=on|off``
+        Store ld/st trace records into a per-vCPU buffer from the
+        generated code and only call out to the trace helpers when it is
+        full or a packet of that vCPU is about to be sent. Only used when
+        the data filter does not depend on run-time state.
+
+    ``async=on|off``
+        Hand full trace buffers to a dedicated writer thread instead of
+        sending them from the vCPU thread.
+
+    ``ring=@var{n}``
+        Number of trace buffers queued per vCPU in async mode, must be a
+        power of 2.
+
+    ``backpressure=block|drop|grow``
+        What a vCPU does when its ring is full: wait for the writer,
+        discard the buffer, or keep appending to the current buffer.
 ERST
 
 DEF("soc", HAS_ARG, QEMU_OPTION_soc,
     "-soc shm=on|off[,shmkey=key][,xmlpath=path]\n"
+    "-soc file=path\n"
     "                -soc loads all CSKY's modules, \n"
     "                setting shm= default is on.\n"
     "                setting shmkey= to connect to shm, used when shm=on, key range 0-9999\n"
     "                setting xmlpath= to point out where xml file is.[have not implemented]\n"
     "                Note: if setting shm=on ignores xmlpath= .\n"
+    "                setting file= to map a board description compiled by cskysim\n"
     , QEMU_ARCH_CSKY | QEMU_ARCH_RISCV)
 SRST
 ``-soc shm=on|off[,xmlpath=@var{path}]``
@@ -298,6 +355,11 @@ Loads all modules, and using shm to point out how to using modules. Valid option
 
     ``xmlpath=@var{path}``
         This option deparse xml to get a description to orgnize the dynsoc.
+
+    ``file=@var{path}``
+        Maps a board description that cskysim compiled from the SoC xml
+        and cached, instead of reading it from shared memory.  Takes
+        precedence over ``shm=on``.
 ERST
 
 DEF("accel", HAS_ARG, QEMU_OPTION_accel,
@@ -305,10 +367,17 @@ DEF("accel", HAS_ARG, QEMU_OPTION_accel,
     "                select accelerator (kvm, xen, hax, hvf, nvmm, whpx or tcg; use 'help' for a list)\n"
     "                igd-passthru=on|off (enable Xen integrated Intel graphics passthrough, default=off)\n"
     "                kernel-irqchip=on|off|split controls accelerated irqchip support (default=on)\n"
+    "                hot-threshold=n (retranslate TBs run n times as superblocks, default 0=off)\n"
+    "                chain-regs=on|off (keep guest registers in host registers across chained TBs, default=off)\n"
+    "                inline-cache=on|off (cache indirect jump and return targets in the code, default=off)\n"
+    "                jmp-cache-bits=n (log2 of the per-vCPU TB jump cache size, default=12)\n"
+    "                jmp-cache-max-bits=n (grow the jump cache up to 2^n entries on misses, default=12)\n"
     "                kvm-shadow-mem=size of KVM shadow MMU in bytes\n"
     "                one-insn-per-tb=on|off (one guest instruction per TCG translation block)\n"
     "                split-wx=on|off (enable TCG split w^x mapping)\n"
+    "                tb-cache=file (TCG translated code persisted across runs)\n"
     "                tb-size=n (TCG translation block cache size)\n"
+    "                translate-threads=n (threads translating jump targets ahead of the vCPUs, default 0=off)\n"
     "                dirty-ring-size=n (KVM dirty ring GFN count, default 0)\n"
     "                notify-vmexit=run|internal-error|disable,notify-window=n (enable notify VM exit and set notify window, x86 only)\n"
     "                thread=single|multi (enable multi-threaded TCG)\n", QEMU_ARCH_ALL)
@@ -325,6 +394,45 @@ SRST
         integrated graphics devices can be passed through to the guest
         (default=off)
 
+    ``hot-threshold=n``
+        Makes TCG count how often each translation block runs and,
+        once a block has run ``n`` times, translate it again as a
+        superblock that follows direct jumps inside its guest page
+        instead of ending at them, so that guest registers stay in host
+        registers across the former block boundaries.  On riscv the
+        superblock also goes on past conditional branches along the side
+        that was taken at least 7 times out of 8 while the blocks were
+        counted, and leaves at the other side.  Only targets that support
+        it (riscv and C-SKY ABIv2) form superblocks, and not with icount.
+        The default of 0 disables this.
+
+    ``chain-regs=on|off``
+        Keeps a few frequently used guest registers in host registers
+        when one translation block jumps directly to the next, so the
+        next block does not load them again from the CPU state.  The
+        registers are still stored back at the end of each block.
+        Targets choose which registers take part (riscv: a0-a5 and sp,
+        C-SKY: the first argument registers and sp); others ignore it.
+        The default is off.
+
+    ``inline-cache=on|off``
+        Gives indirect jumps that targets mark as such (riscv: jalr,
+        C-SKY: jmp, jsr and their relatives) a small cache of the blocks
+        they recently went to, checked by the translated code before it
+        calls out to look the destination up.  Returns are predicted from
+        a per-vCPU stack of the most recent calls.  The default is off.
+
+    ``jmp-cache-bits=n``
+        Sets the number of entries of each vCPU's translation block
+        jump cache to 2^n, between 8 and 20.  The default is 12.
+
+    ``jmp-cache-max-bits=n``
+        Lets each vCPU's jump cache double in size, up to 2^n entries,
+        while more than one lookup in sixteen misses it and has to
+        search the global translation block table.  The default of 12
+        keeps the size fixed at ``jmp-cache-bits``.  Hit and miss
+        counts per vCPU are shown by ``info jit``.
+
     ``kernel-irqchip=on|off|split``
         Controls KVM in-kernel irqchip support. The default is full
         acceleration of the interrupt controllers. On x86, split irqchip
@@ -347,9 +455,34 @@ SRST
         such a case this will default on. On other operating systems, this
         will default off, but one may enable this for testing or debugging.
 
+    ``tb-cache=file``
+        Loads translated code from ``file`` at startup and writes the
+        translation block cache back to it on exit, so that a guest
+        booting the same images again skips most of the translation.
+        A block is only reused if the guest code it was made from is
+        unchanged; a file written by a different QEMU binary (as told by
+        its GNU build ID), CPU configuration or TCG code buffer layout is
+        ignored and replaced.  The code is reloaded at the address it was
+        generated at: the code buffer is mapped at a fixed address on
+        64-bit hosts, and this needs a single TCG thread and
+        ``split-wx=off``.  A position independent QEMU must also run with
+        address space randomization disabled (e.g. ``setarch -R``; cskysim
+        does this itself when the option is present), otherwise the
+        option is ignored with a warning.
+
     ``tb-size=n``
         Controls the size (in MiB) of the TCG translation block cache.
 
+    ``translate-threads=n``
+        Starts ``n`` threads, up to 32, that translate the direct jump
+        targets of each block a vCPU translates, so that the vCPU finds
+        them translated when it gets there instead of stopping to do it
+        itself.  Only targets on the same guest page are translated.
+        This needs ``thread=multi`` and a target that supports it
+        (C-SKY and RISC-V, with their tracing options off); ``info jit``
+        shows how many blocks were translated ahead and how long the
+        vCPUs still spent translating.  The default of 0 disables this.
+
     ``thread=single|multi``
         Controls number of TCG threads. When the TCG is multi-threaded
         there will be one thread per vCPU therefore taking advantage of
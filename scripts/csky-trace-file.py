@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# Locate an instruction in a trace file written by -csky-trace file=
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, see <http://www.gnu.org/licenses/>.
+
+import argparse
+import mmap
+import struct
+import sys
+
+# Keep in sync with include/exec/tracestub.h
+TRACE_FILE_MAGIC = 0x31435254594b5343
+TRACE_FILE_VERSION = 1
+HEADER_LEN = 4096
+HEADER = struct.Struct("<QIIQQQ")
+ENTRY = struct.Struct("<QQ")
+
+
+class TraceFile(object):
+    def __init__(self, path):
+        self.f = open(path, "rb")
+        self.map = mmap.mmap(self.f.fileno(), 0, access=mmap.ACCESS_READ)
+        (magic, version, self.chunk_size, self.data_end,
+         self.index_offset, self.index_num) = HEADER.unpack_from(self.map, 0)
+        if magic != TRACE_FILE_MAGIC or version != TRACE_FILE_VERSION:
+            raise ValueError("%s: not a csky trace file" % path)
+        # QEMU did not close the file, the stream is there but no index
+        self.complete = self.index_offset != 0
+
+    def entry(self, i):
+        return ENTRY.unpack_from(self.map, self.index_offset + i * ENTRY.size)
+
+    def seek(self, icount):
+        """Return (icount, offset) of the last seek point at or before icount"""
+        lo, hi = 0, self.index_num
+        while lo < hi:
+            mid = (lo + hi) // 2
+            if self.entry(mid)[0] <= icount:
+                lo = mid + 1
+            else:
+                hi = mid
+        if lo == 0:
+            return (0, HEADER_LEN)
+        return self.entry(lo - 1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=
+                                     "Find the seek point for an instruction")
+    parser.add_argument("file", help="trace file")
+    parser.add_argument("icount", type=int, nargs="?",
+                        help="instruction number to position at")
+    parser.add_argument("-d", "--dump", metavar="FILE",
+                        help="copy the stream from the seek point to FILE")
+    args = parser.parse_args()
+
+    tf = TraceFile(args.file)
+    if not tf.complete:
+        print("%s: not closed cleanly, no seek points" % args.file,
+              file=sys.stderr)
+    if args.icount is None:
+        print("stream: %d bytes, %d seek points" %
+              (tf.data_end - HEADER_LEN, tf.index_num))
+        for i in range(tf.index_num):
+            print("%16d %16d" % tf.entry(i))
+        return 0
+
+    icount, offset = tf.seek(args.icount)
+    print("icount %d starts at offset %d" % (icount, offset))
+    if args.dump:
+        with open(args.dump, "wb") as out:
+            out.write(tf.map[offset:tf.data_end])
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+#
+# Benchmark the TB shaping options on tests/tcg/multiarch/loop-bench
+#
+# Runs loop-bench under linux-user QEMU once plainly and once with each of
+# -hot-threshold, -chain-regs and -inline-cache, as check-tcg's
+# run-loop-bench and run-loop-bench-{hot,chain,ic} do, and reports the
+# wall time of each run next to the throughput loop-bench prints for each
+# of its kernels.  Columns are guests, so riscv64 and csky can be compared
+# in one table.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+
+import sys
+import re
+import subprocess
+import time
+
+import simplebench
+from results_to_text import results_to_text
+
+
+# Same options as loop-bench-*-opts in tests/tcg/multiarch/Makefile.target
+CASES = {
+    'plain': [],
+    'hot': ['-hot-threshold', '1000'],
+    'chain': ['-chain-regs'],
+    'ic': ['-inline-cache'],
+}
+
+# "kernel: 12.34 Munits/s"
+KERNEL_LINE = re.compile(r'^(.+): (\d+\.\d+) (\S+/s)$')
+
+
+def bench_func(env, case):
+    cmd = [env['qemu-binary']] + env['qemu-args'] + CASES[case['id']] + \
+        [env['loop-bench']]
+
+    start = time.time()
+    p = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                       universal_newlines=True, check=False)
+    seconds = time.time() - start
+
+    if p.returncode:
+        return {'error': 'loop-bench failed: ' + p.stdout.strip()}
+
+    kernels = {}
+    for line in p.stdout.splitlines():
+        m = KERNEL_LINE.match(line.strip())
+        if m:
+            kernels[m.group(1)] = (float(m.group(2)), m.group(3))
+
+    return {'seconds': seconds, 'kernels': kernels}
+
+
+def kernels_to_text(result):
+    """Average throughput of each kernel, one table per guest."""
+    lines = []
+    for env in result['envs']:
+        lines.append(f'{env["id"]} throughput:')
+        names = []
+        for case in result['cases']:
+            for r in result['tab'][case['id']][env['id']]['runs']:
+                for k in r.get('kernels', {}):
+                    if k not in names:
+                        names.append(k)
+
+        lines.append('{:<20} '.format('') +
+                     ''.join('{:>14}'.format(c['id'])
+                             for c in result['cases']))
+        for name in names:
+            cells = []
+            unit = ''
+            for case in result['cases']:
+                runs = result['tab'][case['id']][env['id']]['runs']
+                vals = [r['kernels'][name] for r in runs
+                        if name in r.get('kernels', {})]
+                if vals:
+                    unit = vals[0][1]
+                    cells.append('{:>14.2f}'.format(
+                        sum(v[0] for v in vals) / len(vals)))
+                else:
+                    cells.append('{:>14}'.format('--'))
+            lines.append('{:<20} {} {}'.format(name, ''.join(cells), unit))
+        lines.append('')
+    return '\n'.join(lines)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print(f'USAGE: {sys.argv[0]} NAME:QEMU:LOOP_BENCH[:QEMU_ARG...]... '
+              '[-c CASE,...]')
+        print('e.g. riscv64:build/qemu-riscv64:'
+              'build/tests/tcg/riscv64-linux-user/loop-bench')
+        print('     csky:build/qemu-cskyv2:'
+              'build/tests/tcg/cskyv2-linux-user/loop-bench:-cpu:ck860')
+        print('CASE is one of ' + ', '.join(CASES) + ' (default: all)')
+        exit(1)
+
+    args = sys.argv[1:]
+    cases = list(CASES)
+    if '-c' in args:
+        i = args.index('-c')
+        cases = args[i + 1].split(',')
+        del args[i:i + 2]
+
+    test_envs = []
+    for spec in args:
+        name, qemu, loop_bench, *qemu_args = spec.split(':')
+        test_envs.append({
+            'id': name,
+            'qemu-binary': qemu,
+            'loop-bench': loop_bench,
+            'qemu-args': qemu_args,
+        })
+
+    test_cases = [{'id': c} for c in cases]
+
+    result = simplebench.bench(bench_func, test_envs, test_cases, count=5)
+    print(results_to_text(result))
+    print()
+    print(kernels_to_text(result))
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+#
+# Benchmark translator threads on a boot storm
+#
+# Every hart of tests/tcg/riscv64/boot-storm runs the same fresh code at
+# once, so the run is nearly all translation by vCPUs that contend for
+# the same pages.  Each run boots it under -enable-sync-profile and reports
+# the time from the start of the guest until the last hart is done, the
+# total time QEMU's threads waited on mutexes, and the call sites that
+# waited the most ("info sync-profile"), next to the translator thread
+# counters of "info jit".
+#
+# Rows are translate-threads values; 0 does not pass the option, so a
+# binary without translator threads can be given as the "before" column.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+
+import sys
+import os
+import re
+
+import simplebench
+from results_to_text import results_to_text
+
+sys.path.append(os.path.join(os.path.dirname(__file__), '..', '..', 'python'))
+from qemu.machine import QEMUMachine
+
+
+# boot-storm is built for this many harts, see NHARTS there
+HARTS = 4
+
+# The tail of a report line: call site, wait time (s), count, average (us)
+QSP_LINE = re.compile(r'(\S+:\d+)\s+(\d+\.\d+)\s+(\d+)\s+(\d+\.\d+)$')
+
+
+def hmp(vm, command):
+    return vm.qmp('human-monitor-command', **{'command-line': command})
+
+
+def event_seconds(event):
+    return event['timestamp']['seconds'] + \
+        event['timestamp']['microseconds'] / 1000000
+
+
+def sync_profile(vm):
+    """Return the total wait and the five call sites that waited most."""
+    res = hmp(vm, 'info sync-profile 1000')
+    if 'return' not in res:
+        raise RuntimeError('info sync-profile failed: ' + str(res))
+
+    sites = []
+    for line in res['return'].splitlines():
+        m = QSP_LINE.search(line.strip())
+        if m:
+            sites.append((float(m.group(2)), m.group(1)))
+    sites.sort(reverse=True)
+    return sum(s[0] for s in sites), sites[:5]
+
+
+def bench_func(env, case):
+    accel = 'tcg,thread=multi'
+    if case['threads']:
+        accel += ',translate-threads={}'.format(case['threads'])
+
+    vm = QEMUMachine(env['qemu-binary'], args=[
+        '-M', 'virt', '-smp', str(HARTS), '-accel', accel,
+        '-enable-sync-profile', '-no-shutdown', '-S',
+        '-device', 'loader,file=' + env['boot-storm']])
+
+    try:
+        vm.launch()
+    except Exception as e:
+        return {'error': 'qemu failed: ' + str(e)}
+
+    try:
+        vm.qmp('cont')
+        start = vm.event_wait('RESUME')
+        end = vm.event_wait('SHUTDOWN', timeout=600)
+        if end is None:
+            return {'error': 'boot-storm did not finish'}
+
+        wait, sites = sync_profile(vm)
+        jit = hmp(vm, 'info jit').get('return', '')
+    except Exception as e:
+        return {'error': 'boot-storm failed: ' + str(e)}
+    finally:
+        vm.shutdown()
+
+    return {
+        'seconds': event_seconds(end) - event_seconds(start),
+        'lock-wait': wait,
+        'sites': ['{:.5f}s {}'.format(*s) for s in sites],
+        'translate-ahead': [line for line in jit.splitlines()
+                            if line.startswith(('queued', 'translated',
+                                                'already', 'dropped',
+                                                'time in', 'vCPU'))],
+    }
+
+
+def lock_wait_to_text(result):
+    """Average lock wait of each cell, in the layout of results_to_text."""
+    lines = ['Lock wait (s, sync profiler total):']
+    for case in result['cases']:
+        cells = []
+        for env in result['envs']:
+            runs = result['tab'][case['id']][env['id']]['runs']
+            waits = [r['lock-wait'] for r in runs if 'lock-wait' in r]
+            cells.append('{:.4f}'.format(sum(waits) / len(waits))
+                         if waits else '--')
+        lines.append('{:<12} {}'.format(case['id'], '  '.join(cells)))
+    return '\n'.join(lines)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 3:
+        print(f'USAGE: {sys.argv[0]} BOOT_STORM QEMU_BINARY... '
+              '[-t THREADS,...]')
+        print('BOOT_STORM is tests/tcg/riscv64-softmmu/boot-storm of a '
+              'check-tcg build,')
+        print('each QEMU_BINARY a qemu-system-riscv64 to compare, e.g. '
+              'before:/path after:/path')
+        exit(1)
+
+    args = sys.argv[1:]
+    threads = [0, 2, 4]
+    if '-t' in args:
+        i = args.index('-t')
+        threads = [int(t) for t in args[i + 1].split(',')]
+        del args[i:i + 2]
+
+    test_envs = []
+    for b in args[1:]:
+        name, _, path = b.rpartition(':')
+        test_envs.append({
+            'id': name or path,
+            'qemu-binary': path,
+            'boot-storm': args[0],
+        })
+
+    test_cases = [{'id': f'threads={t}', 'threads': t} for t in threads]
+
+    result = simplebench.bench(bench_func, test_envs, test_cases, count=5)
+    print(results_to_text(result))
+    print()
+    print(lock_wait_to_text(result))
@@ -293,6 +293,15 @@ static QemuOptsList qemu_cpu_prop_opts = {
             .type = QEMU_OPT_BOOL,
             .help = "cpu support unaligned data access",
         },
+        {
+            .name = "jtlb",
+            .type = QEMU_OPT_NUMBER,
+            .help = "entries of the set associative refill JTLB, 0 for none",
+        },{
+            .name = "jtlb_ways",
+            .type = QEMU_OPT_NUMBER,
+            .help = "associativity of the refill JTLB",
+        },
         { /* end of list */ }
     },
 };
@@ -358,6 +367,10 @@ static QemuOptsList qemu_soc_opts = {
             .name = "shmkey",
             .type = QEMU_OPT_NUMBER,
             .help = "share memory key, range [0~9999]",
+        },{
+            .name = "file",
+            .type = QEMU_OPT_STRING,
+            .help = "compiled board description written by cskysim",
         },
         { /* end of list */ }
     },
@@ -2891,7 +2904,9 @@ void qemu_init(int argc, char **argv)
                    exit(1);
                }
 
-               if (qemu_opt_get_bool(opts, "shm", false)) {
+               if (qemu_opt_get(opts, "file")) {
+                   dynsoc_load_file(qemu_opt_get(opts, "file"));
+               } else if (qemu_opt_get_bool(opts, "shm", false)) {
                    int shmkey = qemu_opt_get_number(opts, "shmkey", -1);
                    if (shmkey == -1) {
                        error_report("shared memory(shm) connect fail");
@@ -3802,7 +3817,11 @@ void qemu_init(int argc, char **argv)
     if (trace_opts) {
         str = qemu_opt_get(trace_opts, "port");
         csky_trace_set_cpu(current_machine->cpu_type);
-        if (str != NULL) {
+        if (qemu_opt_get(trace_opts, "file")) {
+            if (traceserver_start_file(qemu_opt_get(trace_opts, "file"))) {
+                exit(1);
+            }
+        } else if (str != NULL) {
                 if (atoi(str)) {
                     traceserver_start(str);
                 } else {
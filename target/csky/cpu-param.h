@@ -29,6 +29,16 @@
 #else
 #define TARGET_VIRT_ADDR_SPACE_BITS 32
 #endif
+
+/*
+ * ABIv1 has no barrier instruction other than sync, and its SMP parts
+ * never reorder loads, so only allow store-to-load reordering.  ABIv2
+ * code is expected to use sync and bar.
+ */
+#ifdef TARGET_CSKYV1
+#define TCG_GUEST_DEFAULT_MO      (TCG_MO_ALL & ~TCG_MO_ST_LD)
+#else
 #define TCG_GUEST_DEFAULT_MO      (0)
+#endif
 
 #endif
@@ -27,6 +27,7 @@
 #include "gdbstub/helpers.h"
 #include "qemu/config-file.h"
 #include "qemu/error-report.h"
+#include "qemu/host-utils.h"
 
 static void csky_cpu_set_pc(CPUState *cs, vaddr value)
 {
@@ -113,6 +114,12 @@ static inline void csky_clear_feature(CPUCSKYState *env, uint64_t feature)
     env->features &= ~feature;
 }
 
+#ifndef CONFIG_USER_ONLY
+/* -cpu-prop jtlb=, shared by all the cpus */
+static uint32_t csky_jtlb_entries;
+static uint32_t csky_jtlb_ways;
+#endif
+
 static void csky_cpu_handle_opts(CPUCSKYState *env)
 {
     QemuOptsList *ret;
@@ -177,6 +184,19 @@ static void csky_cpu_handle_opts(CPUCSKYState *env)
             if (b) {
                 csky_set_feature(env, UNALIGNED_ACCESS);
             }
+
+            csky_jtlb_entries = qemu_opt_get_number(opts, "jtlb", 0);
+            csky_jtlb_ways = qemu_opt_get_number(opts, "jtlb_ways", 4);
+            if (csky_jtlb_entries != 0 &&
+                (!is_power_of_2(csky_jtlb_entries) ||
+                 !is_power_of_2(csky_jtlb_ways) || csky_jtlb_ways > 128 ||
+                 csky_jtlb_entries < csky_jtlb_ways ||
+                 csky_jtlb_entries > 65536)) {
+                error_report("jtlb= and jtlb_ways= must be powers of 2, "
+                             "with jtlb_ways <= 128 and "
+                             "jtlb_ways <= jtlb <= 65536");
+                exit(1);
+            }
         }
     }
 #endif
@@ -345,6 +365,8 @@ static void csky_cpu_reset(DeviceState *dev)
 #endif
 
     csky_nommu_init(env);
+    memset(env->asid_tag, 0xff, sizeof(env->asid_tag));
+    csky_asid_switch(env);
 #endif
 
     if (csky_has_feature(env, DENORMALIZE)) {
@@ -368,6 +390,9 @@ static void csky_cpu_reset(DeviceState *dev)
         csky_trace_handle_opts(cs, env->cpuid);
         csky_handle_opts = 1;
     }
+#ifndef CONFIG_USER_ONLY
+    csky_jtlb_init(env, csky_jtlb_entries, csky_jtlb_ways);
+#endif
 }
 
 static void csky_cpu_disas_set_info(CPUState *s, disassemble_info *info)
@@ -1169,6 +1194,25 @@ static void csky_restore_state_to_opc(CPUState *cs,
     env->pc = data[0];
 }
 
+#ifndef CONFIG_USER_ONLY
+static bool csky_cpu_translate_ahead_ok(CPUState *cs,
+                                        const TranslationBlock *tb)
+{
+    CPUCSKYState *env = cs->env_ptr;
+
+    /*
+     * Both translators read the tracing options from here, not the flags;
+     * everything else they take from @tb or from the CPU configuration.
+     * Under PSR.TM every instruction traps, and nothing is worth it.
+     */
+    return !CSKY_TBFLAG_PSR_TM(tb->flags) &&
+           !tfilter.enable && !tfilter.proxy &&
+           !(cs->csky_trace_features & CSKY_TRACE) &&
+           env->jcount_start == 0 && env->tb_trace == 0 &&
+           env->pctrace == 0 && env->exit_addr == 0;
+}
+#endif /* !CONFIG_USER_ONLY */
+
 #include "hw/core/tcg-cpu-ops.h"
 
 static struct TCGCPUOps csky_tcg_ops = {
@@ -1183,6 +1227,7 @@ static struct TCGCPUOps csky_tcg_ops = {
     .cpu_exec_interrupt = csky_cpu_exec_interrupt,
     .do_interrupt = csky_cpu_do_interrupt,
     .do_unaligned_access = csky_cpu_do_unaligned_access,
+    .translate_ahead_ok = csky_cpu_translate_ahead_ok,
 #endif /* !CONFIG_USER_ONLY */
 };
 
@@ -1250,6 +1295,7 @@ static void register_cpu_type(const CSKYCPUInfo *info)
 {
     TypeInfo type_info = {
         .parent = TYPE_CSKY_CPU,
+        .instance_align = __alignof__(CSKYCPU),
         .instance_init = info->instance_init,
     };
 
@@ -1262,6 +1308,7 @@ static const TypeInfo csky_cpu_type_info = {
     .name = TYPE_CSKY_CPU,
     .parent = TYPE_CPU,
     .instance_size = sizeof(CSKYCPU),
+    .instance_align = __alignof__(CSKYCPU),
     .instance_init = csky_cpu_initfn,
     .abstract = true,
     .class_size = sizeof(CSKYCPUClass),
@@ -87,6 +87,26 @@ struct CSKYMMU {
    uint32_t msa1;       /* CR31 */
 };
 
+/* Data trace record stored by generated code, see gen_trace_rec */
+#define CSKY_TRACE_REC_NUM  256
+
+struct CSKYTraceRec {
+    uint32_t type;      /* enum mem_ldst_type */
+    uint32_t pc;
+    uint32_t last_pc;
+    uint32_t addr;
+    uint32_t value;
+};
+
+/*
+ * The softmmu TLB is tagged with the ASID: each of the CSKY_ASID_SLOTS
+ * most recently used ASIDs has a user and a supervisor mmu index, so an
+ * ASID switch or invalidation only touches the TLB of that ASID.
+ */
+#define CSKY_ASID_SLOTS             (NB_MMU_MODES / 2)
+#define CSKY_MMU_IDX(slot, super)   (((slot) << 1) | (super))
+#define CSKY_MMU_IDX_ALL            ((1 << NB_MMU_MODES) - 1)
+
 /* CSKY CPUCSKYState definition */
 struct CPUArchState {
     uint32_t regs[32];
@@ -212,7 +232,7 @@ struct CPUArchState {
             int16_t  dsps[8];
             uint8_t  udspc[16];
             int8_t   dspc[16];
-        } reg[32];
+        } reg[32] QEMU_ALIGNED(16);     /* expanded with gvec */
         uint32_t fid;
         uint32_t fcr;
         uint32_t fesr;
@@ -270,6 +290,10 @@ struct CPUArchState {
 #if !defined(CONFIG_USER_ONLY)
     struct CPUCSKYTLBContext *tlb_context;
 #endif
+    /* softmmu TLB of the current ASID and the ASID owning each one */
+    uint32_t asid_slot;
+    uint32_t asid_victim;
+    uint32_t asid_tag[CSKY_ASID_SLOTS];
 
     uint32_t tls_value;
     bool in_reset;
@@ -291,6 +315,7 @@ struct CPUArchState {
     void *mptimerdev;
     uint32_t mmu_default;
     uint32_t full_mmu;
+    struct CSKYJTLB *jtlb;
 
     uint32_t tb_trace;
     uint32_t jcount_enable;
@@ -307,6 +332,10 @@ struct CPUArchState {
     struct CPUArchState *next_cpu;
     uint32_t tb_count;
     uint32_t exit_addr;
+
+    /* byte offset of the next free record in trace_rec */
+    uint32_t trace_rec_pos;
+    struct CSKYTraceRec trace_rec[CSKY_TRACE_REC_NUM];
 };
 
 /**
@@ -344,6 +373,9 @@ bool csky_cpu_tlb_fill(CPUState *cs, vaddr address, int size,
 hwaddr csky_cpu_get_phys_page_debug(CPUState *env, vaddr addr);
 bool csky_cpu_exec_interrupt(CPUState *cs, int interrupt_request);
 void csky_nommu_init(CPUCSKYState *env);
+void csky_jtlb_init(CPUCSKYState *env, uint32_t entries, uint32_t ways);
+void csky_jtlb_flush(CPUCSKYState *env);
+void csky_asid_switch(CPUCSKYState *env);
 void csky_cpu_dump_state(CPUState *cs, FILE *f, int flags);
 target_ulong csky_do_semihosting(CPUCSKYState *env);
 
@@ -400,6 +432,8 @@ void csky_nvic_complete_irq(void *opaque);
     (((flag) & CSKY_TBFLAG_PSR_TM_MASK) >> CSKY_TBFLAG_PSR_TM_SHIFT)
 #define CSKY_TBFLAG_PSR_T(flag)    \
     (((flag) & CSKY_TBFLAG_PSR_T_MASK) >> CSKY_TBFLAG_PSR_T_SHIFT)
+#define CSKY_TBFLAG_IDLY4(flag)    \
+    (((flag) & CSKY_TBFLAG_IDLY4_MASK) >> CSKY_TBFLAG_IDLY4_SHIFT)
 
 /* CPU id */
 #define CSKY_CPUID_CK510        0x00000000
@@ -552,7 +586,7 @@ static inline uint32_t csky_env_get_asid(CPUCSKYState *env)
 
 static inline int cpu_mmu_index(CPUCSKYState *env, bool ifetch)
 {
-    return PSR_S(env->cp0.psr);
+    return CSKY_MMU_IDX(env->asid_slot, PSR_S(env->cp0.psr));
 }
 
 static inline void cpu_get_tb_cpu_state(CPUCSKYState *env, vaddr *pc,
@@ -561,7 +595,8 @@ static inline void cpu_get_tb_cpu_state(CPUCSKYState *env, vaddr *pc,
     uint32_t mask;
     CPUState *cpu = env_cpu(env);
     *pc = env->pc;
-    *cs_base = 0;
+    /* the softmmu TLB generated code accesses, see CSKY_MMU_IDX */
+    *cs_base = env->asid_slot;
 
     if (env->features & CPU_C860) {
         mask = CSKY_MP_ASID_MASK;
@@ -0,0 +1,50 @@
+/*
+ * QEMU C-SKY CPU (monitor definitions)
+ *
+ * Copyright (c) 2021 C-SKY Microsystems Co., Ltd. All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qapi/qapi-commands-machine-target.h"
+#include "hw/core/cpu.h"
+#include "cpu.h"
+#include "translate.h"
+
+CskyJtlbInfoList *qmp_query_csky_jtlb(Error **errp)
+{
+    CskyJtlbInfoList *head = NULL, **tail = &head;
+    CPUState *cs;
+
+    CPU_FOREACH(cs) {
+        CSKYJTLB *jt = csky_cpu_get_env(cs)->jtlb;
+        CskyJtlbInfo *info;
+
+        if (jt == NULL) {
+            continue;
+        }
+        info = g_new0(CskyJtlbInfo, 1);
+        info->cpu_index = cs->cpu_index;
+        info->entries = jt->sets * jt->ways;
+        info->ways = jt->ways;
+        info->hit = jt->hit;
+        info->walk_hit = jt->walk_hit;
+        info->miss = jt->miss;
+        info->refill = jt->refill;
+        QAPI_LIST_APPEND(tail, info);
+    }
+
+    return head;
+}
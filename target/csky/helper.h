@@ -26,6 +26,8 @@ DEF_HELPER_2(tag_pctrace, void, env, i32)
 DEF_HELPER_3(jcount, void, env, i32, i32)
 DEF_HELPER_3(csky_trace_icount, void, env, i32, i32)
 DEF_HELPER_2(trace_tb_start, void, env, i32)
+DEF_HELPER_2(trace_tb_start_fast, void, env, i32)
+DEF_HELPER_FLAGS_1(trace_rec_flush, TCG_CALL_NO_RWG, void, env)
 DEF_HELPER_2(trace_tb_exit, void, i32, i32)
 DEF_HELPER_4(trace_ld8u, void, env, i32, i32, i32)
 DEF_HELPER_4(trace_ld16u, void, env, i32, i32, i32)
@@ -230,6 +232,26 @@ DEF_HELPER_2(vdsp_vabss128, void, env, i32)
 DEF_HELPER_2(vdsp_vneg128, void, env, i32)
 DEF_HELPER_2(vdsp_vnegs128, void, env, i32)
 
+/* width-specialised VDSP helpers, see gen_vdsp_fast */
+DEF_HELPER_FLAGS_4(vdsp_vaddh_ub, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vaddh_uh, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vaddh_uw, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vaddh_sb, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vaddh_sh, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vaddh_sw, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vsubh_ub, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vsubh_uh, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vsubh_uw, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vsubh_sb, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vsubh_sh, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vsubh_sw, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vmula_b, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vmula_h, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vmula_w, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vmuls_b, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vmuls_h, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(vdsp_vmuls_w, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+
 DEF_HELPER_2(vdsp_vadd64, void, env, i32)
 DEF_HELPER_2(vdsp_vadde64, void, env, i32)
 DEF_HELPER_2(vdsp_vcadd64, void, env, i32)
@@ -453,10 +475,6 @@ DEF_HELPER_3(dspv2_mulscax_s16_s, i32, i32, i32, i32)
 
 /* declear dsp v3.0 ISA helpers */
 /* ADD/SUB/COMPARE instructions. */
-DEF_HELPER_FLAGS_2(vdsp2_vadd, TCG_CALL_NO_RWG, void, env, i32)
-DEF_HELPER_FLAGS_2(vdsp2_vsub, TCG_CALL_NO_RWG, void, env, i32)
-DEF_HELPER_FLAGS_2(vdsp2_vadd_s, TCG_CALL_NO_RWG, void, env, i32)
-DEF_HELPER_FLAGS_2(vdsp2_vsub_s, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vadd_h, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vsub_h, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vadd_rh, TCG_CALL_NO_RWG, void, env, i32)
@@ -483,10 +501,7 @@ DEF_HELPER_FLAGS_2(vdsp2_vsabs_s, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vsabs_e, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vsabsa, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vsabsa_e, TCG_CALL_NO_RWG, void, env, i32)
-DEF_HELPER_FLAGS_2(vdsp2_vneg, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vneg_s, TCG_CALL_NO_RWG, void, env, i32)
-DEF_HELPER_FLAGS_2(vdsp2_vmax, TCG_CALL_NO_RWG, void, env, i32)
-DEF_HELPER_FLAGS_2(vdsp2_vmin, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vpmax, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vpmin, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vcmpnez, TCG_CALL_NO_RWG, void, env, i32)
@@ -561,12 +576,10 @@ DEF_HELPER_FLAGS_2(vdsp2_vsht_r, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vsht_rs, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vshl, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vshl_s, TCG_CALL_NO_RWG, void, env, i32)
-DEF_HELPER_FLAGS_2(vdsp2_vshli, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vshli_s, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vshli_e, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vshr, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vshr_r, TCG_CALL_NO_RWG, void, env, i32)
-DEF_HELPER_FLAGS_2(vdsp2_vshri, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vshri_r, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vshri_l, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vshri_lr, TCG_CALL_NO_RWG, void, env, i32)
@@ -598,12 +611,6 @@ DEF_HELPER_FLAGS_2(vdsp2_vtbx, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vmovi, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vmaski, TCG_CALL_NO_RWG, void, env, i32)
 
-DEF_HELPER_FLAGS_2(vdsp2_vand, TCG_CALL_NO_RWG, void, env, i32)
-DEF_HELPER_FLAGS_2(vdsp2_vandn, TCG_CALL_NO_RWG, void, env, i32)
-DEF_HELPER_FLAGS_2(vdsp2_vxor, TCG_CALL_NO_RWG, void, env, i32)
-DEF_HELPER_FLAGS_2(vdsp2_vnot, TCG_CALL_NO_RWG, void, env, i32)
-DEF_HELPER_FLAGS_2(vdsp2_vor, TCG_CALL_NO_RWG, void, env, i32)
-DEF_HELPER_FLAGS_2(vdsp2_vorn, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vsel, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vcls, TCG_CALL_NO_RWG, void, env, i32)
 DEF_HELPER_FLAGS_2(vdsp2_vclz, TCG_CALL_NO_RWG, void, env, i32)
@@ -51,6 +51,148 @@ static int get_page_bits(CPUCSKYState *env)
     }
 }
 
+#define PGDIR_SHIFT    22
+#define PTE_INDX_SHIFT  10
+
+void csky_jtlb_init(CPUCSKYState *env, uint32_t entries, uint32_t ways)
+{
+    CSKYJTLB *jt = env->jtlb;
+
+    if (jt == NULL) {
+        jt = g_new0(CSKYJTLB, 1);
+        if (entries) {
+            jt->sets = entries / ways;
+            jt->ways = ways;
+            jt->entry = g_new0(csky_tlb_t, entries);
+            jt->victim = g_new0(uint8_t, jt->sets);
+        }
+        env->jtlb = jt;
+    }
+
+    csky_jtlb_flush(env);
+    jt->hit = 0;
+    jt->walk_hit = 0;
+    jt->miss = 0;
+    jt->refill = 0;
+}
+
+/* Callers flush the softmmu TLB themselves. */
+void csky_jtlb_flush(CPUCSKYState *env)
+{
+    CSKYJTLB *jt = env->jtlb;
+
+    if (jt == NULL || jt->sets == 0) {
+        return;
+    }
+    memset(jt->entry, 0, sizeof(csky_tlb_t) * jt->sets * jt->ways);
+    memset(jt->victim, 0, jt->sets);
+    memset(jt->walk, 0, sizeof(jt->walk));
+    jt->world = env->psr_t;
+}
+
+static inline bool csky_jtlb_match(csky_tlb_t *ptlb, uint32_t vpn,
+                                   uint8_t asid)
+{
+    return (ptlb->V0 || ptlb->V1) && ptlb->VPN == vpn &&
+           (ptlb->G == 1 || ptlb->ASID == asid);
+}
+
+static void csky_jtlb_inv_entry(CPUState *cs, csky_tlb_t *ptlb,
+                                int64_t vpn, int asid, bool flush)
+{
+    if ((ptlb->V0 || ptlb->V1) && (vpn < 0 || ptlb->VPN == vpn) &&
+        (asid < 0 || ptlb->ASID == asid)) {
+        if (flush || ptlb->G) {
+            tlb_flush_page(cs, ptlb->VPN);
+            tlb_flush_page(cs, ptlb->VPN | 0x1000);
+        }
+        memset(ptlb, 0, sizeof(struct csky_tlb_t));
+    }
+}
+
+/*
+ * Drop the refilled entries an invalidation of the architectural JTLB
+ * matches, a @vpn or @asid of -1 matches any.  Unless @flush is set the
+ * caller flushes the softmmu TLB of @vpn or @asid, global pages which
+ * may sit in the softmmu TLB of any ASID are always flushed.
+ */
+static void csky_jtlb_inv(CPUCSKYState *env, int64_t vpn, int asid,
+                          bool flush)
+{
+    CSKYJTLB *jt = env->jtlb;
+    CPUState *cs = env_cpu(env);
+    csky_tlb_t *set;
+    uint32_t i;
+
+    if (jt == NULL || jt->sets == 0) {
+        return;
+    }
+
+    /* Entries are all 4K page pairs, any other page size scans them all */
+    if (vpn >= 0 && ((env->mmu.mpr >> 13) & 0xfff) == 0x0) {
+        set = &jt->entry[((vpn >> 13) & (jt->sets - 1)) * jt->ways];
+        for (i = 0; i < jt->ways; i++) {
+            csky_jtlb_inv_entry(cs, &set[i], vpn, asid, flush);
+        }
+        csky_jtlb_inv_entry(cs, &jt->walk[(vpn >> 13) &
+                                          (CSKY_JTLB_WALK_NUM - 1)],
+                            vpn, asid, flush);
+        return;
+    }
+
+    for (i = 0; i < jt->sets * jt->ways; i++) {
+        csky_jtlb_inv_entry(cs, &jt->entry[i], vpn, asid, flush);
+    }
+    for (i = 0; i < CSKY_JTLB_WALK_NUM; i++) {
+        csky_jtlb_inv_entry(cs, &jt->walk[i], vpn, asid, flush);
+    }
+}
+
+/* Select the softmmu TLB of the current ASID, recycling the oldest one */
+void csky_asid_switch(CPUCSKYState *env)
+{
+    uint32_t tag = ENV_GET_ASID(env) | (env->psr_t << 16);
+    uint32_t i;
+
+    if (env->asid_tag[env->asid_slot] == tag) {
+        return;
+    }
+    for (i = 0; i < CSKY_ASID_SLOTS; i++) {
+        if (env->asid_tag[i] == tag) {
+            env->asid_slot = i;
+            return;
+        }
+    }
+
+    i = env->asid_victim;
+    env->asid_victim = (i + 1) % CSKY_ASID_SLOTS;
+    tlb_flush_by_mmuidx(env_cpu(env), 3 << CSKY_MMU_IDX(i, 0));
+    env->asid_tag[i] = tag;
+    env->asid_slot = i;
+}
+
+/* Flush the softmmu TLB filled while @asid was the current ASID */
+static void csky_asid_flush(CPUCSKYState *env, uint32_t asid)
+{
+    uint32_t tag = asid | (env->psr_t << 16);
+    uint32_t i;
+
+    for (i = 0; i < CSKY_ASID_SLOTS; i++) {
+        if (env->asid_tag[i] == tag) {
+            tlb_flush_by_mmuidx(env_cpu(env), 3 << CSKY_MMU_IDX(i, 0));
+        }
+    }
+}
+
+/* Flush the softmmu pages of the JTLB entry at @vpn for every ASID */
+static void csky_tlb_flush_vpn(CPUCSKYState *env, uint32_t vpn)
+{
+    vaddr len = (env->mmu.mpr | 0x1fff) + 1;
+
+    tlb_flush_range_by_mmuidx(env_cpu(env), vpn, len, CSKY_MMU_IDX_ALL,
+                              TARGET_LONG_BITS);
+}
+
 void helper_ttlbinv_all(CPUCSKYState *env)
 {
     CPUState *cs = env_cpu(env);
@@ -59,6 +201,7 @@ void helper_ttlbinv_all(CPUCSKYState *env)
                sizeof(struct csky_tlb_t) * CSKY_TLB_MAX);
         memset(env->tlb_context->nt_tlb, 0,
                sizeof(struct csky_tlb_t) * CSKY_TLB_MAX);
+        csky_jtlb_flush(env);
     }
     tlb_flush(cs);
 }
@@ -67,39 +210,64 @@ void helper_tlbinv_idx(CPUCSKYState *env)
 {
     CPUState *cs = env_cpu(env);
     csky_tlb_t *ptlb;
-    int j;
 
     if (env->full_mmu) {
         ptlb = &env->tlb_context->tlb[env->mmu.mir & 0x7f];
 
-        for (j = ptlb->VPN;
-             j <= (ptlb->VPN | env->mmu.mpr | 0x1000); j += 0x1000) {
-            tlb_flush_page(cs, j);
-        }
+        csky_tlb_flush_vpn(env, ptlb->VPN);
         memset(ptlb, 0, sizeof(struct csky_tlb_t));
     } else {
         tlb_flush(cs);
     }
 }
 
-void helper_tlbinv_all(CPUCSKYState *env)
+static void csky_tlbinv_all(CPUCSKYState *env)
 {
-    CPUState *cs = env_cpu(env);
     if (env->full_mmu) {
         memset(env->tlb_context->tlb, 0,
                sizeof(struct csky_tlb_t) * CSKY_TLB_MAX);
+        csky_jtlb_flush(env);
     }
-    tb_flush(cs);
-    tlb_flush(cs);
+    tlb_flush(env_cpu(env));
 }
 
-void helper_tlbinv_all_s(CPUCSKYState *env)
+void helper_tlbinv_all(CPUCSKYState *env)
 {
-    CPUState *cs = env_cpu(env);
+    tb_flush(env_cpu(env));
+    csky_tlbinv_all(env);
+}
+
+/*
+ * The TLB state of a CPU is only ever touched from its own thread.  The
+ * broadcast variants queue the invalidation on every other CPU, and on
+ * the source CPU as safe work so that it does not resume before the
+ * others have left their current TB, as tlb_flush_all_cpus_synced does.
+ * The translator ends the TB after tlbi, so the source picks it up at
+ * once.
+ */
+static void csky_tlb_broadcast(CPUCSKYState *env, run_on_cpu_func func,
+                               uint32_t rx)
+{
+    CPUState *src = env_cpu(env);
+    CPUState *cs;
+
     CPU_FOREACH(cs) {
-        env = csky_cpu_get_env(cs);
-        helper_tlbinv_all(env);
+        if (cs != src) {
+            async_run_on_cpu(cs, func, RUN_ON_CPU_HOST_INT(rx));
+        }
     }
+    async_safe_run_on_cpu(src, func, RUN_ON_CPU_HOST_INT(rx));
+}
+
+static void csky_tlbinv_all_work(CPUState *cs, run_on_cpu_data data)
+{
+    csky_tlbinv_all(csky_cpu_get_env(cs));
+}
+
+void helper_tlbinv_all_s(CPUCSKYState *env)
+{
+    tb_flush(env_cpu(env));
+    csky_tlb_broadcast(env, csky_tlbinv_all_work, 0);
 }
 
 static inline uint32_t csky_get_asid(CPUCSKYState *env, uint32_t rx)
@@ -116,143 +284,110 @@ static inline uint32_t csky_get_vpn(CPUCSKYState *env, uint32_t rx)
     return rx & CSKY_VPN_MASK & ~(env->mmu.mpr | 0x1fff);
 }
 
-void helper_tlbinv_asid(CPUCSKYState *env, uint32_t rx)
+/*
+ * Drop the JTLB entries of @asid.  The softmmu TLB of @asid is flushed as
+ * a whole, only global pages need flushing one by one.  The thin MMU
+ * walks the page table without remembering PTE_G, so a global page may
+ * be in the softmmu TLB of any ASID and all of them are flushed.
+ */
+static void csky_tlbinv_asid(CPUCSKYState *env, uint32_t asid)
 {
-    CPUState *cs = env_cpu(env);
+    csky_tlb_t *ptlb;
+    int i;
+
+    if (!env->full_mmu) {
+        tlb_flush(env_cpu(env));
+        return;
+    }
 
+    ptlb = env->tlb_context->tlb;
+    for (i = 0; i < CSKY_TLB_MAX; ++i) {
+        if (ptlb->ASID == asid) {
+            if (ptlb->G) {
+                csky_tlb_flush_vpn(env, ptlb->VPN);
+            }
+            memset(ptlb, 0, sizeof(struct csky_tlb_t));
+        }
+        ptlb++;
+    }
+    csky_jtlb_inv(env, -1, asid, false);
+    csky_asid_flush(env, asid);
+}
+
+/*
+ * Drop the JTLB entries of @vpn, for @asid only unless it is -1.  The
+ * caller flushes the softmmu pages.
+ */
+static void csky_tlbinv_vpn(CPUCSKYState *env, uint32_t vpn, int asid)
+{
     if (env->full_mmu) {
-        uint32_t asid = csky_get_asid(env, rx);
         csky_tlb_t *ptlb = env->tlb_context->tlb;
         int i;
 
         for (i = 0; i < CSKY_TLB_MAX; ++i) {
-            if (ptlb->ASID == asid) {
-                ptlb->V0 = 0;
-                ptlb->V1 = 0;
-                int j;
-                for (j = ptlb->VPN;
-                     j <= (ptlb->VPN | env->mmu.mpr | 0x1000); j += 0x1000) {
-                    tlb_flush_page(cs, j);
-                }
+            if (ptlb->VPN == vpn && (asid < 0 || ptlb->ASID == asid)) {
                 memset(ptlb, 0, sizeof(struct csky_tlb_t));
             }
             ptlb++;
         }
-    } else {
-        tlb_flush(cs);
+        csky_jtlb_inv(env, vpn, asid, false);
     }
 }
 
+void helper_tlbinv_asid(CPUCSKYState *env, uint32_t rx)
+{
+    csky_tlbinv_asid(env, csky_get_asid(env, rx));
+}
+
+static void csky_tlbinv_asid_work(CPUState *cs, run_on_cpu_data data)
+{
+    helper_tlbinv_asid(csky_cpu_get_env(cs), data.host_int);
+}
+
 void helper_tlbinv_asid_s(CPUCSKYState *env, uint32_t rx)
 {
-    CPUState *cs = env_cpu(env);
-    CPU_FOREACH(cs) {
-        env = csky_cpu_get_env(cs);
-        helper_tlbinv_asid(env, rx);
-    }
+    csky_tlb_broadcast(env, csky_tlbinv_asid_work, rx);
 }
 
 void helper_tlbinv_vaa(CPUCSKYState *env, uint32_t rx)
 {
-    CPUState *cs = env_cpu(env);
+    uint32_t vpn = csky_get_vpn(env, rx);
 
-    if (env->full_mmu) {
-        uint32_t vpn = csky_get_vpn(env, rx);
-        csky_tlb_t *ptlb = env->tlb_context->tlb;
-        int i;
+    csky_tlbinv_vpn(env, vpn, -1);
+    csky_tlb_flush_vpn(env, vpn);
+}
 
-        for (i = 0; i < CSKY_TLB_MAX; ++i) {
-            if (ptlb->VPN == vpn) {
-                ptlb->V0 = 0;
-                ptlb->V1 = 0;
-                int j;
-                for (j = ptlb->VPN;
-                     j <= (ptlb->VPN | env->mmu.mpr | 0x1000); j += 0x1000) {
-                    tlb_flush_page(cs, j);
-                }
-                memset(ptlb, 0, sizeof(struct csky_tlb_t));
-            }
-            ptlb++;
-        }
-    } else {
-        tlb_flush(cs);
-    }
+static void csky_tlbinv_vaa_work(CPUState *cs, run_on_cpu_data data)
+{
+    helper_tlbinv_vaa(csky_cpu_get_env(cs), data.host_int);
 }
 
 void helper_tlbinv_vaa_s(CPUCSKYState *env, uint32_t rx)
 {
-    CPUState *cs = env_cpu(env);
-    CPU_FOREACH(cs) {
-        env = csky_cpu_get_env(cs);
-        helper_tlbinv_vaa(env, rx);
-    }
+    csky_tlb_broadcast(env, csky_tlbinv_vaa_work, rx);
 }
 
 void helper_tlbinv_va(CPUCSKYState *env, uint32_t rx)
 {
-    CPUState *cs = env_cpu(env);
+    uint32_t vpn = csky_get_vpn(env, rx);
 
-    if (env->full_mmu) {
-        uint32_t vpn = csky_get_vpn(env, rx);
-        uint32_t asid = csky_get_asid(env, rx);
-        csky_tlb_t *ptlb = env->tlb_context->tlb;
-        int i;
+    csky_tlbinv_vpn(env, vpn, csky_get_asid(env, rx));
+    csky_tlb_flush_vpn(env, vpn);
+}
 
-        for (i = 0; i < CSKY_TLB_MAX; ++i) {
-            if (ptlb->VPN == vpn && ptlb->ASID == asid) {
-                ptlb->V0 = 0;
-                ptlb->V1 = 0;
-                int j;
-                for (j = ptlb->VPN;
-                     j <= (ptlb->VPN | env->mmu.mpr | 0x1000); j += 0x1000) {
-                    tlb_flush_page(cs, j);
-                }
-                memset(ptlb, 0, sizeof(struct csky_tlb_t));
-            }
-            ptlb++;
-        }
-    } else {
-        tlb_flush(cs);
-    }
+static void csky_tlbinv_va_work(CPUState *cs, run_on_cpu_data data)
+{
+    helper_tlbinv_va(csky_cpu_get_env(cs), data.host_int);
 }
 
 void helper_tlbinv_va_s(CPUCSKYState *env, uint32_t rx)
 {
-    CPUState *cs = env_cpu(env);
-    CPU_FOREACH(cs) {
-        env = csky_cpu_get_env(cs);
-        helper_tlbinv_va(env, rx);
-    }
+    csky_tlb_broadcast(env, csky_tlbinv_va_work, rx);
 }
 
 void helper_tlbinv(CPUCSKYState *env)
 {
-    CPUState *cs = env_cpu(env);
-
-    if (env->full_mmu) {
-        csky_tlb_t *ptlb;
-        uint8_t asid;
-        int i;
-
-        asid = ENV_GET_ASID(env);
-        ptlb = &env->tlb_context->tlb[0];
-
-        for (i = 0; i < CSKY_TLB_MAX; ++i) {
-            if (ptlb->ASID == asid) {
-                ptlb->V0 = 0;
-                ptlb->V1 = 0;
-                int j;
-                for (j = ptlb->VPN;
-                     j <= (ptlb->VPN | env->mmu.mpr | 0x1000); j += 0x1000) {
-                    tlb_flush_page(cs, j);
-                }
-                memset(ptlb, 0, sizeof(struct csky_tlb_t));
-            }
-            ptlb++;
-        }
-    } else {
-        tlb_flush(cs);
-    }
+    csky_tlbinv_asid(env, ENV_GET_ASID(env));
 }
 
 void csky_tlbwi(CPUCSKYState *env)
@@ -266,10 +401,7 @@ void csky_tlbwi(CPUCSKYState *env)
     }
 
     ptlb = &env->tlb_context->tlb[env->mmu.mir & 0x7f];
-    int j;
-    for (j = ptlb->VPN; j <= (ptlb->VPN | env->mmu.mpr | 0x1000); j += 0x1000) {
-        tlb_flush_page(cs, j);
-    }
+    csky_tlb_flush_vpn(env, ptlb->VPN);
 
     ptlb->VPN   = env->mmu.meh & ~(env->mmu.mpr | 0x1fff);
     ptlb->ASID  = ENV_GET_ASID(env);
@@ -291,9 +423,8 @@ void csky_tlbwi(CPUCSKYState *env)
     ptlb->PageMask = env->mmu.mpr;
 #endif
 
-    for (j = ptlb->VPN; j <= (ptlb->VPN | env->mmu.mpr | 0x1000); j += 0x1000) {
-        tlb_flush_page(cs, j);
-    }
+    csky_tlb_flush_vpn(env, ptlb->VPN);
+    csky_jtlb_inv(env, ptlb->VPN, -1, false);
 }
 
 void csky_tlbwr(CPUCSKYState *env)
@@ -301,7 +432,6 @@ void csky_tlbwr(CPUCSKYState *env)
     csky_tlb_t *ptlb;
     uint32_t index;
     CPUState *cs = env_cpu(env);
-    int j;
 
     if (!env->full_mmu) {
         tlb_flush(cs);
@@ -320,10 +450,7 @@ void csky_tlbwr(CPUCSKYState *env)
         env->tlb_context->round_robin[index] = 1;
     }
     ptlb =  &env->tlb_context->tlb[index];
-
-    for (j = ptlb->VPN; j <= (ptlb->VPN | env->mmu.mpr | 0x1000); j += 0x1000) {
-        tlb_flush_page(cs, j);
-    }
+    csky_tlb_flush_vpn(env, ptlb->VPN);
 
     ptlb->VPN   = env->mmu.meh & ~(env->mmu.mpr | 0x1fff);
     ptlb->ASID  = ENV_GET_ASID(env);
@@ -345,9 +472,8 @@ void csky_tlbwr(CPUCSKYState *env)
     ptlb->PageMask = env->mmu.mpr;
 #endif
 
-    for (j = ptlb->VPN; j <= (ptlb->VPN | env->mmu.mpr | 0x1000); j += 0x1000) {
-        tlb_flush_page(cs, j);
-    }
+    csky_tlb_flush_vpn(env, ptlb->VPN);
+    csky_jtlb_inv(env, ptlb->VPN, -1, false);
 }
 
 void csky_tlbp(CPUCSKYState *env)
@@ -414,6 +540,7 @@ void csky_tlbr(CPUCSKYState *env)
 #if !defined(TARGET_CSKYV2)
     env->mmu.mpr = ptlb->PageMask;
 #endif
+    csky_asid_switch(env);
 }
 
 /* ----------------------------- */
@@ -427,6 +554,140 @@ enum {
     TLBRET_MATCH = 0
 };
 
+/* Fetch the even/odd pte pair of a 4K @address from the page table */
+static void csky_pte_walk(CPUState *cs, uint32_t pgd_addr,
+                          target_ulong address, uint32_t *pte0, uint32_t *pte1)
+{
+    uint32_t pte_addr;
+
+    /* Get current pgd table base */
+    pgd_addr += (address >> PGDIR_SHIFT) << 2;
+    /* Get pte table base */
+    pte_addr = ldl_phys(cs->as, pgd_addr);
+    pte_addr += (address >> PTE_INDX_SHIFT) & 0xff8;
+
+    *pte0 = ldl_phys(cs->as, pte_addr);
+    *pte1 = ldl_phys(cs->as, pte_addr + 4);
+}
+
+static void csky_tlb_set_pte(CPUCSKYState *env, csky_tlb_t *ptlb,
+                             target_ulong address, uint32_t pte0,
+                             uint32_t pte1)
+{
+    ptlb->VPN   = address & ~0x1fff;
+    ptlb->ASID  = ENV_GET_ASID(env);
+#if !defined(TARGET_CSKYV2)
+    ptlb->G     = (pte0 >> 6) & (pte1 >> 6) & 0X1;
+    ptlb->C0    = (pte0 >> 9) & 0x7;
+    ptlb->C1    = (pte1 >> 9) & 0x7;
+    ptlb->V0    = (pte0 >> 7) & 0x1;
+    ptlb->V1    = (pte1 >> 7) & 0x1;
+    ptlb->D0    = (pte0 >> 8) & 0x1;
+    ptlb->D1    = (pte1 >> 8) & 0x1;
+#else
+    ptlb->G     = pte0 & pte1 & 0X1;
+    ptlb->C0    = (pte0 >> 3) & 0x7;
+    ptlb->C1    = (pte1 >> 3) & 0x7;
+    ptlb->V0    = (pte0 >> 1) & 0x1;
+    ptlb->V1    = (pte1 >> 1) & 0x1;
+    ptlb->D0    = (pte0 >> 2) & 0x1;
+    ptlb->D1    = (pte1 >> 2) & 0x1;
+#endif
+
+    ptlb->PFN[0] = pte0 & ~0xfff;
+    ptlb->PFN[1] = pte1 & ~0xfff;
+
+    ptlb->PageMask = env->mmu.mpr;
+}
+
+static int csky_tlb_access(csky_tlb_t *ptlb, hwaddr *physical, int *prot,
+                           target_ulong address, int rw)
+{
+    int odd = (address >> 12) & 0x1;
+
+    if (!(odd ? ptlb->V1 : ptlb->V0)) {
+        return TLBRET_INVALID;
+    }
+    if (rw == 0 || (odd ? ptlb->D1 : ptlb->D0)) {
+        *physical = ptlb->PFN[odd] | (address & 0xfff);
+        *prot = PAGE_READ;
+        if ((odd ? ptlb->D1 : ptlb->D0)) {
+            *prot |= PAGE_WRITE;
+        }
+        return TLBRET_MATCH;
+    }
+    return TLBRET_DIRTY;
+}
+
+/*
+ * Translate a 4K page through the set associative JTLB, refilling it from
+ * the page table at @pgd_addr on a miss.  An entry that would fault is
+ * walked again first: the guest may have made the pte valid or dirty
+ * without invalidating it, which the architectural JTLB never sees as it
+ * holds far fewer refills.
+ */
+static int csky_jtlb_translate(CPUCSKYState *env, hwaddr *physical,
+                               int *prot, uint32_t pgd_addr,
+                               target_ulong address, int rw)
+{
+    CSKYJTLB *jt = env->jtlb;
+    CPUState *cs = env_cpu(env);
+    uint32_t vpn = address & ~0x1fff;
+    uint8_t asid = ENV_GET_ASID(env);
+    csky_tlb_t *set, *walk, *ptlb;
+    uint32_t pte0, pte1, i;
+    int ret;
+
+    if (unlikely(jt->world != env->psr_t)) {
+        csky_jtlb_flush(env);
+    }
+
+    set = &jt->entry[((vpn >> 13) & (jt->sets - 1)) * jt->ways];
+    walk = &jt->walk[(vpn >> 13) & (CSKY_JTLB_WALK_NUM - 1)];
+
+    if (csky_jtlb_match(walk, vpn, asid)) {
+        jt->walk_hit++;
+        ret = csky_tlb_access(walk, physical, prot, address, rw);
+    } else {
+        for (i = 0; i < jt->ways; i++) {
+            if (csky_jtlb_match(&set[i], vpn, asid)) {
+                break;
+            }
+        }
+        if (i == jt->ways) {
+            goto refill;
+        }
+        jt->hit++;
+        *walk = set[i];
+        ret = csky_tlb_access(walk, physical, prot, address, rw);
+    }
+    if (ret == TLBRET_MATCH) {
+        return ret;
+    }
+    csky_jtlb_inv(env, vpn, -1, true);
+
+refill:
+    jt->miss++;
+    csky_pte_walk(cs, pgd_addr, address, &pte0, &pte1);
+
+    i = jt->victim[(vpn >> 13) & (jt->sets - 1)];
+    ptlb = &set[i];
+    if (ptlb->V0 || ptlb->V1) {
+        if (walk->VPN == ptlb->VPN && walk->ASID == ptlb->ASID) {
+            memset(walk, 0, sizeof(struct csky_tlb_t));
+        }
+        tlb_flush_page(cs, ptlb->VPN);
+        tlb_flush_page(cs, ptlb->VPN | 0x1000);
+    }
+    csky_tlb_set_pte(env, ptlb, address, pte0, pte1);
+    if (ptlb->V0 || ptlb->V1) {
+        jt->victim[(vpn >> 13) & (jt->sets - 1)] = (i + 1) & (jt->ways - 1);
+        jt->refill++;
+        *walk = *ptlb;
+    }
+    return csky_tlb_access(ptlb, physical, prot, address, rw);
+}
+
 static int get_physical_address(CPUCSKYState *env, hwaddr *physical,
                                 int *prot, target_ulong addr,
                                 int access_type, int mmu_idx)
@@ -527,6 +788,7 @@ do_map:
 
     if ((ptlb->G == 1 || ptlb->ASID == ASID) &&
        ptlb->VPN == (address & ~(env->mmu.mpr | 0x1fff))) {
+        env->jtlb->hit++;
         if (!(odd ? ptlb->V1 : ptlb->V0)) {
             return TLBRET_INVALID;
         }
@@ -546,6 +808,7 @@ do_map:
 
     if ((ptlb->G == 1 || ptlb->ASID == ASID) &&
         ptlb->VPN == (address & ~(env->mmu.mpr | 0x1fff))) {
+        env->jtlb->hit++;
         if (!(odd ? ptlb->V1 : ptlb->V0)) {
             return TLBRET_INVALID;
         }
@@ -562,21 +825,16 @@ do_map:
     /* FIXME add cskyv2 hard_tlb_refill*/
 hard_refill:
     if (((env->mmu.mpr >> 13) & 0xfff) == 0x0) {
-        uint32_t pte_addr, pte0, pte1, j;
-
-#define PGDIR_SHIFT    22
-#define PTE_INDX_SHIFT  10
+        uint32_t pte0, pte1, j;
 
-        /* Get current pgd table base */
-        pgd_addr += (address >> PGDIR_SHIFT) << 2;
-        /* Get pte table base */
-        pte_addr = ldl_phys(cs->as, pgd_addr);
-        pte_addr += (address >> PTE_INDX_SHIFT) & 0xff8;
+        if (env->jtlb->sets) {
+            return csky_jtlb_translate(env, physical, prot, pgd_addr,
+                                       address, rw);
+        }
 
-        pte0 = ldl_phys(cs->as, pte_addr);
-        pte1 = ldl_phys(cs->as, pte_addr + 4);
+        env->jtlb->miss++;
+        csky_pte_walk(cs, pgd_addr, address, &pte0, &pte1);
 
-        odd = (address >> 12) & 0x1;
         index = (address >> 13) & 0x3f;
 
         if (env->tlb_context->round_robin[index]) {
@@ -593,45 +851,13 @@ hard_refill:
             tlb_flush_page(cs, j);
         }
 
-        ptlb->VPN   = address & ~0x1fff;
-        ptlb->ASID  = ENV_GET_ASID(env);
-#if !defined(TARGET_CSKYV2)
-        ptlb->G     = (pte0 >> 6) & (pte1 >> 6) & 0X1;
-        ptlb->C0    = (pte0 >> 9) & 0x7;
-        ptlb->C1    = (pte1 >> 9) & 0x7;
-        ptlb->V0    = (pte0 >> 7) & 0x1;
-        ptlb->V1    = (pte1 >> 7) & 0x1;
-        ptlb->D0    = (pte0 >> 8) & 0x1;
-        ptlb->D1    = (pte1 >> 8) & 0x1;
-#else
-        ptlb->G     = pte0 & pte1 & 0X1;
-        ptlb->C0    = (pte0 >> 3) & 0x7;
-        ptlb->C1    = (pte1 >> 3) & 0x7;
-        ptlb->V0    = (pte0 >> 1) & 0x1;
-        ptlb->V1    = (pte1 >> 1) & 0x1;
-        ptlb->D0    = (pte0 >> 2) & 0x1;
-        ptlb->D1    = (pte1 >> 2) & 0x1;
-#endif
-
-        ptlb->PFN[0] = pte0 & ~0xfff;
-        ptlb->PFN[1] = pte1 & ~0xfff;
+        csky_tlb_set_pte(env, ptlb, address, pte0, pte1);
+        env->jtlb->refill++;
 
-        ptlb->PageMask = env->mmu.mpr;
-
-        if (!(odd ? ptlb->V1 : ptlb->V0)) {
-            return TLBRET_INVALID;
-        }
-        if (rw == 0 || (odd ? ptlb->D1 : ptlb->D0)) {
-            *physical = ptlb->PFN[odd] | (address & 0xfff);
-            *prot = PAGE_READ;
-            if ((odd ? ptlb->D1 : ptlb->D0)) {
-                *prot |= PAGE_WRITE;
-            }
-            return TLBRET_MATCH;
-        }
-        return TLBRET_DIRTY;
+        return csky_tlb_access(ptlb, physical, prot, address, rw);
     }
 
+    env->jtlb->miss++;
     return TLBRET_NOMATCH;
 }
 
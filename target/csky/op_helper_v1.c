@@ -1621,13 +1621,9 @@ void helper_mtcr_cr20(CPUCSKYState *env, uint32_t rx)
 
 void helper_meh_write(CPUCSKYState *env, uint32_t rx)
 {
-    CPUState *cs = env_cpu(env);
-    /* if ASID is Changed, QEMU TLB must be flush */
-    if ((env->mmu.meh & 0xff) != (rx & 0xff)) {
-        tlb_flush(cs);
-    }
-
     env->mmu.meh = rx;
+    /* if ASID is Changed, switch to the QEMU TLB of the new one */
+    csky_asid_switch(env);
 }
 
 void helper_mcir_write(CPUCSKYState *env, uint32_t rx)
@@ -48,7 +48,7 @@ void helper_exception(CPUCSKYState *env, uint32_t excp)
     uint16_t insn;
     cs->exception_index = excp;
     if (excp == EXCP_CSKY_BKPT || excp == EXCP_DEBUG) {
-        if (semihosting_enabled(!cpu_mmu_index(env, false))) {
+        if (semihosting_enabled(!PSR_S(env->cp0.psr))) {
             insn = cpu_lduw_code(env, env->pc);
             if (insn == 0) {
                 magic = cpu_lduw_code(env, env->pc + 2);
@@ -1352,20 +1352,9 @@ void helper_rfi(CPUCSKYState *env)
 
 void helper_meh_write(CPUCSKYState *env, uint32_t rx)
 {
-    uint32_t mask;
-    CPUState *cs = env_cpu(env);
-
-    if (env->features & CPU_C860) {
-        mask = CSKY_MP_ASID_MASK;
-    } else {
-        mask = CSKY_ASID_MASK;
-    }
-    /* if ASID is Changed, QEMU TLB must be flush */
-    if ((env->mmu.meh & mask) != (rx & mask)) {
-        tlb_flush(cs);
-    }
-
     env->mmu.meh = rx;
+    /* if ASID is Changed, switch to the QEMU TLB of the new one */
+    csky_asid_switch(env);
 }
 
 void helper_mcir_write(CPUCSKYState *env, uint32_t rx)
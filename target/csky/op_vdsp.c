@@ -22,8 +22,59 @@
 #include "exec/helper-proto.h"
 #include "exec/exec-all.h"
 #include "csky_ldst.h"
+#include "tcg/tcg-gvec-desc.h"
 #include <math.h>
 
+/*
+ * Width-specialised forms of the element-wise operations that have no
+ * generic vector op. gen_vdsp_fast picks one per (op, width, sign) at
+ * translate time, so each is a single loop over the operand bytes.
+ */
+#define DO_VDSP_3OP(NAME, TYPE, OP)                                     \
+void VDSP_HELPER(NAME)(void *vd, void *vn, void *vm, uint32_t desc)     \
+{                                                                       \
+    intptr_t i, opr_sz = simd_oprsz(desc);                              \
+    TYPE *d = vd, *n = vn, *m = vm;                                     \
+                                                                        \
+    for (i = 0; i < opr_sz / sizeof(TYPE); i++) {                       \
+        d[i] = OP(d[i], n[i], m[i]);                                    \
+    }                                                                   \
+}
+
+/* same as halving through double and truncating, as vaddh64 does */
+#define DO_HADD(D, N, M)    (((int64_t)(N) + (M)) / 2)
+#define DO_HSUB(D, N, M)    (((int64_t)(N) - (M)) / 2)
+#define DO_MLA(D, N, M)     ((D) + (uint32_t)(N) * (M))
+#define DO_MLS(D, N, M)     ((D) - (uint32_t)(N) * (M))
+
+DO_VDSP_3OP(vaddh_ub, uint8_t, DO_HADD)
+DO_VDSP_3OP(vaddh_uh, uint16_t, DO_HADD)
+DO_VDSP_3OP(vaddh_uw, uint32_t, DO_HADD)
+DO_VDSP_3OP(vaddh_sb, int8_t, DO_HADD)
+DO_VDSP_3OP(vaddh_sh, int16_t, DO_HADD)
+DO_VDSP_3OP(vaddh_sw, int32_t, DO_HADD)
+
+DO_VDSP_3OP(vsubh_ub, uint8_t, DO_HSUB)
+DO_VDSP_3OP(vsubh_uh, uint16_t, DO_HSUB)
+DO_VDSP_3OP(vsubh_uw, uint32_t, DO_HSUB)
+DO_VDSP_3OP(vsubh_sb, int8_t, DO_HSUB)
+DO_VDSP_3OP(vsubh_sh, int16_t, DO_HSUB)
+DO_VDSP_3OP(vsubh_sw, int32_t, DO_HSUB)
+
+DO_VDSP_3OP(vmula_b, uint8_t, DO_MLA)
+DO_VDSP_3OP(vmula_h, uint16_t, DO_MLA)
+DO_VDSP_3OP(vmula_w, uint32_t, DO_MLA)
+
+DO_VDSP_3OP(vmuls_b, uint8_t, DO_MLS)
+DO_VDSP_3OP(vmuls_h, uint16_t, DO_MLS)
+DO_VDSP_3OP(vmuls_w, uint32_t, DO_MLS)
+
+#undef DO_VDSP_3OP
+#undef DO_HADD
+#undef DO_HSUB
+#undef DO_MLA
+#undef DO_MLS
+
 void VDSP_HELPER(vadd64)(CPUCSKYState *env, uint32_t insn)
 {
     int cnt, i;
@@ -299,280 +299,6 @@ static inline uint32_t get_size_from_imm(CPUCSKYState *env, uint32_t *imm)
     return res;
 }
 
-void VDSP2_HELPER(vadd)(CPUCSKYState *env, uint32_t insn)
-{
-    int i, number;
-    uint32_t size, width, rx, ry, rz;
-
-    size = ((insn >> 20) & 0x1) | ((insn >> 24) & 0x2);
-    width = 8 << size;
-    number = 128 / width;
-
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    ry = (insn >> CSKY_VDSP2_VREG_SHI_VRY) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-
-    switch (width) {
-    case 8:
-        for (i = 0; i < number; i++) {
-            env->vfp.reg[rz].dspc[i] = (env->vfp.reg[rx].dspc[i] +
-                                        env->vfp.reg[ry].dspc[i]);
-        }
-        break;
-    case 16:
-        for (i = 0; i < number; i++) {
-            env->vfp.reg[rz].dsps[i] = (env->vfp.reg[rx].dsps[i] +
-                                        env->vfp.reg[ry].dsps[i]);
-        }
-        break;
-    case 32:
-        for (i = 0; i < number; i++) {
-            env->vfp.reg[rz].dspi[i] = (env->vfp.reg[rx].dspi[i] +
-                                        env->vfp.reg[ry].dspi[i]);
-        }
-        break;
-    case 64:
-        for (i = 0; i < number; i++) {
-            env->vfp.reg[rz].dspl[i] = (env->vfp.reg[rx].dspl[i] +
-                                        env->vfp.reg[ry].dspl[i]);
-        }
-        break;
-    default:
-        helper_exception(env, EXCP_CSKY_UDEF);
-        return;
-    }
-}
-
-void VDSP2_HELPER(vsub)(CPUCSKYState *env, uint32_t insn)
-{
-    int i, number;
-    uint32_t size, width, rx, ry, rz;
-
-    size = ((insn >> 20) & 0x1) | ((insn >> 24) & 0x2);
-    width = 8 << size;
-    number = 128 / width;
-
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    ry = (insn >> CSKY_VDSP2_VREG_SHI_VRY) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-
-    switch (width) {
-    case 8:
-        for (i = 0; i < number; i++) {
-            env->vfp.reg[rz].dspc[i] = (env->vfp.reg[rx].dspc[i] -
-                                        env->vfp.reg[ry].dspc[i]);
-        }
-        break;
-    case 16:
-        for (i = 0; i < number; i++) {
-            env->vfp.reg[rz].dsps[i] = (env->vfp.reg[rx].dsps[i] -
-                                        env->vfp.reg[ry].dsps[i]);
-        }
-        break;
-    case 32:
-        for (i = 0; i < number; i++) {
-            env->vfp.reg[rz].dspi[i] = (env->vfp.reg[rx].dspi[i] -
-                                        env->vfp.reg[ry].dspi[i]);
-        }
-        break;
-    case 64:
-        for (i = 0; i < number; i++) {
-            env->vfp.reg[rz].dspl[i] = (env->vfp.reg[rx].dspl[i] -
-                                        env->vfp.reg[ry].dspl[i]);
-        }
-        break;
-    default:
-        helper_exception(env, EXCP_CSKY_UDEF);
-        return;
-    }
-}
-
-void VDSP2_HELPER(vadd_s)(CPUCSKYState *env, uint32_t insn)
-{
-    int i, number;
-    uint32_t size, width, sign, rx, ry, rz;
-
-    size = ((insn >> 20) & 0x1) | ((insn >> 24) & 0x2);
-    width = 8 << size;
-    number = 128 / width;
-
-    sign = (insn >> CSKY_VDSP2_SIGN_SHI) & CSKY_VDSP2_SIGN_MASK;
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    ry = (insn >> CSKY_VDSP2_VREG_SHI_VRY) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-
-    if (sign) {
-        switch (width) {
-        case 8:
-            for (i = 0; i < number; i++) {
-                uint8_t a, b;
-                a = env->vfp.reg[rx].udspc[i];
-                b = env->vfp.reg[ry].udspc[i];
-                env->vfp.reg[rz].udspc[i] = sat_add_s8(a, b);
-            }
-            break;
-        case 16:
-            for (i = 0; i < number; i++) {
-                uint16_t a, b;
-                a = env->vfp.reg[rx].udsps[i];
-                b = env->vfp.reg[ry].udsps[i];
-                env->vfp.reg[rz].udsps[i] = sat_add_s16(a, b);
-            }
-            break;
-        case 32:
-            for (i = 0; i < number; i++) {
-                uint32_t a, b;
-                a = env->vfp.reg[rx].udspi[i];
-                b = env->vfp.reg[ry].udspi[i];
-                env->vfp.reg[rz].udspi[i] = sat_add_s32(a, b);
-            }
-            break;
-        case 64:
-            for (i = 0; i < number; i++) {
-                uint64_t a, b;
-                a = env->vfp.reg[rx].udspl[i];
-                b = env->vfp.reg[ry].udspl[i];
-                env->vfp.reg[rz].udspl[i] = sat_add_s64(a, b);
-            }
-            break;
-        default:
-            helper_exception(env, EXCP_CSKY_UDEF);
-            return;
-        }
-    } else {
-        switch (width) {
-        case 8:
-            for (i = 0; i < number; i++) {
-                uint8_t a, b;
-                a = env->vfp.reg[rx].udspc[i];
-                b = env->vfp.reg[ry].udspc[i];
-                env->vfp.reg[rz].udspc[i] = sat_add_u8(a, b);
-            }
-            break;
-        case 16:
-            for (i = 0; i < number; i++) {
-                uint16_t a, b;
-                a = env->vfp.reg[rx].udsps[i];
-                b = env->vfp.reg[ry].udsps[i];
-                env->vfp.reg[rz].udsps[i] = sat_add_u16(a, b);
-            }
-            break;
-        case 32:
-            for (i = 0; i < number; i++) {
-                uint32_t a, b;
-                a = env->vfp.reg[rx].udspi[i];
-                b = env->vfp.reg[ry].udspi[i];
-                env->vfp.reg[rz].udspi[i] = sat_add_u32(a, b);
-            }
-            break;
-        case 64:
-            for (i = 0; i < number; i++) {
-                uint64_t a, b;
-                a = env->vfp.reg[rx].udspl[i];
-                b = env->vfp.reg[ry].udspl[i];
-                env->vfp.reg[rz].udspl[i] = sat_add_u64(a, b);
-            }
-            break;
-        default:
-            helper_exception(env, EXCP_CSKY_UDEF);
-            return;
-        }
-    }
-}
-
-void VDSP2_HELPER(vsub_s)(CPUCSKYState *env, uint32_t insn)
-{
-    int i, number;
-    uint32_t size, width, sign, rx, ry, rz;
-
-    size = ((insn >> 20) & 0x1) | ((insn >> 24) & 0x2);
-    width = 8 << size;
-    number = 128 / width;
-
-    sign = (insn >> CSKY_VDSP2_SIGN_SHI) & CSKY_VDSP2_SIGN_MASK;
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    ry = (insn >> CSKY_VDSP2_VREG_SHI_VRY) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-
-    if (sign) {
-        switch (width) {
-        case 8:
-            for (i = 0; i < number; i++) {
-                uint8_t a, b;
-                a = env->vfp.reg[rx].udspc[i];
-                b = env->vfp.reg[ry].udspc[i];
-                env->vfp.reg[rz].udspc[i] = sat_sub_s8(a, b);
-            }
-            break;
-        case 16:
-            for (i = 0; i < number; i++) {
-                uint16_t a, b;
-                a = env->vfp.reg[rx].udsps[i];
-                b = env->vfp.reg[ry].udsps[i];
-                env->vfp.reg[rz].udsps[i] = sat_sub_s16(a, b);
-            }
-            break;
-        case 32:
-            for (i = 0; i < number; i++) {
-                uint32_t a, b;
-                a = env->vfp.reg[rx].udspi[i];
-                b = env->vfp.reg[ry].udspi[i];
-                env->vfp.reg[rz].udspi[i] = sat_sub_s32(a, b);
-            }
-            break;
-        case 64:
-            for (i = 0; i < number; i++) {
-                uint64_t a, b;
-                a = env->vfp.reg[rx].udspl[i];
-                b = env->vfp.reg[ry].udspl[i];
-                env->vfp.reg[rz].udspl[i] = sat_sub_s64(a, b);
-            }
-            break;
-        default:
-            helper_exception(env, EXCP_CSKY_UDEF);
-            return;
-        }
-    } else {
-        switch (width) {
-        case 8:
-            for (i = 0; i < number; i++) {
-                uint8_t a, b;
-                a = env->vfp.reg[rx].udspc[i];
-                b = env->vfp.reg[ry].udspc[i];
-                env->vfp.reg[rz].udspc[i] = sat_sub_u8(a, b);
-            }
-            break;
-        case 16:
-            for (i = 0; i < number; i++) {
-                uint16_t a, b;
-                a = env->vfp.reg[rx].udsps[i];
-                b = env->vfp.reg[ry].udsps[i];
-                env->vfp.reg[rz].udsps[i] = sat_sub_u16(a, b);
-            }
-            break;
-        case 32:
-            for (i = 0; i < number; i++) {
-                uint32_t a, b;
-                a = env->vfp.reg[rx].udspi[i];
-                b = env->vfp.reg[ry].udspi[i];
-                env->vfp.reg[rz].udspi[i] = sat_sub_u32(a, b);
-            }
-            break;
-        case 64:
-            for (i = 0; i < number; i++) {
-                uint64_t a, b;
-                a = env->vfp.reg[rx].udspl[i];
-                b = env->vfp.reg[ry].udspl[i];
-                env->vfp.reg[rz].udspl[i] = sat_sub_u64(a, b);
-            }
-            break;
-        default:
-            helper_exception(env, EXCP_CSKY_UDEF);
-            return;
-        }
-    }
-}
-
 void VDSP2_HELPER(vadd_h)(CPUCSKYState *env, uint32_t insn)
 {
     int i, number;
@@ -2552,185 +2278,20 @@ void VDSP2_HELPER(vsabsa_e)(CPUCSKYState *env, uint32_t insn)
                 tmp1.udspi[i] = env->vfp.reg[rz].udspi[i] + abs_32(a - b);
 
                 a = env->vfp.reg[rx].udsps[i + number / 2];
-                b = env->vfp.reg[ry].udsps[i + number / 2];
-                tmp2.udspi[i] = env->vfp.reg[rz + 1].udspi[i] + abs_32(a - b);
-            }
-            break;
-        case 32:
-            for (i = 0; i < number / 2; i++) {
-                uint64_t a, b;
-                a = env->vfp.reg[rx].udspi[i];
-                b = env->vfp.reg[ry].udspi[i];
-                tmp1.udspl[i] = env->vfp.reg[rz].udspl[i] + abs_64(a - b);
-
-                a = env->vfp.reg[rx].udspi[i + number / 2];
-                b = env->vfp.reg[ry].udspi[i + number / 2];
-                tmp2.udspl[i] = env->vfp.reg[rz + 1].udspl[i] + abs_64(a - b);
-            }
-            break;
-        default:
-            helper_exception(env, EXCP_CSKY_UDEF);
-            return;
-        }
-    }
-    memcpy(&env->vfp.reg[rz], &tmp1, sizeof(union VDSP));
-    memcpy(&env->vfp.reg[rz + 1], &tmp2, sizeof(union VDSP));
-}
-
-void VDSP2_HELPER(vneg)(CPUCSKYState *env, uint32_t insn)
-{
-    int i, number;
-    uint32_t size, width, rx, rz;
-
-    size = ((insn >> 20) & 0x1) | ((insn >> 24) & 0x2);
-    width = 8 << size;
-    number = 128 / width;
-
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-
-    switch (width) {
-    case 8:
-        for (i = 0; i < number; i++) {
-            env->vfp.reg[rz].dspc[i] = -(env->vfp.reg[rx].dspc[i]);
-        }
-        break;
-    case 16:
-        for (i = 0; i < number; i++) {
-            env->vfp.reg[rz].dsps[i] = -(env->vfp.reg[rx].dsps[i]);
-        }
-        break;
-    case 32:
-        for (i = 0; i < number; i++) {
-            env->vfp.reg[rz].dspi[i] = -(env->vfp.reg[rx].dspi[i]);
-        }
-        break;
-    default:
-        helper_exception(env, EXCP_CSKY_UDEF);
-        return;
-    }
-}
-
-void VDSP2_HELPER(vneg_s)(CPUCSKYState *env, uint32_t insn)
-{
-    int i, number;
-    uint32_t size, width, rx, rz;
-
-    size = ((insn >> 20) & 0x1) | ((insn >> 24) & 0x2);
-    width = 8 << size;
-    number = 128 / width;
-
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-
-    switch (width) {
-    case 8:
-        for (i = 0; i < number; i++) {
-            if (env->vfp.reg[rx].dspc[i] == MIN_S8) {
-                env->vfp.reg[rx].dspc[i] = MAX_S8;
-            } else {
-                env->vfp.reg[rz].dspc[i] = -(env->vfp.reg[rx].dspc[i]);
-            }
-        }
-        break;
-    case 16:
-        for (i = 0; i < number; i++) {
-            if (env->vfp.reg[rx].dsps[i] == MIN_S16) {
-                env->vfp.reg[rx].dsps[i] = MAX_S16;
-            } else {
-                env->vfp.reg[rz].dsps[i] = -(env->vfp.reg[rx].dsps[i]);
-            }
-        }
-        break;
-    case 32:
-        for (i = 0; i < number; i++) {
-            if (env->vfp.reg[rx].dspi[i] == MIN_S32) {
-                env->vfp.reg[rx].dspi[i] = MAX_S32;
-            } else {
-                env->vfp.reg[rz].dspi[i] = -(env->vfp.reg[rx].dspi[i]);
-            }
-        }
-        break;
-    default:
-        helper_exception(env, EXCP_CSKY_UDEF);
-        return;
-    }
-}
-
-void VDSP2_HELPER(vmax)(CPUCSKYState *env, uint32_t insn)
-{
-    int i, number;
-    uint32_t size, width, sign, rx, ry, rz;
-
-    size = ((insn >> 20) & 0x1) | ((insn >> 24) & 0x2);
-    width = 8 << size;
-    number = 128 / width;
-
-    sign = (insn >> CSKY_VDSP2_SIGN_SHI) & CSKY_VDSP2_SIGN_MASK;
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    ry = (insn >> CSKY_VDSP2_VREG_SHI_VRY) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-
-    if (sign) {
-        switch (width) {
-        case 8:
-            for (i = 0; i < number; i++) {
-                if (env->vfp.reg[rx].dspc[i] >= env->vfp.reg[ry].dspc[i]) {
-                    env->vfp.reg[rz].dspc[i] = env->vfp.reg[rx].dspc[i];
-                } else {
-                    env->vfp.reg[rz].dspc[i] = env->vfp.reg[ry].dspc[i];
-                }
-            }
-            break;
-        case 16:
-            for (i = 0; i < number; i++) {
-                if (env->vfp.reg[rx].dsps[i] >= env->vfp.reg[ry].dsps[i]) {
-                    env->vfp.reg[rz].dsps[i] = env->vfp.reg[rx].dsps[i];
-                } else {
-                    env->vfp.reg[rz].dsps[i] = env->vfp.reg[ry].dsps[i];
-                }
-            }
-            break;
-        case 32:
-            for (i = 0; i < number; i++) {
-                if (env->vfp.reg[rx].dspi[i] >= env->vfp.reg[ry].dspi[i]) {
-                    env->vfp.reg[rz].dspi[i] = env->vfp.reg[rx].dspi[i];
-                } else {
-                    env->vfp.reg[rz].dspi[i] = env->vfp.reg[ry].dspi[i];
-                }
-            }
-            break;
-        default:
-            helper_exception(env, EXCP_CSKY_UDEF);
-            return;
-        }
-    } else {
-        switch (width) {
-        case 8:
-            for (i = 0; i < number; i++) {
-                if (env->vfp.reg[rx].udspc[i] >= env->vfp.reg[ry].udspc[i]) {
-                    env->vfp.reg[rz].udspc[i] = env->vfp.reg[rx].udspc[i];
-                } else {
-                    env->vfp.reg[rz].udspc[i] = env->vfp.reg[ry].udspc[i];
-                }
-            }
-            break;
-        case 16:
-            for (i = 0; i < number; i++) {
-                if (env->vfp.reg[rx].udsps[i] >= env->vfp.reg[ry].udsps[i]) {
-                    env->vfp.reg[rz].udsps[i] = env->vfp.reg[rx].udsps[i];
-                } else {
-                    env->vfp.reg[rz].udsps[i] = env->vfp.reg[ry].udsps[i];
-                }
+                b = env->vfp.reg[ry].udsps[i + number / 2];
+                tmp2.udspi[i] = env->vfp.reg[rz + 1].udspi[i] + abs_32(a - b);
             }
             break;
         case 32:
-            for (i = 0; i < number; i++) {
-                if (env->vfp.reg[rx].udspi[i] >= env->vfp.reg[ry].udspi[i]) {
-                    env->vfp.reg[rz].udspi[i] = env->vfp.reg[rx].udspi[i];
-                } else {
-                    env->vfp.reg[rz].udspi[i] = env->vfp.reg[ry].udspi[i];
-                }
+            for (i = 0; i < number / 2; i++) {
+                uint64_t a, b;
+                a = env->vfp.reg[rx].udspi[i];
+                b = env->vfp.reg[ry].udspi[i];
+                tmp1.udspl[i] = env->vfp.reg[rz].udspl[i] + abs_64(a - b);
+
+                a = env->vfp.reg[rx].udspi[i + number / 2];
+                b = env->vfp.reg[ry].udspi[i + number / 2];
+                tmp2.udspl[i] = env->vfp.reg[rz + 1].udspl[i] + abs_64(a - b);
             }
             break;
         default:
@@ -2738,88 +2299,53 @@ void VDSP2_HELPER(vmax)(CPUCSKYState *env, uint32_t insn)
             return;
         }
     }
+    memcpy(&env->vfp.reg[rz], &tmp1, sizeof(union VDSP));
+    memcpy(&env->vfp.reg[rz + 1], &tmp2, sizeof(union VDSP));
 }
 
-void VDSP2_HELPER(vmin)(CPUCSKYState *env, uint32_t insn)
+void VDSP2_HELPER(vneg_s)(CPUCSKYState *env, uint32_t insn)
 {
     int i, number;
-    uint32_t size, width, sign, rx, ry, rz;
+    uint32_t size, width, rx, rz;
 
     size = ((insn >> 20) & 0x1) | ((insn >> 24) & 0x2);
     width = 8 << size;
     number = 128 / width;
 
-    sign = (insn >> CSKY_VDSP2_SIGN_SHI) & CSKY_VDSP2_SIGN_MASK;
     rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    ry = (insn >> CSKY_VDSP2_VREG_SHI_VRY) & CSKY_VDSP2_VREG_MASK;
     rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
 
-    if (sign) {
-        switch (width) {
-        case 8:
-            for (i = 0; i < number; i++) {
-                if (env->vfp.reg[rx].dspc[i] <= env->vfp.reg[ry].dspc[i]) {
-                    env->vfp.reg[rz].dspc[i] = env->vfp.reg[rx].dspc[i];
-                } else {
-                    env->vfp.reg[rz].dspc[i] = env->vfp.reg[ry].dspc[i];
-                }
-            }
-            break;
-        case 16:
-            for (i = 0; i < number; i++) {
-                if (env->vfp.reg[rx].dsps[i] <= env->vfp.reg[ry].dsps[i]) {
-                    env->vfp.reg[rz].dsps[i] = env->vfp.reg[rx].dsps[i];
-                } else {
-                    env->vfp.reg[rz].dsps[i] = env->vfp.reg[ry].dsps[i];
-                }
-            }
-            break;
-        case 32:
-            for (i = 0; i < number; i++) {
-                if (env->vfp.reg[rx].dspi[i] <= env->vfp.reg[ry].dspi[i]) {
-                    env->vfp.reg[rz].dspi[i] = env->vfp.reg[rx].dspi[i];
-                } else {
-                    env->vfp.reg[rz].dspi[i] = env->vfp.reg[ry].dspi[i];
-                }
+    switch (width) {
+    case 8:
+        for (i = 0; i < number; i++) {
+            if (env->vfp.reg[rx].dspc[i] == MIN_S8) {
+                env->vfp.reg[rx].dspc[i] = MAX_S8;
+            } else {
+                env->vfp.reg[rz].dspc[i] = -(env->vfp.reg[rx].dspc[i]);
             }
-            break;
-        default:
-            helper_exception(env, EXCP_CSKY_UDEF);
-            return;
         }
-    } else {
-        switch (width) {
-        case 8:
-            for (i = 0; i < number; i++) {
-                if (env->vfp.reg[rx].udspc[i] <= env->vfp.reg[ry].udspc[i]) {
-                    env->vfp.reg[rz].udspc[i] = env->vfp.reg[rx].udspc[i];
-                } else {
-                    env->vfp.reg[rz].udspc[i] = env->vfp.reg[ry].udspc[i];
-                }
-            }
-            break;
-        case 16:
-            for (i = 0; i < number; i++) {
-                if (env->vfp.reg[rx].udsps[i] <= env->vfp.reg[ry].udsps[i]) {
-                    env->vfp.reg[rz].udsps[i] = env->vfp.reg[rx].udsps[i];
-                } else {
-                    env->vfp.reg[rz].udsps[i] = env->vfp.reg[ry].udsps[i];
-                }
+        break;
+    case 16:
+        for (i = 0; i < number; i++) {
+            if (env->vfp.reg[rx].dsps[i] == MIN_S16) {
+                env->vfp.reg[rx].dsps[i] = MAX_S16;
+            } else {
+                env->vfp.reg[rz].dsps[i] = -(env->vfp.reg[rx].dsps[i]);
             }
-            break;
-        case 32:
-            for (i = 0; i < number; i++) {
-                if (env->vfp.reg[rx].udspi[i] <= env->vfp.reg[ry].udspi[i]) {
-                    env->vfp.reg[rz].udspi[i] = env->vfp.reg[rx].udspi[i];
-                } else {
-                    env->vfp.reg[rz].udspi[i] = env->vfp.reg[ry].udspi[i];
-                }
+        }
+        break;
+    case 32:
+        for (i = 0; i < number; i++) {
+            if (env->vfp.reg[rx].dspi[i] == MIN_S32) {
+                env->vfp.reg[rx].dspi[i] = MAX_S32;
+            } else {
+                env->vfp.reg[rz].dspi[i] = -(env->vfp.reg[rx].dspi[i]);
             }
-            break;
-        default:
-            helper_exception(env, EXCP_CSKY_UDEF);
-            return;
         }
+        break;
+    default:
+        helper_exception(env, EXCP_CSKY_UDEF);
+        return;
     }
 }
 
@@ -9274,53 +8800,6 @@ void VDSP2_HELPER(vshl_s)(CPUCSKYState *env, uint32_t insn)
     }
 }
 
-void VDSP2_HELPER(vshli)(CPUCSKYState *env, uint32_t insn)
-{
-    int i, number;
-    uint32_t width = 0, rx, rz, imm;
-
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-    imm = ((insn >> 19) & 0x7e) + ((insn >> 5) & 0x1);
-
-    decode_imm7(env, &imm, &width);
-    number = 128 / width;
-
-    switch (width) {
-    case 8:
-        for (i = 0; i < number; i++) {
-            uint8_t a;
-            a = env->vfp.reg[rx].udspc[i];
-            env->vfp.reg[rz].udspc[i] = shl_8(a, imm);
-        }
-        break;
-    case 16:
-        for (i = 0; i < number; i++) {
-            uint16_t a;
-            a = env->vfp.reg[rx].udsps[i];
-            env->vfp.reg[rz].udsps[i] = shl_16(a, imm);
-        }
-        break;
-    case 32:
-        for (i = 0; i < number; i++) {
-            uint32_t a;
-            a = env->vfp.reg[rx].udspi[i];
-            env->vfp.reg[rz].udspi[i] = shl_32(a, imm);
-        }
-        break;
-    case 64:
-        for (i = 0; i < number; i++) {
-            uint64_t a;
-            a = env->vfp.reg[rx].udspl[i];
-            env->vfp.reg[rz].udspl[i] = shl_64(a, imm);
-        }
-        break;
-    default:
-        helper_exception(env, EXCP_CSKY_UDEF);
-        return;
-    }
-}
-
 void VDSP2_HELPER(vshli_s)(CPUCSKYState *env, uint32_t insn)
 {
     int i, number;
@@ -9731,91 +9210,6 @@ void VDSP2_HELPER(vshr_r)(CPUCSKYState *env, uint32_t insn)
     }
 }
 
-void VDSP2_HELPER(vshri)(CPUCSKYState *env, uint32_t insn)
-{
-    int i, number;
-    uint32_t width = 0, sign, rx, rz, imm;
-
-    sign = (insn >> CSKY_VDSP2_SIGN_SHI) & CSKY_VDSP2_SIGN_MASK;
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-    imm = ((insn >> 19) & 0x7e) + ((insn >> 5) & 0x1);
-
-    decode_imm7(env, &imm, &width);
-    imm++;  /* oimm */
-    number = 128 / width;
-
-    if (sign) {
-        switch (width) {
-        case 8:
-            for (i = 0; i < number; i++) {
-                int8_t a;
-                a = env->vfp.reg[rx].dspc[i];
-                env->vfp.reg[rz].dspc[i] = shr_s8(a, imm);
-            }
-            break;
-        case 16:
-            for (i = 0; i < number; i++) {
-                int16_t a;
-                a = env->vfp.reg[rx].dsps[i];
-                env->vfp.reg[rz].dsps[i] = shr_s16(a, imm);
-            }
-            break;
-        case 32:
-            for (i = 0; i < number; i++) {
-                int32_t a;
-                a = env->vfp.reg[rx].dspi[i];
-                env->vfp.reg[rz].dspi[i] = shr_s32(a, imm);
-            }
-            break;
-        case 64:
-            for (i = 0; i < number; i++) {
-                int64_t a;
-                a = env->vfp.reg[rx].dspl[i];
-                env->vfp.reg[rz].dspl[i] = shr_s64(a, imm);
-            }
-            break;
-        default:
-            helper_exception(env, EXCP_CSKY_UDEF);
-            return;
-        }
-    } else {
-        switch (width) {
-        case 8:
-            for (i = 0; i < number; i++) {
-                uint8_t a;
-                a = env->vfp.reg[rx].udspc[i];
-                env->vfp.reg[rz].udspc[i] = shr_u8(a, imm);
-            }
-            break;
-        case 16:
-            for (i = 0; i < number; i++) {
-                uint16_t a;
-                a = env->vfp.reg[rx].udsps[i];
-                env->vfp.reg[rz].udsps[i] = shr_u16(a, imm);
-            }
-            break;
-        case 32:
-            for (i = 0; i < number; i++) {
-                uint32_t a;
-                a = env->vfp.reg[rx].udspi[i];
-                env->vfp.reg[rz].udspi[i] = shr_u32(a, imm);
-            }
-            break;
-        case 64:
-            for (i = 0; i < number; i++) {
-                uint64_t a;
-                a = env->vfp.reg[rx].udspl[i];
-                env->vfp.reg[rz].udspl[i] = shr_u64(a, imm);
-            }
-            break;
-        default:
-            helper_exception(env, EXCP_CSKY_UDEF);
-            return;
-        }
-    }
-}
-
 void VDSP2_HELPER(vshri_r)(CPUCSKYState *env, uint32_t insn)
 {
     int i, number;
@@ -11477,87 +10871,6 @@ void VDSP2_HELPER(vmaski)(CPUCSKYState *env, uint32_t insn)
     }
 }
 
-void VDSP2_HELPER(vand)(CPUCSKYState *env, uint32_t insn)
-{
-    uint32_t rx, ry, rz;
-
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    ry = (insn >> CSKY_VDSP2_VREG_SHI_VRY) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-
-    env->vfp.reg[rz].dspl[0] = (env->vfp.reg[rx].dspl[0]
-                                & env->vfp.reg[ry].dspl[0]);
-    env->vfp.reg[rz].dspl[1] = (env->vfp.reg[rx].dspl[1]
-                                & env->vfp.reg[ry].dspl[1]);
-}
-
-void VDSP2_HELPER(vandn)(CPUCSKYState *env, uint32_t insn)
-{
-    uint32_t rx, ry, rz;
-
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    ry = (insn >> CSKY_VDSP2_VREG_SHI_VRY) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-
-    env->vfp.reg[rz].dspl[0] = (env->vfp.reg[rx].dspl[0]
-                                & ~(env->vfp.reg[ry].dspl[0]));
-    env->vfp.reg[rz].dspl[1] = (env->vfp.reg[rx].dspl[1]
-                                & ~(env->vfp.reg[ry].dspl[1]));
-}
-
-void VDSP2_HELPER(vxor)(CPUCSKYState *env, uint32_t insn)
-{
-    uint32_t rx, ry, rz;
-
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    ry = (insn >> CSKY_VDSP2_VREG_SHI_VRY) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-
-    env->vfp.reg[rz].dspl[0] = (env->vfp.reg[rx].dspl[0]
-                                ^ env->vfp.reg[ry].dspl[0]);
-    env->vfp.reg[rz].dspl[1] = (env->vfp.reg[rx].dspl[1]
-                                ^ env->vfp.reg[ry].dspl[1]);
-}
-
-void VDSP2_HELPER(vnot)(CPUCSKYState *env, uint32_t insn)
-{
-    uint32_t rx, rz;
-
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-
-    env->vfp.reg[rz].dspl[0] = ~(env->vfp.reg[rx].dspl[0]);
-    env->vfp.reg[rz].dspl[1] = ~(env->vfp.reg[rx].dspl[1]);
-}
-
-void VDSP2_HELPER(vor)(CPUCSKYState *env, uint32_t insn)
-{
-    uint32_t rx, ry, rz;
-
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    ry = (insn >> CSKY_VDSP2_VREG_SHI_VRY) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-
-    env->vfp.reg[rz].dspl[0] = (env->vfp.reg[rx].dspl[0]
-                                | env->vfp.reg[ry].dspl[0]);
-    env->vfp.reg[rz].dspl[1] = (env->vfp.reg[rx].dspl[1]
-                                | env->vfp.reg[ry].dspl[1]);
-}
-
-void VDSP2_HELPER(vorn)(CPUCSKYState *env, uint32_t insn)
-{
-    uint32_t rx, ry, rz;
-
-    rx = (insn >> CSKY_VDSP2_VREG_SHI_VRX) & CSKY_VDSP2_VREG_MASK;
-    ry = (insn >> CSKY_VDSP2_VREG_SHI_VRY) & CSKY_VDSP2_VREG_MASK;
-    rz = (insn >> CSKY_VDSP2_VREG_SHI_VRZ) & CSKY_VDSP2_VREG_MASK;
-
-    env->vfp.reg[rz].dspl[0] = (env->vfp.reg[rx].dspl[0]
-                                | ~(env->vfp.reg[ry].dspl[0]));
-    env->vfp.reg[rz].dspl[1] = (env->vfp.reg[rx].dspl[1]
-                                | ~(env->vfp.reg[ry].dspl[1]));
-}
-
 void VDSP2_HELPER(vsel)(CPUCSKYState *env, uint32_t insn)
 {
     uint32_t rx, ry, rz, rk;
@@ -47,7 +47,12 @@ typedef struct DisasContext {
     int condexec_cond;
     int idly4_counter;
     bool trace_match;
+    /* enum csky_trace_tb_class, valid until pc reaches trace_limit */
+    int trace_class;
+    uint64_t trace_limit;
     TCGLabel *condlabel;
+    /* movi patched with the insn count once the TB is complete */
+    TCGOp *jcount_start_insn;
 
     uint64_t features;
 
@@ -97,6 +102,28 @@ typedef struct CPUCSKYTLBContext {
     uint8_t t_round_robin[CSKY_TLB_MAX / 2];
 } CPUCSKYTLBContext;
 
+/*
+ * Set associative JTLB that takes the hardware refills of 4K pages in
+ * place of the 2 x 64 entry one when -cpu-prop jtlb= is given.  The most
+ * recent refills are kept in a direct mapped cache of page walks tagged
+ * by VPN and ASID, which is always a subset of the sets.  The counters
+ * are kept in both modes and reported by query-csky-jtlb.
+ */
+#define CSKY_JTLB_WALK_NUM      16
+typedef struct CSKYJTLB {
+    uint32_t sets;              /* 0 when only the architectural JTLB is used */
+    uint32_t ways;
+    uint32_t world;             /* psr_t the entries were refilled in */
+    csky_tlb_t *entry;          /* sets * ways */
+    uint8_t *victim;            /* next way to replace in each set */
+    csky_tlb_t walk[CSKY_JTLB_WALK_NUM];
+
+    uint64_t hit;
+    uint64_t walk_hit;
+    uint64_t miss;
+    uint64_t refill;
+} CSKYJTLB;
+
 int mmu_get_physical_address(CPUCSKYState *env, hwaddr *physical,
                              int *prot, target_ulong address, int rw);
 int thin_mmu_get_physical_address(CPUCSKYState *env, hwaddr *physical,
@@ -629,6 +656,9 @@ static inline void helper_tee_choose_cr(CPUCSKYState *env)
         env->tlb_context->round_robin = env->tlb_context->nt_round_robin;
 #endif
     }
+#if !defined(CONFIG_USER_ONLY)
+    csky_asid_switch(env);
+#endif
 }
 
 /* For ck_tee_lite, when change from Trust to Non-Trust world by NT-interrupt,
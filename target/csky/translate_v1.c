@@ -44,6 +44,7 @@ static const char *regnames[] = {
 #define DISAS_JUMP    DISAS_TARGET_0 /* only pc was modified dynamically */
 #define DISAS_UPDATE  DISAS_TARGET_1 /* cpu state was modified dynamically */
 #define DISAS_TB_JUMP DISAS_TARGET_2 /* only pc was modified statically */
+#define DISAS_RETURN  DISAS_TARGET_3 /* as DISAS_JUMP, for a return */
 
 static TCGv_i32 cpu_R[16];
 static TCGv_i32 cpu_c;
@@ -70,6 +71,12 @@ void csky_translate_init(void)
                             offsetof(CPUCSKYState, regs[i]),
                             regnames[i]);
     }
+
+    /* Argument registers and sp, for -accel tcg,chain-regs=on */
+    for (i = 2; i < 6; i++) {
+        tcg_chain_global(tcgv_i32_temp(cpu_R[i]));
+    }
+    tcg_chain_global(tcgv_i32_temp(cpu_R[0]));
     cpu_c = tcg_global_mem_new_i32(cpu_env,
         offsetof(CPUCSKYState, psr_c), "cpu_c");
     cpu_v = tcg_global_mem_new_i32(cpu_env,
@@ -1368,6 +1375,7 @@ static inline void bsr(DisasContext *ctx, int offset)
     }
     val += ctx->pc + 2;
     tcg_gen_movi_tl(cpu_R[15], ctx->pc + 2);
+    translator_push_return(&ctx->base);
 
     gen_goto_tb(ctx, 0, val);
 }
@@ -1408,6 +1416,7 @@ static void disas_csky_v1_insn(CPUCSKYState *env, DisasContext *ctx)
 #endif
                     break;/*bkpt*/
                 case 0x1:
+                    tcg_gen_mb(TCG_MO_ALL | TCG_BAR_SC);
                     break;/*sync*/
                 case 0x2:
 #if defined(CONFIG_USER_ONLY)
@@ -1722,13 +1731,14 @@ static void disas_csky_v1_insn(CPUCSKYState *env, DisasContext *ctx)
                 }
                 ctx->maybe_change_flow = 1;
 #endif
-                ctx->base.is_jmp = DISAS_JUMP;
+                ctx->base.is_jmp = rx == 15 ? DISAS_RETURN : DISAS_JUMP;
                 break;/*jmp*/
             case 0xd:
                 rx = insn & 0x000f;
                 t0 = tcg_temp_new();
                 tcg_gen_andi_tl(t0, cpu_R[rx], 0xfffffffe);
                 tcg_gen_movi_tl(cpu_R[15], ctx->pc + 2);
+                translator_push_return(&ctx->base);
                 store_cpu_field(t0, pc);
 
 #if !defined(CONFIG_USER_ONLY)
@@ -2723,6 +2733,7 @@ static void disas_csky_v1_insn(CPUCSKYState *env, DisasContext *ctx)
             addr = (ctx->pc + 2 + (disp << 2)) & 0xfffffffc;
             tcg_gen_movi_tl(t1, addr);
             tcg_gen_movi_tl(cpu_R[15], ctx->pc + 2);
+            translator_push_return(&ctx->base);
 #if defined(CONFIG_USER_ONLY)
             addr = cpu_ldl_code(env, addr);
             if (gen_mem_trace()) {
@@ -2879,18 +2890,37 @@ illegal_op:
     }
 }
 
-static void csky_trace_tb_start(CPUCSKYState *env, const TranslationBlock *tb)
+static void csky_trace_tb_start(DisasContext *dc, const TranslationBlock *tb)
 {
     uint32_t tb_pc = (uint32_t)tb->pc;
     TCGv t0 = tcg_constant_tl(tb_pc);
-    gen_helper_trace_tb_start(cpu_env, t0);
+
+    dc->trace_class = csky_trace_tb_class(tb_pc, &dc->trace_limit);
+    switch (dc->trace_class) {
+    case TRACE_TB_INSIDE:
+        gen_helper_trace_tb_start_fast(cpu_env, t0);
+        break;
+    case TRACE_TB_OUTSIDE:
+        /* data trace still needs the tb pc for proxy offsets */
+        if (tfilter.proxy) {
+            store_cpu_field(t0, last_pc);
+        }
+        break;
+    default:
+        gen_helper_trace_tb_start(cpu_env, t0);
+        break;
+    }
 }
 
-static void csky_trace_tb_exit(uint32_t subtype, uint32_t offset)
+static void csky_trace_tb_exit(DisasContext *dc, uint32_t subtype,
+                               uint32_t offset)
 {
     TCGv t0 = tcg_constant_tl(subtype);
     TCGv t1 = tcg_constant_tl(offset);
 
+    if (dc->trace_class == TRACE_TB_OUTSIDE) {
+        return;
+    }
     gen_helper_trace_tb_exit(t0, t1);
 }
 
@@ -2911,7 +2941,6 @@ static void csky_dump_tb_map(DisasContextBase *dcbase)
                   tb_pc, tb_end, icount);
 }
 
-static TCGOp *jcount_start_insn;
 static void gen_csky_jcount_start(DisasContext *dc, CPUCSKYState *env)
 {
     CPUState *cs = env_cpu(env);
@@ -2921,7 +2950,7 @@ static void gen_csky_jcount_start(DisasContext *dc, CPUCSKYState *env)
      * of the movi so that we later (when we know the actual insn count)
      * can update the immediate argument with the actual insn count.  */
     tcg_gen_movi_i32(t1, 0xdeadbeef);
-    jcount_start_insn = tcg_last_op();
+    dc->jcount_start_insn = tcg_last_op();
 
     tcg_gen_movi_tl(t0, dc->pc);
     if (env->jcount_start != 0) {
@@ -2932,9 +2961,9 @@ static void gen_csky_jcount_start(DisasContext *dc, CPUCSKYState *env)
     }
 }
 
-static void gen_csky_jcount_end(int num_insns)
+static void gen_csky_jcount_end(DisasContext *dc, int num_insns)
 {
-    tcg_set_insn_param(jcount_start_insn, 1,
+    tcg_set_insn_param(dc->jcount_start_insn, 1,
                        tcgv_i32_arg(tcg_constant_i32(num_insns)));
 }
 
@@ -2957,6 +2986,7 @@ static void csky_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cs)
 #endif
 
     dc->pc = dc->base.pc_first;
+    /* fixed when the CPU is configured, like for ABIv2 */
     dc->features = env->features;
 
 #ifndef CONFIG_USER_ONLY
@@ -2968,11 +2998,13 @@ static void csky_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cs)
 #ifdef CONFIG_USER_ONLY
     dc->mem_idx = CSKY_USERMODE;
 #else
-    dc->mem_idx = dc->super;
+    dc->mem_idx = CSKY_MMU_IDX(tb->cs_base, dc->super);
 #endif
 
     dc->next_page_start =
         (dc->base.pc_first & TARGET_PAGE_MASK) + TARGET_PAGE_SIZE;
+    dc->trace_class = TRACE_TB_FILTER;
+    dc->trace_limit = UINT64_MAX;
 }
 
 static void csky_tr_tb_start(DisasContextBase *dcbase, CPUState *cpu)
@@ -2981,8 +3013,12 @@ static void csky_tr_tb_start(DisasContextBase *dcbase, CPUState *cpu)
     DisasContext *dc = container_of(dcbase, DisasContext, base);
     const TranslationBlock *tb = dcbase->tb;
 
-    dc->idly4_counter = env->idly4_counter;
-    dc->condexec_cond = env->sce_condexec_bits;
+    dc->idly4_counter = CSKY_TBFLAG_IDLY4(tb->flags);
+    /*
+     * ABIv1 has no SCE: the condexec bits stay at their reset value and
+     * are not in the flags, so do not read them from a live env.
+     */
+    dc->condexec_cond = 1;
 
     if (tfilter.enable) {
         dc->trace_match = trace_match_range(env, dc->pc);
@@ -2995,7 +3031,7 @@ static void csky_tr_tb_start(DisasContextBase *dcbase, CPUState *cpu)
     }
 
     if (gen_tb_trace()) {
-        csky_trace_tb_start(env, tb);
+        csky_trace_tb_start(dc, tb);
     }
 
     if (env->tb_trace == 1 || env->pctrace == 1) {
@@ -3045,6 +3081,14 @@ static bool csky_pre_translate_insn(DisasContext *dc, CPUState *cpu)
         }
     }
 
+    /* keep the tb within one trace window, see csky_trace_tb_class. */
+    if (unlikely(dc->pc >= dc->trace_limit)) {
+        gen_save_pc(dc->pc);
+        dc->base.is_jmp = DISAS_UPDATE;
+        dc->base.num_insns--;
+        return true;
+    }
+
     if ((!dc->trace_match) && tfilter.enable) {
         if (unlikely(trace_match_range(env, dc->pc))) {
             gen_save_pc(dc->pc);
@@ -3092,7 +3136,7 @@ static void csky_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
         return;
     }
 
-    dc->insn = cpu_lduw_code(env, dc->pc);
+    dc->insn = translator_lduw(env, &dc->base, dc->pc);
 
     /* 16 bit instruction*/
     disas_csky_v1_insn(env, dc);
@@ -3101,6 +3145,22 @@ static void csky_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
     csky_post_translate_insn(dc);
 }
 
+/*
+ * Look up the TB for the pc just stored, or find it in the inline cache
+ * of the jump; returns are predicted from the return-address stack.
+ */
+static void gen_indirect_jump(DisasContext *dc, bool is_return)
+{
+    TCGv_i64 dest = tcg_temp_new_i64();
+
+    tcg_gen_extu_i32_i64(dest, load_cpu_field(pc));
+    if (is_return) {
+        translator_return(&dc->base, dest);
+    } else {
+        translator_lookup_and_goto_ptr(&dc->base, dest);
+    }
+}
+
 static void csky_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
 {
     DisasContext *dc = container_of(dcbase, DisasContext, base);
@@ -3112,14 +3172,14 @@ static void csky_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
     if (gen_tb_trace()) {
         if (cpu->singlestep_enabled) {
             /* exit on singlestep. */
-            csky_trace_tb_exit(0x1, dc->pc - dc->base.pc_first);
+            csky_trace_tb_exit(dc, 0x1, dc->pc - dc->base.pc_first);
         } else if (dc->base.is_jmp == DISAS_NEXT
             || dc->base.is_jmp == DISAS_UPDATE) {
             /* exit on special insns. */
-            csky_trace_tb_exit(0x2, dc->pc - dc->base.pc_first);
+            csky_trace_tb_exit(dc, 0x2, dc->pc - dc->base.pc_first);
         } else if (dc->base.is_jmp == DISAS_TOO_MANY) {
             /* exit on too many insns. */
-            csky_trace_tb_exit(0x3, dc->pc - dc->base.pc_first);
+            csky_trace_tb_exit(dc, 0x3, dc->pc - dc->base.pc_first);
         }
     }
     if (dc->base.is_jmp != DISAS_TB_JUMP && dc->base.is_jmp != DISAS_TB_JUMP) {
@@ -3143,8 +3203,8 @@ static void csky_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
             gen_goto_tb(dc, 1, dc->pc);
             break;
         case DISAS_JUMP:
-            /* indicate that the hash table must be used to find the next TB */
-            tcg_gen_lookup_and_goto_ptr();
+        case DISAS_RETURN:
+            gen_indirect_jump(dc, dc->base.is_jmp == DISAS_RETURN);
             break;
         case DISAS_UPDATE:
             /* special insns like mtcr/wait/rfi
@@ -3164,7 +3224,7 @@ static void csky_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
     }
 
     if (env->jcount_start != 0 || cpu->csky_trace_features & CSKY_TRACE) {
-        gen_csky_jcount_end(dcbase->num_insns);
+        gen_csky_jcount_end(dc, dcbase->num_insns);
     }
 
     if (env->tb_trace == 1) {
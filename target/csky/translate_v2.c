@@ -27,6 +27,7 @@
 #include "exec/log.h"
 #include "exec/translator.h"
 #include "tcg/tcg-op.h"
+#include "tcg/tcg-op-gvec.h"
 #include "qemu/log.h"
 #include <math.h>
 #include "exec/gdbstub.h"
@@ -52,6 +53,7 @@
 #define DISAS_JUMP    DISAS_TARGET_0 /* only pc was modified dynamically */
 #define DISAS_UPDATE  DISAS_TARGET_1 /* cpu state was modified dynamically */
 #define DISAS_TB_JUMP DISAS_TARGET_2 /* only pc was modified statically */
+#define DISAS_RETURN  DISAS_TARGET_3 /* as DISAS_JUMP, for a return */
 
 static TCGv_i32 cpu_R[32];
 static TCGv_i32 cpu_c;
@@ -232,6 +234,12 @@ void csky_translate_init(void)
             regnames[i]);
     }
 
+    /* Argument registers and sp, for -accel tcg,chain-regs=on */
+    for (i = 0; i < 4; i++) {
+        tcg_chain_global(tcgv_i32_temp(cpu_R[i]));
+    }
+    tcg_chain_global(tcgv_i32_temp(cpu_R[14]));
+
     cpu_c = tcg_global_mem_new_i32(cpu_env,
         offsetof(CPUCSKYState, psr_c), "cpu_c");
     cpu_v = tcg_global_mem_new_i32(cpu_env,
@@ -284,23 +292,125 @@ static inline void gen_save_pc(target_ulong pc)
 
 }
 
-static void csky_trace_tb_start(CPUCSKYState *env, const TranslationBlock *tb)
+static void csky_trace_tb_start(DisasContext *dc, const TranslationBlock *tb)
 {
     uint32_t tb_pc = (uint32_t)tb->pc;
-    TCGv t0;
+    TCGv t0 = tcg_constant_tl(tb_pc);
 
-    t0 = tcg_constant_tl(tb_pc);
-    gen_helper_trace_tb_start(cpu_env, t0);
+    dc->trace_class = csky_trace_tb_class(tb_pc, &dc->trace_limit);
+    switch (dc->trace_class) {
+    case TRACE_TB_INSIDE:
+        gen_helper_trace_tb_start_fast(cpu_env, t0);
+        break;
+    case TRACE_TB_OUTSIDE:
+        /* data trace still needs the tb pc for proxy offsets */
+        if (tfilter.proxy) {
+            store_cpu_field(t0, last_pc);
+        }
+        break;
+    default:
+        gen_helper_trace_tb_start(cpu_env, t0);
+        break;
+    }
 }
 
-static void csky_trace_tb_exit(uint32_t subtype, uint32_t offset)
+static void csky_trace_tb_exit(DisasContext *dc, uint32_t subtype,
+                               uint32_t offset)
 {
     TCGv t0 = tcg_constant_tl(subtype);
     TCGv t1 = tcg_constant_tl(offset);
 
+    if (dc->trace_class == TRACE_TB_OUTSIDE) {
+        return;
+    }
     gen_helper_trace_tb_exit(t0, t1);
 }
 
+/*
+ * Store a data trace record into env->trace_rec through a bump offset.
+ * The trace_rec_flush helper only runs when the buffer is full, the
+ * records are turned into packets before the next packet of this vCPU.
+ */
+static void gen_trace_rec(DisasContext *ctx, int type, TCGv val, TCGv addr)
+{
+    TCGLabel *l1 = gen_new_label();
+    TCGv_i32 pos = tcg_temp_new_i32();
+    TCGv_ptr rec = tcg_temp_new_ptr();
+    intptr_t base = offsetof(CPUCSKYState, trace_rec);
+
+    tcg_gen_ld_i32(pos, cpu_env, offsetof(CPUCSKYState, trace_rec_pos));
+    tcg_gen_brcondi_i32(TCG_COND_LTU, pos,
+                        sizeof_field(CPUCSKYState, trace_rec), l1);
+    gen_helper_trace_rec_flush(cpu_env);
+    tcg_gen_movi_i32(pos, 0);
+    gen_set_label(l1);
+
+    tcg_gen_ext_i32_ptr(rec, pos);
+    tcg_gen_add_ptr(rec, rec, cpu_env);
+    tcg_gen_st_i32(tcg_constant_i32(type), rec,
+                   base + offsetof(struct CSKYTraceRec, type));
+    tcg_gen_st_i32(tcg_constant_i32(ctx->pc), rec,
+                   base + offsetof(struct CSKYTraceRec, pc));
+    if (tfilter.proxy) {
+        TCGv_i32 t0 = load_cpu_field(last_pc);
+        tcg_gen_st_i32(t0, rec, base + offsetof(struct CSKYTraceRec, last_pc));
+    }
+    tcg_gen_st_i32(addr, rec, base + offsetof(struct CSKYTraceRec, addr));
+    tcg_gen_st_i32(val, rec, base + offsetof(struct CSKYTraceRec, value));
+    tcg_gen_addi_i32(pos, pos, sizeof(struct CSKYTraceRec));
+    store_cpu_field(pos, trace_rec_pos);
+}
+
+/* enum mem_ldst_type of each trace helper suffix, for the ld/st macros */
+enum {
+    TRACE_ld8u = LD8U,
+    TRACE_ld16u = LD16U,
+    TRACE_ld32u = LD32U,
+    TRACE_ld8s = LD8S,
+    TRACE_ld16s = LD16S,
+    TRACE_st8 = ST8,
+    TRACE_st16 = ST16,
+    TRACE_st32 = ST32,
+};
+
+static void gen_trace_ldst(DisasContext *ctx, int type, TCGv val, TCGv addr)
+{
+    TCGv_i32 t0 = tcg_constant_i32(ctx->pc);
+
+    if (gen_mem_trace_inline()) {
+        gen_trace_rec(ctx, type, val, addr);
+        return;
+    }
+    switch (type) {
+    case LD8U:
+        gen_helper_trace_ld8u(cpu_env, t0, val, addr);
+        break;
+    case LD16U:
+        gen_helper_trace_ld16u(cpu_env, t0, val, addr);
+        break;
+    case LD32U:
+        gen_helper_trace_ld32u(cpu_env, t0, val, addr);
+        break;
+    case LD8S:
+        gen_helper_trace_ld8s(cpu_env, t0, val, addr);
+        break;
+    case LD16S:
+        gen_helper_trace_ld16s(cpu_env, t0, val, addr);
+        break;
+    case ST8:
+        gen_helper_trace_st8(cpu_env, t0, val, addr);
+        break;
+    case ST16:
+        gen_helper_trace_st16(cpu_env, t0, val, addr);
+        break;
+    case ST32:
+        gen_helper_trace_st32(cpu_env, t0, val, addr);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
 static void csky_tb_start_tb(CPUCSKYState *env, const TranslationBlock *tb)
 {
     uint32_t tb_pc = (uint32_t)tb->pc;
@@ -320,11 +430,11 @@ static inline void generate_exception(DisasContext *ctx, int excp)
         if (current_cpu->singlestep_enabled) {
             excp = EXCP_DEBUG;
             if (gen_tb_trace()) {
-                csky_trace_tb_exit(0x1, ctx->pc - ctx->base.pc_first);
+                csky_trace_tb_exit(ctx, 0x1, ctx->pc - ctx->base.pc_first);
             }
         } else {
             if (gen_tb_trace()) {
-                csky_trace_tb_exit(0x2, ctx->pc - ctx->base.pc_first);
+                csky_trace_tb_exit(ctx, 0x2, ctx->pc - ctx->base.pc_first);
             }
         }
     }
@@ -343,9 +453,9 @@ static inline void gen_goto_tb(DisasContext *ctx, int n, uint32_t dest)
 
     if (unlikely(ctx->base.singlestep_enabled)) {
         if ((ctx->insn & 0xc0000000) != 0xc0000000) {
-            csky_trace_tb_exit(0x1, ctx->pc + 2 - ctx->base.pc_first);
+            csky_trace_tb_exit(ctx, 0x1, ctx->pc + 2 - ctx->base.pc_first);
         } else {
-            csky_trace_tb_exit(0x1, ctx->pc + 4 - ctx->base.pc_first);
+            csky_trace_tb_exit(ctx, 0x1, ctx->pc + 4 - ctx->base.pc_first);
         }
         gen_save_pc(dest);
         t0 = tcg_constant_tl(EXCP_DEBUG);
@@ -372,6 +482,24 @@ static inline void gen_goto_tb(DisasContext *ctx, int n, uint32_t dest)
 
 }
 
+/*
+ * Unconditional direct branch of @isize bytes to @dest.  A superblock
+ * goes on translating at @dest instead, unless the branch itself is
+ * conditionally executed.  dc->pc is advanced past the branch once it
+ * has been decoded, so leave it that far short of @dest.
+ */
+static void gen_jump(DisasContext *ctx, uint32_t dest, int isize)
+{
+    if (ctx->condexec_cond == 1 && ctx->idly4_counter == 0 &&
+        translator_follow_jump(&ctx->base, ctx->pc + isize, dest)) {
+        ctx->pc = dest - isize;
+        return;
+    }
+
+    gen_goto_tb(ctx, 0, dest);
+    ctx->base.is_jmp = DISAS_TB_JUMP;
+}
+
 #define ldst(name, suf, rx, rz, imm, isize, mop)                   \
 do {                                                               \
     if (ctx->bctm) {                                               \
@@ -385,8 +513,7 @@ do {                                                               \
         tcg_gen_addi_tl(t0, cpu_R[rx], imm);                       \
         tcg_gen_qemu_##name(cpu_R[rz], t0, ctx->mem_idx, mop);     \
         if (gen_mem_trace()) {                                     \
-            TCGv_i32 t2 = tcg_constant_i32(ctx->pc);               \
-            gen_helper_trace_##suf(cpu_env, t2, cpu_R[rz], t0);    \
+            gen_trace_ldst(ctx, TRACE_##suf, cpu_R[rz], t0);       \
         }                                                          \
         gen_goto_tb(ctx, 1, ctx->pc + isize);                      \
         ctx->base.is_jmp = DISAS_TB_JUMP;                          \
@@ -394,8 +521,7 @@ do {                                                               \
         tcg_gen_addi_tl(t0, cpu_R[rx], imm);                       \
         tcg_gen_qemu_##name(cpu_R[rz], t0, ctx->mem_idx, mop);     \
         if (gen_mem_trace()) {                                     \
-            TCGv_i32 t2 = tcg_constant_i32(ctx->pc);               \
-            gen_helper_trace_##suf(cpu_env, t2, cpu_R[rz], t0);    \
+            gen_trace_ldst(ctx, TRACE_##suf, cpu_R[rz], t0);       \
         }                                                          \
     }                                                              \
 } while (0)
@@ -414,8 +540,7 @@ do {                                                               \
         tcg_gen_add_tl(t0, cpu_R[rx], t0);                         \
         tcg_gen_qemu_##name(cpu_R[rz], t0, ctx->mem_idx, mop);     \
         if (gen_mem_trace()) {                                     \
-            TCGv_i32 t2 = tcg_constant_i32(ctx->pc);               \
-            gen_helper_trace_##suf(cpu_env, t2, cpu_R[rz], t0);    \
+            gen_trace_ldst(ctx, TRACE_##suf, cpu_R[rz], t0);       \
         }                                                          \
         gen_goto_tb(ctx, 1, ctx->pc + 4);                          \
         ctx->base.is_jmp = DISAS_TB_JUMP;                          \
@@ -425,8 +550,7 @@ do {                                                               \
         tcg_gen_add_tl(t0, cpu_R[rx], t0);                         \
         tcg_gen_qemu_##name(cpu_R[rz], t0, ctx->mem_idx, mop);     \
         if (gen_mem_trace()) {                                     \
-            TCGv_i32 t2 = tcg_constant_i32(ctx->pc);               \
-            gen_helper_trace_##suf(cpu_env, t2, cpu_R[rz], t0);    \
+            gen_trace_ldst(ctx, TRACE_##suf, cpu_R[rz], t0);       \
         }                                                          \
     }                                                              \
 } while (0)
@@ -618,9 +742,7 @@ static inline void bsr16(DisasContext *ctx, int offset)
     }
     val += ctx->pc;
 
-    gen_goto_tb(ctx, 0, val);
-
-    ctx->base.is_jmp = DISAS_TB_JUMP;
+    gen_jump(ctx, val, 2);
 }
 
 static inline void pop16(DisasContext *ctx, int imm)
@@ -663,7 +785,7 @@ static inline void pop16(DisasContext *ctx, int imm)
 
     tcg_gen_andi_tl(t0, cpu_R[15], 0xfffffffe);
     store_cpu_field(t0, pc);
-    ctx->base.is_jmp = DISAS_JUMP;
+    ctx->base.is_jmp = DISAS_RETURN;
 }
 
 static inline void push16(DisasContext *ctx, int imm)
@@ -857,7 +979,7 @@ static inline void gen_arith_misc16(DisasContext *ctx, uint32_t sop,
             }
             ctx->maybe_change_flow = 1;
 #endif
-            ctx->base.is_jmp = DISAS_JUMP;
+            ctx->base.is_jmp = rx == 15 ? DISAS_RETURN : DISAS_JUMP;
         }
         break;
     case 0x1:
@@ -866,6 +988,7 @@ static inline void gen_arith_misc16(DisasContext *ctx, uint32_t sop,
             TCGv t0 = tcg_temp_new();
             tcg_gen_andi_tl(t0, cpu_R[rx], 0xfffffffe);
             tcg_gen_movi_tl(cpu_R[15], ctx->pc + 2);
+            translator_push_return(&ctx->base);
             store_cpu_field(t0, pc);
 
 #if !defined(CONFIG_USER_ONLY)
@@ -948,6 +1071,7 @@ static void gen_branch16(DisasContext *ctx, uint32_t op, int offset)
         } else if (!has_insn(ctx, ABIV2_ELRW)) {
             /*bsr16*/
             tcg_gen_movi_tl(cpu_R[15], ctx->pc + 2);
+            translator_push_return(&ctx->base);
             bsr16(ctx, offset);
         } else {
             /* lrw16 extend */
@@ -973,9 +1097,7 @@ static void gen_branch16(DisasContext *ctx, uint32_t op, int offset)
             }
             val += ctx->pc;
 
-            gen_goto_tb(ctx, 0, val);
-
-            ctx->base.is_jmp = DISAS_TB_JUMP;
+            gen_jump(ctx, val, 2);
         }
         break;
     case 0x2:
@@ -1396,14 +1518,13 @@ static void disas_csky_16_insn(CPUCSKYState *env, DisasContext *ctx)
     case 0x4:
         /*lrw16*/
         t0 = tcg_temp_new();
-        TCGv_i32 t3 = tcg_constant_i32(ctx->pc);
         imm = ((insn & 0x300) >> 3) | (insn & 0x1f);
         rz = (insn >> 5) & 0x7;
         addr = (ctx->pc + (imm << 2)) & 0xfffffffc ;
         tcg_gen_movi_tl(t0, addr);
         tcg_gen_qemu_ld_i32(cpu_R[rz], t0, ctx->mem_idx, MO_TEUL);
         if (gen_mem_trace()) {
-            gen_helper_trace_ld32u(cpu_env, t3, cpu_R[rz], t0);
+            gen_trace_ldst(ctx, LD32U, cpu_R[rz], t0);
         }
         break;
     case 0x5:
@@ -1553,9 +1674,7 @@ static inline void bsr32(DisasContext *ctx, int offset)
     }
     val += ctx->pc;
 
-    gen_goto_tb(ctx, 0, val);
-
-    ctx->base.is_jmp = DISAS_TB_JUMP;
+    gen_jump(ctx, val, 4);
 }
 
 static inline void sce(DisasContext *ctx, int cond)
@@ -2466,9 +2585,7 @@ static inline int csky_log2(uint32_t s)
 do {                                                            \
     tcg_gen_qemu_##name(cpu_R[rz], cpu_R[rx], ctx->mem_idx, mop);    \
     if (gen_mem_trace()) {                                      \
-        TCGv_i32 t2;                       \
-        t2 = tcg_constant_i32(ctx->pc);                            \
-        gen_helper_trace_##suf(cpu_env, t2, cpu_R[rz], cpu_R[rx]);    \
+        gen_trace_ldst(ctx, TRACE_##suf, cpu_R[rz], cpu_R[rx]);  \
     }                                                           \
     tcg_gen_addi_tl(cpu_R[rx], cpu_R[rx], imm);                 \
 } while (0)
@@ -2478,9 +2595,7 @@ do {                                                            \
     tcg_gen_mov_tl(t0, cpu_R[ry]);                              \
     tcg_gen_qemu_##name(cpu_R[rz], cpu_R[rx], ctx->mem_idx, mop);    \
     if (gen_mem_trace()) {                                      \
-        TCGv_i32 t2;                       \
-        t2 = tcg_constant_i32(ctx->pc);                            \
-        gen_helper_trace_##suf(cpu_env, t2, cpu_R[rz], cpu_R[rx]);    \
+        gen_trace_ldst(ctx, TRACE_##suf, cpu_R[rz], cpu_R[rx]);  \
     }                                                           \
     tcg_gen_add_tl(cpu_R[rx], cpu_R[rx], t0);                   \
 } while (0)
@@ -2490,15 +2605,14 @@ static inline void dspv2_insn_pldbi_d(DisasContext *s, int rz, int rx)
     /* Rz[31:0] <- mem(Rx)
      * Rz+1[31:0] <- mem(Rx + 4)
      * Rx[31:0] <- Rx[31:0] + 8 */
-    TCGv_i32 t2 = tcg_constant_i32(s->pc);
     tcg_gen_qemu_ld_i32(cpu_R[rz], cpu_R[rx], s->mem_idx, MO_TEUL);
     if (gen_mem_trace()) {
-        gen_helper_trace_ld32u(cpu_env, t2, cpu_R[rz], cpu_R[rx]);
+        gen_trace_ldst(s, LD32U, cpu_R[rz], cpu_R[rx]);
     }
     tcg_gen_addi_i32(cpu_R[rx], cpu_R[rx], 4);
     tcg_gen_qemu_ld_i32(cpu_R[(rz + 1) % 32], cpu_R[rx], s->mem_idx, MO_TEUL);
     if (gen_mem_trace()) {
-        gen_helper_trace_ld32u(cpu_env, t2, cpu_R[(rz + 1) % 32], cpu_R[rx]);
+        gen_trace_ldst(s, LD32U, cpu_R[(rz + 1) % 32], cpu_R[rx]);
     }
     tcg_gen_addi_i32(cpu_R[rx], cpu_R[rx], 4);
 }
@@ -2509,16 +2623,15 @@ static inline void dspv2_insn_pldbir_d(DisasContext *s, int rz, int rx, int ry)
      * Rz+1[31:0] <- mem(Rx + Ry)
      * Rx[31:0] <- Rx[31:0] + 2*Ry */
     TCGv_i32 t0 = tcg_temp_new_i32();
-    TCGv_i32 t2 = tcg_constant_i32(s->pc);
     tcg_gen_mov_i32(t0, cpu_R[ry]);
     tcg_gen_qemu_ld_i32(cpu_R[rz], cpu_R[rx], s->mem_idx, MO_TEUL);
     if (gen_mem_trace()) {
-        gen_helper_trace_ld32u(cpu_env, t2, cpu_R[rz], cpu_R[rx]);
+        gen_trace_ldst(s, LD32U, cpu_R[rz], cpu_R[rx]);
     }
     tcg_gen_add_i32(cpu_R[rx], cpu_R[rx], t0);
     tcg_gen_qemu_ld_i32(cpu_R[(rz + 1) % 32], cpu_R[rx], s->mem_idx, MO_TEUL);
     if (gen_mem_trace()) {
-        gen_helper_trace_ld32u(cpu_env, t2, cpu_R[(rz + 1) % 32], cpu_R[rx]);
+        gen_trace_ldst(s, LD32U, cpu_R[(rz + 1) % 32], cpu_R[rx]);
     }
     tcg_gen_add_i32(cpu_R[rx], cpu_R[rx], t0);
 }
@@ -2862,14 +2975,15 @@ static inline void pop(DisasContext *ctx, int imm)
 
     tcg_gen_andi_tl(t0, cpu_R[15], 0xfffffffe);
     store_cpu_field(t0, pc);
-    ctx->base.is_jmp = DISAS_JUMP;
+    ctx->base.is_jmp = DISAS_RETURN;
 }
 
 static inline void ldex_w(DisasContext *ctx,
                           uint32_t rz, uint32_t rx, uint32_t imm)
 {
     tcg_gen_addi_tl(excl_addr, cpu_R[rx], imm << 2);
-    tcg_gen_qemu_ld_i32(excl_val, excl_addr, ctx->mem_idx, MO_TEUL);
+    tcg_gen_qemu_ld_i32(excl_val, excl_addr, ctx->mem_idx,
+                        MO_TEUL | MO_ALIGN);
     tcg_gen_mov_i32(cpu_R[rz], excl_val);
 }
 
@@ -2998,7 +3112,7 @@ static inline void stex_w(DisasContext *ctx,
     TCGLabel *l3 = gen_new_label();
     TCGLabel *l4 = gen_new_label();
 
-    MemOp opc = 2 | MO_ALIGN | MO_LE;
+    MemOp opc = MO_TEUL | MO_ALIGN;
 
     t0 = tcg_temp_new_i32();
     t1 = tcg_temp_new_i32();
@@ -3059,6 +3173,37 @@ static void sti(DisasContext *ctx, uint32_t sop, int rz, int rx, int imm)
     }
 }
 
+/*
+ * bar orders the accesses selected by rz<3:2> (before: write, read)
+ * against those selected by rz<1:0> (after: write, read).  An empty
+ * side selects both kinds of access.
+ */
+static TCGBar gen_bar_type(int rz)
+{
+    bool bw = rz & 0x8, br = rz & 0x4, aw = rz & 0x2, ar = rz & 0x1;
+    TCGBar bar = 0;
+
+    if (!bw && !br) {
+        bw = br = true;
+    }
+    if (!aw && !ar) {
+        aw = ar = true;
+    }
+    if (br && ar) {
+        bar |= TCG_MO_LD_LD;
+    }
+    if (br && aw) {
+        bar |= TCG_MO_LD_ST;
+    }
+    if (bw && ar) {
+        bar |= TCG_MO_ST_LD;
+    }
+    if (bw && aw) {
+        bar |= TCG_MO_ST_ST;
+    }
+    return bar;
+}
+
 static inline void special(DisasContext *ctx, int rx, uint32_t sop,
                             int rz, int ry)
 {
@@ -3068,6 +3213,7 @@ static inline void special(DisasContext *ctx, int rx, uint32_t sop,
     switch (sop) {
     case 0x1:
         /* sync */
+        tcg_gen_mb(TCG_MO_ALL | TCG_BAR_SC);
         break;
     case 0x4:
         /* bmset */
@@ -3392,7 +3538,7 @@ static inline void special(DisasContext *ctx, int rx, uint32_t sop,
     case 0x21:
         /* bar */
         check_insn(ctx, CPU_C860);
-        /* ignore this instruction. */
+        tcg_gen_mb(gen_bar_type(rz) | TCG_BAR_SC);
         break;
     case 0x22:
         /* ck860 tlbi instructions */
@@ -4097,7 +4243,7 @@ static inline void imm_1op(DisasContext *ctx, uint32_t sop, int rx, int imm)
 {
     target_ulong addr;
     int val = 0;
-    TCGv_i32 t0, t1, t3;
+    TCGv_i32 t0, t1;
 
     switch (sop) {
     case 0x0: /* br */
@@ -4107,8 +4253,7 @@ static inline void imm_1op(DisasContext *ctx, uint32_t sop, int rx, int imm)
         }
         val += ctx->pc;
 
-        gen_goto_tb(ctx, 0, val);
-        ctx->base.is_jmp = DISAS_TB_JUMP;
+        gen_jump(ctx, val, 4);
         break;
     case 0x1: /* bnezad */
         check_insn(ctx, CPU_C860 | CPU_E803);
@@ -4136,13 +4281,14 @@ static inline void imm_1op(DisasContext *ctx, uint32_t sop, int rx, int imm)
         }
         ctx->maybe_change_flow = 1;
 #endif
-        ctx->base.is_jmp = DISAS_JUMP;
+        ctx->base.is_jmp = rx == 15 ? DISAS_RETURN : DISAS_JUMP;
         break;
     case 0x7:/* jsr */
         check_insn_except(ctx, CPU_E801 | CPU_E802);
         t0 = tcg_temp_new();
         tcg_gen_andi_tl(t0, cpu_R[rx], 0xfffffffe);
         tcg_gen_movi_tl(cpu_R[15], ctx->pc + 4);
+        translator_push_return(&ctx->base);
         store_cpu_field(t0, pc);
 
 #if !defined(CONFIG_USER_ONLY)
@@ -4233,18 +4379,16 @@ static inline void imm_1op(DisasContext *ctx, uint32_t sop, int rx, int imm)
         break;
     case 0x14:/* lrw */
         t0 = tcg_temp_new();
-        t3 = tcg_constant_i32(ctx->pc);
         addr = (ctx->pc + (imm << 2)) & 0xfffffffc ;
         tcg_gen_movi_tl(t0, addr);
         tcg_gen_qemu_ld_i32(cpu_R[rx], t0, ctx->mem_idx, MO_TEUL);
         if (gen_mem_trace()) {
-            gen_helper_trace_ld32u(cpu_env, t3, cpu_R[rx], t0);
+            gen_trace_ldst(ctx, LD32U, cpu_R[rx], t0);
         }
         break;
     case 0x16: /* jmpi */
         check_insn_except(ctx, CPU_E801 | CPU_E802);
         t0 = tcg_temp_new();
-        t3 = tcg_constant_i32(ctx->pc);
 
         addr = (ctx->pc + (imm << 2)) & 0xfffffffc ;
         t1 = tcg_temp_new();
@@ -4252,7 +4396,7 @@ static inline void imm_1op(DisasContext *ctx, uint32_t sop, int rx, int imm)
         tcg_gen_movi_tl(t0, addr);
         tcg_gen_qemu_ld_i32(t0, t0, ctx->mem_idx, MO_TEUL);
         if (gen_mem_trace()) {
-            gen_helper_trace_ld32u(cpu_env, t3, t0, t1);
+            gen_trace_ldst(ctx, LD32U, t0, t1);
         }
         store_cpu_field(t0, pc);
 
@@ -4271,14 +4415,14 @@ static inline void imm_1op(DisasContext *ctx, uint32_t sop, int rx, int imm)
         check_insn_except(ctx, CPU_E801 | CPU_E802);
         t0 = tcg_temp_new();
         t1 = tcg_temp_new();
-        t3 = tcg_constant_i32(ctx->pc);
         addr =  (ctx->pc + (imm << 2)) & 0xfffffffc;
         tcg_gen_movi_tl(cpu_R[15], ctx->pc + 4);
+        translator_push_return(&ctx->base);
         tcg_gen_movi_tl(t1, addr);
         tcg_gen_movi_tl(t0, addr);
         tcg_gen_qemu_ld_i32(t0, t0, ctx->mem_idx, MO_TEUL);
         if (gen_mem_trace()) {
-            gen_helper_trace_ld32u(cpu_env, t3, t0, t1);
+            gen_trace_ldst(ctx, LD32U, t0, t1);
         }
         store_cpu_field(t0, pc);
 
@@ -7308,6 +7452,129 @@ wrong:
 // #endif
 }
 
+typedef void VDSPGVec2Fn(unsigned, uint32_t, uint32_t, uint32_t, uint32_t);
+typedef void VDSPGVec3Fn(unsigned, uint32_t, uint32_t, uint32_t,
+                         uint32_t, uint32_t);
+typedef void VDSPGVec2iFn(unsigned, uint32_t, uint32_t, int64_t,
+                          uint32_t, uint32_t);
+
+static gen_helper_gvec_3 * const vdsp_vaddh_fns[2][3] = {
+    { gen_helper_vdsp_vaddh_ub, gen_helper_vdsp_vaddh_uh,
+      gen_helper_vdsp_vaddh_uw },
+    { gen_helper_vdsp_vaddh_sb, gen_helper_vdsp_vaddh_sh,
+      gen_helper_vdsp_vaddh_sw },
+};
+
+static gen_helper_gvec_3 * const vdsp_vsubh_fns[2][3] = {
+    { gen_helper_vdsp_vsubh_ub, gen_helper_vdsp_vsubh_uh,
+      gen_helper_vdsp_vsubh_uw },
+    { gen_helper_vdsp_vsubh_sb, gen_helper_vdsp_vsubh_sh,
+      gen_helper_vdsp_vsubh_sw },
+};
+
+/* the low half of the product does not depend on the sign */
+static gen_helper_gvec_3 * const vdsp_vmula_fns[3] = {
+    gen_helper_vdsp_vmula_b, gen_helper_vdsp_vmula_h, gen_helper_vdsp_vmula_w,
+};
+
+static gen_helper_gvec_3 * const vdsp_vmuls_fns[3] = {
+    gen_helper_vdsp_vmuls_b, gen_helper_vdsp_vmuls_h, gen_helper_vdsp_vmuls_w,
+};
+
+/*
+ * Expand the common element-wise VDSP operations of both the 64 and 128
+ * bit units with gvec, or with the width-specialised helper from the
+ * tables above. The generic helpers treat 64-bit lanes as a no-op for
+ * these, so that case and everything else is left to the caller.
+ */
+static bool gen_vdsp_fast(DisasContext *s, uint32_t insn, int oprsz)
+{
+    int op1 = (insn >> CSKY_VDSP_SOP_SHI_M) & CSKY_VDSP_SOP_MASK_M;
+    int op2 = (insn >> CSKY_VDSP_SOP_SHI_S) & CSKY_VDSP_SOP_MASK_S;
+    int vece = ((insn >> CSKY_VDSP_WIDTH_BIT_HI & 0x2) |
+                (insn >> CSKY_VDSP_WIDTH_BIT_LO & 0x1));
+    bool sign = (insn >> CSKY_VDSP_SIGN_SHI) & CSKY_VDSP_SIGN_MASK;
+    int rx = (insn >> CSKY_VDSP_REG_SHI_VRX) & CSKY_VDSP_REG_MASK;
+    int ry = (insn >> CSKY_VDSP_REG_SHI_VRY) & CSKY_VDSP_REG_MASK;
+    int rz = insn & CSKY_VDSP_REG_MASK;
+    gen_helper_gvec_3 *ool = NULL;
+    VDSPGVec3Fn *fn = NULL;
+
+    if (vece == MO_64) {
+        return false;
+    }
+
+    switch (op1) {
+    case VDSP_VADD:
+        if (op2 == 0x0) {           /* VADD.T */
+            fn = tcg_gen_gvec_add;
+        } else if (op2 == 0xc) {    /* VADDH.T */
+            ool = vdsp_vaddh_fns[sign][vece];
+        } else if (op2 == 0xe) {    /* VADD.T.S */
+            fn = sign ? tcg_gen_gvec_ssadd : tcg_gen_gvec_usadd;
+        }
+        break;
+    case VDSP_VSUB:
+        if (op2 == 0x0) {           /* VSUB.T */
+            fn = tcg_gen_gvec_sub;
+        } else if (op2 == 0xc) {    /* VSUBH.T */
+            ool = vdsp_vsubh_fns[sign][vece];
+        } else if (op2 == 0xe) {    /* VSUB.T.S */
+            fn = sign ? tcg_gen_gvec_sssub : tcg_gen_gvec_ussub;
+        }
+        break;
+    case VDSP_VMUL:
+        if (op2 == 0x0) {           /* VMUL.T */
+            fn = tcg_gen_gvec_mul;
+        } else if (op2 == 0x2) {    /* VMULA.T */
+            ool = vdsp_vmula_fns[vece];
+        } else if (op2 == 0x4) {    /* VMULS.T */
+            ool = vdsp_vmuls_fns[vece];
+        }
+        break;
+    case VDSP_VCMP:
+        if (op2 == 0x8) {           /* VMAX.T */
+            fn = sign ? tcg_gen_gvec_smax : tcg_gen_gvec_umax;
+        } else if (op2 == 0x9) {    /* VMIN.T */
+            fn = sign ? tcg_gen_gvec_smin : tcg_gen_gvec_umin;
+        }
+        break;
+    case VDSP_VAND:
+        switch (op2) {
+        case 0x0:                   /* VAND.T */
+            fn = tcg_gen_gvec_and;
+            break;
+        case 0x1:                   /* VANDN.T */
+            fn = tcg_gen_gvec_andc;
+            break;
+        case 0x2:                   /* VOR.T */
+            fn = tcg_gen_gvec_or;
+            break;
+        case 0x3:                   /* VNOR.T */
+            fn = tcg_gen_gvec_nor;
+            break;
+        case 0x4:                   /* VXOR.T */
+            fn = tcg_gen_gvec_xor;
+            break;
+        }
+        break;
+    }
+
+    if (fn) {
+        fn(vece, offsetof(CPUCSKYState, vfp.reg[rz]),
+           offsetof(CPUCSKYState, vfp.reg[rx]),
+           offsetof(CPUCSKYState, vfp.reg[ry]), oprsz, oprsz);
+    } else if (ool) {
+        tcg_gen_gvec_3_ool(offsetof(CPUCSKYState, vfp.reg[rz]),
+                           offsetof(CPUCSKYState, vfp.reg[rx]),
+                           offsetof(CPUCSKYState, vfp.reg[ry]),
+                           oprsz, oprsz, 0, ool);
+    } else {
+        return false;
+    }
+    return true;
+}
+
 static void disas_vdsp_insn128(DisasContext *s, uint32_t insn)
 {
     int op1, op2, op3, wid, ldst = 0;
@@ -7319,6 +7586,10 @@ static void disas_vdsp_insn128(DisasContext *s, uint32_t insn)
 
     TCGv vdsp_insn = tcg_constant_tl(insn);
 
+    if (gen_vdsp_fast(s, insn, 16)) {
+        return;
+    }
+
     switch (op1) {
     case VDSP_VADD: /*VADD*/
         switch  (op2) {
@@ -7711,6 +7982,10 @@ static void disas_vdsp_insn64( DisasContext *s, uint32_t insn)
 
     TCGv vdsp_insn = tcg_constant_tl(insn);
 
+    if (gen_vdsp_fast(s, insn, 8)) {
+        return;
+    }
+
     switch (op1) {
     case VDSP_VADD: /*VADD*/
         switch (op2) {
@@ -10346,17 +10621,161 @@ static void disas_dspv2_insn( DisasContext *s, uint32_t insn)
     }
 }
 
+/*
+ * VDSP2 operations that map onto generic vector ops are expanded inline
+ * with gvec on env->vfp.reg[], the others still call the op_vdsp2.c helpers.
+ */
+#define VDSP2_VLEN  16
+
+static inline uint32_t vdsp2_reg_offset(uint32_t insn, int shift)
+{
+    int reg = (insn >> shift) & CSKY_VDSP2_VREG_MASK;
+
+    return offsetof(CPUCSKYState, vfp.reg[reg]);
+}
+
+/* element size of the .T suffix, MO_8 to MO_64 */
+static inline int vdsp2_vece(uint32_t insn)
+{
+    return ((insn >> CSKY_VDSP2_WIDTH_BIT0) & 0x1) |
+           ((insn >> (CSKY_VDSP2_WIDTH_BIT1 - 1)) & 0x2);
+}
+
+static inline bool vdsp2_sign(uint32_t insn)
+{
+    return (insn >> CSKY_VDSP2_SIGN_SHI) & CSKY_VDSP2_SIGN_MASK;
+}
+
+static void gen_vdsp2_gvec2(uint32_t insn, int vece, VDSPGVec2Fn *fn)
+{
+    fn(vece, vdsp2_reg_offset(insn, CSKY_VDSP2_VREG_SHI_VRZ),
+       vdsp2_reg_offset(insn, CSKY_VDSP2_VREG_SHI_VRX),
+       VDSP2_VLEN, VDSP2_VLEN);
+}
+
+static void gen_vdsp2_gvec3(uint32_t insn, int vece, VDSPGVec3Fn *fn)
+{
+    fn(vece, vdsp2_reg_offset(insn, CSKY_VDSP2_VREG_SHI_VRZ),
+       vdsp2_reg_offset(insn, CSKY_VDSP2_VREG_SHI_VRX),
+       vdsp2_reg_offset(insn, CSKY_VDSP2_VREG_SHI_VRY),
+       VDSP2_VLEN, VDSP2_VLEN);
+}
+
+/* VMAX/VMIN/VNEG have no 64-bit form */
+static void gen_vdsp2_gvec3_no64(DisasContext *s, uint32_t insn,
+                                 VDSPGVec3Fn *fn)
+{
+    int vece = vdsp2_vece(insn);
+
+    if (vece == MO_64) {
+        generate_exception(s, EXCP_CSKY_UDEF);
+        return;
+    }
+    gen_vdsp2_gvec3(insn, vece, fn);
+}
+
+/*
+ * Decode the imm7 field of the immediate shifts into element size and
+ * shift count, the same way as decode_imm7 in op_vdsp2.c.
+ */
+static bool vdsp2_decode_imm7(uint32_t insn, int *vece, int *shift)
+{
+    uint32_t imm = ((insn >> 19) & 0x7e) + ((insn >> 5) & 0x1);
+
+    switch (imm & 0x70) {
+    case 0x20:
+        if (imm & 0x8) {
+            return false;
+        }
+        *vece = MO_8;
+        *shift = imm & 0xf;
+        break;
+    case 0x30:
+        *vece = MO_16;
+        *shift = imm & 0xf;
+        break;
+    case 0x10:
+        *vece = MO_32;
+        *shift = imm & 0xf;
+        break;
+    case 0x40:
+        *vece = MO_32;
+        *shift = (imm & 0xf) + 16;
+        break;
+    case 0x00:
+        *vece = MO_64;
+        *shift = imm & 0xf;
+        break;
+    case 0x70:
+        *vece = MO_64;
+        *shift = (imm & 0xf) + 16;
+        break;
+    case 0x60:
+        *vece = MO_64;
+        *shift = (imm & 0xf) + 32;
+        break;
+    case 0x50:
+        *vece = MO_64;
+        *shift = (imm & 0xf) + 48;
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+static void gen_vdsp2_vshli(DisasContext *s, uint32_t insn)
+{
+    int vece, shift;
+
+    if (!vdsp2_decode_imm7(insn, &vece, &shift)) {
+        generate_exception(s, EXCP_CSKY_UDEF);
+        return;
+    }
+    tcg_gen_gvec_shli(vece, vdsp2_reg_offset(insn, CSKY_VDSP2_VREG_SHI_VRZ),
+                      vdsp2_reg_offset(insn, CSKY_VDSP2_VREG_SHI_VRX),
+                      shift, VDSP2_VLEN, VDSP2_VLEN);
+}
+
+static void gen_vdsp2_vshri(DisasContext *s, uint32_t insn)
+{
+    uint32_t rz = vdsp2_reg_offset(insn, CSKY_VDSP2_VREG_SHI_VRZ);
+    uint32_t rx = vdsp2_reg_offset(insn, CSKY_VDSP2_VREG_SHI_VRX);
+    VDSPGVec2iFn *fn;
+    int vece, shift;
+
+    if (!vdsp2_decode_imm7(insn, &vece, &shift)) {
+        generate_exception(s, EXCP_CSKY_UDEF);
+        return;
+    }
+    /* the shift count is oimm, 1 to the element width */
+    shift++;
+    if (shift == (8 << vece)) {
+        if (vdsp2_sign(insn)) {
+            tcg_gen_gvec_sari(vece, rz, rx, shift - 1,
+                              VDSP2_VLEN, VDSP2_VLEN);
+        } else {
+            tcg_gen_gvec_dup_imm(vece, rz, VDSP2_VLEN, VDSP2_VLEN, 0);
+        }
+        return;
+    }
+    fn = vdsp2_sign(insn) ? tcg_gen_gvec_sari : tcg_gen_gvec_shri;
+    fn(vece, rz, rx, shift, VDSP2_VLEN, VDSP2_VLEN);
+}
+
 static inline void vdsp2_sop_add_sub_cmp(DisasContext *s, uint32_t insn)
 {
     TCGv dsp_insn = tcg_constant_tl(insn);
     int op2 = (insn >> 5) & 0x3f;
+    bool sign = vdsp2_sign(insn);
 
     switch (op2) {
     case 0x0:       /* VADD.T */
-        gen_helper_vdsp2_vadd(cpu_env, dsp_insn);
+        gen_vdsp2_gvec3(insn, vdsp2_vece(insn), tcg_gen_gvec_add);
         break;
     case 0x1:       /* VADD.T.S */
-        gen_helper_vdsp2_vadd_s(cpu_env, dsp_insn);
+        gen_vdsp2_gvec3(insn, vdsp2_vece(insn),
+                        sign ? tcg_gen_gvec_ssadd : tcg_gen_gvec_usadd);
         break;
     case 0x30:      /* VADD.T.E */
         gen_helper_vdsp2_vadd_e(cpu_env, dsp_insn);
@@ -10377,10 +10796,11 @@ static inline void vdsp2_sop_add_sub_cmp(DisasContext *s, uint32_t insn)
         gen_helper_vdsp2_vaddh_r(cpu_env, dsp_insn);
         break;
     case 0x8:       /* VSUB.T */
-        gen_helper_vdsp2_vsub(cpu_env, dsp_insn);
+        gen_vdsp2_gvec3(insn, vdsp2_vece(insn), tcg_gen_gvec_sub);
         break;
     case 0x9:       /* VSUB.T.S */
-        gen_helper_vdsp2_vsub_s(cpu_env, dsp_insn);
+        gen_vdsp2_gvec3(insn, vdsp2_vece(insn),
+                        sign ? tcg_gen_gvec_sssub : tcg_gen_gvec_ussub);
         break;
     case 0x31:      /* VSUB.T.E */
         gen_helper_vdsp2_vsub_e(cpu_env, dsp_insn);
@@ -10401,7 +10821,11 @@ static inline void vdsp2_sop_add_sub_cmp(DisasContext *s, uint32_t insn)
         gen_helper_vdsp2_vsubh_r(cpu_env, dsp_insn);
         break;
     case 0x38:      /* VNEG.T */
-        gen_helper_vdsp2_vneg(cpu_env, dsp_insn);
+        if (vdsp2_vece(insn) == MO_64) {
+            generate_exception(s, EXCP_CSKY_UDEF);
+            break;
+        }
+        gen_vdsp2_gvec2(insn, vdsp2_vece(insn), tcg_gen_gvec_neg);
         break;
     case 0x39:      /* VENG.T.S */
         gen_helper_vdsp2_vneg_s(cpu_env, dsp_insn);
@@ -10473,10 +10897,12 @@ static inline void vdsp2_sop_add_sub_cmp(DisasContext *s, uint32_t insn)
         gen_helper_vdsp2_vcmplsz(cpu_env, dsp_insn);
         break;
     case 0x24:      /* VMAX.T */
-        gen_helper_vdsp2_vmax(cpu_env, dsp_insn);
+        gen_vdsp2_gvec3_no64(s, insn,
+                             sign ? tcg_gen_gvec_smax : tcg_gen_gvec_umax);
         break;
     case 0x25:      /* VMIN.T */
-        gen_helper_vdsp2_vmin(cpu_env, dsp_insn);
+        gen_vdsp2_gvec3_no64(s, insn,
+                             sign ? tcg_gen_gvec_smin : tcg_gen_gvec_umin);
         break;
     case 0x28:      /* VPMAX.T */
         gen_helper_vdsp2_vpmax(cpu_env, dsp_insn);
@@ -10635,7 +11061,7 @@ static inline void vdsp2_sop_shift_imm(DisasContext *s, uint32_t insn)
 
     switch (op2) {
     case 0x0:       /* VSHLI.T */
-        gen_helper_vdsp2_vshli(cpu_env, dsp_insn);
+        gen_vdsp2_vshli(s, insn);
         break;
     case 0x1:       /* VSHLI.T.S */
         gen_helper_vdsp2_vshli_s(cpu_env, dsp_insn);
@@ -10644,7 +11070,7 @@ static inline void vdsp2_sop_shift_imm(DisasContext *s, uint32_t insn)
         gen_helper_vdsp2_vshli_e(cpu_env, dsp_insn);
         break;
     case 0x4:       /* VSHRI.T */
-        gen_helper_vdsp2_vshri(cpu_env, dsp_insn);
+        gen_vdsp2_vshri(s, insn);
         break;
     case 0x5:       /* VSHRI.T.R */
         gen_helper_vdsp2_vshri_r(cpu_env, dsp_insn);
@@ -10685,22 +11111,22 @@ static inline void vdsp2_sop_bit(DisasContext *s, uint32_t insn)
 
     switch (op2) {
     case 0x0:       /* VAND.T */
-        gen_helper_vdsp2_vand(cpu_env, dsp_insn);
+        gen_vdsp2_gvec3(insn, MO_64, tcg_gen_gvec_and);
         break;
     case 0x1:       /* VANDN.T */
-        gen_helper_vdsp2_vandn(cpu_env, dsp_insn);
+        gen_vdsp2_gvec3(insn, MO_64, tcg_gen_gvec_andc);
         break;
     case 0x2:       /* VXOR.T */
-        gen_helper_vdsp2_vxor(cpu_env, dsp_insn);
+        gen_vdsp2_gvec3(insn, MO_64, tcg_gen_gvec_xor);
         break;
     case 0x3:       /* VOR.T */
-        gen_helper_vdsp2_vor(cpu_env, dsp_insn);
+        gen_vdsp2_gvec3(insn, MO_64, tcg_gen_gvec_or);
         break;
     case 0x4:       /* VORN.T */
-        gen_helper_vdsp2_vorn(cpu_env, dsp_insn);
+        gen_vdsp2_gvec3(insn, MO_64, tcg_gen_gvec_orc);
         break;
     case 0x8:       /* VNOT.T */
-        gen_helper_vdsp2_vnot(cpu_env, dsp_insn);
+        gen_vdsp2_gvec2(insn, MO_64, tcg_gen_gvec_not);
         break;
     case 0x5:       /* VTST.T */
         gen_helper_vdsp2_vtst(cpu_env, dsp_insn);
@@ -11219,6 +11645,7 @@ static void disas_csky_32_insn(CPUCSKYState *env, DisasContext *ctx)
     case 0x8:/*bsr*/
         imm = insn & 0x3ffffff;
         tcg_gen_movi_tl(cpu_R[15], ctx->pc + 4);
+        translator_push_return(&ctx->base);
         bsr32(ctx, imm);
         break;
     case 0x9:/*imm_2op*/
@@ -11276,7 +11703,6 @@ static void csky_dump_tb_map(DisasContextBase *dcbase)
                   tb_pc, tb_end, icount);
 }
 
-static TCGOp *jcount_start_insn;
 static void gen_csky_jcount_start(DisasContext *dc, CPUCSKYState *env)
 {
     CPUState *cs = env_cpu(env);
@@ -11286,7 +11712,7 @@ static void gen_csky_jcount_start(DisasContext *dc, CPUCSKYState *env)
      * of the movi so that we later (when we know the actual insn count)
      * can update the immediate argument with the actual insn count.  */
     tcg_gen_movi_i32(t1, 0xdeadbeef);
-    jcount_start_insn = tcg_last_op();
+    dc->jcount_start_insn = tcg_last_op();
 
     tcg_gen_movi_tl(t0, dc->pc);
     if (env->jcount_start != 0) {
@@ -11297,9 +11723,9 @@ static void gen_csky_jcount_start(DisasContext *dc, CPUCSKYState *env)
     }
 }
 
-static void gen_csky_jcount_end(int num_insns)
+static void gen_csky_jcount_end(DisasContext *dc, int num_insns)
 {
-    tcg_set_insn_param(jcount_start_insn, 1,
+    tcg_set_insn_param(dc->jcount_start_insn, 1,
                        tcgv_i32_arg(tcg_constant_i32(num_insns)));
 }
 
@@ -11334,11 +11760,13 @@ static void csky_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cs)
 #ifdef CONFIG_USER_ONLY
     dc->mem_idx = CSKY_USERMODE;
 #else
-    dc->mem_idx = dc->super;
+    dc->mem_idx = CSKY_MMU_IDX(tb->cs_base, dc->super);
 #endif
 
     dc->next_page_start =
         (dc->base.pc_first & TARGET_PAGE_MASK) + TARGET_PAGE_SIZE;
+    dc->trace_class = TRACE_TB_FILTER;
+    dc->trace_limit = UINT64_MAX;
 
     cpu_F0s = tcg_temp_new_i32();
     cpu_F1s = tcg_temp_new_i32();
@@ -11352,8 +11780,8 @@ static void csky_tr_tb_start(DisasContextBase *dcbase, CPUState *cpu)
     DisasContext *dc = container_of(dcbase, DisasContext, base);
     const TranslationBlock *tb = dcbase->tb;
 
-    dc->idly4_counter = env->idly4_counter;
-    dc->condexec_cond = env->sce_condexec_bits;
+    dc->idly4_counter = CSKY_TBFLAG_IDLY4(tb->flags);
+    dc->condexec_cond = CSKY_TBFLAG_SCE_CONDEXEC(tb->flags);
 
     if (tfilter.enable) {
         dc->trace_match = trace_match_range(env, dc->pc);
@@ -11366,7 +11794,7 @@ static void csky_tr_tb_start(DisasContextBase *dcbase, CPUState *cpu)
     }
 
     if (gen_tb_trace()) {
-        csky_trace_tb_start(env, tb);
+        csky_trace_tb_start(dc, tb);
     }
 
     if (env->tb_trace == 1 || env->pctrace == 1) {
@@ -11419,6 +11847,14 @@ static bool csky_pre_translate_insn(DisasContext *dc, CPUState *cpu)
     }
 
     /* if trace range match, break the tb. */
+    /* keep the tb within one trace window, see csky_trace_tb_class. */
+    if (unlikely(dc->pc >= dc->trace_limit)) {
+        gen_save_pc(dc->pc);
+        dc->base.is_jmp = DISAS_UPDATE;
+        dc->base.num_insns--;
+        return true;
+    }
+
     if ((!dc->trace_match) && tfilter.enable) {
         if (unlikely(trace_match_range(env, dc->pc))) {
             gen_save_pc(dc->pc);
@@ -11486,7 +11922,7 @@ static void csky_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
         return;
     }
 
-    dc->insn = cpu_lduw_code(env, dc->pc);
+    dc->insn = translator_lduw(env, &dc->base, dc->pc);
 
     if ((dc->insn & 0xc000) != 0xc000) {
         /* 16 bit instruction*/
@@ -11494,7 +11930,8 @@ static void csky_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
         dc->pc += 2;
     } else {
         /*32 bit instruction*/
-        dc->insn = (dc->insn << 16) | cpu_lduw_code(env, dc->pc + 2);
+        dc->insn = (dc->insn << 16) |
+                   translator_lduw(env, &dc->base, dc->pc + 2);
         disas_csky_32_insn(env, dc);
         dc->pc += 4;
     }
@@ -11502,6 +11939,22 @@ static void csky_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
     csky_post_translate_insn(dc);
 }
 
+/*
+ * Look up the TB for the pc just stored, or find it in the inline cache
+ * of the jump; returns are predicted from the return-address stack.
+ */
+static void gen_indirect_jump(DisasContext *dc, bool is_return)
+{
+    TCGv_i64 dest = tcg_temp_new_i64();
+
+    tcg_gen_extu_i32_i64(dest, load_cpu_field(pc));
+    if (is_return) {
+        translator_return(&dc->base, dest);
+    } else {
+        translator_lookup_and_goto_ptr(&dc->base, dest);
+    }
+}
+
 static void csky_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
 {
     DisasContext *dc = container_of(dcbase, DisasContext, base);
@@ -11513,14 +11966,14 @@ static void csky_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
     if (gen_tb_trace()) {
         if (cpu->singlestep_enabled) {
             /* exit on singlestep. */
-            csky_trace_tb_exit(0x1, dc->pc - dc->base.pc_first);
+            csky_trace_tb_exit(dc, 0x1, dc->pc - dc->base.pc_first);
         } else if (dc->base.is_jmp == DISAS_NEXT
             || dc->base.is_jmp == DISAS_UPDATE) {
             /* exit on special insns. */
-            csky_trace_tb_exit(0x2, dc->pc - dc->base.pc_first);
+            csky_trace_tb_exit(dc, 0x2, dc->pc - dc->base.pc_first);
         } else if (dc->base.is_jmp == DISAS_TOO_MANY) {
             /* exit on too many insns. */
-            csky_trace_tb_exit(0x3, dc->pc - dc->base.pc_first);
+            csky_trace_tb_exit(dc, 0x3, dc->pc - dc->base.pc_first);
         }
     }
     if (dc->base.is_jmp != DISAS_TB_JUMP && dc->base.is_jmp != DISAS_TB_JUMP) {
@@ -11544,8 +11997,8 @@ static void csky_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
             gen_goto_tb(dc, 1, dc->pc);
             break;
         case DISAS_JUMP:
-            /* indicate that the hash table must be used to find the next TB */
-            tcg_gen_lookup_and_goto_ptr();
+        case DISAS_RETURN:
+            gen_indirect_jump(dc, dc->base.is_jmp == DISAS_RETURN);
             break;
         case DISAS_UPDATE:
             /* special insns like mtcr/wait/nir */
@@ -11564,7 +12017,7 @@ static void csky_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
     }
 
     if (env->jcount_start != 0 || cpu->csky_trace_features & CSKY_TRACE) {
-        gen_csky_jcount_end(dcbase->num_insns);
+        gen_csky_jcount_end(dc, dcbase->num_insns);
     }
 
     if (env->tb_trace == 1) {
@@ -11585,6 +12038,23 @@ static void csky_tr_disas_log(const DisasContextBase *dcbase,
     target_disas(logfile, cpu, dcbase->pc_first, dcbase->tb->size);
 }
 
+/* Branches are folded into hot superblocks unless tracing sees TBs. */
+static bool csky_tr_superblock(DisasContextBase *dcbase, CPUState *cpu)
+{
+    CPUCSKYState *env = cpu->env_ptr;
+#ifndef CONFIG_USER_ONLY
+    DisasContext *dc = container_of(dcbase, DisasContext, base);
+
+    if (dc->trace_mode != NORMAL_MODE) {
+        return false;
+    }
+#endif
+    return !gen_tb_trace() && !tfilter.enable &&
+           !(cpu->csky_trace_features & CSKY_TRACE) &&
+           env->jcount_start == 0 && env->tb_trace == 0 &&
+           env->pctrace == 0 && env->exit_addr == 0;
+}
+
 static const TranslatorOps csky_translator_ops = {
     .init_disas_context = csky_tr_init_disas_context,
     .tb_start           = csky_tr_tb_start,
@@ -11593,6 +12063,7 @@ static const TranslatorOps csky_translator_ops = {
     .translate_insn     = csky_tr_translate_insn,
     .tb_stop            = csky_tr_tb_stop,
     .disas_log          = csky_tr_disas_log,
+    .superblock         = csky_tr_superblock,
 };
 
 /*
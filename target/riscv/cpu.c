@@ -1535,6 +1535,13 @@ static void riscv_restore_state_to_opc(CPUState *cs,
         env->pc = pc;
     }
     env->bins = data[1];
+#ifndef CONFIG_USER_ONLY
+    /* the whole TB was counted on entry, data[2] is the faulting insn */
+    if (EX_TBFLAGS_ANY(tb_flags, PMU_INSNS) &&
+        !(tb_cflags(tb) & CF_USE_ICOUNT)) {
+        env->pmu_insns -= tb->icount - data[2];
+    }
+#endif
 }
 
 static void csky_cpu_handle_opts(CPURISCVState *env)
@@ -2789,6 +2796,12 @@ static Property riscv_cpu_properties[] = {
     DEFINE_PROP_UINT16("vlen", RISCVCPU, cfg.vlen, 128),
     DEFINE_PROP_UINT16("elen", RISCVCPU, cfg.elen, 64),
     DEFINE_PROP_UINT16("rlen", RISCVCPU, cfg.mrowlen, 128),
+    /*
+     * Run the matrix multiply-accumulate instructions through the
+     * element-by-element reference helpers instead of the specialised
+     * kernels, to cross-check the two.
+     */
+    DEFINE_PROP_BOOL("x-matrix-ref", RISCVCPU, cfg.matrix_ref, false),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -2839,6 +2852,32 @@ static const struct SysemuCPUOps riscv_sysemu_ops = {
     .write_elf32_note = riscv_cpu_write_elf32_note,
     .legacy_vmsd = &vmstate_riscv_cpu,
 };
+
+/* An extension in this state is not made dirty in the middle of a TB. */
+static bool riscv_ext_status_settled(RISCVExtStatus status)
+{
+    return status == EXT_STATUS_DISABLED || status == EXT_STATUS_DIRTY;
+}
+
+static bool riscv_cpu_translate_ahead_ok(CPUState *cs,
+                                         const TranslationBlock *tb)
+{
+    CPURISCVState *env = cs->env_ptr;
+    CPURISCVTBFlags tb_flags = { tb->flags, tb->cs_base };
+
+    /* mark_{fs,vs,ms}_dirty change the flags that the targets see. */
+    if (!riscv_ext_status_settled(EX_TBFLAGS_ANY(tb_flags, FS)) ||
+        !riscv_ext_status_settled(EX_TBFLAGS_ANY(tb_flags, VS)) ||
+        (!EX_TBFLAGS_THEAD(tb_flags, MSD) &&
+         !riscv_ext_status_settled(EX_TBFLAGS_THEAD(tb_flags, MS)))) {
+        return false;
+    }
+
+    /* The translator reads the tracing options from here, not the flags. */
+    return !tfilter.enable && !(cs->csky_trace_features & CSKY_TRACE) &&
+           env->jcount_start == 0 && env->tb_trace == 0 &&
+           env->pctrace == 0;
+}
 #endif
 
 #include "hw/core/tcg-cpu-ops.h"
@@ -2857,6 +2896,7 @@ static const struct TCGCPUOps riscv_tcg_ops = {
     .debug_excp_handler = riscv_cpu_debug_excp_handler,
     .debug_check_breakpoint = riscv_cpu_debug_check_breakpoint,
     .debug_check_watchpoint = riscv_cpu_debug_check_watchpoint,
+    .translate_ahead_ok = riscv_cpu_translate_ahead_ok,
 #endif /* !CONFIG_USER_ONLY */
 };
 
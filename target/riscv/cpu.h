@@ -38,7 +38,7 @@
  * RISC-V-specific extra insn start words:
  * 1: Original instruction opcode
  */
-#define TARGET_INSN_START_EXTRA_WORDS 1
+#define TARGET_INSN_START_EXTRA_WORDS 2
 
 #define RV(x) ((target_ulong)1 << (x - 'A'))
 
@@ -133,6 +133,8 @@ typedef struct CPURISCVTBFlags {
     target_ulong flags2;
 } CPURISCVTBFlags;
 
+typedef struct RISCVPMUModel RISCVPMUModel;
+
 typedef struct PMUCTRState {
     /* Current value of a counter */
     target_ulong mhpmcounter_val;
@@ -145,6 +147,8 @@ typedef struct PMUCTRState {
     bool started;
     /* Value beyond UINT32_MAX/UINT64_MAX before overflow interrupt trigger */
     target_ulong irq_overflow_left;
+    /* pmu_insns value at which an instructions counter overflows, or 0 */
+    uint64_t irq_insns_at;
 } PMUCTRState;
 
 struct CPUArchState {
@@ -329,6 +333,14 @@ struct CPUArchState {
     /* PMU event selector configured values for RV32 */
     target_ulong mhpmeventh_val[RV_MAX_MHPMEVENTS];
 
+    /*
+     * Instructions retired, added per TB by translated code when icount is
+     * off and an instructions event is mapped to a counter, and the count
+     * at which the next instructions counter overflows.
+     */
+    uint64_t pmu_insns;
+    uint64_t pmu_insns_limit;
+
     target_ulong sscratch;
     target_ulong mscratch;
 
@@ -510,6 +522,11 @@ struct ArchCPU {
     uint32_t pmu_avail_ctrs;
     /* Mapping of events to counters */
     GHashTable *pmu_event_ctr_map;
+    /* Mapped events that need the cache/branch model, and its state */
+    uint32_t pmu_model_events;
+    RISCVPMUModel *pmu_model;
+    /* An instructions event is mapped, see TB_FLAGS_ANY.PMU_INSNS */
+    bool pmu_insns_mapped;
     /* extended by Xuantie for xiaohui platform */
     XTPowerState power_state;
 };
@@ -618,6 +635,10 @@ FIELD(TB_FLAGS_ANY, ITRIGGER, 22, 1)
 FIELD(TB_FLAGS_ANY, VIRT_ENABLED, 23, 1)
 FIELD(TB_FLAGS_ANY, PRIV, 24, 2)
 FIELD(TB_FLAGS_ANY, AXL, 26, 2)
+/* Feed loads, stores and branches to the PMU cache/branch model */
+FIELD(TB_FLAGS_ANY, PMU_MODEL, 28, 1)
+/* Count retired instructions in env->pmu_insns */
+FIELD(TB_FLAGS_ANY, PMU_INSNS, 29, 1)
 
 FIELD(TB_FLAGS_THEAD, PWI32, 0, 1)
 FIELD(TB_FLAGS_THEAD, PWI64, 1, 1)
@@ -859,9 +880,19 @@ enum {
 enum riscv_pmu_event_idx {
     RISCV_PMU_EVENT_HW_CPU_CYCLES = 0x01,
     RISCV_PMU_EVENT_HW_INSTRUCTIONS = 0x02,
+    RISCV_PMU_EVENT_HW_CACHE_REFERENCES = 0x03,
+    RISCV_PMU_EVENT_HW_CACHE_MISSES = 0x04,
+    RISCV_PMU_EVENT_HW_BRANCH_INSTRUCTIONS = 0x05,
+    RISCV_PMU_EVENT_HW_BRANCH_MISSES = 0x06,
+    RISCV_PMU_EVENT_CACHE_L1D_READ_ACCESS = 0x10000,
+    RISCV_PMU_EVENT_CACHE_L1D_READ_MISS = 0x10001,
+    RISCV_PMU_EVENT_CACHE_L1D_WRITE_ACCESS = 0x10002,
+    RISCV_PMU_EVENT_CACHE_L1D_WRITE_MISS = 0x10003,
     RISCV_PMU_EVENT_CACHE_DTLB_READ_MISS = 0x10019,
     RISCV_PMU_EVENT_CACHE_DTLB_WRITE_MISS = 0x1001B,
     RISCV_PMU_EVENT_CACHE_ITLB_PREFETCH_MISS = 0x10021,
+    RISCV_PMU_EVENT_CACHE_BPU_READ_ACCESS = 0x10028,
+    RISCV_PMU_EVENT_CACHE_BPU_READ_MISS = 0x10029,
 };
 
 /* CSR function table */
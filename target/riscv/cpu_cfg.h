@@ -134,6 +134,7 @@ struct RISCVCPUConfig {
     bool epmp;
     bool debug;
     bool misa_w;
+    bool matrix_ref;
 
     bool short_isa_string;
 
@@ -227,6 +227,8 @@ void cpu_get_tb_cpu_state(CPURISCVState *env, vaddr *pc,
     if (cpu->cfg.debug && !icount_enabled()) {
         DP_TBFLAGS_ANY(flags, ITRIGGER, env->itrigger_enabled);
     }
+    DP_TBFLAGS_ANY(flags, PMU_MODEL, cpu->pmu_model_events != 0);
+    DP_TBFLAGS_ANY(flags, PMU_INSNS, cpu->pmu_insns_mapped);
     DP_TBFLAGS_THEAD(flags, MSD, env->mxstatus & MXSTATUS_MSD);
     if (!(env->mxstatus & MXSTATUS_MSD) && cpu->cfg.ext_matrix) {
         DP_TBFLAGS_THEAD(flags, MS, get_field(env->mstatus, MSTATUS_TH_MS));
@@ -935,6 +935,22 @@ static int read_hpmcounterh(CPURISCVState *env, int csrno, target_ulong *val)
 
 #else /* CONFIG_USER_ONLY */
 
+/*
+ * Without icount, a programmable counter mapped to instructions follows
+ * the per-TB count kept by translated code while it is mapped; minstret
+ * and the cycle counters keep following the host tick counter.
+ */
+static target_ulong get_ctr_ticks(CPURISCVState *env, uint32_t ctr_idx,
+                                  bool shift)
+{
+    if (!icount_enabled() && ctr_idx > 2 &&
+        riscv_pmu_ctr_monitor_instructions(env, ctr_idx)) {
+        return shift ? env->pmu_insns >> 32 : env->pmu_insns;
+    }
+
+    return get_ticks(shift);
+}
+
 static int read_mhpmevent(CPURISCVState *env, int csrno, target_ulong *val)
 {
     int evt_index = csrno - CSR_MCOUNTINHIBIT;
@@ -992,7 +1008,7 @@ static int write_mhpmcounter(CPURISCVState *env, int csrno, target_ulong val)
     counter->mhpmcounter_val = val;
     if (riscv_pmu_ctr_monitor_cycles(env, ctr_idx) ||
         riscv_pmu_ctr_monitor_instructions(env, ctr_idx)) {
-        counter->mhpmcounter_prev = get_ticks(false);
+        counter->mhpmcounter_prev = get_ctr_ticks(env, ctr_idx, false);
         if (ctr_idx > 2) {
             if (riscv_cpu_mxl(env) == MXL_RV32) {
                 mhpmctr_val = mhpmctr_val |
@@ -1019,7 +1035,7 @@ static int write_mhpmcounterh(CPURISCVState *env, int csrno, target_ulong val)
     mhpmctr_val = mhpmctr_val | (mhpmctrh_val << 32);
     if (riscv_pmu_ctr_monitor_cycles(env, ctr_idx) ||
         riscv_pmu_ctr_monitor_instructions(env, ctr_idx)) {
-        counter->mhpmcounterh_prev = get_ticks(true);
+        counter->mhpmcounterh_prev = get_ctr_ticks(env, ctr_idx, true);
         if (ctr_idx > 2) {
             riscv_pmu_setup_timer(env, mhpmctr_val, ctr_idx);
         }
@@ -1060,7 +1076,7 @@ static RISCVException riscv_pmu_read_ctr(CPURISCVState *env, target_ulong *val,
      */
     if (riscv_pmu_ctr_monitor_cycles(env, ctr_idx) ||
         riscv_pmu_ctr_monitor_instructions(env, ctr_idx)) {
-        *val = get_ticks(upper_half) - ctr_prev + ctr_val;
+        *val = get_ctr_ticks(env, ctr_idx, upper_half) - ctr_prev + ctr_val;
     } else {
         *val = ctr_val;
     }
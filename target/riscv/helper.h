@@ -160,6 +160,10 @@ DEF_HELPER_1(tlb_flush, void, env)
 DEF_HELPER_1(tlb_flush_all, void, env)
 /* Native Debug */
 DEF_HELPER_1(itrigger_match, void, env)
+/* PMU */
+DEF_HELPER_FLAGS_1(pmu_insns_overflow, TCG_CALL_NO_WG, void, env)
+DEF_HELPER_FLAGS_3(pmu_mem, TCG_CALL_NO_WG, void, env, tl, i32)
+DEF_HELPER_FLAGS_3(pmu_branch, TCG_CALL_NO_WG, void, env, tl, tl)
 #endif
 
 /* Hypervisor functions */
@@ -1855,6 +1859,14 @@ DEF_HELPER_6(vnmsub_vx_7_b, void, ptr, ptr, tl, ptr, env, i32)
 DEF_HELPER_6(vnmsub_vx_7_h, void, ptr, ptr, tl, ptr, env, i32)
 DEF_HELPER_6(vnmsub_vx_7_w, void, ptr, ptr, tl, ptr, env, i32)
 DEF_HELPER_6(vnmsub_vx_7_d, void, ptr, ptr, tl, ptr, env, i32)
+DEF_HELPER_FLAGS_4(gvec_vmacc_7_b, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(gvec_vmacc_7_h, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(gvec_vnmsac_7_b, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(gvec_vnmsac_7_h, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(gvec_vmadd_7_b, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(gvec_vmadd_7_h, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(gvec_vnmsub_7_b, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
+DEF_HELPER_FLAGS_4(gvec_vnmsub_7_h, TCG_CALL_NO_RWG, void, ptr, ptr, ptr, i32)
 
 DEF_HELPER_6(vwmaccu_vv_7_b, void, ptr, ptr, ptr, ptr, env, i32)
 DEF_HELPER_6(vwmaccu_vv_7_h, void, ptr, ptr, ptr, ptr, env, i32)
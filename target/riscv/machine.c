@@ -331,6 +331,27 @@ static const VMStateDescription vmstate_pmu_ctr_state = {
     }
 };
 
+static int pmu_insns_post_load(void *opaque, int version_id)
+{
+    RISCVCPU *cpu = opaque;
+
+    /* Make the next TB recompute the limit */
+    cpu->env.pmu_insns_limit = 0;
+    return 0;
+}
+
+static const VMStateDescription vmstate_pmu_insns = {
+    .name = "cpu/pmu_insns",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .needed = pmu_needed,
+    .post_load = pmu_insns_post_load,
+    .fields = (VMStateField[]) {
+        VMSTATE_UINT64(env.pmu_insns, RISCVCPU),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
 static bool jvt_needed(void *opaque)
 {
     RISCVCPU *cpu = opaque;
@@ -418,6 +439,7 @@ const VMStateDescription vmstate_riscv_cpu = {
         &vmstate_debug,
         &vmstate_smstateen,
         &vmstate_jvt,
+        &vmstate_pmu_insns,
         NULL
     }
 };
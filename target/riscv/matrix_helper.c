@@ -613,16 +613,89 @@ static void mmext_mmaqa_b(void *md, void *ms1, void *ms2, CPURISCVState *env,
     }
 }
 
-#define GEN_MMAQA_B_HELPER(insn, macc_fn_b)                   \
+/*
+ * The generic mmaqa/fmmacc loops above are the reference implementation.
+ * The kernels below work on the register storage directly; the
+ * x-matrix-ref cpu property switches back to the reference so that the
+ * two can be diffed.
+ */
+static inline bool mmext_use_ref(CPURISCVState *env)
+{
+    return env_archcpu(env)->cfg.matrix_ref;
+}
+
+/*
+ * int8 kernel: compute four columns of md per pass over a row of ms1 so
+ * each a[k] is loaded once, with a plain multiply-add inner loop that the
+ * compiler can vectorise.  md must not overlap the sources, since the
+ * reference writes each result before reading the next column.
+ */
+#define GEN_MMAQA_B_KERNEL(NAME, TA, TB)                                  \
+static void NAME(void *md, void *ms1, void *ms2, CPURISCVState *env)      \
+{                                                                         \
+    uint32_t rows = get_mrows(env), rlenb = get_rlenb(env);               \
+    uint32_t m = MIN(env->sizem, rows), n = MIN(env->sizen, rows);        \
+    uint32_t sizek = env->sizek;                                          \
+    uint32_t i, j, k;                                                     \
+                                                                          \
+    for (i = 0; i < m; i++) {                                             \
+        const TA *a = (const TA *)((int8_t *)ms1 + i * rlenb);            \
+        int32_t *d = (int32_t *)((int8_t *)md + i * rlenb);               \
+                                                                          \
+        for (j = 0; j + 4 <= n; j += 4) {                                 \
+            const TB *b0 = (const TB *)((int8_t *)ms2 + j * rlenb);       \
+            const TB *b1 = b0 + rlenb, *b2 = b1 + rlenb, *b3 = b2 + rlenb; \
+            int32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;                       \
+                                                                          \
+            for (k = 0; k < sizek; k++) {                                 \
+                int32_t av = a[k];                                        \
+                s0 += av * b0[k];                                         \
+                s1 += av * b1[k];                                         \
+                s2 += av * b2[k];                                         \
+                s3 += av * b3[k];                                         \
+            }                                                             \
+            d[j] += s0;                                                   \
+            d[j + 1] += s1;                                               \
+            d[j + 2] += s2;                                               \
+            d[j + 3] += s3;                                               \
+        }                                                                 \
+        for (; j < n; j++) {                                              \
+            const TB *b = (const TB *)((int8_t *)ms2 + j * rlenb);        \
+            int32_t sum = 0;                                              \
+                                                                          \
+            for (k = 0; k < sizek; k++) {                                 \
+                sum += (int32_t)a[k] * b[k];                              \
+            }                                                             \
+            d[j] += sum;                                                  \
+        }                                                                 \
+        for (; j < rows; j++) {                                           \
+            d[j] = 0;                                                     \
+        }                                                                 \
+    }                                                                     \
+    for (; i < rows; i++) {                                               \
+        memset((int8_t *)md + i * rlenb, 0, rows * sizeof(int32_t));      \
+    }                                                                     \
+}
+
+GEN_MMAQA_B_KERNEL(mmaqa_b_ss_kernel, int8_t,  int8_t)
+GEN_MMAQA_B_KERNEL(mmaqa_b_uu_kernel, uint8_t, uint8_t)
+GEN_MMAQA_B_KERNEL(mmaqa_b_us_kernel, uint8_t, int8_t)
+GEN_MMAQA_B_KERNEL(mmaqa_b_su_kernel, int8_t,  uint8_t)
+
+#define GEN_MMAQA_B_HELPER(insn, macc_fn_b, kernel)           \
 void HELPER(insn)(void *md, void *ms1, void *ms2,             \
                   CPURISCVState *env){                        \
-    mmext_mmaqa_b(md, ms1, ms2, env, macc_fn_b);              \
+    if (mmext_use_ref(env) || md == ms1 || md == ms2) {       \
+        mmext_mmaqa_b(md, ms1, ms2, env, macc_fn_b);          \
+    } else {                                                  \
+        kernel(md, ms1, ms2, env);                            \
+    }                                                         \
 }
 
-GEN_MMAQA_B_HELPER(mmaqa_b,   macc_b_ss_s)
-GEN_MMAQA_B_HELPER(mmaqau_b,  macc_b_uu_s)
-GEN_MMAQA_B_HELPER(mmaqaus_b, macc_b_us_s)
-GEN_MMAQA_B_HELPER(mmaqasu_b, macc_b_su_s)
+GEN_MMAQA_B_HELPER(mmaqa_b,   macc_b_ss_s, mmaqa_b_ss_kernel)
+GEN_MMAQA_B_HELPER(mmaqau_b,  macc_b_uu_s, mmaqa_b_uu_kernel)
+GEN_MMAQA_B_HELPER(mmaqaus_b, macc_b_us_s, mmaqa_b_us_kernel)
+GEN_MMAQA_B_HELPER(mmaqasu_b, macc_b_su_s, mmaqa_b_su_kernel)
 
 /* half byte oprands accumulate to single word */
 static inline int32_t macc_p_ss_s(int8_t a, int8_t b, int32_t sum,
@@ -779,6 +852,76 @@ static uint64_t fmacc64(uint64_t a, uint64_t b, uint64_t d, float_status *s)
 }
 
 
+/*
+ * The fp kernels keep the reference order of operations, so results and
+ * accrued exception flags are identical; all rows and columns are still
+ * computed because the discarded ones can raise flags too.  What they
+ * save is the per-element accessor and pair selection overhead.
+ */
+static void mmext_fmmacc_h_kernel(void *md, void *ms1, void *ms2,
+                                  CPURISCVState *env, bool use_bf16)
+{
+    uint32_t rows = get_mrows(env), stride = get_rlenb(env) >> 1;
+    uint32_t sizek = env->sizek >> 1;
+    float_status *s = &env->fp_status;
+    uint32_t i, j, k;
+
+    /* the ms2 pair is contiguous, so its 2 * rows rows can be walked as one */
+    for (i = 0; i < rows; i++) {
+        const uint16_t *a = (const uint16_t *)ms1 + i * stride;
+        uint16_t *d = (uint16_t *)md + i * stride;
+
+        for (j = 0; j < rows * 2; j++) {
+            const uint16_t *b = (const uint16_t *)ms2 + j * stride;
+            uint16_t temp = 0;
+
+            if (use_bf16) {
+                for (k = 0; k < sizek; k++) {
+                    temp = bfloat16_muladd(a[k], b[k], temp, 0, s);
+                }
+            } else {
+                for (k = 0; k < sizek; k++) {
+                    temp = float16_muladd(a[k], b[k], temp, 0, s);
+                }
+            }
+            if (i < env->sizem && j < env->sizen) {
+                d[j] = use_bf16 ? bfloat16_add(d[j], temp, s)
+                                : float16_add(d[j], temp, s);
+            } else {
+                d[j] = 0;
+            }
+        }
+    }
+}
+
+static void mmext_fmmacc_s_kernel(void *md, void *ms1, void *ms2,
+                                  CPURISCVState *env)
+{
+    uint32_t rows = get_mrows(env), stride = get_rlenb(env) >> 2;
+    uint32_t sizek = env->sizek >> 2;
+    float_status *s = &env->fp_status;
+    uint32_t i, j, k;
+
+    for (i = 0; i < rows; i++) {
+        const uint32_t *a = (const uint32_t *)ms1 + i * stride;
+        uint32_t *d = (uint32_t *)md + i * stride;
+
+        for (j = 0; j < rows; j++) {
+            const uint32_t *b = (const uint32_t *)ms2 + j * stride;
+            uint32_t temp = 0;
+
+            for (k = 0; k < sizek; k++) {
+                temp = float32_muladd(a[k], b[k], temp, 0, s);
+            }
+            if (i < env->sizem && j < env->sizen) {
+                d[j] = float32_add(d[j], temp, s);
+            } else {
+                d[j] = 0;
+            }
+        }
+    }
+}
+
 void helper_fmmacc_h(void *md, void *ms1, void *ms2,
                      CPURISCVState *env, uint32_t use_bf16){
     uint32_t i, j, k;
@@ -786,6 +929,11 @@ void helper_fmmacc_h(void *md, void *ms1, void *ms2,
     uint16_t oprd_a, oprd_b;
     void *ms2_pair_1 = ms2;
     void *ms2_pair_2 = (void *) (((int8_t *) ms2) + get_mlenb(env));
+
+    if (!mmext_use_ref(env)) {
+        mmext_fmmacc_h_kernel(md, ms1, ms2, env, use_bf16);
+        return;
+    }
     for (i = 0; i < get_mrows(env); i++) {
         for (j = 0; j < get_mrows(env) * 2; j++) {
             temp = 0;
@@ -823,6 +971,11 @@ void helper_fmmacc_s(void *md, void *ms1, void *ms2,
     uint32_t i, j, k;
     uint32_t temp, psum;
     uint32_t oprd_a, oprd_b;
+
+    if (!mmext_use_ref(env)) {
+        mmext_fmmacc_s_kernel(md, ms1, ms2, env);
+        return;
+    }
     for (i = 0; i < get_mrows(env); i++) {
         for (j = 0; j < get_mrows(env); j++) {
             temp = 0;
@@ -973,6 +1126,27 @@ static void probe_pages(CPURISCVState *env, target_ulong addr,
     }
 }
 
+/*
+ * Return a host pointer for the len bytes of a row at addr when they lie
+ * in a single page of plain RAM, so the row can be copied directly to or
+ * from the matrix register.  NULL means the row crosses a page, hits MMIO
+ * or a watchpoint, and has to go through the element accessors.  The row
+ * must already have been probed.
+ */
+static void *mmext_row_host(CPURISCVState *env, target_ulong addr,
+                            target_ulong len, MMUAccessType access_type)
+{
+#if HOST_BIG_ENDIAN
+    return NULL;
+#else
+    if (len == 0 || -(addr | TARGET_PAGE_MASK) < len) {
+        return NULL;
+    }
+    return tlb_vaddr_to_host(env, addr, access_type,
+                             cpu_mmu_index(env, false));
+#endif
+}
+
 #define MMEXT_LD_ELEM(NAME, LDSUF)                                         \
 static int64_t NAME(CPURISCVState *env, target_ulong addr,                 \
                     uintptr_t retaddr){                                    \
@@ -1000,14 +1174,24 @@ static void mmext_mld(void *md, target_ulong rs1, target_ulong s2,
     }
 
     for (i = 0; i < get_mrows(env); i++) {
-        for (k = 0; k < (get_rlenb(env) >> esz); k++) {
-            addr = rs1 + i * s2 + k * (1 << esz);
-            if (i < env->sizem && k < (env->sizek >> esz)) {
-                set_elem(md, i, k, env, ld_elem(env, addr, ra));
+        char *row = (char *)md + i * get_rlenb(env);
+        target_ulong len = 0;
+
+        if (i < env->sizem) {
+            void *host;
+
+            len = MIN(env->sizek, get_rlenb(env)) >> esz << esz;
+            host = mmext_row_host(env, rs1 + i * s2, len, MMU_DATA_LOAD);
+            if (host) {
+                memcpy(row, host, len);
             } else {
-                set_elem(md, i, k, env, 0);
+                for (k = 0; k < (len >> esz); k++) {
+                    addr = rs1 + i * s2 + k * (1 << esz);
+                    set_elem(md, i, k, env, ld_elem(env, addr, ra));
+                }
             }
         }
+        memset(row + len, 0, get_rlenb(env) - len);
     }
     if (gen_mem_trace()) {
         uint32_t packlen = 2 * sizeof(uint8_t) + sizeof(uint32_t);
@@ -1062,6 +1246,15 @@ static void mmext_mldm(void *md, target_ulong rs1, uint8_t nf,
     for (n = 0; n < nf; n++) {
         temp = (void *)((char *) md + n * get_mlenb(env));
         for (i = 0; i < get_mrows(env); i++) {
+            void *host;
+
+            addr = rs1 + n * get_mlenb(env) + get_rlenb(env) * i;
+            host = mmext_row_host(env, addr, get_rlenb(env), MMU_DATA_LOAD);
+            if (host) {
+                memcpy((char *)temp + i * get_rlenb(env), host,
+                       get_rlenb(env));
+                continue;
+            }
             for (k = 0; k < (get_rlenb(env) >> esz); k++) {
                 addr = rs1 + n * get_mlenb(env) + get_rlenb(env) * i + k * (1 << esz);
                 set_elem(temp, i, k, env, ld_elem(env, addr, ra));
@@ -1138,6 +1331,13 @@ static void mmext_mst(void *ms3, target_ulong rs1, target_ulong s2,
     }
 
     for (i = 0; i < env->sizem; i++) {
+        target_ulong len = env->sizek >> esz << esz;
+        void *host = mmext_row_host(env, rs1 + i * s2, len, MMU_DATA_STORE);
+
+        if (host) {
+            memcpy(host, (char *)ms3 + i * get_rlenb(env), len);
+            continue;
+        }
         for (k = 0; k < (env->sizek >> esz); k++) {
             addr = rs1 + i * s2 + k * (1 << esz);
             st_elem(env, addr, get_elem(ms3, i, k, env), ra);
@@ -1196,6 +1396,15 @@ static void mmext_mstm(void *ms3, target_ulong rs1, uint8_t nf,
     for (n = 0; n < nf; n++) {
         temp = (void *)((char *) ms3 + n * get_mlenb(env));
         for (i = 0; i < get_mrows(env); i++) {
+            void *host;
+
+            addr = rs1 + n * get_mlenb(env) + get_rlenb(env) * i;
+            host = mmext_row_host(env, addr, get_rlenb(env), MMU_DATA_STORE);
+            if (host) {
+                memcpy(host, (char *)temp + i * get_rlenb(env),
+                       get_rlenb(env));
+                continue;
+            }
             for (k = 0; k < (get_rlenb(env) >> esz); k++) {
                 addr = rs1 + n * get_mlenb(env) + get_rlenb(env) * i + k * (1 << esz);
                 st_elem(env, addr, get_elem(temp, i, k, env), ra);
@@ -21,11 +21,59 @@
 #include "pmu.h"
 #include "sysemu/cpu-timers.h"
 #include "sysemu/device_tree.h"
+#include "exec/helper-proto.h"
 
 #define RISCV_TIMEBASE_FREQ 1000000000 /* 1Ghz */
 #define MAKE_32BIT_MASK(shift, length) \
         (((uint32_t)(~0UL) >> (32 - (length))) << (shift))
 
+/*
+ * Cache and branch events are counted by a small model of the C910 L1 data
+ * cache (64KiB, 2-way, 64-byte lines) and of a bimodal branch predictor.
+ * Translated code only calls into it while one of these events is mapped
+ * to a counter, see TB_FLAGS_ANY.PMU_MODEL.
+ */
+#define PMU_L1D_LINE_BITS   6
+#define PMU_L1D_SETS        512
+#define PMU_L1D_WAYS        2
+/* Indexed by pc[11:1], which is all a CF_PCREL TB knows of its pc */
+#define PMU_BHT_ENTRIES     2048
+
+struct RISCVPMUModel {
+    /* Line address + 1 of each way, 0 if invalid */
+    uint64_t l1d_tag[PMU_L1D_SETS][PMU_L1D_WAYS];
+    uint8_t l1d_mru[PMU_L1D_SETS];
+    /* 2-bit saturating counters, taken if >= 2 */
+    uint8_t bht[PMU_BHT_ENTRIES];
+};
+
+enum {
+    PMU_MODEL_CACHE_REFERENCES,
+    PMU_MODEL_CACHE_MISSES,
+    PMU_MODEL_BRANCH_INSTRUCTIONS,
+    PMU_MODEL_BRANCH_MISSES,
+    PMU_MODEL_L1D_READ_ACCESS,
+    PMU_MODEL_L1D_READ_MISS,
+    PMU_MODEL_L1D_WRITE_ACCESS,
+    PMU_MODEL_L1D_WRITE_MISS,
+    PMU_MODEL_BPU_READ_ACCESS,
+    PMU_MODEL_BPU_READ_MISS,
+    PMU_MODEL_NUM_EVENTS
+};
+
+static const enum riscv_pmu_event_idx pmu_model_event_idx[] = {
+    [PMU_MODEL_CACHE_REFERENCES] = RISCV_PMU_EVENT_HW_CACHE_REFERENCES,
+    [PMU_MODEL_CACHE_MISSES] = RISCV_PMU_EVENT_HW_CACHE_MISSES,
+    [PMU_MODEL_BRANCH_INSTRUCTIONS] = RISCV_PMU_EVENT_HW_BRANCH_INSTRUCTIONS,
+    [PMU_MODEL_BRANCH_MISSES] = RISCV_PMU_EVENT_HW_BRANCH_MISSES,
+    [PMU_MODEL_L1D_READ_ACCESS] = RISCV_PMU_EVENT_CACHE_L1D_READ_ACCESS,
+    [PMU_MODEL_L1D_READ_MISS] = RISCV_PMU_EVENT_CACHE_L1D_READ_MISS,
+    [PMU_MODEL_L1D_WRITE_ACCESS] = RISCV_PMU_EVENT_CACHE_L1D_WRITE_ACCESS,
+    [PMU_MODEL_L1D_WRITE_MISS] = RISCV_PMU_EVENT_CACHE_L1D_WRITE_MISS,
+    [PMU_MODEL_BPU_READ_ACCESS] = RISCV_PMU_EVENT_CACHE_BPU_READ_ACCESS,
+    [PMU_MODEL_BPU_READ_MISS] = RISCV_PMU_EVENT_CACHE_BPU_READ_MISS,
+};
+
 /*
  * To keep it simple, any event can be mapped to any programmable counters in
  * QEMU. The generic cycle & instruction count events can also be monitored
@@ -35,7 +83,7 @@
  */
 void riscv_pmu_generate_fdt_node(void *fdt, int num_ctrs, char *pmu_name)
 {
-    uint32_t fdt_event_ctr_map[15] = {};
+    uint32_t fdt_event_ctr_map[24] = {};
     uint32_t cmask;
 
     /* All the programmable counters can map to any event */
@@ -77,6 +125,21 @@ void riscv_pmu_generate_fdt_node(void *fdt, int num_ctrs, char *pmu_name)
    fdt_event_ctr_map[13] = cpu_to_be32(0x00010021);
    fdt_event_ctr_map[14] = cpu_to_be32(cmask);
 
+   /* SBI_PMU_HW_CACHE_REFERENCES .. SBI_PMU_HW_BRANCH_MISSES : type(0x00) */
+   fdt_event_ctr_map[15] = cpu_to_be32(0x00000003);
+   fdt_event_ctr_map[16] = cpu_to_be32(0x00000006);
+   fdt_event_ctr_map[17] = cpu_to_be32(cmask);
+
+   /* SBI_PMU_HW_CACHE_L1D : 0x00 READ/WRITE : ACCESS/MISS type(0x01) */
+   fdt_event_ctr_map[18] = cpu_to_be32(0x00010000);
+   fdt_event_ctr_map[19] = cpu_to_be32(0x00010003);
+   fdt_event_ctr_map[20] = cpu_to_be32(cmask);
+
+   /* SBI_PMU_HW_CACHE_BPU : 0x05 READ : 0x00 ACCESS/MISS type(0x01) */
+   fdt_event_ctr_map[21] = cpu_to_be32(0x00010028);
+   fdt_event_ctr_map[22] = cpu_to_be32(0x00010029);
+   fdt_event_ctr_map[23] = cpu_to_be32(cmask);
+
    /* This a OpenSBI specific DT property documented in OpenSBI docs */
    qemu_fdt_setprop(fdt, pmu_name, "riscv,event-to-mhpmcounters",
                     fdt_event_ctr_map, sizeof(fdt_event_ctr_map));
@@ -272,6 +335,24 @@ static gboolean pmu_remove_event_map(gpointer key, gpointer value,
     return (GPOINTER_TO_UINT(value) == GPOINTER_TO_UINT(udata)) ? true : false;
 }
 
+static void pmu_update_model_events(RISCVCPU *cpu)
+{
+    uint32_t events = 0;
+    int i;
+
+    for (i = 0; i < PMU_MODEL_NUM_EVENTS; i++) {
+        if (g_hash_table_lookup(cpu->pmu_event_ctr_map,
+                                GUINT_TO_POINTER(pmu_model_event_idx[i]))) {
+            events |= BIT(i);
+        }
+    }
+    cpu->pmu_model_events = events;
+
+    i = RISCV_PMU_EVENT_HW_INSTRUCTIONS;
+    cpu->pmu_insns_mapped = g_hash_table_lookup(cpu->pmu_event_ctr_map,
+                                                GUINT_TO_POINTER(i)) != NULL;
+}
+
 static int64_t pmu_icount_ticks_to_ns(int64_t value)
 {
     int64_t ret = 0;
@@ -303,6 +384,8 @@ int riscv_pmu_update_event_map(CPURISCVState *env, uint64_t value,
         g_hash_table_foreach_remove(cpu->pmu_event_ctr_map,
                                     pmu_remove_event_map,
                                     GUINT_TO_POINTER(ctr_idx));
+        env->pmu_ctrs[ctr_idx].irq_insns_at = 0;
+        pmu_update_model_events(cpu);
         return 0;
     }
 
@@ -318,6 +401,16 @@ int riscv_pmu_update_event_map(CPURISCVState *env, uint64_t value,
     case RISCV_PMU_EVENT_CACHE_DTLB_READ_MISS:
     case RISCV_PMU_EVENT_CACHE_DTLB_WRITE_MISS:
     case RISCV_PMU_EVENT_CACHE_ITLB_PREFETCH_MISS:
+    case RISCV_PMU_EVENT_HW_CACHE_REFERENCES:
+    case RISCV_PMU_EVENT_HW_CACHE_MISSES:
+    case RISCV_PMU_EVENT_HW_BRANCH_INSTRUCTIONS:
+    case RISCV_PMU_EVENT_HW_BRANCH_MISSES:
+    case RISCV_PMU_EVENT_CACHE_L1D_READ_ACCESS:
+    case RISCV_PMU_EVENT_CACHE_L1D_READ_MISS:
+    case RISCV_PMU_EVENT_CACHE_L1D_WRITE_ACCESS:
+    case RISCV_PMU_EVENT_CACHE_L1D_WRITE_MISS:
+    case RISCV_PMU_EVENT_CACHE_BPU_READ_ACCESS:
+    case RISCV_PMU_EVENT_CACHE_BPU_READ_MISS:
         break;
     default:
         /* We don't support any raw events right now */
@@ -325,18 +418,38 @@ int riscv_pmu_update_event_map(CPURISCVState *env, uint64_t value,
     }
     g_hash_table_insert(cpu->pmu_event_ctr_map, GUINT_TO_POINTER(event_idx),
                         GUINT_TO_POINTER(ctr_idx));
+    pmu_update_model_events(cpu);
 
     return 0;
 }
 
+static void pmu_set_overflow(RISCVCPU *cpu, uint32_t ctr_idx)
+{
+    CPURISCVState *env = &cpu->env;
+    target_ulong *mhpmevent_val;
+    uint64_t of_bit_mask;
+
+    if (riscv_cpu_mxl(env) == MXL_RV32) {
+        mhpmevent_val = &env->mhpmeventh_val[ctr_idx];
+        of_bit_mask = MHPMEVENTH_BIT_OF;
+    } else {
+        mhpmevent_val = &env->mhpmevent_val[ctr_idx];
+        of_bit_mask = MHPMEVENT_BIT_OF;
+    }
+
+    /* Generate interrupt only if OF bit is clear */
+    if (!(*mhpmevent_val & of_bit_mask)) {
+        *mhpmevent_val |= of_bit_mask;
+        riscv_cpu_update_mip(env, MIP_LCOFIP, BOOL_TO_MASK(1));
+    }
+}
+
 static void pmu_timer_trigger_irq(RISCVCPU *cpu,
                                   enum riscv_pmu_event_idx evt_idx)
 {
     uint32_t ctr_idx;
     CPURISCVState *env = &cpu->env;
     PMUCTRState *counter;
-    target_ulong *mhpmevent_val;
-    uint64_t of_bit_mask;
     int64_t irq_trigger_at;
 
     if (evt_idx != RISCV_PMU_EVENT_HW_CPU_CYCLES &&
@@ -350,14 +463,6 @@ static void pmu_timer_trigger_irq(RISCVCPU *cpu,
         return;
     }
 
-    if (riscv_cpu_mxl(env) == MXL_RV32) {
-        mhpmevent_val = &env->mhpmeventh_val[ctr_idx];
-        of_bit_mask = MHPMEVENTH_BIT_OF;
-     } else {
-        mhpmevent_val = &env->mhpmevent_val[ctr_idx];
-        of_bit_mask = MHPMEVENT_BIT_OF;
-    }
-
     counter = &env->pmu_ctrs[ctr_idx];
     if (counter->irq_overflow_left > 0) {
         irq_trigger_at = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) +
@@ -368,11 +473,7 @@ static void pmu_timer_trigger_irq(RISCVCPU *cpu,
     }
 
     if (cpu->pmu_avail_ctrs & BIT(ctr_idx)) {
-        /* Generate interrupt only if OF bit is clear */
-        if (!(*mhpmevent_val & of_bit_mask)) {
-            *mhpmevent_val |= of_bit_mask;
-            riscv_cpu_update_mip(env, MIP_LCOFIP, BOOL_TO_MASK(1));
-        }
+        pmu_set_overflow(cpu, ctr_idx);
     }
 }
 
@@ -383,7 +484,108 @@ void riscv_pmu_timer_cb(void *priv)
 
     /* Timer event was triggered only for these events */
     pmu_timer_trigger_irq(cpu, RISCV_PMU_EVENT_HW_CPU_CYCLES);
-    pmu_timer_trigger_irq(cpu, RISCV_PMU_EVENT_HW_INSTRUCTIONS);
+    if (icount_enabled()) {
+        pmu_timer_trigger_irq(cpu, RISCV_PMU_EVENT_HW_INSTRUCTIONS);
+    }
+}
+
+static void pmu_update_insns_limit(CPURISCVState *env)
+{
+    uint64_t limit = UINT64_MAX;
+    int i;
+
+    for (i = 3; i < RV_MAX_MHPMCOUNTERS; i++) {
+        uint64_t insns_at = env->pmu_ctrs[i].irq_insns_at;
+
+        if (insns_at && insns_at < limit) {
+            limit = insns_at;
+        }
+    }
+    env->pmu_insns_limit = limit;
+}
+
+/*
+ * Called from the start of a TB once pmu_insns reaches pmu_insns_limit:
+ * raise the overflow of every instructions counter that has wrapped.
+ */
+void helper_pmu_insns_overflow(CPURISCVState *env)
+{
+    RISCVCPU *cpu = env_archcpu(env);
+    uint32_t ctr_idx;
+
+    for (ctr_idx = 3; ctr_idx < RV_MAX_MHPMCOUNTERS; ctr_idx++) {
+        PMUCTRState *counter = &env->pmu_ctrs[ctr_idx];
+
+        if (!counter->irq_insns_at || counter->irq_insns_at > env->pmu_insns) {
+            continue;
+        }
+        counter->irq_insns_at = 0;
+        if (riscv_pmu_counter_enabled(cpu, ctr_idx) &&
+            riscv_pmu_ctr_monitor_instructions(env, ctr_idx)) {
+            pmu_set_overflow(cpu, ctr_idx);
+        }
+    }
+    pmu_update_insns_limit(env);
+}
+
+static void pmu_model_count(RISCVCPU *cpu, int event)
+{
+    if (cpu->pmu_model_events & BIT(event)) {
+        riscv_pmu_incr_ctr(cpu, pmu_model_event_idx[event]);
+    }
+}
+
+void helper_pmu_mem(CPURISCVState *env, target_ulong addr, uint32_t is_store)
+{
+    RISCVCPU *cpu = env_archcpu(env);
+    RISCVPMUModel *model = cpu->pmu_model;
+    uint64_t line = ((uint64_t)addr >> PMU_L1D_LINE_BITS) + 1;
+    uint32_t set = (addr >> PMU_L1D_LINE_BITS) & (PMU_L1D_SETS - 1);
+    uint64_t *tag = model->l1d_tag[set];
+    bool miss = false;
+
+    if (tag[0] == line) {
+        model->l1d_mru[set] = 0;
+    } else if (tag[1] == line) {
+        model->l1d_mru[set] = 1;
+    } else {
+        /* Replace the least recently used way */
+        uint8_t victim = !model->l1d_mru[set];
+
+        tag[victim] = line;
+        model->l1d_mru[set] = victim;
+        miss = true;
+    }
+
+    pmu_model_count(cpu, PMU_MODEL_CACHE_REFERENCES);
+    pmu_model_count(cpu, is_store ? PMU_MODEL_L1D_WRITE_ACCESS :
+                                    PMU_MODEL_L1D_READ_ACCESS);
+    if (miss) {
+        pmu_model_count(cpu, PMU_MODEL_CACHE_MISSES);
+        pmu_model_count(cpu, is_store ? PMU_MODEL_L1D_WRITE_MISS :
+                                        PMU_MODEL_L1D_READ_MISS);
+    }
+}
+
+void helper_pmu_branch(CPURISCVState *env, target_ulong pc,
+                       target_ulong taken)
+{
+    RISCVCPU *cpu = env_archcpu(env);
+    uint8_t *ctr = &cpu->pmu_model->bht[(pc >> 1) & (PMU_BHT_ENTRIES - 1)];
+    bool predicted = *ctr >= 2;
+
+    if (taken) {
+        *ctr += *ctr < 3;
+    } else {
+        *ctr -= *ctr > 0;
+    }
+
+    pmu_model_count(cpu, PMU_MODEL_BRANCH_INSTRUCTIONS);
+    pmu_model_count(cpu, PMU_MODEL_BPU_READ_ACCESS);
+    if (predicted != !!taken) {
+        pmu_model_count(cpu, PMU_MODEL_BRANCH_MISSES);
+        pmu_model_count(cpu, PMU_MODEL_BPU_READ_MISS);
+    }
 }
 
 int riscv_pmu_setup_timer(CPURISCVState *env, uint64_t value, uint32_t ctr_idx)
@@ -403,6 +605,20 @@ int riscv_pmu_setup_timer(CPURISCVState *env, uint64_t value, uint32_t ctr_idx)
         overflow_delta = UINT64_MAX;
     }
 
+    /*
+     * Without icount, translated code counts retired instructions itself,
+     * so arm pmu_insns_limit rather than guessing a deadline for the timer.
+     */
+    if (!icount_enabled() && riscv_pmu_ctr_monitor_instructions(env, ctr_idx)) {
+        if (overflow_delta > UINT64_MAX - env->pmu_insns) {
+            counter->irq_insns_at = 0;
+        } else {
+            counter->irq_insns_at = env->pmu_insns + overflow_delta;
+        }
+        pmu_update_insns_limit(env);
+        return 0;
+    }
+
     /*
      * QEMU supports only int64_t timers while RISC-V counters are uint64_t.
      * Compute the leftover and save it so that it can be reprogrammed again
@@ -449,6 +665,8 @@ int riscv_pmu_init(RISCVCPU *cpu, int num_counters)
 
     /* Create a bitmask of available programmable counters */
     cpu->pmu_avail_ctrs = MAKE_32BIT_MASK(3, num_counters);
+    cpu->pmu_model = g_new0(RISCVPMUModel, 1);
+    cpu->env.pmu_insns_limit = UINT64_MAX;
 
     return 0;
 }
@@ -140,6 +140,18 @@ typedef struct DisasContext {
     bool frm_valid;
     /* TCG of the current insn_start */
     TCGOp *insn_start;
+    /* Count retired instructions for the PMU, and feed its event model */
+    bool pmu_insns;
+    bool pmu_model;
+    TCGOp *pmu_insns_op;
+    /* The cold sides of the branches a superblock went on past */
+    struct {
+        TCGLabel *label;
+        target_ulong dest;
+        target_ulong pc_save;
+        int num_insns;
+    } side_exit[SUPERBLOCK_MAX_JUMPS];
+    int nb_side_exits;
 } DisasContext;
 
 static void csky_trace_tb_start(CPURISCVState *env, TranslationBlock *tb)
@@ -195,6 +207,59 @@ static void gen_csky_jcount_end(int num_insns)
                        tcgv_i32_arg(tcg_constant_i32(num_insns)));
 }
 
+#ifndef CONFIG_USER_ONLY
+static void gen_pmu_insns_start(DisasContext *ctx)
+{
+    TCGv_i32 num_insns = tcg_temp_new_i32();
+    TCGv_i64 insns = tcg_temp_new_i64();
+    TCGv_i64 t0 = tcg_temp_new_i64();
+    TCGLabel *l = gen_new_label();
+
+    /* Patched with the number of insns in the TB by gen_pmu_insns_end. */
+    tcg_gen_movi_i32(num_insns, 0xdeadbeef);
+    ctx->pmu_insns_op = tcg_last_op();
+
+    tcg_gen_ld_i64(insns, cpu_env, offsetof(CPURISCVState, pmu_insns));
+    tcg_gen_extu_i32_i64(t0, num_insns);
+    tcg_gen_add_i64(insns, insns, t0);
+    tcg_gen_st_i64(insns, cpu_env, offsetof(CPURISCVState, pmu_insns));
+
+    tcg_gen_ld_i64(t0, cpu_env, offsetof(CPURISCVState, pmu_insns_limit));
+    tcg_gen_brcond_i64(TCG_COND_LTU, insns, t0, l);
+    gen_helper_pmu_insns_overflow(cpu_env);
+    gen_set_label(l);
+}
+
+static void gen_pmu_insns_end(DisasContext *ctx)
+{
+    tcg_set_insn_param(ctx->pmu_insns_op, 1,
+                       tcgv_i32_arg(tcg_constant_i32(ctx->base.num_insns)));
+}
+#endif
+
+static void gen_pmu_mem(DisasContext *ctx, TCGv addr, bool is_store)
+{
+#ifndef CONFIG_USER_ONLY
+    if (ctx->pmu_model) {
+        gen_helper_pmu_mem(cpu_env, addr, tcg_constant_i32(is_store));
+    }
+#endif
+}
+
+static void gen_pmu_branch(DisasContext *ctx, TCGCond cond,
+                           TCGv src1, TCGv src2)
+{
+#ifndef CONFIG_USER_ONLY
+    if (ctx->pmu_model) {
+        TCGv taken = tcg_temp_new();
+
+        tcg_gen_setcond_tl(cond, taken, src1, src2);
+        gen_helper_pmu_branch(cpu_env, tcg_constant_tl(ctx->base.pc_next),
+                              taken);
+    }
+#endif
+}
+
 static void csky_dump_tb_map(DisasContextBase *dcbase)
 {
     target_ulong tb_pc = dcbase->pc_first;
@@ -364,6 +429,40 @@ static void lookup_and_goto_ptr(DisasContext *ctx)
     tcg_gen_lookup_and_goto_ptr();
 }
 
+/*
+ * Calls and returns as hinted by the ISA: x1 and x5 are link registers,
+ * written by calls and read by returns.
+ */
+static bool is_link_reg(int reg)
+{
+    return reg == xRA || reg == xT0;
+}
+
+/*
+ * The jump of jalr to @dest, already in cpu_pc.  Returns are predicted
+ * from the return-address stack, other targets are cached at the site.
+ */
+static void gen_indirect_jump(DisasContext *ctx, TCGv dest, bool is_return)
+{
+    TCGv_i64 dest64 = tcg_temp_new_i64();
+
+#ifndef CONFIG_USER_ONLY
+    if (ctx->itrigger) {
+        gen_helper_itrigger_match(cpu_env);
+    }
+#endif
+    /* TBs are looked up with the pc zero-extended for RV32 */
+    tcg_gen_extu_tl_i64(dest64, dest);
+    if (get_xl(ctx) == MXL_RV32) {
+        tcg_gen_ext32u_i64(dest64, dest64);
+    }
+    if (is_return) {
+        translator_return(&ctx->base, dest64);
+    } else {
+        translator_lookup_and_goto_ptr(&ctx->base, dest64);
+    }
+}
+
 static void exit_tb(DisasContext *ctx)
 {
 #ifndef CONFIG_USER_ONLY
@@ -405,6 +504,45 @@ static void gen_goto_tb(DisasContext *ctx, int n, target_long diff)
     }
 }
 
+/*
+ * Leave a superblock for pc_next + @diff if @cond holds.  The exit itself
+ * is emitted by gen_side_exits at the end of the TB, so that the hot path
+ * goes on without a label and keeps its globals in host registers.
+ */
+static void gen_side_exit(DisasContext *ctx, TCGCond cond, TCGv src1,
+                          TCGv src2, target_long diff)
+{
+    int i = ctx->nb_side_exits++;
+
+    assert(i < ARRAY_SIZE(ctx->side_exit));
+    ctx->side_exit[i].label = gen_new_label();
+    ctx->side_exit[i].dest = ctx->base.pc_next + diff;
+    ctx->side_exit[i].pc_save = ctx->pc_save;
+    ctx->side_exit[i].num_insns = ctx->base.num_insns;
+    tcg_gen_brcond_tl(cond, src1, src2, ctx->side_exit[i].label);
+}
+
+static void gen_side_exits(DisasContext *ctx)
+{
+    for (int i = 0; i < ctx->nb_side_exits; i++) {
+        gen_set_label(ctx->side_exit[i].label);
+#ifndef CONFIG_USER_ONLY
+        if (ctx->pmu_insns) {
+            /* The whole superblock was counted on entry. */
+            TCGv_i64 insns = tcg_temp_new_i64();
+
+            tcg_gen_ld_i64(insns, cpu_env, offsetof(CPURISCVState, pmu_insns));
+            tcg_gen_subi_i64(insns, insns, ctx->base.num_insns -
+                             ctx->side_exit[i].num_insns);
+            tcg_gen_st_i64(insns, cpu_env, offsetof(CPURISCVState, pmu_insns));
+        }
+#endif
+        ctx->pc_save = ctx->side_exit[i].pc_save;
+        gen_update_pc(ctx, ctx->side_exit[i].dest - ctx->base.pc_next);
+        lookup_and_goto_ptr(ctx);
+    }
+}
+
 /*
  * Wrappers for getting reg values.
  *
@@ -665,6 +803,17 @@ static void gen_jal(DisasContext *ctx, int rd, target_ulong imm)
 
     gen_pc_plus_diff(succ_pc, ctx, ctx->cur_insn_len);
     gen_set_gpr(ctx, rd, succ_pc);
+    if (is_link_reg(rd)) {
+        translator_push_return(&ctx->base);
+    }
+
+    if (translator_follow_jump(&ctx->base,
+                               ctx->base.pc_next + ctx->cur_insn_len,
+                               ctx->base.pc_next + imm)) {
+        /* riscv_tr_translate_insn then moves pc_next on to the target. */
+        ctx->base.pc_next += imm - ctx->cur_insn_len;
+        return;
+    }
 
     gen_goto_tb(ctx, 0, imm); /* must use this for safety */
     ctx->base.is_jmp = DISAS_NORETURN;
@@ -1037,6 +1186,7 @@ static bool gen_arith(DisasContext *ctx, arg_r *a, DisasExtend ext,
 
 static void gen_load_internal(DisasContext *ctx, int memop, TCGv t1, TCGv t0)
 {
+    gen_pmu_mem(ctx, t0, false);
     if (gen_mem_trace()) {
         gen_update_pc(ctx, 0);
         switch (memop) {
@@ -1069,6 +1219,7 @@ static void gen_load_internal(DisasContext *ctx, int memop, TCGv t1, TCGv t0)
 
 static void gen_store_internal(DisasContext *ctx, int memop, TCGv dat, TCGv t0)
 {
+    gen_pmu_mem(ctx, t0, true);
     if (gen_mem_trace()) {
         gen_update_pc(ctx, 0);
         switch (memop) {
@@ -1423,6 +1574,14 @@ static void riscv_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cs)
     ctx->npill = EX_TBFLAGS_THEAD(tb_flags, NPILL);
     ctx->bf16 = EX_TBFLAGS_THEAD(tb_flags, BF16);
     ctx->mrowlen = cpu->cfg.mrowlen;
+#ifndef CONFIG_USER_ONLY
+    ctx->pmu_insns = EX_TBFLAGS_ANY(tb_flags, PMU_INSNS) &&
+                     !(tb_cflags(ctx->base.tb) & CF_USE_ICOUNT);
+#else
+    ctx->pmu_insns = false;
+#endif
+    ctx->pmu_model = EX_TBFLAGS_ANY(tb_flags, PMU_MODEL);
+    ctx->nb_side_exits = 0;
 }
 
 static void csky_tb_start_tb(CPURISCVState *env, TranslationBlock *tb)
@@ -1443,6 +1602,12 @@ static void riscv_tr_tb_start(DisasContextBase *db, CPUState *cpu)
     CPURISCVState *env = cpu->env_ptr;
     TranslationBlock *tb = db->tb;
 
+#ifndef CONFIG_USER_ONLY
+    if (ctx->pmu_insns) {
+        gen_pmu_insns_start(ctx);
+    }
+#endif
+
     if ((cpu->csky_trace_features & CSKY_TRACE) || env->jcount_start != 0) {
         gen_csky_jcount_start(ctx, cpu);
     }
@@ -1465,7 +1630,8 @@ static void riscv_tr_insn_start(DisasContextBase *dcbase, CPUState *cpu)
         pc_next &= ~TARGET_PAGE_MASK;
     }
 
-    tcg_gen_insn_start(pc_next, 0);
+    /* the index takes back the count of insns not run, see pmu_insns */
+    tcg_gen_insn_start(pc_next, 0, ctx->base.num_insns - 1);
     ctx->insn_start = tcg_last_op();
 }
 
@@ -1532,9 +1698,15 @@ static void riscv_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
     default:
         g_assert_not_reached();
     }
+    gen_side_exits(ctx);
     if (cpu->csky_trace_features & CSKY_TRACE || env->jcount_start != 0) {
         gen_csky_jcount_end(dcbase->num_insns);
     }
+#ifndef CONFIG_USER_ONLY
+    if (ctx->pmu_insns) {
+        gen_pmu_insns_end(ctx);
+    }
+#endif
 
     if (env->tb_trace == 1) {
         /* jcount to filter tb_trace */
@@ -1563,6 +1735,21 @@ static void riscv_tr_disas_log(const DisasContextBase *dcbase,
     target_disas(logfile, cpu, dcbase->pc_first, dcbase->tb->size);
 }
 
+/*
+ * jal and the hot side of branches are folded into hot superblocks unless
+ * TB boundaries are observed.
+ */
+static bool riscv_tr_superblock(DisasContextBase *dcbase, CPUState *cpu)
+{
+    DisasContext *ctx = container_of(dcbase, DisasContext, base);
+    CPURISCVState *env = cpu->env_ptr;
+
+    return !ctx->itrigger && !gen_tb_trace() &&
+           !(cpu->csky_trace_features & CSKY_TRACE) &&
+           env->jcount_start == 0 && env->tb_trace == 0 &&
+           env->pctrace == 0;
+}
+
 static const TranslatorOps riscv_tr_ops = {
     .init_disas_context = riscv_tr_init_disas_context,
     .tb_start           = riscv_tr_tb_start,
@@ -1570,6 +1757,7 @@ static const TranslatorOps riscv_tr_ops = {
     .translate_insn     = riscv_tr_translate_insn,
     .tb_stop            = riscv_tr_tb_stop,
     .disas_log          = riscv_tr_disas_log,
+    .superblock         = riscv_tr_superblock,
 };
 
 void gen_intermediate_code(CPUState *cs, TranslationBlock *tb, int *max_insns,
@@ -1599,6 +1787,12 @@ void riscv_translate_init(void)
             offsetof(CPURISCVState, gprh[i]), riscv_int_regnamesh[i]);
     }
 
+    /* Argument registers and sp, for -accel tcg,chain-regs=on */
+    for (i = xA0; i <= xA5; i++) {
+        tcg_chain_global(tcgv_tl_temp(cpu_gpr[i]));
+    }
+    tcg_chain_global(tcgv_tl_temp(cpu_gpr[xSP]));
+
     for (i = 0; i < 32; i++) {
         cpu_fpr[i] = tcg_global_mem_new_i64(cpu_env,
             offsetof(CPURISCVState, fpr[i]), riscv_fpr_regnames[i]);
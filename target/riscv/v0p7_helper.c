@@ -382,6 +382,50 @@ GEN_VEXT_ST_STRIDE(vsse_v_d, int64_t, int64_t, ste_d)
  *** unit-stride: access elements stored contiguously in memory
  */
 
+/*
+ * Copy a whole unit-stride access between the register file and host
+ * memory when every page it touches is plain RAM.  The access is at most
+ * one register group, so it never spans more than two pages.  Returns
+ * false if the caller has to fall back to element accesses, e.g. for
+ * MMIO; the pages have been probed in either case.
+ */
+static bool vext_ldst_us_host_7(void *vd, target_ulong base,
+                                CPURISCVState *env, target_ulong len,
+                                uintptr_t ra, MMUAccessType access_type,
+                                uint32_t olen)
+{
+    target_ulong pagelen = -(base | TARGET_PAGE_MASK);
+    target_ulong len0 = MIN(pagelen, len);
+    int mmu_idx = cpu_mmu_index(env, false);
+    void *host0, *host1 = NULL;
+
+    host0 = probe_access(env, adjust_addr(olen, base), len0, access_type,
+                         mmu_idx, ra);
+    if (len > len0) {
+        host1 = probe_access(env, adjust_addr(olen, base + len0), len - len0,
+                             access_type, mmu_idx, ra);
+    }
+#if HOST_BIG_ENDIAN
+    return false;
+#else
+    if (!host0 || (len > len0 && !host1)) {
+        return false;
+    }
+    if (access_type == MMU_DATA_LOAD) {
+        memcpy(vd, host0, len0);
+        if (len > len0) {
+            memcpy(vd + len0, host1, len - len0);
+        }
+    } else {
+        memcpy(host0, vd, len0);
+        if (len > len0) {
+            memcpy(host1, vd + len0, len - len0);
+        }
+    }
+    return true;
+#endif
+}
+
 /* unmasked unit-stride load and store operation*/
 static void
 vext_ldst_us_7(void *vd, target_ulong base, CPURISCVState *env, uint32_t desc,
@@ -395,7 +439,14 @@ vext_ldst_us_7(void *vd, target_ulong base, CPURISCVState *env, uint32_t desc,
     uint32_t olen = 16 << vext_ol_7(desc);
 
     /* probe every access */
-    probe_pages_7(env, base, env->vl * nf * msz, ra, access_type, olen);
+    if (nf == 1 && esz == msz && env->vl != 0) {
+        if (vext_ldst_us_host_7(vd, base, env, env->vl * msz, ra,
+                                access_type, olen)) {
+            goto clear;
+        }
+    } else {
+        probe_pages_7(env, base, env->vl * nf * msz, ra, access_type, olen);
+    }
     /* load bytes from guest memory */
     for (i = 0; i < env->vl; i++) {
         k = 0;
@@ -405,6 +456,7 @@ vext_ldst_us_7(void *vd, target_ulong base, CPURISCVState *env, uint32_t desc,
             k++;
         }
     }
+clear:
     /* clear tail elements */
     if (clear_elem) {
         for (k = 0; k < nf; k++) {
@@ -2023,6 +2075,33 @@ GEN_VEXT_VV(vnmsub_vv_7_h, 2, 2, clearh_7)
 GEN_VEXT_VV(vnmsub_vv_7_w, 4, 4, clearl_7)
 GEN_VEXT_VV(vnmsub_vv_7_d, 8, 8, clearq_7)
 
+/*
+ * Out-of-line fallbacks for the gvec expansion of the unmasked
+ * multiply-add instructions, used when the host has no vector multiply
+ * for the element size.  The whole register group is active, so there
+ * is neither a mask nor a tail to handle.
+ */
+#undef GEN_VEXT_GVEC_MAC
+#define GEN_VEXT_GVEC_MAC(NAME, ETYPE, OP)                       \
+void HELPER(NAME)(void *vd, void *vs1, void *vs2, uint32_t desc) \
+{                                                                \
+    intptr_t i, opr_sz = simd_oprsz(desc) / sizeof(ETYPE);       \
+    ETYPE *d = vd, *s1 = vs1, *s2 = vs2;                         \
+                                                                 \
+    for (i = 0; i < opr_sz; i++) {                               \
+        d[i] = OP(s2[i], s1[i], d[i]);                           \
+    }                                                            \
+}
+
+GEN_VEXT_GVEC_MAC(gvec_vmacc_7_b, int8_t, DO_MACC)
+GEN_VEXT_GVEC_MAC(gvec_vmacc_7_h, int16_t, DO_MACC)
+GEN_VEXT_GVEC_MAC(gvec_vnmsac_7_b, int8_t, DO_NMSAC)
+GEN_VEXT_GVEC_MAC(gvec_vnmsac_7_h, int16_t, DO_NMSAC)
+GEN_VEXT_GVEC_MAC(gvec_vmadd_7_b, int8_t, DO_MADD)
+GEN_VEXT_GVEC_MAC(gvec_vmadd_7_h, int16_t, DO_MADD)
+GEN_VEXT_GVEC_MAC(gvec_vnmsub_7_b, int8_t, DO_NMSUB)
+GEN_VEXT_GVEC_MAC(gvec_vnmsub_7_h, int16_t, DO_NMSUB)
+
 #undef OPIVX3
 #define OPIVX3(NAME, TD, T1, T2, TX1, TX2, HD, HS2, OP)             \
 static void do_##NAME(void *vd, target_long s1, void *vs2, int i)   \
@@ -536,12 +536,15 @@ static int alloc_code_gen_buffer(size_t size, int splitwx, Error **errp)
     return PROT_READ | PROT_WRITE | PROT_EXEC;
 }
 #else
+/* The address asked for by tcg_region_code_hint(), or NULL. */
+static void *code_gen_hint;
+
 static int alloc_code_gen_buffer_anon(size_t size, int prot,
                                       int flags, Error **errp)
 {
     void *buf;
 
-    buf = mmap(NULL, size, prot, flags, -1, 0);
+    buf = mmap(code_gen_hint, size, prot, flags, -1, 0);
     if (buf == MAP_FAILED) {
         error_setg_errno(errp, errno,
                          "allocate %zu bytes for jit buffer", size);
@@ -858,6 +861,66 @@ void tcg_region_prologue_set(TCGContext *s)
                      region.after_prologue);
 }
 
+/*
+ * Ask for the code buffer to be mapped at @hint, if that range is free,
+ * so that the persistent TB cache finds it at the same address in every
+ * run.  Must be called before tcg_init(); only the anonymous mapping of a
+ * buffer without split-wx honours it.
+ */
+void tcg_region_code_hint(void *hint)
+{
+#if !defined(USE_STATIC_CODE_GEN_BUFFER) && !defined(_WIN32)
+    code_gen_hint = hint;
+#endif
+}
+
+/*
+ * Describe the code buffer for the persistent TB cache.  Code saved from
+ * one run can only be loaded back at the address it was generated at,
+ * so this is limited to a single region without a split-wx mapping.
+ * @buf is the start of the buffer (and of the prologue), @start the first
+ * byte after the prologue and @end the allocation pointer of the context
+ * owning the region.  Returns false if the buffer does not qualify.
+ */
+bool tcg_region_code_span(void **buf, void **start, void **end,
+                          size_t *total_size)
+{
+    const TCGContext *s = &tcg_init_ctx;
+
+    if (region.n != 1 || tcg_splitwx_diff) {
+        return false;
+    }
+    if (qatomic_read(&tcg_cur_ctxs)) {
+        s = qatomic_read(&tcg_ctxs[0]);
+    }
+
+    *buf = region.start_aligned;
+    *start = region.after_prologue;
+    *end = qatomic_read(&s->code_gen_ptr);
+    *total_size = region.total_size;
+    return true;
+}
+
+/*
+ * Set aside the first @size bytes of the single region for code loaded by
+ * the persistent TB cache; a later call replaces the reservation, so zero
+ * gives it back.  Must be called before any vCPU thread has taken its
+ * copy of the initial context.  Returns NULL if the region is too small.
+ */
+void *tcg_region_code_reserve(size_t size)
+{
+    TCGContext *s = &tcg_init_ctx;
+    void *start = region.after_prologue;
+
+    g_assert(region.n == 1 && tcg_cur_ctxs == 0);
+
+    if (size > s->code_gen_highwater - start) {
+        return NULL;
+    }
+    s->code_gen_ptr = start + size;
+    return start;
+}
+
 /*
  * Returns the size (in bytes) of all translated code (i.e. from all regions)
  * currently in the cache.
@@ -1334,7 +1334,8 @@ static void tcg_context_init(unsigned max_cpus)
      * In user-mode we simply share the init context among threads, since we
      * use a single region. See the documentation tcg_region_init() for the
      * reasoning behind this.
-     * In softmmu we will have at most max_cpus TCG threads.
+     * In softmmu we will have at most max_cpus TCG threads; the caller
+     * counts any translator threads in max_cpus.
      */
 #ifdef CONFIG_USER_ONLY
     tcg_ctxs = &tcg_ctx;
@@ -1384,6 +1385,9 @@ TranslationBlock *tcg_tb_alloc(TCGContext *s)
 void tcg_prologue_init(TCGContext *s)
 {
     size_t prologue_size;
+#ifdef CONFIG_USER_ONLY
+    int i, n;
+#endif
 
     s->code_ptr = s->code_gen_ptr;
     s->code_buf = s->code_gen_ptr;
@@ -1401,6 +1405,22 @@ void tcg_prologue_init(TCGContext *s)
     /* Generate the prologue.  */
     tcg_target_qemu_prologue(s);
 
+#ifdef CONFIG_USER_ONLY
+    /*
+     * The prologue may have reserved a register picked for chaining:
+     * user mode creates the CPU and the target globals first.  System
+     * mode creates them after the prologue, and tcg_chain_global()
+     * already leaves out what it reserved.
+     */
+    for (i = n = 0; i < s->nb_chain; i++) {
+        if (!tcg_regset_test_reg(s->reserved_regs, s->chain_regs[i])) {
+            s->chain_temps[n] = s->chain_temps[i];
+            s->chain_regs[n++] = s->chain_regs[i];
+        }
+    }
+    s->nb_chain = n;
+#endif
+
 #ifdef TCG_TARGET_NEED_POOL_LABELS
     /* Allow the prologue to put e.g. guest_base into a pool entry.  */
     {
@@ -1608,6 +1628,52 @@ TCGTemp *tcg_global_mem_new_internal(TCGType type, TCGv_ptr base,
     return ts;
 }
 
+/*
+ * Chained globals.  With the convention enabled, each TB starts by
+ * loading these globals into fixed host registers and records in
+ * tb->chain_entry where its code continues after the loads.  Before
+ * goto_tb, the TB moves the same globals back into those registers, so
+ * a chained jump may enter the successor at chain_entry and skip the
+ * reloads.  The registers only ever cache values that are also in env;
+ * stores at the end of the TB are unchanged.
+ */
+static bool tcg_chain_enabled;
+
+void tcg_enable_chain_globals(void)
+{
+    tcg_chain_enabled = true;
+}
+
+/* Called by targets in priority order, after creating their globals.  */
+void tcg_chain_global(TCGTemp *ts)
+{
+    TCGContext *s = tcg_ctx;
+    TCGRegSet used = s->reserved_regs | tcg_target_call_clobber_regs;
+    int i;
+
+    if (!tcg_chain_enabled || s->nb_chain == TCG_MAX_CHAIN_GLOBALS
+        || ts->kind != TEMP_GLOBAL || ts->indirect_reg
+        || ts->base_type != ts->type) {
+        return;
+    }
+    for (i = 0; i < s->nb_chain; i++) {
+        if (s->chain_temps[i] == temp_idx(ts)) {
+            return;
+        }
+        tcg_regset_set_reg(used, s->chain_regs[i]);
+    }
+    for (i = 0; i < ARRAY_SIZE(tcg_target_reg_alloc_order); i++) {
+        TCGReg reg = tcg_target_reg_alloc_order[i];
+
+        if (tcg_regset_test_reg(tcg_target_available_regs[ts->type], reg)
+            && !tcg_regset_test_reg(used, reg)) {
+            s->chain_temps[s->nb_chain] = temp_idx(ts);
+            s->chain_regs[s->nb_chain++] = reg;
+            return;
+        }
+    }
+}
+
 TCGTemp *tcg_temp_new_internal(TCGType type, TCGTempKind kind)
 {
     TCGContext *s = tcg_ctx;
@@ -3284,6 +3350,20 @@ static void la_bb_end(TCGContext *s, int ng, int nt)
     }
 }
 
+/*
+ * liveness analysis: goto_tb: chained globals stay live in registers,
+ * synced, so that they are still there to hand to the next TB.
+ */
+static void la_chain_live(TCGContext *s)
+{
+    for (int i = 0; i < s->nb_chain; i++) {
+        TCGTemp *ts = &s->temps[s->chain_temps[i]];
+
+        ts->state = TS_MEM;
+        *la_temp_pref(ts) = (TCGRegSet)1 << s->chain_regs[i];
+    }
+}
+
 /* liveness analysis: sync globals back to memory.  */
 static void la_global_sync(TCGContext *s, int ng)
 {
@@ -3705,6 +3785,9 @@ liveness_pass_1(TCGContext *s)
             /* If end of basic block, update.  */
             if (def->flags & TCG_OPF_BB_EXIT) {
                 la_func_end(s, nb_globals, nb_temps);
+                if (opc == INDEX_op_goto_tb) {
+                    la_chain_live(s);
+                }
             } else if (def->flags & TCG_OPF_COND_BRANCH) {
                 la_bb_sync(s, nb_globals, nb_temps);
             } else if (def->flags & TCG_OPF_BB_END) {
@@ -4320,7 +4403,13 @@ static void temp_load(TCGContext *s, TCGTemp *ts, TCGRegSet desired_regs,
 static void temp_save(TCGContext *s, TCGTemp *ts, TCGRegSet allocated_regs)
 {
     /* The liveness analysis already ensures that globals are back
-       in memory. Keep an tcg_debug_assert for safety. */
+       in memory.  A chained global may still be cached in a register
+       since the start of the TB, but never dirty there.
+       Keep an tcg_debug_assert for safety. */
+    if (ts->kind == TEMP_GLOBAL && ts->val_type == TEMP_VAL_REG) {
+        tcg_debug_assert(ts->mem_coherent);
+        temp_free_or_dead(s, ts, -1);
+    }
     tcg_debug_assert(ts->val_type == TEMP_VAL_MEM || temp_readonly(ts));
 }
 
@@ -4409,6 +4498,35 @@ static void tcg_reg_alloc_cbranch(TCGContext *s, TCGRegSet allocated_regs)
     }
 }
 
+/*
+ * Before goto_tb, place the chained globals in the registers in which
+ * a successor entered at its chain_entry expects them.  Liveness kept
+ * them synced, so whatever is evicted here is already in memory.
+ */
+static void tcg_reg_alloc_chain(TCGContext *s)
+{
+    TCGRegSet allocated_regs = s->reserved_regs;
+
+    for (int i = 0; i < s->nb_chain; i++) {
+        TCGTemp *ts = &s->temps[s->chain_temps[i]];
+        TCGReg reg = s->chain_regs[i];
+
+        if (ts->val_type != TEMP_VAL_REG || ts->reg != reg) {
+            tcg_reg_free(s, reg, allocated_regs);
+            if (ts->val_type == TEMP_VAL_REG) {
+                tcg_debug_assert(ts->mem_coherent);
+                if (!tcg_out_mov(s, ts->type, reg, ts->reg)) {
+                    g_assert_not_reached();
+                }
+                set_temp_val_reg(s, ts, reg);
+            } else {
+                temp_load(s, ts, (TCGRegSet)1 << reg, allocated_regs, 0);
+            }
+        }
+        tcg_regset_set_reg(allocated_regs, reg);
+    }
+}
+
 /*
  * Specialized code generation for INDEX_op_mov_* with a constant.
  */
@@ -5992,6 +6110,17 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
     s->code_buf = tcg_splitwx_to_rw(tb->tc.ptr);
     s->code_ptr = s->code_buf;
 
+    /* Load the chained globals; a chained jump enters just after.  */
+    for (i = 0; i < s->nb_chain; i++) {
+        TCGTemp *ts = &s->temps[s->chain_temps[i]];
+
+        tcg_out_ld(s, ts->type, s->chain_regs[i],
+                   ts->mem_base->reg, ts->mem_offset);
+        set_temp_val_reg(s, ts, s->chain_regs[i]);
+        ts->mem_coherent = 1;
+    }
+    tb->chain_entry = s->nb_chain ? tcg_current_code_size(s) : 0;
+
 #ifdef TCG_TARGET_NEED_LDST_LABELS
     QSIMPLEQ_INIT(&s->ldst_labels);
 #endif
@@ -6043,6 +6172,7 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
             tcg_out_exit_tb(s, op->args[0]);
             break;
         case INDEX_op_goto_tb:
+            tcg_reg_alloc_chain(s);
             tcg_out_goto_tb(s, op->args[0]);
             break;
         case INDEX_op_dup2_vec:
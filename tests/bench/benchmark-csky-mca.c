@@ -0,0 +1,200 @@
+/*
+ * CSKY MCA DSP kernel benchmark
+ *
+ * Runs the FIR, MAC and vector kernels and their scalar references on
+ * the same random inputs, checks that the outputs are identical and
+ * reports the throughput of both.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or
+ * (at your option) any later version.  See the COPYING file in the
+ * top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "hw/misc/csky_mca_sim.h"
+
+#define BUF_ELEMS       4096
+#define ROUNDS          2000
+
+typedef struct MCABuffers {
+    int32_t a[BUF_ELEMS];
+    int32_t b[BUF_ELEMS];
+    int32_t init[BUF_ELEMS];
+    int32_t coeff[256];
+    int32_t out[BUF_ELEMS];
+    int32_t out_ref[BUF_ELEMS];
+} MCABuffers;
+
+static void fill_random(int32_t *buf, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = g_test_rand_int();
+    }
+}
+
+static MCABuffers *mca_buffers_new(void)
+{
+    MCABuffers *bufs = g_new0(MCABuffers, 1);
+
+    fill_random(bufs->a, BUF_ELEMS);
+    fill_random(bufs->b, BUF_ELEMS);
+    fill_random(bufs->init, BUF_ELEMS);
+    fill_random(bufs->coeff, ARRAY_SIZE(bufs->coeff));
+    return bufs;
+}
+
+static void report(const char *name, uint64_t samples, double fast,
+                   double ref)
+{
+    g_test_message("%s: %.2f Msamples/sec, reference %.2f Msamples/sec",
+                   name, samples / fast / 1e6, samples / ref / 1e6);
+}
+
+static void test_fir(const void *opaque)
+{
+    drv_asrc_data_mode_t data_mode = GPOINTER_TO_INT(opaque);
+    uint32_t elem = data_mode == DRV_ASRC_DATA_MODE_16_BITS ? 2 : 4;
+    g_autofree MCABuffers *bufs = mca_buffers_new();
+    double fast = 0, ref = 0;
+    uint64_t samples = 0;
+
+    for (int i = 0; i < ROUNDS; i++) {
+        uint32_t order = g_test_rand_int_range(0, 64);
+        uint32_t num = g_test_rand_int_range(0, 1024);
+        const char *end = (const char *)bufs->a + num * elem;
+        uint32_t size, size_ref;
+
+        memset(bufs->out, 0x5a, sizeof(bufs->out));
+        memset(bufs->out_ref, 0x5a, sizeof(bufs->out_ref));
+
+        g_test_timer_start();
+        size = csky_mca_sim_fir(data_mode, DRV_FIR_IIR_COEFF_SEL_32_BITS,
+                                order, 0, bufs->a, end, bufs->coeff,
+                                bufs->out);
+        fast += g_test_timer_elapsed();
+
+        g_test_timer_start();
+        size_ref = csky_mca_sim_fir_ref(data_mode,
+                                        DRV_FIR_IIR_COEFF_SEL_32_BITS, order,
+                                        0, bufs->a, end, bufs->coeff,
+                                        bufs->out_ref);
+        ref += g_test_timer_elapsed();
+
+        g_assert_cmpuint(size, ==, size_ref);
+        g_assert(!memcmp(bufs->out, bufs->out_ref, sizeof(bufs->out)));
+        samples += size / elem;
+    }
+
+    report("fir", samples, fast, ref);
+}
+
+static void test_mac(const void *opaque)
+{
+    drv_acc_data_bits_t input_bits = GPOINTER_TO_INT(opaque);
+    uint32_t elem = drv_acc_size_of_data_bits(input_bits);
+    g_autofree MCABuffers *bufs = mca_buffers_new();
+    double fast = 0, ref = 0;
+    uint64_t samples = 0;
+
+    for (int i = 0; i < ROUNDS; i++) {
+        uint32_t way = g_test_rand_int_range(1, 256);
+        uint32_t step = g_test_rand_int_range(0, 4) * elem;
+        uint32_t depth = MIN(g_test_rand_int_range(1, 16),
+                             sizeof(bufs->a) / (way * elem + step));
+        bool init = g_test_rand_bit(), active = g_test_rand_bit();
+        bool b_loop = g_test_rand_bit(), a_loop = g_test_rand_bit();
+        uint32_t init_shift = g_test_rand_int_range(0, 32);
+        drv_acc_shift_dir_t init_dir = g_test_rand_bit();
+        drv_acc_data_bits_t init_bits = g_test_rand_int_range(0, 3);
+        uint32_t result_shift = g_test_rand_int_range(0, 48);
+        drv_acc_shift_dir_t result_dir = g_test_rand_bit();
+        drv_acc_data_bits_t result_bits = g_test_rand_int_range(0, 3);
+
+        memset(bufs->out, 0x5a, sizeof(bufs->out));
+        memset(bufs->out_ref, 0x5a, sizeof(bufs->out_ref));
+
+        g_test_timer_start();
+        csky_mca_sim_mac(bufs->a, bufs->b, bufs->init, bufs->out, depth, way,
+                         input_bits, init, active, b_loop, a_loop,
+                         init_shift, init_dir, init_bits, result_shift,
+                         result_dir, result_bits, step);
+        fast += g_test_timer_elapsed();
+
+        g_test_timer_start();
+        csky_mca_sim_mac_ref(bufs->a, bufs->b, bufs->init, bufs->out_ref,
+                             depth, way, input_bits, init, active, b_loop,
+                             a_loop, init_shift, init_dir, init_bits,
+                             result_shift, result_dir, result_bits, step);
+        ref += g_test_timer_elapsed();
+
+        g_assert(!memcmp(bufs->out, bufs->out_ref, sizeof(bufs->out)));
+        samples += depth * way;
+    }
+
+    report("mac", samples, fast, ref);
+}
+
+static void test_vec(const void *opaque)
+{
+    drv_acc_data_bits_t input_bits = GPOINTER_TO_INT(opaque) & 3;
+    csky_mca_sim_vec_op_t op = GPOINTER_TO_INT(opaque) >> 2;
+    g_autofree MCABuffers *bufs = mca_buffers_new();
+    double fast = 0, ref = 0;
+    uint64_t samples = 0;
+
+    for (int i = 0; i < ROUNDS; i++) {
+        uint32_t depth = g_test_rand_int_range(1, BUF_ELEMS + 1);
+        bool scalar = g_test_rand_bit();
+        uint32_t scalar_value = g_test_rand_int();
+        uint32_t result_shift = g_test_rand_int_range(0, 40);
+        drv_acc_shift_dir_t result_dir = g_test_rand_bit();
+        drv_acc_data_bits_t result_bits = g_test_rand_int_range(0, 3);
+
+        memset(bufs->out, 0x5a, sizeof(bufs->out));
+        memset(bufs->out_ref, 0x5a, sizeof(bufs->out_ref));
+
+        g_test_timer_start();
+        csky_mca_sim_vec(op, bufs->a, bufs->b, bufs->out, depth, input_bits,
+                         scalar, result_shift, result_dir, result_bits,
+                         scalar_value);
+        fast += g_test_timer_elapsed();
+
+        g_test_timer_start();
+        csky_mca_sim_vec_ref(op, bufs->a, bufs->b, bufs->out_ref, depth,
+                             input_bits, scalar, result_shift, result_dir,
+                             result_bits, scalar_value);
+        ref += g_test_timer_elapsed();
+
+        g_assert(!memcmp(bufs->out, bufs->out_ref, sizeof(bufs->out)));
+        samples += depth;
+    }
+
+    report(op == THEAD_MCA_SIM_VEC_OP_MUL ? "vec mul" : "vec add",
+           samples, fast, ref);
+}
+
+int main(int argc, char **argv)
+{
+    static const char *const bits[] = { "8", "16", "32" };
+    static const char *const modes[] = { "32", "24", "16in32", "16" };
+    char name[64];
+
+    g_test_init(&argc, &argv, NULL);
+
+    for (int i = 0; i < ARRAY_SIZE(modes); i++) {
+        snprintf(name, sizeof(name), "/csky-mca/benchmark/fir/%s", modes[i]);
+        g_test_add_data_func(name, GINT_TO_POINTER(i), test_fir);
+    }
+    for (int i = 0; i < ARRAY_SIZE(bits); i++) {
+        snprintf(name, sizeof(name), "/csky-mca/benchmark/mac/%s", bits[i]);
+        g_test_add_data_func(name, GINT_TO_POINTER(i), test_mac);
+    }
+    for (int op = 0; op < 2; op++) {
+        for (int i = 0; i < ARRAY_SIZE(bits); i++) {
+            snprintf(name, sizeof(name), "/csky-mca/benchmark/vec-%s/%s",
+                     op == THEAD_MCA_SIM_VEC_OP_MUL ? "mul" : "add", bits[i]);
+            g_test_add_data_func(name, GINT_TO_POINTER(op << 2 | i), test_vec);
+        }
+    }
+
+    return g_test_run();
+}
@@ -0,0 +1,127 @@
+/*
+ * Litmus-style checks of the C-SKY ABIv1 memory ordering under MTTCG
+ *
+ * ABIv1 has no bar, so code relies on the default ordering, which keeps
+ * everything but store-to-load (TCG_GUEST_DEFAULT_MO), and on sync.
+ * Message passing and load buffering are run without any barrier, store
+ * buffering with sync; the forbidden outcomes must never be observed.
+ * Only a host with a weaker memory model than that can tell a missing
+ * barrier apart.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MP_ROUNDS       1000000
+#define LB_ROUNDS       20000
+#define SB_ROUNDS       20000
+
+static volatile unsigned int mp_data, mp_flag;
+static volatile unsigned int lb_x, lb_y, sb_x, sb_y;
+static unsigned int r[2];
+static pthread_barrier_t start, done;
+
+static void *mp_writer(void *arg)
+{
+    for (unsigned int i = 1; i <= MP_ROUNDS; i++) {
+        mp_data = i;
+        mp_flag = i;
+    }
+    return NULL;
+}
+
+static void *mp_reader(void *arg)
+{
+    unsigned int flag, data;
+
+    do {
+        flag = mp_flag;
+        data = mp_data;
+        if (data < flag) {
+            fprintf(stderr, "mp: saw flag %u with data %u\n", flag, data);
+            exit(EXIT_FAILURE);
+        }
+    } while (flag != MP_ROUNDS);
+    return NULL;
+}
+
+static void *lb_thread(void *arg)
+{
+    int me = (long)arg;
+    volatile unsigned int *mine = me ? &lb_y : &lb_x;
+    volatile unsigned int *other = me ? &lb_x : &lb_y;
+
+    for (int i = 0; i < LB_ROUNDS; i++) {
+        pthread_barrier_wait(&start);
+        r[me] = *other;
+        *mine = 1;
+        pthread_barrier_wait(&done);
+        if (me == 0) {
+            if (r[0] == 1 && r[1] == 1) {
+                fprintf(stderr, "lb: both loads saw 1 in round %d\n", i);
+                exit(EXIT_FAILURE);
+            }
+            lb_x = lb_y = 0;
+        }
+        pthread_barrier_wait(&done);
+    }
+    return NULL;
+}
+
+static void *sb_thread(void *arg)
+{
+    int me = (long)arg;
+    volatile unsigned int *mine = me ? &sb_y : &sb_x;
+    volatile unsigned int *other = me ? &sb_x : &sb_y;
+
+    for (int i = 0; i < SB_ROUNDS; i++) {
+        pthread_barrier_wait(&start);
+        *mine = 1;
+        asm volatile("sync" ::: "memory");
+        r[me] = *other;
+        pthread_barrier_wait(&done);
+        if (me == 0) {
+            if (r[0] == 0 && r[1] == 0) {
+                fprintf(stderr, "sb: both loads saw 0 in round %d\n", i);
+                exit(EXIT_FAILURE);
+            }
+            sb_x = sb_y = 0;
+        }
+        pthread_barrier_wait(&done);
+    }
+    return NULL;
+}
+
+static void run(void *(*fn[])(void *))
+{
+    pthread_t th[2];
+
+    for (long i = 0; i < 2; i++) {
+        if (pthread_create(&th[i], NULL, fn[i], (void *)i)) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        pthread_join(th[i], NULL);
+    }
+}
+
+int main(void)
+{
+    void *(*mp[])(void *) = { mp_writer, mp_reader };
+    void *(*lb[])(void *) = { lb_thread, lb_thread };
+    void *(*sb[])(void *) = { sb_thread, sb_thread };
+
+    pthread_barrier_init(&start, NULL, 2);
+    pthread_barrier_init(&done, NULL, 2);
+
+    run(mp);
+    run(lb);
+    run(sb);
+
+    printf("mp, lb and sb litmus tests passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/*
+ * Litmus-style checks of the C-SKY memory ordering under MTTCG
+ *
+ * Run with -cpu ck860. Message passing with bar, store buffering with
+ * sync and an ldex.w/stex.w counter, each on concurrent threads; the
+ * forbidden outcomes must never be observed.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BAR_BWAW    ".long 0xc000842a"
+#define BAR_BRAR    ".long 0xc0008425"
+
+#define MP_ROUNDS       1000000
+#define SB_ROUNDS       20000
+#define CNT_THREADS     4
+#define CNT_ROUNDS      100000
+
+static volatile unsigned int mp_data, mp_flag;
+static volatile unsigned int sb_x, sb_y;
+static unsigned int sb_r[2];
+static pthread_barrier_t sb_start, sb_done;
+static volatile unsigned int counter;
+
+static void *mp_writer(void *arg)
+{
+    for (unsigned int i = 1; i <= MP_ROUNDS; i++) {
+        mp_data = i;
+        asm volatile(BAR_BWAW ::: "memory");
+        mp_flag = i;
+    }
+    return NULL;
+}
+
+static void *mp_reader(void *arg)
+{
+    unsigned int flag, data;
+
+    do {
+        flag = mp_flag;
+        asm volatile(BAR_BRAR ::: "memory");
+        data = mp_data;
+        if (data < flag) {
+            fprintf(stderr, "mp: saw flag %u with data %u\n", flag, data);
+            exit(EXIT_FAILURE);
+        }
+    } while (flag != MP_ROUNDS);
+    return NULL;
+}
+
+static void *sb_thread(void *arg)
+{
+    int me = (long)arg;
+    volatile unsigned int *mine = me ? &sb_y : &sb_x;
+    volatile unsigned int *other = me ? &sb_x : &sb_y;
+
+    for (int i = 0; i < SB_ROUNDS; i++) {
+        pthread_barrier_wait(&sb_start);
+        *mine = 1;
+        asm volatile("sync" ::: "memory");
+        sb_r[me] = *other;
+        pthread_barrier_wait(&sb_done);
+        if (me == 0) {
+            if (sb_r[0] == 0 && sb_r[1] == 0) {
+                fprintf(stderr, "sb: both loads saw 0 in round %d\n", i);
+                exit(EXIT_FAILURE);
+            }
+            sb_x = sb_y = 0;
+        }
+    }
+    return NULL;
+}
+
+static void atomic_inc(volatile unsigned int *p)
+{
+    unsigned int tmp;
+
+    asm volatile("1: ldex.w %0, (%1, 0)\n\t"
+                 "addi %0, 1\n\t"
+                 "stex.w %0, (%1, 0)\n\t"
+                 "bez %0, 1b"
+                 : "=&r"(tmp) : "r"(p) : "memory");
+}
+
+static void *cnt_thread(void *arg)
+{
+    for (int i = 0; i < CNT_ROUNDS; i++) {
+        atomic_inc(&counter);
+    }
+    return NULL;
+}
+
+static void run(void *(*fn[])(void *), int n)
+{
+    pthread_t th[CNT_THREADS];
+
+    for (long i = 0; i < n; i++) {
+        if (pthread_create(&th[i], NULL, fn[i], (void *)i)) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        pthread_join(th[i], NULL);
+    }
+}
+
+int main(void)
+{
+    void *(*mp[])(void *) = { mp_writer, mp_reader };
+    void *(*sb[])(void *) = { sb_thread, sb_thread };
+    void *(*cnt[])(void *) = { cnt_thread, cnt_thread, cnt_thread,
+                               cnt_thread };
+
+    run(mp, 2);
+
+    pthread_barrier_init(&sb_start, NULL, 2);
+    pthread_barrier_init(&sb_done, NULL, 2);
+    run(sb, 2);
+
+    run(cnt, CNT_THREADS);
+    if (counter != CNT_THREADS * CNT_ROUNDS) {
+        fprintf(stderr, "ldex/stex: counter %u, expected %u\n",
+                counter, CNT_THREADS * CNT_ROUNDS);
+        return EXIT_FAILURE;
+    }
+
+    printf("mp, sb and ldex/stex litmus tests passed\n");
+    return EXIT_SUCCESS;
+}
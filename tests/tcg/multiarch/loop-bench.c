@@ -0,0 +1,413 @@
+/*
+ * Guest loops in the style of the integer SPEC kernels
+ *
+ * Pointer chasing, table-driven CRC, a bytecode interpreter, an
+ * insertion sort and calls through function pointers, each checked
+ * against a simpler reference and timed.
+ * Running it with and without -hot-threshold compares plain TB
+ * chaining with hot-trace superblocks; the numbers are meant to be
+ * compared between the two runs.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ROUNDS      64
+#define NODES       4096
+#define CRC_BYTES   16384
+#define PROG_STEPS  20000
+#define SORT_ELEMS  1024
+#define SHAPES      4096
+
+static uint32_t seed = 1;
+
+static uint32_t rand32(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void fail(const char *what)
+{
+    fprintf(stderr, "%s: result differs from the reference\n", what);
+    exit(EXIT_FAILURE);
+}
+
+/* mcf-like: walk a randomly linked list */
+typedef struct Node {
+    struct Node *next;
+    uint32_t val;
+} Node;
+
+static Node nodes[NODES];
+
+static void bench_list(void)
+{
+    uint64_t sum = 0, ref = 0;
+    int perm[NODES];
+    double t;
+
+    for (int i = 0; i < NODES; i++) {
+        perm[i] = i;
+    }
+    for (int i = NODES - 1; i > 0; i--) {
+        int j = rand32() % (i + 1), tmp = perm[i];
+
+        perm[i] = perm[j];
+        perm[j] = tmp;
+    }
+    for (int i = 0; i < NODES; i++) {
+        nodes[perm[i]].next = &nodes[perm[(i + 1) % NODES]];
+        nodes[i].val = rand32();
+        ref += nodes[i].val;
+    }
+
+    t = now();
+    for (int r = 0; r < ROUNDS; r++) {
+        Node *n = &nodes[perm[0]];
+
+        do {
+            sum += n->val;
+            n = n->next;
+        } while (n != &nodes[perm[0]]);
+    }
+    t = now() - t;
+
+    if (sum != ref * ROUNDS) {
+        fail("list");
+    }
+    printf("list walk: %.2f Mnodes/s\n", ROUNDS * NODES / t / 1e6);
+}
+
+/* bzip2-like: table-driven CRC-32 against the bitwise form */
+static uint8_t crc_data[CRC_BYTES];
+static uint32_t crc_table[256];
+
+static uint32_t crc_bitwise(const uint8_t *p, size_t n)
+{
+    uint32_t crc = ~0u;
+
+    while (n--) {
+        crc ^= *p++;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t crc_table_driven(const uint8_t *p, size_t n)
+{
+    uint32_t crc = ~0u;
+
+    while (n--) {
+        crc = (crc >> 8) ^ crc_table[(crc ^ *p++) & 0xff];
+    }
+    return ~crc;
+}
+
+static void bench_crc(void)
+{
+    uint32_t crc = 0, ref;
+    double t;
+
+    for (int i = 0; i < 256; i++) {
+        uint8_t b = i;
+
+        crc_table[i] = crc_bitwise(&b, 1) ^ crc_bitwise((uint8_t[]){0}, 1);
+    }
+    for (int i = 0; i < CRC_BYTES; i++) {
+        crc_data[i] = rand32();
+    }
+    ref = crc_bitwise(crc_data, CRC_BYTES);
+
+    t = now();
+    for (int r = 0; r < ROUNDS; r++) {
+        crc = crc_table_driven(crc_data, CRC_BYTES);
+    }
+    t = now() - t;
+
+    if (crc != ref) {
+        fail("crc");
+    }
+    printf("crc32: %.2f MB/s\n", ROUNDS * CRC_BYTES / t / 1e6);
+}
+
+/* perlbench-like: switch-dispatched stack machine */
+enum { OP_PUSH, OP_ADD, OP_MUL, OP_XOR, OP_DUP, OP_DROP, OP_END };
+
+static uint8_t prog[PROG_STEPS + 1];
+static uint32_t args[PROG_STEPS];
+
+static uint32_t interpret(void)
+{
+    uint32_t stack[64], *sp = stack;
+
+    for (int pc = 0; ; pc++) {
+        switch (prog[pc]) {
+        case OP_PUSH:
+            *sp++ = args[pc];
+            break;
+        case OP_ADD:
+            sp--;
+            sp[-1] += sp[0];
+            break;
+        case OP_MUL:
+            sp--;
+            sp[-1] *= sp[0] | 1;
+            break;
+        case OP_XOR:
+            sp--;
+            sp[-1] ^= sp[0];
+            break;
+        case OP_DUP:
+            sp[0] = sp[-1];
+            sp++;
+            break;
+        case OP_DROP:
+            sp--;
+            break;
+        case OP_END:
+            return sp[-1];
+        }
+    }
+}
+
+static void bench_interp(void)
+{
+    uint32_t result = 0, ref = 0;
+    int depth = 0;
+    double t;
+
+    /* generate a program that keeps 1..32 values on the stack */
+    for (int i = 0; i < PROG_STEPS; i++) {
+        int op = depth < 2 ? OP_PUSH : rand32() % OP_END;
+
+        if ((op == OP_PUSH || op == OP_DUP) && depth == 32) {
+            op = OP_ADD;
+        }
+        if (op == OP_DROP && depth < 2) {
+            op = OP_PUSH;
+        }
+        prog[i] = op;
+        args[i] = rand32();
+        depth += op == OP_PUSH || op == OP_DUP ? 1 : -1;
+    }
+    prog[PROG_STEPS] = OP_END;
+
+    /* the reference folds the same program without dispatch */
+    {
+        uint32_t stack[64], *sp = stack;
+
+        for (int i = 0; i < PROG_STEPS; i++) {
+            uint8_t op = prog[i];
+
+            if (op == OP_PUSH) {
+                *sp++ = args[i];
+            } else if (op == OP_DUP) {
+                sp[0] = sp[-1];
+                sp++;
+            } else if (op == OP_DROP) {
+                sp--;
+            } else {
+                sp--;
+                sp[-1] = op == OP_ADD ? sp[-1] + sp[0] :
+                         op == OP_MUL ? sp[-1] * (sp[0] | 1) :
+                         sp[-1] ^ sp[0];
+            }
+        }
+        ref = sp[-1];
+    }
+
+    t = now();
+    for (int r = 0; r < ROUNDS; r++) {
+        result = interpret();
+    }
+    t = now() - t;
+
+    if (result != ref) {
+        fail("interp");
+    }
+    printf("interpreter: %.2f Mops/s\n", ROUNDS * PROG_STEPS / t / 1e6);
+}
+
+/* a sort kernel with short inner loops */
+static uint32_t sort_buf[SORT_ELEMS];
+
+static void bench_sort(void)
+{
+    uint64_t sum = 0, ref = 0;
+    double t = 0;
+
+    for (int r = 0; r < ROUNDS / 8; r++) {
+        double start;
+
+        for (int i = 0; i < SORT_ELEMS; i++) {
+            sort_buf[i] = rand32();
+            ref += sort_buf[i];
+        }
+
+        start = now();
+        for (int i = 1; i < SORT_ELEMS; i++) {
+            uint32_t v = sort_buf[i];
+            int j = i;
+
+            while (j > 0 && sort_buf[j - 1] > v) {
+                sort_buf[j] = sort_buf[j - 1];
+                j--;
+            }
+            sort_buf[j] = v;
+        }
+        t += now() - start;
+
+        for (int i = 0; i < SORT_ELEMS; i++) {
+            if (i && sort_buf[i - 1] > sort_buf[i]) {
+                fail("sort");
+            }
+            sum += sort_buf[i];
+        }
+    }
+
+    if (sum != ref) {
+        fail("sort");
+    }
+    printf("insertion sort: %.2f Kelems/s\n",
+           ROUNDS / 8 * SORT_ELEMS / t / 1e3);
+}
+
+/*
+ * C++-like: virtual calls through per-class tables, recursion, and a
+ * longjmp out of a call chain that leaves returns unmatched
+ */
+typedef struct Shape {
+    const struct ShapeOps *ops;
+    uint32_t a, b;
+} Shape;
+
+typedef struct ShapeOps {
+    uint32_t (*area)(const Shape *s);
+    uint32_t (*perimeter)(const Shape *s);
+} ShapeOps;
+
+static uint32_t rect_area(const Shape *s)
+{
+    return s->a * s->b;
+}
+
+static uint32_t rect_perimeter(const Shape *s)
+{
+    return 2 * (s->a + s->b);
+}
+
+static uint32_t square_area(const Shape *s)
+{
+    return s->a * s->a;
+}
+
+static uint32_t square_perimeter(const Shape *s)
+{
+    return 4 * s->a;
+}
+
+static uint32_t tri_area(const Shape *s)
+{
+    return s->a * s->b / 2;
+}
+
+static uint32_t tri_perimeter(const Shape *s)
+{
+    return s->a + s->b + (s->a > s->b ? s->a : s->b);
+}
+
+static const ShapeOps shape_ops[] = {
+    { rect_area, rect_perimeter },
+    { square_area, square_perimeter },
+    { tri_area, tri_perimeter },
+};
+
+static Shape shapes[SHAPES];
+static jmp_buf unwind;
+static volatile int do_unwind = 1;
+
+static uint32_t depth_sum(uint32_t n)
+{
+    if (n == 0) {
+        if (do_unwind) {
+            longjmp(unwind, 1);
+        }
+        return 0;
+    }
+    return n + depth_sum(n - 1);
+}
+
+static uint32_t fib(uint32_t n)
+{
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+static void bench_dispatch(void)
+{
+    uint64_t sum = 0, ref = 0;
+    uint32_t unwinds = 0;
+    double t;
+
+    for (int i = 0; i < SHAPES; i++) {
+        int kind = rand32() % 3;
+        Shape *s = &shapes[i];
+
+        s->ops = &shape_ops[kind];
+        s->a = rand32() % 1000;
+        s->b = rand32() % 1000;
+        if (kind == 0) {
+            ref += s->a * s->b + 2 * (s->a + s->b);
+        } else if (kind == 1) {
+            ref += s->a * s->a + 4 * s->a;
+        } else {
+            ref += s->a * s->b / 2 + s->a + s->b +
+                   (s->a > s->b ? s->a : s->b);
+        }
+    }
+
+    t = now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < SHAPES; i++) {
+            const Shape *s = &shapes[i];
+
+            sum += s->ops->area(s) + s->ops->perimeter(s);
+        }
+        sum += fib(16);
+        if (setjmp(unwind) == 0) {
+            depth_sum(32);
+        } else {
+            unwinds++;
+        }
+    }
+    t = now() - t;
+
+    if (sum != (ref + 987) * ROUNDS || unwinds != ROUNDS) {
+        fail("dispatch");
+    }
+    printf("virtual calls: %.2f Mcalls/s\n", ROUNDS * SHAPES * 2 / t / 1e6);
+}
+
+int main(void)
+{
+    bench_list();
+    bench_crc();
+    bench_interp();
+    bench_sort();
+    bench_dispatch();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+/*
+ * Tile load throughput of the matrix extension
+ *
+ * Multiplies two int8 matrices with mld.b/mmaqa.b/mst.w tiles and checks
+ * the result against a scalar reference, then times the tile loads on
+ * their own.  Run with -cpu c907fdvm (rlen=128); the numbers are meant
+ * to be compared between two builds.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define MM_OP           0x2b
+#define A0              10
+#define A1              11
+
+/* the mld/mst forms take rs1 = a0 (base) and rs2 = a1 (stride) */
+#define MCFG            (0xfe000000u | (A0 << 15) | MM_OP)
+#define MZERO(md)       (0xa0000000u | ((md) << 15) | MM_OP)
+#define MLD_B(md)       (0x08000000u | (A1 << 20) | (A0 << 15) | \
+                         ((md) << 7) | MM_OP)
+#define MST_W(ms3)      (0x0a000000u | (A1 << 20) | (A0 << 15) | \
+                         (2 << 10) | ((ms3) << 7) | MM_OP)
+#define MMAQA_B(md, ms1, ms2) \
+                        (0x20000000u | ((ms2) << 21) | ((ms1) << 18) | \
+                         ((md) << 15) | MM_OP)
+
+/* tile shape for rlen = 128: 4 rows of 16 bytes */
+#define TM              4
+#define TK              16
+
+#define M               64
+#define N               64
+#define K               256
+#define LOAD_ITERS      (1 << 18)
+
+static int8_t a[M][K], b[N][K];
+static int32_t c[M][N], ref[M][N];
+
+#define MM_INSN(insn, base, stride)                                     \
+    do {                                                                \
+        register uintptr_t a0_ asm("a0") = (uintptr_t)(base);           \
+        register uintptr_t a1_ asm("a1") = (uintptr_t)(stride);         \
+        asm volatile(".long %c2" : : "r"(a0_), "r"(a1_), "i"(insn)      \
+                     : "memory");                                       \
+    } while (0)
+
+static void mcfg(unsigned m, unsigned n, unsigned k)
+{
+    MM_INSN(MCFG, m | (n << 8) | (k << 16), 0);
+}
+
+static void matmul(void)
+{
+    for (int i = 0; i < M; i += TM) {
+        for (int j = 0; j < N; j += TM) {
+            MM_INSN(MZERO(2), 0, 0);
+            for (int k = 0; k < K; k += TK) {
+                MM_INSN(MLD_B(0), &a[i][k], K);
+                MM_INSN(MLD_B(1), &b[j][k], K);
+                MM_INSN(MMAQA_B(2, 0, 1), 0, 0);
+            }
+            MM_INSN(MST_W(2), &c[i][j], N * sizeof(int32_t));
+        }
+    }
+}
+
+static void tile_loads(void)
+{
+    for (int n = 0; n < LOAD_ITERS; n++) {
+        int i = (n * TM) % M, k = (n * TK) % K;
+
+        MM_INSN(MLD_B(0), &a[i][k], K);
+        MM_INSN(MLD_B(1), &b[i][k], K);
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+    double t0, t1;
+
+    for (int i = 0; i < M; i++) {
+        for (int k = 0; k < K; k++) {
+            a[i][k] = (int8_t)(i * 7 + k * 3);
+        }
+    }
+    for (int j = 0; j < N; j++) {
+        for (int k = 0; k < K; k++) {
+            b[j][k] = (int8_t)(j * 5 - k * 11);
+        }
+    }
+    for (int i = 0; i < M; i++) {
+        for (int j = 0; j < N; j++) {
+            int32_t sum = 0;
+
+            for (int k = 0; k < K; k++) {
+                sum += a[i][k] * b[j][k];
+            }
+            ref[i][j] = sum;
+        }
+    }
+
+    mcfg(TM, TM, TK);
+
+    t0 = now();
+    matmul();
+    t1 = now();
+    if (memcmp(c, ref, sizeof(c))) {
+        printf("FAIL: tiled result differs from the reference\n");
+        return 1;
+    }
+    printf("matmul %dx%dx%d: %.3f ms\n", M, N, K, (t1 - t0) * 1e3);
+
+    t0 = now();
+    tile_loads();
+    t1 = now();
+    printf("mld.b: %.1f MiB/s\n",
+           2.0 * LOAD_ITERS * TM * TK / (t1 - t0) / (1 << 20));
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * Matrix multiply-accumulate results, for diffing the specialised
+ * kernels against the reference helpers
+ *
+ * Runs mmaqa{,u,us,su}.b, fmmacc.s and fmmacc.h on pseudo-random tiles
+ * for a few full and partial shapes and prints the destination and the
+ * accrued fflags.  The Makefile runs it once with -cpu c907fdvm and once
+ * with x-matrix-ref=on and compares the two outputs.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MM_OP           0x2b
+#define A0              10
+#define A1              11
+
+#define MCFG            (0xfe000000u | (A0 << 15) | MM_OP)
+#define MLD_W(md)       (0x08000000u | (A1 << 20) | (A0 << 15) | \
+                         (2 << 10) | ((md) << 7) | MM_OP)
+#define MST_W(ms3)      (0x0a000000u | (A1 << 20) | (A0 << 15) | \
+                         (2 << 10) | ((ms3) << 7) | MM_OP)
+/* funct3 selects the signedness for mmaqa.b, bits 11:7 the fp width */
+#define MM_RMM(hi, f3, lo, md, ms1, ms2) \
+                        (((hi) << 25) | ((ms2) << 21) | ((ms1) << 18) | \
+                         ((md) << 15) | ((f3) << 12) | ((lo) << 7) | MM_OP)
+#define MMAQA_B(f3)     MM_RMM(0x10, f3, 0, 0, 2, 4)
+#define FMMACC_S        MM_RMM(0x08, 0, 2, 0, 2, 4)
+#define FMMACC_H        MM_RMM(0x08, 0, 1, 0, 2, 4)
+
+/* rlen = 128: 4 rows of 16 bytes per register */
+#define ROWS            4
+#define RLENB           16
+
+static uint8_t src[3][2][ROWS][RLENB];
+static uint8_t dst[ROWS][RLENB];
+
+#define MM_INSN(insn, base, stride)                                     \
+    do {                                                                \
+        register uintptr_t a0_ asm("a0") = (uintptr_t)(base);           \
+        register uintptr_t a1_ asm("a1") = (uintptr_t)(stride);         \
+        asm volatile(".long %c2" : : "r"(a0_), "r"(a1_), "i"(insn)      \
+                     : "memory");                                       \
+    } while (0)
+
+static uint32_t seed = 1;
+
+static uint32_t rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static void fill(int kind)
+{
+    for (int r = 0; r < 3; r++) {
+        for (int p = 0; p < 2; p++) {
+            for (int i = 0; i < ROWS; i++) {
+                for (int k = 0; k < RLENB; k += 4) {
+                    uint32_t v = rnd();
+
+                    if (kind == 1) {
+                        /* fp32 in [1, 2) with random sign */
+                        v = 0x3f800000 | (v & 0x807fffff);
+                    } else if (kind == 2) {
+                        /* two fp16 in [0.5, 2) */
+                        v = (v & 0x83ff83ff) | 0x38003800 |
+                            ((v >> 4) & 0x04000400);
+                    }
+                    memcpy(&src[r][p][i][k], &v, 4);
+                }
+            }
+        }
+    }
+}
+
+/* load md = m0 from src[0], ms1 = m2 from src[1], ms2 = m4/m5 from src[2] */
+static void load(void)
+{
+    MM_INSN(MCFG, ROWS | (ROWS << 8) | (RLENB << 16), 0);
+    MM_INSN(MLD_W(0), src[0][0], RLENB);
+    MM_INSN(MLD_W(2), src[1][0], RLENB);
+    MM_INSN(MLD_W(4), src[2][0], RLENB);
+    MM_INSN(MLD_W(5), src[2][1], RLENB);
+}
+
+static void dump(const char *name, unsigned m, unsigned n, unsigned k)
+{
+    unsigned long fflags;
+
+    MM_INSN(MCFG, ROWS | (ROWS << 8) | (RLENB << 16), 0);
+    MM_INSN(MST_W(0), dst, RLENB);
+    asm volatile("csrrw %0, fflags, zero" : "=r"(fflags));
+
+    printf("%s m=%u n=%u k=%u fflags=%02lx:", name, m, n, k, fflags);
+    for (int i = 0; i < ROWS; i++) {
+        printf(" ");
+        for (int j = 0; j < RLENB; j++) {
+            printf("%02x", dst[i][j]);
+        }
+    }
+    printf("\n");
+}
+
+#define RUN(name, insn, kind, m, n, k)                                  \
+    do {                                                                \
+        fill(kind);                                                     \
+        load();                                                         \
+        MM_INSN(MCFG, (m) | ((n) << 8) | ((k) << 16), 0);               \
+        MM_INSN(insn, 0, 0);                                            \
+        dump(name, m, n, k);                                            \
+    } while (0)
+
+static const unsigned shapes[][3] = {
+    { 4, 4, 16 }, { 3, 2, 13 }, { 1, 4, 8 }, { 4, 1, 4 },
+};
+
+int main(void)
+{
+    asm volatile("csrw fflags, zero");
+
+    for (int s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        unsigned m = shapes[s][0], n = shapes[s][1], k = shapes[s][2];
+
+        RUN("mmaqa.b", MMAQA_B(0), 0, m, n, k);
+        RUN("mmaqau.b", MMAQA_B(1), 0, m, n, k);
+        RUN("mmaqaus.b", MMAQA_B(2), 0, m, n, k);
+        RUN("mmaqasu.b", MMAQA_B(3), 0, m, n, k);
+        RUN("fmmacc.s", FMMACC_S, 1, m, n, k & ~3);
+        RUN("fmmacc.h", FMMACC_H, 2, m, n * 2, k & ~1);
+    }
+    return 0;
+}
@@ -18,7 +18,12 @@
 #include "qemu/log.h"
 #include "cpu.h"
 #include "qemu/config-file.h"
+#include "qemu/error-report.h"
+#include "qemu/host-utils.h"
 #include "sysemu/runstate.h"
+#ifdef CONFIG_ZSTD
+#include <zstd.h>
+#endif
 struct csky_trace_server_state traceserver;
 #ifdef CONFIG_USER_ONLY
 static int traceserver_fd = -1;
@@ -27,6 +32,11 @@ long long csky_trace_icount;
 struct csky_trace_filter tfilter;
 int waddr_num, raddr_num;
 extern bool is_gdbserver_start;
+#ifdef CONFIG_ZSTD
+static ZSTD_CCtx *trace_zctx;
+static char *trace_zbuf;
+static size_t trace_zlen;
+#endif
 
 QemuOptsList qemu_csky_trace_opts = {
     .name = "csky-trace",
@@ -68,6 +78,34 @@ QemuOptsList qemu_csky_trace_opts = {
             .name = "proxy_trace",
             .type = QEMU_OPT_BOOL,
             .help = "add inst addr for memory trace or not",
+        },{
+            .name = "inline_mem",
+            .type = QEMU_OPT_BOOL,
+            .help = "store ld/st trace records from generated code",
+        },{
+            .name = "file",
+            .type = QEMU_OPT_STRING,
+            .help = "write trace to a file instead of a port",
+        },{
+            .name = "file_chunk",
+            .type = QEMU_OPT_SIZE,
+            .help = "size of the mapped window of the trace file",
+        },{
+            .name = "compress",
+            .type = QEMU_OPT_STRING,
+            .help = "off|delta|zstd stream compression",
+        },{
+            .name = "async",
+            .type = QEMU_OPT_BOOL,
+            .help = "send trace from a writer thread",
+        },{
+            .name = "ring",
+            .type = QEMU_OPT_NUMBER,
+            .help = "number of buffers per vCPU ring in async mode",
+        },{
+            .name = "backpressure",
+            .type = QEMU_OPT_STRING,
+            .help = "block|drop|grow when the ring is full",
         },{ /* end of list */ }
     },
 };
@@ -127,6 +165,8 @@ void csky_trace_handle_opts(CPUState *cs, uint32_t cpuid)
             if (!b) {
                 tfilter.event &= ~TRACE_EVENT_X_LMUL;
             }
+            traceserver.inline_mem = qemu_opt_get_bool(opts, "inline_mem",
+                                                       false);
             b = qemu_opt_get_bool(opts, "auto_trace", true);
             if (!b) {
                 tfilter.event &= ~TRACE_EVENT_DATA;
@@ -137,51 +177,230 @@ void csky_trace_handle_opts(CPUState *cs, uint32_t cpuid)
     }
 }
 
+/*
+ * The trace output of the calling thread: every vCPU stages its packets in
+ * a ring of its own, producers outside vCPU threads share the last one.
+ */
+static struct csky_trace_ring *trace_ring_get(void)
+{
+    int idx = MAX_TRACE_RINGS;
+    struct csky_trace_ring *r;
+
+    if (current_cpu) {
+        idx = current_cpu->cpu_index % MAX_TRACE_RINGS;
+    }
+    r = traceserver.rings[idx];
+    if (r == NULL) {
+        r = g_new0(struct csky_trace_ring, 1);
+        qatomic_store_release(&traceserver.rings[idx], r);
+    }
+    return r;
+}
+
 static int test = 0;
-static void trace_add_syn(void)
+static void trace_add_syn(struct csky_trace_ring *r)
 {
     uint16_t syn_start = SYN_START;
     uint16_t syn_end = SYN_END;
     uint16_t syn_icount = SYN_ICOUNT;
 
-    traceserver.insn_num = csky_trace_icount - traceserver.last_icount;
-    memcpy(traceserver.buf + traceserver.pos, &syn_start, sizeof(uint16_t));
-    memcpy(traceserver.buf + traceserver.pos + 2, &syn_icount,
-        sizeof(uint16_t));
-    memcpy(traceserver.buf + traceserver.pos + 4, &(traceserver.insn_num),
-        sizeof(uint32_t));
-    memcpy(traceserver.buf + traceserver.pos + 8, &syn_end,
-        sizeof(uint16_t));
+    r->insn_num = r->icount - r->last_icount;
+    memcpy(r->buf + r->pos, &syn_start, sizeof(uint16_t));
+    memcpy(r->buf + r->pos + 2, &syn_icount, sizeof(uint16_t));
+    memcpy(r->buf + r->pos + 4, &r->insn_num, sizeof(uint32_t));
+    memcpy(r->buf + r->pos + 8, &syn_end, sizeof(uint16_t));
 
-    traceserver.pos += 5 * sizeof(uint16_t);
-    test += traceserver.insn_num;
+    r->pos += 5 * sizeof(uint16_t);
+    test += r->insn_num;
+    r->delta_inst = 0;
+    r->delta_data = 0;
 }
-void trace_buf_alloc(bool add_sync)
+
+static void trace_stage_alloc(struct csky_trace_ring *r, bool add_sync)
 {
-    traceserver.buf = (char *)malloc(DEFAULT_BUFFER_LEN);
-    memset(traceserver.buf, 0, DEFAULT_BUFFER_LEN);
-    traceserver.len = DEFAULT_BUFFER_LEN;
-    traceserver.pos = 0;
+    r->buf = (char *)malloc(DEFAULT_BUFFER_LEN);
+    memset(r->buf, 0, DEFAULT_BUFFER_LEN);
+    r->len = DEFAULT_BUFFER_LEN;
+    r->pos = 0;
     if (add_sync) {
-        trace_add_syn();
+        trace_add_syn(r);
+    }
+}
+
+void trace_buf_alloc(bool add_sync)
+{
+    trace_stage_alloc(trace_ring_get(), add_sync);
+}
+
+static void trace_stage_clear(struct csky_trace_ring *r)
+{
+    r->pos = 0;
+    trace_add_syn(r);
+    r->chunk_icount = qatomic_read(&csky_trace_icount);
+    r->chunk_indexed = false;
+    if (traceserver.file &&
+        r->chunk_icount >= traceserver.file->next_index) {
+        traceserver.file->next_index = r->chunk_icount
+                                       + TRACE_FILE_INDEX_STEP;
+        r->chunk_indexed = true;
+        csky_trace_resync();
     }
 }
 
 void trace_buf_clear(void)
 {
-    traceserver.pos = 0;
-    trace_add_syn();
+    struct csky_trace_ring *r = trace_ring_get();
+
+    if (r->buf != NULL) {
+        trace_stage_clear(r);
+    }
 }
-#ifdef CONFIG_USER_ONLY
+/* map the next window of the trace file, growing the file as needed */
+static bool trace_file_map(struct csky_trace_file *tf)
+{
+    uint64_t start = tf->pos;
+    void *map;
+
+    if (tf->map) {
+        munmap(tf->map, tf->chunk_size);
+        tf->map = NULL;
+    }
+    if (tf->size < start + tf->chunk_size) {
+        if (ftruncate(tf->fd, start + tf->chunk_size) < 0) {
+            error_report("csky-trace: cannot grow trace file: %s",
+                         strerror(errno));
+            return false;
+        }
+        tf->size = start + tf->chunk_size;
+    }
+    map = mmap(NULL, tf->chunk_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+               tf->fd, start);
+    if (map == MAP_FAILED) {
+        error_report("csky-trace: cannot map trace file: %s",
+                     strerror(errno));
+        return false;
+    }
+    tf->map = map;
+    tf->map_start = start;
+    return true;
+}
+
+static void trace_file_write(struct csky_trace_chunk *c)
+{
+    struct csky_trace_file *tf = traceserver.file;
+    struct csky_trace_index_entry entry;
+    const char *buf = c->buf;
+    uint32_t len = c->pos;
+    uint32_t n;
+
+    if (c->indexed) {
+        entry.icount = cpu_to_le64(c->icount);
+        entry.offset = cpu_to_le64(tf->pos);
+        g_array_append_val(tf->index, entry);
+    }
+    while (len > 0) {
+        if (tf->map == NULL || tf->pos == tf->map_start + tf->chunk_size) {
+            if (!trace_file_map(tf)) {
+                return;
+            }
+        }
+        n = MIN(len, tf->map_start + tf->chunk_size - tf->pos);
+        memcpy(tf->map + (tf->pos - tf->map_start), buf, n);
+        tf->pos += n;
+        buf += n;
+        len -= n;
+    }
+    /* what is mapped reaches the file even if QEMU dies now */
+    tf->hdr->data_end = cpu_to_le64(tf->pos);
+}
+
+/* append the index, complete the header and cut the preallocated tail */
+static void trace_file_close(void)
+{
+    struct csky_trace_file *tf = traceserver.file;
+    uint64_t index_offset = ROUND_UP(tf->pos, 8);
+    size_t index_len = tf->index->len * sizeof(struct csky_trace_index_entry);
+
+    if (tf->map) {
+        munmap(tf->map, tf->chunk_size);
+    }
+    if (pwrite(tf->fd, tf->index->data, index_len, index_offset)
+            != (ssize_t)index_len
+        || ftruncate(tf->fd, index_offset + index_len) < 0) {
+        error_report("csky-trace: cannot finish trace file: %s",
+                     strerror(errno));
+    } else {
+        /* the index is only announced once it has been written */
+        tf->hdr->data_end = cpu_to_le64(tf->pos);
+        tf->hdr->index_num = cpu_to_le64(tf->index->len);
+        tf->hdr->index_offset = cpu_to_le64(index_offset);
+    }
+    munmap(tf->hdr, TRACE_FILE_HEADER_LEN);
+    close(tf->fd);
+    g_array_free(tf->index, true);
+    g_free(tf);
+    traceserver.file = NULL;
+}
+
+#ifdef CONFIG_ZSTD
+/* wrap a chunk into a TRACE_ZSTD_BLOCK packet, false to send it as is */
+static bool trace_zstd_block(struct csky_trace_chunk *c,
+                             struct csky_trace_chunk *out)
+{
+    size_t bound = ZSTD_compressBound(c->pos) + TRACE_ZSTD_HEADER_LEN;
+    uint32_t hdr[3];
+    size_t ret;
+
+    if (trace_zctx == NULL) {
+        trace_zctx = ZSTD_createCCtx();
+    }
+    if (trace_zlen < bound) {
+        trace_zbuf = g_realloc(trace_zbuf, bound);
+        trace_zlen = bound;
+    }
+    ret = ZSTD_compressCCtx(trace_zctx, trace_zbuf + TRACE_ZSTD_HEADER_LEN,
+                            bound - TRACE_ZSTD_HEADER_LEN, c->buf, c->pos,
+                            TRACE_ZSTD_LEVEL);
+    if (ZSTD_isError(ret)) {
+        return false;
+    }
+    hdr[0] = TRACE_ZSTD_BLOCK;
+    hdr[1] = ret;
+    hdr[2] = c->pos;
+    memcpy(trace_zbuf, hdr, TRACE_ZSTD_HEADER_LEN);
+    *out = *c;
+    out->buf = trace_zbuf;
+    out->pos = ret + TRACE_ZSTD_HEADER_LEN;
+    return true;
+}
+#endif
 
-static void send_packet(void)
+/* write a whole chunk to the trace consumer */
+static void trace_write_out(struct csky_trace_chunk *c)
 {
+#ifdef CONFIG_USER_ONLY
     int ret;
-    uint32_t last = traceserver.pos;
     uint32_t start = 0;
+    uint32_t last;
+#endif
+#ifdef CONFIG_ZSTD
+    struct csky_trace_chunk packed;
+
+    if (c->zstd && trace_zstd_block(c, &packed)) {
+        c = &packed;
+    }
+#endif
+#ifdef CONFIG_USER_ONLY
+    last = c->pos;
+#endif
+
+    if (traceserver.file) {
+        trace_file_write(c);
+        return;
+    }
+#ifdef CONFIG_USER_ONLY
     while (last > 0) {
-        ret = send(traceserver.fd, (const uint8_t *)traceserver.buf + start,
-                last, 0);
+        ret = send(traceserver.fd, (const uint8_t *)c->buf + start, last, 0);
         if (ret < 0) {
             if (errno != EINTR) {
                 return;
@@ -191,24 +410,266 @@ static void send_packet(void)
             last -= ret;
         }
     }
+#else
+    qemu_chr_fe_write_all(&traceserver.chr, (const uint8_t *)c->buf, c->pos);
+#endif
 }
+
+static void trace_sink_close(void)
+{
+    if (traceserver.file) {
+        trace_file_close();
+        return;
+    }
+#ifdef CONFIG_USER_ONLY
+    close(traceserver.fd);
+#else
+    qemu_chr_fe_disconnect(&traceserver.chr);
 #endif
+}
 
+/*
+ * Asynchronous output: every producer thread hands full buffers to its own
+ * ring and gets an empty one back, the writer thread drains all rings in
+ * sequence order so the stream keeps the order the chunks were produced.
+ */
+static bool trace_ring_full(struct csky_trace_ring *r)
+{
+    return r->head - qatomic_load_acquire(&r->tail) > r->mask;
+}
 
-void trace_termsig_handler(void)
+static void trace_ring_wait(struct csky_trace_ring *r)
 {
-    if (traceserver.initok) {
-        trace_add_syn();
-#ifdef CONFIG_USER_ONLY
-        send_packet();
-        close(traceserver.fd);
+    while (trace_ring_full(r)) {
+        qemu_event_reset(&traceserver.space_ev);
+        if (!trace_ring_full(r)) {
+            break;
+        }
+        qemu_event_wait(&traceserver.space_ev);
+    }
+}
+
+/*
+ * Queue the current buffer. Returns false if the buffer was kept by the
+ * grow policy and must not be cleared by the caller.
+ */
+static bool trace_ring_push(struct csky_trace_ring *r, bool force)
+{
+    struct csky_trace_chunk *c;
+    char *buf;
+    uint32_t len;
+
+    if (r->slot == NULL) {
+        r->slot = g_new0(struct csky_trace_chunk, traceserver.ring_slots);
+        r->mask = traceserver.ring_slots - 1;
+    }
+    if (trace_ring_full(r)) {
+        /* a seek point is never dropped, the index must be able to use it */
+        if (force || traceserver.backpressure == TRACE_BP_BLOCK ||
+            r->chunk_indexed) {
+            trace_ring_wait(r);
+        } else if (traceserver.backpressure == TRACE_BP_DROP) {
+            traceserver.dropped_chunks++;
+            traceserver.dropped_bytes += r->pos;
+            /* what follows may need state that was lost, start afresh */
+            if (traceserver.file) {
+                traceserver.file->next_index = 0;
+            }
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    c = &r->slot[r->head & r->mask];
+    buf = c->buf;
+    len = c->len;
+    c->buf = r->buf;
+    c->len = r->len;
+    c->pos = r->pos;
+    c->seq = qatomic_fetch_inc(&traceserver.seq);
+    c->icount = r->chunk_icount;
+    c->indexed = r->chunk_indexed;
+    c->zstd = traceserver.zstd;
+    qatomic_store_release(&r->head, r->head + 1);
+    qemu_event_set(&traceserver.data_ev);
+
+    /* reuse the buffer the writer has finished with */
+    if (buf == NULL) {
+        buf = (char *)malloc(DEFAULT_BUFFER_LEN);
+        len = DEFAULT_BUFFER_LEN;
+    }
+    r->buf = buf;
+    r->len = len;
+    r->pos = 0;
+    return true;
+}
+
+static struct csky_trace_ring *trace_ring_next(void)
+{
+    struct csky_trace_ring *r, *best = NULL;
+    uint64_t seq = UINT64_MAX;
+    int i;
+
+    for (i = 0; i <= MAX_TRACE_RINGS; i++) {
+        r = qatomic_load_acquire(&traceserver.rings[i]);
+        if (r && r->tail != qatomic_load_acquire(&r->head)) {
+            if (r->slot[r->tail & r->mask].seq < seq) {
+                seq = r->slot[r->tail & r->mask].seq;
+                best = r;
+            }
+        }
+    }
+    return best;
+}
+
+static void *trace_writer_thread(void *opaque)
+{
+    struct csky_trace_ring *r;
+    struct csky_trace_chunk *c;
+    bool quit;
+
+    for (;;) {
+        qemu_event_reset(&traceserver.data_ev);
+        /* read before draining so a final push is never missed */
+        quit = qatomic_read(&traceserver.writer_quit);
+        while ((r = trace_ring_next()) != NULL) {
+            c = &r->slot[r->tail & r->mask];
+            trace_write_out(c);
+            qatomic_store_release(&r->tail, r->tail + 1);
+            qemu_event_set(&traceserver.space_ev);
+        }
+        if (quit) {
+            break;
+        }
+        qemu_event_wait(&traceserver.data_ev);
+    }
+    return NULL;
+}
+
+static void trace_ring_setup(void)
+{
+    QemuOpts *opts = qemu_opts_find(qemu_find_opts("csky-trace"), NULL);
+    const char *bp;
+    uint64_t slots;
+
+    qemu_mutex_init(&traceserver.out_lock);
+    if (!opts || !qemu_opt_get_bool(opts, "async", false)) {
+        return;
+    }
+    slots = qemu_opt_get_number(opts, "ring", DEFAULT_RING_SLOTS);
+    if (slots < 2 || slots > MAX_RING_SLOTS || !is_power_of_2(slots)) {
+        error_report("csky-trace: ring must be a power of 2 in [2, %d]",
+                     MAX_RING_SLOTS);
+        exit(1);
+    }
+    bp = qemu_opt_get(opts, "backpressure");
+    if (bp == NULL || !strcmp(bp, "block")) {
+        traceserver.backpressure = TRACE_BP_BLOCK;
+    } else if (!strcmp(bp, "drop")) {
+        traceserver.backpressure = TRACE_BP_DROP;
+    } else if (!strcmp(bp, "grow")) {
+        traceserver.backpressure = TRACE_BP_GROW;
+    } else {
+        error_report("csky-trace: backpressure must be block, drop or grow");
+        exit(1);
+    }
+    traceserver.ring_slots = slots;
+    qemu_event_init(&traceserver.data_ev, false);
+    qemu_event_init(&traceserver.space_ev, false);
+    qemu_thread_create(&traceserver.writer, "csky-trace", trace_writer_thread,
+                       NULL, QEMU_THREAD_JOINABLE);
+    traceserver.async = true;
+}
+
+static void trace_codec_setup(void)
+{
+    QemuOpts *opts = qemu_opts_find(qemu_find_opts("csky-trace"), NULL);
+    const char *codec = opts ? qemu_opt_get(opts, "compress") : NULL;
+
+    if (codec == NULL || !strcmp(codec, "off")) {
+        traceserver.codec = TRACE_CODEC_RAW;
+    } else if (!strcmp(codec, "delta")) {
+        traceserver.codec = TRACE_CODEC_DELTA;
+    } else if (!strcmp(codec, "zstd")) {
+#ifdef CONFIG_ZSTD
+        traceserver.codec = TRACE_CODEC_ZSTD;
 #else
-        qemu_chr_fe_write_all(&traceserver.chr,
-            (const uint8_t *)traceserver.buf, traceserver.pos);
-        qemu_chr_fe_disconnect(&traceserver.chr);
+        error_report("csky-trace: zstd support is not compiled in");
+        exit(1);
 #endif
+    } else {
+        error_report("csky-trace: compress must be off, delta or zstd");
+        exit(1);
+    }
+}
+
+/*
+ * Drain the rings and stop the writer. The rings themselves are left to
+ * the exit: other vCPUs may still be running and staging into theirs.
+ */
+static void trace_writer_stop(void)
+{
+    if (traceserver.async) {
+        qatomic_set(&traceserver.writer_quit, true);
+        qemu_event_set(&traceserver.data_ev);
+        qemu_thread_join(&traceserver.writer);
+        traceserver.async = false;
+        if (traceserver.dropped_chunks) {
+            qemu_log_mask(LOG_GUEST_ERROR, "csky-trace: dropped %" PRIu64
+                          " chunks (%" PRIu64 " bytes)\n",
+                          traceserver.dropped_chunks,
+                          traceserver.dropped_bytes);
+        }
+    }
+}
+
+/* returns false if the buffer must be kept, see trace_ring_push */
+static bool trace_output(struct csky_trace_ring *r, bool force)
+{
+    struct csky_trace_chunk c;
+
+    if (traceserver.async) {
+        return trace_ring_push(r, force);
+    }
+    c.buf = r->buf;
+    c.pos = r->pos;
+    c.icount = r->chunk_icount;
+    c.indexed = r->chunk_indexed;
+    c.zstd = traceserver.zstd;
+    qemu_mutex_lock(&traceserver.out_lock);
+    trace_write_out(&c);
+    qemu_mutex_unlock(&traceserver.out_lock);
+    return true;
+}
+
+/* send what every vCPU has staged */
+static void trace_output_all(void)
+{
+    struct csky_trace_ring *r;
+    int i;
+
+    for (i = 0; i <= MAX_TRACE_RINGS; i++) {
+        r = traceserver.rings[i];
+        if (r == NULL || r->buf == NULL) {
+            continue;
+        }
+        if (r->pos > 5 * sizeof(uint16_t)) {
+            r->last_icount += r->insn_num;
+            trace_add_syn(r);
+        }
+        trace_output(r, true);
+    }
+}
+
+void trace_termsig_handler(void)
+{
+    csky_trace_rec_sync_all();
+    if (traceserver.initok) {
+        trace_output_all();
+        trace_writer_stop();
+        trace_sink_close();
     }
-    trace_buf_clear();
 }
 
 /* Trace_send is triggered by the target insn counter.
@@ -216,51 +677,78 @@ void trace_termsig_handler(void)
  */
 void trace_send(void)
 {
+    struct csky_trace_ring *r = trace_ring_get();
+
+    csky_trace_rec_sync();
     if (traceserver.initok) {
-        if (traceserver.buf == NULL) {
-            trace_buf_alloc(true);
+        if (r->buf == NULL) {
+            trace_stage_alloc(r, true);
+        }
+        if (!trace_output(r, false)) {
+            return;
         }
-#ifdef CONFIG_USER_ONLY
-        send_packet();
-#else
-        qemu_chr_fe_write_all(&traceserver.chr,
-            (const uint8_t *)traceserver.buf, traceserver.pos);
-#endif
     }
     trace_buf_clear();
-    traceserver.last_icount += traceserver.insn_num;
+    r->last_icount += r->insn_num;
 }
 
 void trace_send_immediately(void)
 {
-    if ((traceserver.buf != NULL) && (traceserver.initok != false)) {
-        if (traceserver.pos > 5 * sizeof(uint16_t)) {
-            traceserver.last_icount += traceserver.insn_num;
-            trace_add_syn();
+    struct csky_trace_ring *r = trace_ring_get();
+
+    csky_trace_rec_sync();
+    if ((r->buf != NULL) && (traceserver.initok != false)) {
+        if (r->pos > 5 * sizeof(uint16_t)) {
+            r->last_icount += r->insn_num;
+            trace_add_syn(r);
         }
-#ifdef CONFIG_USER_ONLY
-        send_packet();
-#else
-        qemu_chr_fe_write_all(&traceserver.chr,
-            (const uint8_t *)traceserver.buf, traceserver.pos);
-#endif
-        trace_buf_clear();
+        trace_output(r, true);
+        trace_stage_clear(r);
     }
 }
 
-void write_trace_before(uint32_t packlen, bool header)
+/*
+ * Count icount instructions run by the calling vCPU, of which the filter
+ * let through all if traced; the buffer goes out every INSN_PER_PACKET.
+ */
+void trace_count_insns(uint32_t icount, bool traced)
 {
+    struct csky_trace_ring *r = trace_ring_get();
 
-    if (traceserver.buf == 0) {
-        trace_buf_alloc(!header);
+    r->run_icount += icount;
+    if (r->run_icount - r->sent_icount > INSN_PER_PACKET) {
+        trace_send();
+        r->sent_icount = r->run_icount;
     }
-    if ((traceserver.pos + packlen) > traceserver.len) {
-        traceserver.buf = (char *)realloc(traceserver.buf,
-            traceserver.len + 2 * 1024);
-        traceserver.len += 2 * 1024;
+    if (traced) {
+        r->icount += icount;
+        qatomic_add(&csky_trace_icount, icount);
     }
 }
 
+/* make room for packlen bytes in the buffer of the calling vCPU */
+static struct csky_trace_ring *trace_stage_reserve(uint32_t packlen,
+                                                   bool header)
+{
+    struct csky_trace_ring *r = trace_ring_get();
+
+    csky_trace_rec_sync();
+
+    if (r->buf == NULL) {
+        trace_stage_alloc(r, !header);
+    }
+    if ((r->pos + packlen) > r->len) {
+        r->buf = (char *)realloc(r->buf, r->len + 2 * 1024);
+        r->len += 2 * 1024;
+    }
+    return r;
+}
+
+void write_trace_before(uint32_t packlen, bool header)
+{
+    trace_stage_reserve(packlen, header);
+}
+
 void write_trace_header(uint32_t config)
 {
     uint32_t version = ((CURRENT_TRACE_VERSION) << 8) | TRACE_VERSION;
@@ -269,41 +757,50 @@ void write_trace_header(uint32_t config)
     char *cpu = tfilter.cpu;
     uint32_t packlen = 0;
     uint16_t config_type = TRACE_CONFIG;
+    struct csky_trace_ring *r;
     static bool header = true; /* a header or just trace config */
     cpuid[0] = TRACE_CPUID;
     cpuid[1] = tfilter.cpuid;
     cpu[0] = CPU_NAME;
 
     if (header) {
+        if (traceserver.codec == TRACE_CODEC_DELTA) {
+            config |= TRACE_EVENT_DELTA;
+        } else if (traceserver.codec == TRACE_CODEC_ZSTD) {
+            config |= TRACE_EVENT_DELTA | TRACE_EVENT_ZSTD;
+        }
         packlen = 9 * sizeof(uint32_t) + 1 * sizeof(uint16_t) + 20 * sizeof(char);
-        write_trace_before(packlen, true);
+        r = trace_stage_reserve(packlen, true);
         /* add version */
-        memcpy(traceserver.buf + traceserver.pos, &version, sizeof(uint32_t));
-        traceserver.pos += sizeof(uint32_t);
+        memcpy(r->buf + r->pos, &version, sizeof(uint32_t));
+        r->pos += sizeof(uint32_t);
         /* add traceid */
-        memcpy(traceserver.buf + traceserver.pos, &traceid, sizeof(uint32_t));
-        traceserver.pos += sizeof(uint32_t);
+        memcpy(r->buf + r->pos, &traceid, sizeof(uint32_t));
+        r->pos += sizeof(uint32_t);
         /* add cpuid */
-        memcpy(traceserver.buf + traceserver.pos, cpuid, sizeof(uint32_t) * 6);
-        traceserver.pos += sizeof(uint32_t) * 6;
+        memcpy(r->buf + r->pos, cpuid, sizeof(uint32_t) * 6);
+        r->pos += sizeof(uint32_t) * 6;
         /* add cpu */
-        memcpy(traceserver.buf + traceserver.pos, cpu, sizeof(char) * 20);
-        traceserver.pos += sizeof(char) * 20;
+        memcpy(r->buf + r->pos, cpu, sizeof(char) * 20);
+        r->pos += sizeof(char) * 20;
         /* add trace control registers */
-        memcpy(traceserver.buf + traceserver.pos, &config_type,
-            sizeof(uint16_t));
-        traceserver.pos += sizeof(uint16_t);
-        memcpy(traceserver.buf + traceserver.pos, &config, sizeof(uint32_t));
-        traceserver.pos += sizeof(uint32_t);
+        memcpy(r->buf + r->pos, &config_type, sizeof(uint16_t));
+        r->pos += sizeof(uint16_t);
+        memcpy(r->buf + r->pos, &config, sizeof(uint32_t));
+        r->pos += sizeof(uint32_t);
         trace_send_immediately();
         header = false;
+        /* everything after the header uses the announced codec */
+        traceserver.delta = traceserver.codec != TRACE_CODEC_RAW;
+        traceserver.zstd = traceserver.codec == TRACE_CODEC_ZSTD;
     } else {
         write_trace_8_8(TRACE_CONFIG, 6, 0, config);
     }
 }
 //#define CSKY_TRACE_COMPRESS
 /* compress and send the coming element   */
-static void csky_trace_compress(uint32_t packetlen, char *start)
+static void csky_trace_compress(struct csky_trace_ring *r,
+                                uint32_t packetlen, char *start)
 {
 #ifdef CSKY_TRACE_COMPRESS
     uint64_t compress_element;
@@ -318,16 +815,14 @@ static void csky_trace_compress(uint32_t packetlen, char *start)
                 packetlen) == 0) {
             pcompress->count++;
         } else {
-            memcpy(traceserver.buf + traceserver.pos, pcompress->lastpacket,
-                pcompress->len);
-            traceserver.pos += pcompress->len / sizeof(uint8_t);
+            memcpy(r->buf + r->pos, pcompress->lastpacket, pcompress->len);
+            r->pos += pcompress->len / sizeof(uint8_t);
             if (pcompress->count > 1) {
-                write_trace_before(sizeof(uint64_t), false);
+                trace_stage_reserve(sizeof(uint64_t), false);
                 compress_element = ((uint64_t)pcompress->count << 32)
                     | ((1 << 24) | TRACE_COMPRESS);
-                memcpy(traceserver.buf + traceserver.pos, &compress_element,
-                    sizeof(uint64_t));
-                traceserver.pos += sizeof(uint64_t);
+                memcpy(r->buf + r->pos, &compress_element, sizeof(uint64_t));
+                r->pos += sizeof(uint64_t);
             }
             pcompress->lastpacket = (char *)realloc(pcompress->lastpacket,
                 packetlen);
@@ -337,43 +832,120 @@ static void csky_trace_compress(uint32_t packetlen, char *start)
         }
     }
 #else
-    memcpy(traceserver.buf + traceserver.pos, start, packetlen);
-    traceserver.pos += packetlen / sizeof(uint8_t);
+    memcpy(r->buf + r->pos, start, packetlen);
+    r->pos += packetlen / sizeof(uint8_t);
 #endif
 }
 
+static inline void trace_put_byte(struct csky_trace_ring *r, uint8_t value)
+{
+    r->buf[r->pos++] = value;
+}
+
+static void trace_put_varint(struct csky_trace_ring *r, uint32_t value)
+{
+    while (value >= 0x80) {
+        trace_put_byte(r, value | 0x80);
+        value >>= 7;
+    }
+    trace_put_byte(r, value);
+}
+
+static void trace_put_delta(struct csky_trace_ring *r, uint32_t *last,
+                            uint32_t value)
+{
+    int32_t delta = value - *last;
+
+    *last = value;
+    trace_put_varint(r, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+}
+
+static bool trace_is_data_addr(uint8_t type)
+{
+    return type == DATA_RADDR || type == DATA_WADDR ||
+           type == DATA_SRADDR || type == DATA_SWADDR;
+}
+
+/* packlen - 1 is the number of value bytes of the raw packet */
+static void write_delta_8(uint8_t type, uint32_t packlen, uint32_t value)
+{
+    struct csky_trace_ring *r = trace_stage_reserve(TRACE_DELTA_MAXLEN, false);
+
+    trace_put_byte(r, type);
+    if (type == INST_OFFSET) {
+        trace_put_delta(r, &r->delta_inst, value);
+    } else {
+        trace_put_varint(r, value & MAKE_64BIT_MASK(0, (packlen - 1) * 8));
+    }
+}
+
+static void write_delta_8_8(uint8_t type, uint32_t packlen, uint8_t value1,
+                            uint32_t value2)
+{
+    struct csky_trace_ring *r = trace_stage_reserve(TRACE_DELTA_MAXLEN, false);
+
+    trace_put_byte(r, type);
+    trace_put_byte(r, value1);
+    if (trace_is_data_addr(type)) {
+        trace_put_delta(r, &r->delta_data, value2);
+    } else {
+        trace_put_varint(r, value2 & MAKE_64BIT_MASK(0, (packlen - 2) * 8));
+    }
+}
+
 void write_trace_8(uint8_t type, uint32_t  packlen, uint32_t value)
 {
+    struct csky_trace_ring *r;
+
+    if (traceserver.delta) {
+        write_delta_8(type, packlen, value);
+        return;
+    }
     value =  (value << 8) | type;
 
-    write_trace_before(packlen, false);
+    r = trace_stage_reserve(packlen, false);
 
-    assert((traceserver.pos + packlen) <= traceserver.len);
-    csky_trace_compress(packlen, (char *)&value);
+    assert((r->pos + packlen) <= r->len);
+    csky_trace_compress(r, packlen, (char *)&value);
 }
 
 void write_trace_8_8(uint8_t type, uint32_t packlen, uint8_t value1
     , uint32_t value2)
 {
     uint64_t value = type;
+    struct csky_trace_ring *r;
+
+    if (traceserver.delta) {
+        write_delta_8_8(type, packlen, value1, value2);
+        return;
+    }
     value = ((uint64_t)value1 << 8) | value;
     value = ((uint64_t)value2 << 16 * sizeof(uint8_t)) | value;
 
-    write_trace_before(packlen, false);
-    assert((traceserver.pos + packlen) <= traceserver.len);
-    csky_trace_compress(packlen, (char *)&value);
+    r = trace_stage_reserve(packlen, false);
+    assert((r->pos + packlen) <= r->len);
+    csky_trace_compress(r, packlen, (char *)&value);
 }
 
 void write_trace_8_24(uint8_t type, uint32_t packlen, uint32_t value1,
     uint32_t value2)
 {
     uint64_t value = type;
+    struct csky_trace_ring *r;
+
+    if (traceserver.delta) {
+        r = trace_stage_reserve(TRACE_DELTA_MAXLEN, false);
+        trace_put_byte(r, type);
+        trace_put_varint(r, value1 & MAKE_64BIT_MASK(0, 24));
+        trace_put_varint(r, value2);
+        return;
+    }
     value = ((uint64_t)value1 << 8) | value;
     value = ((uint64_t)value2 << 32 * sizeof(uint8_t)) | value;
 
-    write_trace_before(packlen, false);
-    assert((traceserver.pos + packlen) <= traceserver.len);
-    csky_trace_compress(packlen, (char *)&value);
+    r = trace_stage_reserve(packlen, false);
+    assert((r->pos + packlen) <= r->len);
+    csky_trace_compress(r, packlen, (char *)&value);
 }
 /*
 void write_trace_8_seq(uint8_t type, uint32_t packlen, uint8_t *value)
@@ -384,6 +956,76 @@ void write_trace_8_seq(uint8_t type, uint32_t packlen, uint8_t *value)
     memcpy(traceserver.buf + traceserver.pos + 1 , value, packlen - 1);
     traceserver.pos += packlen / sizeof(uint8_t);
 }*/
+/* Write the trace to a file instead of waiting for a trace client */
+int traceserver_start_file(const char *path)
+{
+    QemuOpts *opts = qemu_opts_find(qemu_find_opts("csky-trace"), NULL);
+    struct csky_trace_file *tf;
+    struct csky_trace_file_header *hdr;
+    uint64_t chunk = TRACE_FILE_CHUNK;
+    Error *err = NULL;
+    int fd;
+
+    if (opts) {
+        chunk = qemu_opt_get_size(opts, "file_chunk", TRACE_FILE_CHUNK);
+    }
+    if (chunk == 0 || chunk > UINT32_MAX ||
+        chunk % qemu_real_host_page_size()) {
+        error_report("csky-trace: file_chunk must be a multiple of the "
+                     "host page size");
+        return -1;
+    }
+    fd = qemu_create(path, O_RDWR | O_TRUNC, 0644, &err);
+    if (fd < 0) {
+        error_report_err(err);
+        return -1;
+    }
+    /*
+     * The header stays mapped and data_end follows the stream, so a file
+     * left behind by a QEMU that did not exit cleanly is still readable up
+     * to there. It has no index, which is written at close.
+     */
+    if (ftruncate(fd, TRACE_FILE_HEADER_LEN) < 0) {
+        error_report("csky-trace: cannot size trace file: %s",
+                     strerror(errno));
+        close(fd);
+        return -1;
+    }
+    hdr = mmap(NULL, TRACE_FILE_HEADER_LEN, PROT_READ | PROT_WRITE,
+               MAP_SHARED, fd, 0);
+    if (hdr == MAP_FAILED) {
+        error_report("csky-trace: cannot map trace file: %s",
+                     strerror(errno));
+        close(fd);
+        return -1;
+    }
+    hdr->magic = cpu_to_le64(TRACE_FILE_MAGIC);
+    hdr->version = cpu_to_le32(TRACE_FILE_VERSION);
+    hdr->chunk_size = cpu_to_le32(chunk);
+    hdr->data_end = cpu_to_le64(TRACE_FILE_HEADER_LEN);
+
+    tf = g_new0(struct csky_trace_file, 1);
+    tf->fd = fd;
+    tf->hdr = hdr;
+    tf->size = TRACE_FILE_HEADER_LEN;
+    tf->chunk_size = chunk;
+    tf->pos = TRACE_FILE_HEADER_LEN;
+    tf->index = g_array_new(false, false,
+                            sizeof(struct csky_trace_index_entry));
+    traceserver.file = tf;
+
+    trace_codec_setup();
+    trace_ring_setup();
+    traceserver.initok = true;
+    if (tfilter.enable) {
+        write_trace_header(tfilter.event);
+    }
+#ifndef CONFIG_USER_ONLY
+    atexit(trace_exit_notify);
+#endif
+    return 0;
+}
+
 #ifdef CONFIG_USER_ONLY
 
 static int traceserver_open(int port)
@@ -454,6 +1096,8 @@ int traceserver_start(int port, int debug_mode)
     if (traceserver_fd < 0) {
         return -1;
     }
+    trace_codec_setup();
+    trace_ring_setup();
     traceserver_accept();
     if (debug_mode) {
         tfilter.event |= TRACE_EVENT_GDB;
@@ -467,18 +1111,11 @@ int traceserver_start(int port, int debug_mode)
 
 void trace_exit_notify(void)
 {
-    if ((traceserver.buf != NULL) && (traceserver.initok != false)) {
-        if (traceserver.pos > 5 * sizeof(uint16_t)) {
-            traceserver.last_icount += traceserver.insn_num;
-            trace_add_syn();
-        }
-        send_packet();
-        close(traceserver.fd);
-        trace_buf_clear();
-        if (traceserver.buf != NULL) {
-            free(traceserver.buf);
-            traceserver.buf = NULL;
-        }
+    csky_trace_rec_sync_all();
+    if (traceserver.initok != false) {
+        trace_output_all();
+        trace_writer_stop();
+        trace_sink_close();
         traceserver.initok = false;
     }
     qemu_log_mask(LOG_GUEST_ERROR, "WADDR_NUM: %d\n", waddr_num);
@@ -513,20 +1150,12 @@ static void trace_chr_event(void *opaque, QEMUChrEvent event)
 
 void trace_exit_notify(void)
 {
-     if ((traceserver.buf != NULL) && (traceserver.initok != false)) {
-        if (traceserver.pos > 5 * sizeof(uint16_t)) {
-            traceserver.last_icount += traceserver.insn_num;
-            trace_add_syn();
-        }
+    csky_trace_rec_sync_all();
+    if (traceserver.initok != false) {
+        trace_output_all();
+        trace_writer_stop();
         traceserver.initok = false;
-        qemu_chr_fe_write_all(&traceserver.chr,
-                (const uint8_t *)traceserver.buf, traceserver.pos);
-        qemu_chr_fe_disconnect(&traceserver.chr);
-        trace_buf_clear();
-        if (traceserver.buf != NULL) {
-            free(traceserver.buf);
-            traceserver.buf = NULL;
-        }
+        trace_sink_close();
     }
 }
 
@@ -555,6 +1184,8 @@ int traceserver_start(const char *device)
         qemu_chr_fe_set_handlers(&traceserver.chr, NULL, NULL,
                                  trace_chr_event, NULL, NULL, NULL, true);
     }
+    trace_codec_setup();
+    trace_ring_setup();
     atexit(trace_exit_notify);
     return 0;
 }